@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <cassert>
 #include <csignal>
+#include <cstring>
 #include <iostream>
 #include <map>
 #include <string>
@@ -8,9 +9,14 @@
 typedef void (*sighandler_t)(int sig);
 
 #include "cereal/services.h"
+#include "cereal/messaging/bridge_batch.h"
 #include "msgq/impl_msgq.h"
 #include "msgq/impl_zmq.h"
 
+const int BATCH_DEFAULT_PORT = 8022;
+// flush early so a single packet stays well below zmq's and the receiver's limits
+const size_t BATCH_MAX_SIZE = 16 * 1024 * 1024;
+
 std::atomic<bool> do_exit = false;
 static void set_do_exit(int sig) {
   do_exit = true;
@@ -34,11 +40,158 @@ static std::vector<std::string> get_services(std::string whitelist_str, bool zmq
   return service_list;
 }
 
+// "carState:10,can:5" -> forward every 10th carState and every 5th can message
+static std::map<std::string, int> parse_decimation(const std::string &arg) {
+  std::map<std::string, int> decimation;
+  size_t start = 0;
+  while (start < arg.size()) {
+    size_t end = arg.find(',', start);
+    if (end == std::string::npos) end = arg.size();
+    std::string item = arg.substr(start, end - start);
+    size_t sep = item.find(':');
+    if (sep != std::string::npos) {
+      decimation[item.substr(0, sep)] = std::max(1, atoi(item.c_str() + sep + 1));
+    }
+    start = end + 1;
+  }
+  return decimation;
+}
+
+static void send_packet(PubSocket *sock, const std::string &packet) {
+  int ret;
+  do {
+    ret = sock->send((char *)packet.data(), packet.size());
+  } while (ret == -1 && errno == EINTR && !do_exit);
+  assert(ret >= 0 || do_exit || errno == EAGAIN);
+}
+
+// msgq -> one zmq stream. everything received in a poll cycle goes out as a single packet
+static int run_batch_sender(int port, int zstd_level, const std::map<std::string, int> &decimation) {
+  struct Service {
+    std::string name;
+    int decimation = 1;
+    uint64_t count = 0;
+  };
+
+  MSGQContext sub_context;
+  ZMQContext pub_context;
+  MSGQPoller poller;
+  ZMQPubSocket pub_sock;
+  int ret = pub_sock.connect(&pub_context, std::to_string(port), false);
+  assert(ret == 0);
+
+  std::map<SubSocket*, Service> sub2service;
+  for (auto endpoint : get_services("", false)) {
+    SubSocket *sub_sock = new MSGQSubSocket();
+    sub_sock->connect(&sub_context, endpoint, "127.0.0.1", false);
+    poller.registerSocket(sub_sock);
+
+    auto it = decimation.find(endpoint);
+    sub2service[sub_sock] = {endpoint, it != decimation.end() ? it->second : 1};
+  }
+
+  BridgeBatchWriter writer(zstd_level);
+  while (!do_exit) {
+    for (auto sub_sock : poller.poll(100)) {
+      Service &service = sub2service.at(sub_sock);
+      // drain the queue, a cycle can have several messages per service
+      while (Message *msg = sub_sock->receive(true)) {
+        if (service.count++ % service.decimation == 0) {
+          writer.add(service.name, msg->getData(), msg->getSize());
+        }
+        delete msg;
+        if (writer.size() > BATCH_MAX_SIZE) send_packet(&pub_sock, writer.finish());
+      }
+    }
+    if (writer.count() > 0) send_packet(&pub_sock, writer.finish());
+  }
+
+  for (auto &[sub_sock, _] : sub2service) delete sub_sock;
+  return 0;
+}
+
+// batched zmq stream -> msgq
+static int run_batch_receiver(const std::string &ip, int port, const std::string &whitelist_str) {
+  ZMQContext sub_context;
+  MSGQContext pub_context;
+  ZMQSubSocket sub_sock;
+  int ret = sub_sock.connect(&sub_context, std::to_string(port), ip, false, false);
+  assert(ret == 0);
+  sub_sock.setTimeout(100);
+
+  std::map<std::string, PubSocket*> pub_socks;
+  for (auto endpoint : get_services(whitelist_str, !whitelist_str.empty())) {
+    PubSocket *pub_sock = new MSGQPubSocket();
+    pub_sock->connect(&pub_context, endpoint);
+    pub_socks[endpoint] = pub_sock;
+  }
+
+  BridgeBatchReader reader;
+  while (!do_exit) {
+    Message *msg = sub_sock.receive();
+    if (msg == NULL) continue;
+
+    bool ok = reader.read(msg->getData(), msg->getSize(), [&](const std::string &name, const char *data, size_t size) {
+      auto it = pub_socks.find(name);
+      if (it != pub_socks.end()) it->second->send((char *)data, size);
+    });
+    if (!ok) std::cout << "dropping malformed packet of size " << msg->getSize() << std::endl;
+    delete msg;
+  }
+
+  for (auto &[_, pub_sock] : pub_socks) delete pub_sock;
+  return 0;
+}
+
+static void usage(const char *name) {
+  std::cout << "usage: " << name << "                                  msgq -> zmq, one socket per service" << std::endl
+            << "       " << name << " <ip> <whitelist>                  zmq -> msgq, one socket per service" << std::endl
+            << "       " << name << " --batch [--port N] [--zstd LEVEL] [--decimate svc:N,...]" << std::endl
+            << "                                                   msgq -> zmq, one batched stream" << std::endl
+            << "       " << name << " --batch-recv <ip> [--port N] [--whitelist svc,...]" << std::endl
+            << "                                                   batched zmq stream -> msgq" << std::endl;
+}
+
 int main(int argc, char** argv) {
   signal(SIGPIPE, (sighandler_t)sigpipe_handler);
   signal(SIGINT, (sighandler_t)set_do_exit);
   signal(SIGTERM, (sighandler_t)set_do_exit);
 
+  if (argc > 1 && strncmp(argv[1], "--", 2) == 0) {
+    bool batch_recv = strcmp(argv[1], "--batch-recv") == 0;
+    if (!batch_recv && strcmp(argv[1], "--batch") != 0) {
+      usage(argv[0]);
+      return 1;
+    }
+
+    int i = 2;
+    std::string ip = "127.0.0.1";
+    if (batch_recv) {
+      if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+      }
+      ip = argv[i++];
+    }
+
+    int port = BATCH_DEFAULT_PORT, zstd_level = 0;
+    std::string whitelist_str, decimation_str;
+    for (; i + 1 < argc; i += 2) {
+      std::string opt = argv[i];
+      if (opt == "--port") port = atoi(argv[i + 1]);
+      else if (opt == "--zstd") zstd_level = atoi(argv[i + 1]);
+      else if (opt == "--decimate") decimation_str = argv[i + 1];
+      else if (opt == "--whitelist") whitelist_str = argv[i + 1];
+      else break;
+    }
+    if (i != argc) {
+      usage(argv[0]);
+      return 1;
+    }
+    return batch_recv ? run_batch_receiver(ip, port, whitelist_str)
+                      : run_batch_sender(port, zstd_level, parse_decimation(decimation_str));
+  }
+
   bool zmq_to_msgq = argc > 2;
   std::string ip = zmq_to_msgq ? argv[1] : "127.0.0.1";
   std::string whitelist_str = zmq_to_msgq ? std::string(argv[2]) : "";
@@ -0,0 +1,106 @@
+#include "cereal/messaging/bridge_batch.h"
+
+#include <cassert>
+#include <cstring>
+
+#include "common/timing.h"
+
+BridgeBatchWriter::BridgeBatchWriter(int zstd_level) : zstd_level_(zstd_level) {
+  if (zstd_level_ > 0) {
+    cctx_ = ZSTD_createCCtx();
+    assert(cctx_ != nullptr);
+  }
+}
+
+BridgeBatchWriter::~BridgeBatchWriter() {
+  ZSTD_freeCCtx(cctx_);
+}
+
+void BridgeBatchWriter::add(const std::string &name, const char *data, size_t size) {
+  assert(name.size() <= UINT8_MAX && size <= UINT32_MAX);
+  uint8_t name_size = name.size();
+  uint32_t data_size = size;
+  payload_.append((const char *)&name_size, sizeof(name_size));
+  payload_.append(name);
+  payload_.append((const char *)&data_size, sizeof(data_size));
+  payload_.append(data, size);
+  count_++;
+}
+
+const std::string &BridgeBatchWriter::finish() {
+  BridgeBatchHeader header = {
+    .magic = BRIDGE_BATCH_MAGIC,
+    .version = BRIDGE_BATCH_VERSION,
+    .compression = cctx_ ? BRIDGE_BATCH_ZSTD : BRIDGE_BATCH_RAW,
+    .reserved = 0,
+    .num_msgs = count_,
+    .payload_size = (uint32_t)payload_.size(),
+    .send_time = nanos_since_epoch(),
+  };
+
+  if (cctx_) {
+    packet_.resize(sizeof(header) + ZSTD_compressBound(payload_.size()));
+    size_t compressed_size = ZSTD_compressCCtx(cctx_, packet_.data() + sizeof(header), packet_.size() - sizeof(header),
+                                               payload_.data(), payload_.size(), zstd_level_);
+    assert(!ZSTD_isError(compressed_size));
+    packet_.resize(sizeof(header) + compressed_size);
+  } else {
+    packet_.resize(sizeof(header));
+    packet_.append(payload_);
+  }
+  memcpy(packet_.data(), &header, sizeof(header));
+
+  payload_.clear();
+  count_ = 0;
+  return packet_;
+}
+
+BridgeBatchReader::BridgeBatchReader() {
+  dctx_ = ZSTD_createDCtx();
+  assert(dctx_ != nullptr);
+}
+
+BridgeBatchReader::~BridgeBatchReader() {
+  ZSTD_freeDCtx(dctx_);
+}
+
+bool BridgeBatchReader::read(const char *data, size_t size, const std::function<void(const std::string &name, const char *data, size_t size)> &fn) {
+  BridgeBatchHeader header;
+  if (size < sizeof(header)) return false;
+  memcpy(&header, data, sizeof(header));
+  if (header.magic != BRIDGE_BATCH_MAGIC || header.version != BRIDGE_BATCH_VERSION) return false;
+  send_time_ = header.send_time;
+
+  const char *payload = data + sizeof(header);
+  size_t payload_size = size - sizeof(header);
+  if (header.compression == BRIDGE_BATCH_ZSTD) {
+    // the header comes off the network, only allocate what the zstd frame says it holds
+    const unsigned long long content_size = ZSTD_getFrameContentSize(payload, payload_size);
+    if (content_size != header.payload_size || content_size > BRIDGE_BATCH_MAX_PAYLOAD) return false;
+    payload_.resize(header.payload_size);
+    size_t ret = ZSTD_decompressDCtx(dctx_, payload_.data(), payload_.size(), payload, payload_size);
+    if (ZSTD_isError(ret) || ret != header.payload_size) return false;
+    payload = payload_.data();
+    payload_size = payload_.size();
+  } else if (header.compression != BRIDGE_BATCH_RAW || payload_size != header.payload_size) {
+    return false;
+  }
+
+  size_t ptr = 0;
+  for (uint32_t i = 0; i < header.num_msgs; i++) {
+    uint8_t name_size;
+    uint32_t msg_size;
+    if (ptr + sizeof(name_size) > payload_size) return false;
+    memcpy(&name_size, payload + ptr, sizeof(name_size));
+    ptr += sizeof(name_size);
+    if (ptr + name_size + sizeof(msg_size) > payload_size) return false;
+    name_.assign(payload + ptr, name_size);
+    ptr += name_size;
+    memcpy(&msg_size, payload + ptr, sizeof(msg_size));
+    ptr += sizeof(msg_size);
+    if (ptr + msg_size > payload_size) return false;
+    fn(name_, payload + ptr, msg_size);
+    ptr += msg_size;
+  }
+  return ptr == payload_size;
+}
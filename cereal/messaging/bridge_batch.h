@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include <zstd.h>
+
+// Framing for the batched bridge mode: all messages received in one poll cycle are sent as
+// one packet, optionally zstd compressed.
+//
+// packet: BridgeBatchHeader + payload (compressed if header.compression == 1)
+// payload: repeated [uint8 name_size][name][uint32 size][data]
+
+const uint32_t BRIDGE_BATCH_MAGIC = 0x42524447;  // "BRDG"
+const uint16_t BRIDGE_BATCH_VERSION = 1;
+// a bigger decompressed payload is rejected rather than allocated
+const uint32_t BRIDGE_BATCH_MAX_PAYLOAD = 64 << 20;
+
+enum BridgeBatchCompression : uint8_t {
+  BRIDGE_BATCH_RAW = 0,
+  BRIDGE_BATCH_ZSTD = 1,
+};
+
+struct BridgeBatchHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint8_t compression;
+  uint8_t reserved;
+  uint32_t num_msgs;
+  uint32_t payload_size;  // uncompressed
+  uint64_t send_time;     // nanos_since_epoch of the sender
+};
+
+class BridgeBatchWriter {
+public:
+  // zstd_level 0 disables compression
+  BridgeBatchWriter(int zstd_level = 0);
+  ~BridgeBatchWriter();
+  void add(const std::string &name, const char *data, size_t size);
+  inline size_t size() const { return payload_.size(); }
+  inline uint32_t count() const { return count_; }
+  // returns the framed packet for all messages added since the last call
+  const std::string &finish();
+
+private:
+  int zstd_level_;
+  ZSTD_CCtx *cctx_ = nullptr;
+  uint32_t count_ = 0;
+  std::string payload_;
+  std::string packet_;
+};
+
+class BridgeBatchReader {
+public:
+  BridgeBatchReader();
+  ~BridgeBatchReader();
+  // calls fn for every message in the packet, returns false if the packet is malformed
+  bool read(const char *data, size_t size, const std::function<void(const std::string &name, const char *data, size_t size)> &fn);
+  inline uint64_t sendTime() const { return send_time_; }
+
+private:
+  ZSTD_DCtx *dctx_ = nullptr;
+  uint64_t send_time_ = 0;
+  std::string name_;
+  std::string payload_;
+};
@@ -21,6 +21,16 @@
 
 class SubMaster {
 public:
+  // a service slot resolved once with handle(), indexes the flat service array without any string lookups
+  class Handle {
+  public:
+    Handle() = default;
+  private:
+    explicit Handle(int index) : index_(index) {}
+    int index_ = -1;
+    friend class SubMaster;
+  };
+
   SubMaster(const std::vector<const char *> &service_list, const std::vector<const char *> &poll = {},
             const char *address = nullptr, const std::vector<const char *> &ignore_alive = {});
   void update(int timeout = 1000);
@@ -32,24 +42,39 @@ public:
   ~SubMaster();
 
   uint64_t frame = 0;
-  bool updated(const char *name) const;
-  bool alive(const char *name) const;
-  bool valid(const char *name) const;
-  uint64_t rcv_frame(const char *name) const;
-  uint64_t rcv_time(const char *name) const;
-  cereal::Event::Reader &operator[](const char *name) const;
+  Handle handle(const char *name) const;
+  bool updated(Handle h) const;
+  bool alive(Handle h) const;
+  bool valid(Handle h) const;
+  uint64_t rcv_frame(Handle h) const;
+  uint64_t rcv_time(Handle h) const;
+  cereal::Event::Reader &operator[](Handle h) const;
+
+  inline bool updated(const char *name) const { return updated(handle(name)); }
+  inline bool alive(const char *name) const { return alive(handle(name)); }
+  inline bool valid(const char *name) const { return valid(handle(name)); }
+  inline uint64_t rcv_frame(const char *name) const { return rcv_frame(handle(name)); }
+  inline uint64_t rcv_time(const char *name) const { return rcv_time(handle(name)); }
+  inline cereal::Event::Reader &operator[](const char *name) const { return (*this)[handle(name)]; }
 
 private:
+  struct SubMessage;
+  SubMessage *find_(SubSocket *socket) const;
+  void update_msg_(SubMessage *m, uint64_t current_time, const cereal::Event::Reader &event);
+  void update_alive_(uint64_t current_time);
   bool all_(const std::vector<const char *> &service_list, bool valid, bool alive);
   Poller *poller_ = nullptr;
-  struct SubMessage;
-  std::map<SubSocket *, SubMessage *> messages_;
-  std::map<std::string, SubMessage *> services_;
+  std::vector<SubMessage *> messages_;
+  // sorted by socket, for the lookups of polled sockets in update()
+  std::vector<std::pair<SubSocket *, SubMessage *>> sockets_;
+  std::map<std::string, int> services_;
 };
 
 class MessageBuilder : public capnp::MallocMessageBuilder {
 public:
   MessageBuilder() = default;
+  // first_segment must be zeroed, it's cleared again on destruction so it can be reused
+  MessageBuilder(kj::ArrayPtr<capnp::word> first_segment) : capnp::MallocMessageBuilder(first_segment) {}
 
   cereal::Event::Builder initEvent(bool valid = true) {
     cereal::Event::Builder event = initRoot<cereal::Event>();
@@ -1,6 +1,7 @@
 #include <time.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <algorithm>
 #include <string>
 #include <mutex>
 
@@ -70,42 +71,52 @@ SubMaster::SubMaster(const std::vector<const char *> &service_list, const std::v
       .allocated_msg_reader = malloc(sizeof(capnp::FlatArrayMessageReader)),
       .is_polled = is_polled};
     m->msg_reader = new (m->allocated_msg_reader) capnp::FlatArrayMessageReader({});
-    messages_[socket] = m;
-    services_[name] = m;
+    services_[name] = messages_.size();
+    messages_.push_back(m);
+    sockets_.push_back({socket, m});
   }
+  std::sort(sockets_.begin(), sockets_.end());
+}
+
+SubMaster::Handle SubMaster::handle(const char *name) const {
+  return Handle(services_.at(name));
+}
+
+SubMaster::SubMessage *SubMaster::find_(SubSocket *socket) const {
+  auto it = std::lower_bound(sockets_.begin(), sockets_.end(), socket, [](auto &kv, SubSocket *s) { return kv.first < s; });
+  assert(it != sockets_.end() && it->first == socket);
+  return it->second;
 }
 
 void SubMaster::update(int timeout) {
-  for (auto &kv : messages_) kv.second->updated = false;
+  for (SubMessage *m : messages_) m->updated = false;
 
   auto sockets = poller_->poll(timeout);
 
-  // add non-polled sockets for non-blocking receive
-  for (auto &kv : messages_) {
-    SubMessage *m = kv.second;
-    SubSocket *s = kv.first;
-    if (!m->is_polled) sockets.push_back(s);
-  }
-
   uint64_t current_time = nanos_since_boot();
+  if (++frame == UINT64_MAX) frame = 1;
 
-  std::vector<std::pair<std::string, cereal::Event::Reader>> messages;
-
-  for (auto s : sockets) {
-    Message *msg = s->receive(true);
-    if (msg == nullptr) continue;
-
-    SubMessage *m = messages_.at(s);
+  auto receive = [&](SubMessage *m) {
+    Message *msg = m->socket->receive(true);
+    if (msg == nullptr) return;
 
     m->msg_reader->~FlatArrayMessageReader();
     capnp::ReaderOptions options;
     options.traversalLimitInWords = kj::maxValue; // Don't limit
     m->msg_reader = new (m->allocated_msg_reader) capnp::FlatArrayMessageReader(m->aligned_buf.align(msg), options);
     delete msg;
-    messages.push_back({m->name, m->msg_reader->getRoot<cereal::Event>()});
+    update_msg_(m, current_time, m->msg_reader->getRoot<cereal::Event>());
+  };
+
+  for (auto s : sockets) {
+    receive(find_(s));
+  }
+  // non-polled sockets are checked with a non-blocking receive
+  for (SubMessage *m : messages_) {
+    if (!m->is_polled) receive(m);
   }
 
-  update_msgs(current_time, messages);
+  update_alive_(current_time);
 }
 
 void SubMaster::update_msgs(uint64_t current_time, const std::vector<std::pair<std::string, cereal::Event::Reader>> &messages){
@@ -116,18 +127,24 @@ void SubMaster::update_msgs(uint64_t current_time, const std::vector<std::pair<s
     if (m_find == services_.end()){
       continue;
     }
-    SubMessage *m = m_find->second;
-    m->event = kv.second;
-    m->updated = true;
-    m->rcv_time = current_time;
-    m->rcv_frame = frame;
-    m->valid = m->event.getValid();
-    if (SIMULATION) m->alive = true;
+    update_msg_(messages_[m_find->second], current_time, kv.second);
   }
 
+  update_alive_(current_time);
+}
+
+void SubMaster::update_msg_(SubMessage *m, uint64_t current_time, const cereal::Event::Reader &event) {
+  m->event = event;
+  m->updated = true;
+  m->rcv_time = current_time;
+  m->rcv_frame = frame;
+  m->valid = m->event.getValid();
+  if (SIMULATION) m->alive = true;
+}
+
+void SubMaster::update_alive_(uint64_t current_time) {
   if (!SIMULATION) {
-    for (auto &kv : messages_) {
-      SubMessage *m = kv.second;
+    for (SubMessage *m : messages_) {
       m->alive = (m->freq <= (1e-5) || ((current_time - m->rcv_time) * (1e-9)) < (10.0 / m->freq));
     }
   }
@@ -135,8 +152,7 @@ void SubMaster::update_msgs(uint64_t current_time, const std::vector<std::pair<s
 
 bool SubMaster::all_(const std::vector<const char *> &service_list, bool valid, bool alive) {
   int found = 0;
-  for (auto &kv : messages_) {
-    SubMessage *m = kv.second;
+  for (SubMessage *m : messages_) {
     if (service_list.size() == 0 || inList(service_list, m->name.c_str())) {
       found += (!valid || m->valid) && (!alive || (m->alive || m->ignore_alive));
     }
@@ -157,34 +173,33 @@ void SubMaster::drain() {
   }
 }
 
-bool SubMaster::updated(const char *name) const {
-  return services_.at(name)->updated;
+bool SubMaster::updated(Handle h) const {
+  return messages_.at(h.index_)->updated;
 }
 
-bool SubMaster::alive(const char *name) const {
-  return services_.at(name)->alive;
+bool SubMaster::alive(Handle h) const {
+  return messages_.at(h.index_)->alive;
 }
 
-bool SubMaster::valid(const char *name) const {
-  return services_.at(name)->valid;
+bool SubMaster::valid(Handle h) const {
+  return messages_.at(h.index_)->valid;
 }
 
-uint64_t SubMaster::rcv_frame(const char *name) const {
-  return services_.at(name)->rcv_frame;
+uint64_t SubMaster::rcv_frame(Handle h) const {
+  return messages_.at(h.index_)->rcv_frame;
 }
 
-uint64_t SubMaster::rcv_time(const char *name) const {
-  return services_.at(name)->rcv_time;
+uint64_t SubMaster::rcv_time(Handle h) const {
+  return messages_.at(h.index_)->rcv_time;
 }
 
-cereal::Event::Reader &SubMaster::operator[](const char *name) const {
-  return services_.at(name)->event;
+cereal::Event::Reader &SubMaster::operator[](Handle h) const {
+  return messages_.at(h.index_)->event;
 }
 
 SubMaster::~SubMaster() {
   delete poller_;
-  for (auto &kv : messages_) {
-    SubMessage *m = kv.second;
+  for (SubMessage *m : messages_) {
     m->msg_reader->~FlatArrayMessageReader();
     free(m->allocated_msg_reader);
     delete m->socket;
@@ -0,0 +1,138 @@
+// Loopback benchmark for the bridge transports: one zmq message per msgq message, batched, and batched + zstd.
+// Synthetic messages are sent in 10ms cycles over tcp://127.0.0.1, reports throughput and end-to-end latency.
+// usage: ./bench_bridge [seconds] [rate multiplier]
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cereal/messaging/bridge_batch.h"
+#include "common/timing.h"
+#include "msgq/impl_zmq.h"
+
+const int PORT = 8021;
+const int CYCLE_MS = 10;
+
+struct SyntheticService {
+  std::string name;
+  int frequency;
+  size_t size;
+};
+
+// roughly what a device streams for live tools
+const std::vector<SyntheticService> SERVICES = {
+  {"can", 100, 3000}, {"sendcan", 100, 300}, {"carState", 100, 700}, {"carControl", 100, 500},
+  {"controlsState", 100, 1200}, {"accelerometer", 100, 100}, {"gyroscope", 100, 100},
+  {"modelV2", 20, 25000}, {"radarState", 20, 900}, {"longitudinalPlan", 20, 1500}, {"liveLocationKalman", 20, 2500},
+  {"deviceState", 2, 900}, {"pandaStates", 10, 300},
+};
+
+struct Result {
+  uint64_t msgs = 0, raw_bytes = 0, wire_bytes = 0;
+  std::vector<double> latency_ms;
+};
+
+// capnp messages are mostly small integers and zero padding, mimic that so compression ratios are realistic
+static std::string make_payload(std::mt19937 &rng, size_t size) {
+  std::string data(size, '\0');
+  for (size_t i = 0; i < size; i += 8) {
+    if (rng() % 3 == 0) data[i] = rng() & 0xff;
+    if (rng() % 5 == 0) data[i + 1 < size ? i + 1 : i] = rng() & 0xff;
+  }
+  return data;
+}
+
+static Result run(const char *mode, double seconds, int rate_mult, bool batch, int zstd_level) {
+  ZMQContext pub_context, sub_context;
+  ZMQPubSocket pub_sock;
+  ZMQSubSocket sub_sock;
+  assert(pub_sock.connect(&pub_context, std::to_string(PORT), false) == 0);
+  assert(sub_sock.connect(&sub_context, std::to_string(PORT), "127.0.0.1", false, false) == 0);
+  sub_sock.setTimeout(100);
+  // wait for the subscription to propagate
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  Result result;
+  std::atomic<bool> sending = true;
+  std::thread receiver([&]() {
+    BridgeBatchReader reader;
+    while (true) {
+      Message *msg = sub_sock.receive();
+      if (msg == NULL) {
+        if (!sending) break;
+        continue;
+      }
+      uint64_t now = nanos_since_epoch();
+      result.wire_bytes += msg->getSize();
+      auto handle = [&](const char *data, size_t size) {
+        uint64_t sent;
+        memcpy(&sent, data, sizeof(sent));
+        result.latency_ms.push_back((now - sent) * 1e-6);
+        result.raw_bytes += size;
+        result.msgs++;
+      };
+      if (batch) {
+        bool ok = reader.read(msg->getData(), msg->getSize(), [&](const std::string &, const char *data, size_t size) { handle(data, size); });
+        assert(ok);
+      } else {
+        handle(msg->getData(), msg->getSize());
+      }
+      delete msg;
+    }
+  });
+
+  std::mt19937 rng(0);
+  std::vector<std::string> payloads;
+  for (auto &s : SERVICES) payloads.push_back(make_payload(rng, s.size));
+
+  BridgeBatchWriter writer(zstd_level);
+  auto start = std::chrono::steady_clock::now();
+  for (int cycle = 0; cycle * CYCLE_MS < seconds * 1000; cycle++) {
+    for (size_t i = 0; i < SERVICES.size(); i++) {
+      int per_second = SERVICES[i].frequency * rate_mult;
+      // number of messages of this service due in this cycle
+      int n = (per_second * (cycle + 1) * CYCLE_MS) / 1000 - (per_second * cycle * CYCLE_MS) / 1000;
+      for (int j = 0; j < n; j++) {
+        uint64_t t = nanos_since_epoch();
+        memcpy(payloads[i].data(), &t, sizeof(t));
+        if (batch) {
+          writer.add(SERVICES[i].name, payloads[i].data(), payloads[i].size());
+        } else {
+          pub_sock.send(payloads[i].data(), payloads[i].size());
+        }
+      }
+    }
+    if (batch && writer.count() > 0) {
+      const std::string &packet = writer.finish();
+      pub_sock.send((char *)packet.data(), packet.size());
+    }
+    std::this_thread::sleep_until(start + std::chrono::milliseconds((cycle + 1) * CYCLE_MS));
+  }
+  sending = false;
+  receiver.join();
+
+  std::sort(result.latency_ms.begin(), result.latency_ms.end());
+  auto pct = [&](double p) { return result.latency_ms.empty() ? 0.0 : result.latency_ms[(size_t)(p * (result.latency_ms.size() - 1))]; };
+  printf("%-12s %9.0f msgs/s %8.2f MB/s raw %8.2f MB/s wire   latency p50 %6.2f ms p99 %6.2f ms max %6.2f ms\n",
+         mode, result.msgs / seconds, result.raw_bytes / seconds / 1e6, result.wire_bytes / seconds / 1e6,
+         pct(0.5), pct(0.99), pct(1.0));
+  return result;
+}
+
+int main(int argc, char *argv[]) {
+  const double seconds = argc > 1 ? atof(argv[1]) : 5.0;
+  const int rate_mult = argc > 2 ? atoi(argv[2]) : 1;
+
+  run("unbatched", seconds, rate_mult, false, 0);
+  run("batched", seconds, rate_mult, true, 0);
+  run("batched+zstd", seconds, rate_mult, true, 3);
+  return 0;
+}
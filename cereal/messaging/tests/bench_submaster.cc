@@ -0,0 +1,67 @@
+// benchmarks one SubMaster update cycle with 30 services, comparing string and handle lookups
+// usage: ./bench_submaster [iterations]
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "cereal/messaging/messaging.h"
+#include "cereal/services.h"
+#include "common/timing.h"
+
+const int NUM_SERVICES = 30;
+
+int main(int argc, char *argv[]) {
+  const int iterations = argc > 1 ? atoi(argv[1]) : 10000;
+
+  std::vector<const char *> names;
+  for (auto &[name, _] : services) {
+    if (names.size() == NUM_SERVICES) break;
+    names.push_back(name.c_str());
+  }
+
+  PubMaster pm(names);
+  SubMaster sm(names);
+  std::vector<SubMaster::Handle> handles;
+  for (auto name : names) handles.push_back(sm.handle(name));
+
+  MessageBuilder msg;
+  msg.initEvent();
+  auto bytes = msg.toBytes();
+
+  auto publish_all = [&]() {
+    for (auto name : names) pm.send(name, bytes.begin(), bytes.size());
+  };
+
+  // let the subscribers connect
+  publish_all();
+  sm.update(100);
+
+  uint64_t update_ns = 0, string_ns = 0, handle_ns = 0;
+  int count = 0;
+  for (int i = 0; i < iterations; i++) {
+    publish_all();
+
+    uint64_t t0 = nanos_since_boot();
+    sm.update(0);
+    uint64_t t1 = nanos_since_boot();
+    for (auto name : names) {
+      if (sm.updated(name) && sm.alive(name) && sm.valid(name)) count += sm[name].getValid();
+    }
+    uint64_t t2 = nanos_since_boot();
+    for (auto h : handles) {
+      if (sm.updated(h) && sm.alive(h) && sm.valid(h)) count += sm[h].getValid();
+    }
+    uint64_t t3 = nanos_since_boot();
+
+    update_ns += t1 - t0;
+    string_ns += t2 - t1;
+    handle_ns += t3 - t2;
+  }
+
+  printf("%d services, %d iterations, %d lookups\n", NUM_SERVICES, iterations, count);
+  printf("update():         %8.2f us/cycle\n", update_ns / 1e3 / iterations);
+  printf("string accessors: %8.2f us/cycle\n", string_ns / 1e3 / iterations);
+  printf("handle accessors: %8.2f us/cycle\n", handle_ns / 1e3 / iterations);
+  return 0;
+}
@@ -40,6 +40,8 @@ _services: dict[str, tuple] = {
   "carOutput": (True, 100., 10),
   "longitudinalPlan": (True, 20., 5),
   "procLog": (True, 0.5, 15),
+  "procLogDelta": (False, 10.),  # live consumers only, procLog is logged
+  "rateKeeperStats": (True, 1.),
   "gpsLocationExternal": (True, 10., 10),
   "gpsLocation": (True, 1., 1),
   "ubloxGnss": (True, 10.),
@@ -1,11 +1,20 @@
 #include "common/clutil.h"
 
 #include <cassert>
+#include <cstring>
 #include <iostream>
+#include <functional>
 #include <memory>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 #include "common/util.h"
 #include "common/swaglog.h"
+#include "common/timing.h"
+#include "system/hardware/hw.h"
 
 namespace {  // helper functions
 
@@ -53,6 +62,157 @@ void cl_print_build_errors(cl_program program, cl_device_id device) {
   LOGE("build failed; status=%d, log: %s", status, log.c_str());
 }
 
+// ***** program binary cache *****
+
+// bump when the file layout changes
+const uint32_t CL_CACHE_MAGIC = 0x43504c43;  // "CLPC"
+const uint32_t CL_CACHE_VERSION = 1;
+
+struct ClCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key_hash;
+  uint64_t binary_size;
+};
+
+uint64_t fnv1a_64(const std::string &data, uint64_t hash = 0xcbf29ce484222325ULL) {
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// the -I dirs in the build args, in the order the compiler searches them
+std::vector<std::string> cl_include_dirs(const char *args) {
+  std::vector<std::string> dirs;
+  std::istringstream ss(args ? args : "");
+  for (std::string tok; ss >> tok;) {
+    if (tok == "-I") {
+      if (ss >> tok) dirs.push_back(tok);
+    } else if (tok.rfind("-I", 0) == 0) {
+      dirs.push_back(tok.substr(2));
+    }
+  }
+  dirs.push_back(".");
+  return dirs;
+}
+
+// hashes the contents of every header src includes, recursively. one that can't be found only
+// has its name hashed, the build fails on it anyway
+uint64_t cl_hash_includes(const std::string &src, const std::vector<std::string> &dirs, uint64_t hash, std::set<std::string> &seen) {
+  static const std::regex include_re(R"(^\s*#\s*include\s*[<"]([^>"]+)[>"])");
+  std::istringstream lines(src);
+  for (std::string line; std::getline(lines, line);) {
+    std::smatch m;
+    if (!std::regex_search(line, m, include_re)) continue;
+
+    const std::string name = m[1].str();
+    hash = fnv1a_64(name + '\0', hash);
+    for (const auto &dir : dirs) {
+      const std::string path = dir + "/" + name;
+      if (!util::file_exists(path)) continue;
+      if (seen.insert(path).second) {
+        const std::string header = util::read_file(path);
+        hash = cl_hash_includes(header, dirs, fnv1a_64(header, hash), seen);
+      }
+      break;
+    }
+  }
+  return hash;
+}
+
+// the cache key covers everything that can change the compiled output: source, included headers, build args and the device/driver
+uint64_t cl_cache_key(cl_device_id device_id, const std::string &src, const char *args) {
+  cl_platform_id platform = NULL;
+  CL_CHECK(clGetDeviceInfo(device_id, CL_DEVICE_PLATFORM, sizeof(platform), &platform, NULL));
+
+  std::set<std::string> seen;
+  uint64_t hash = fnv1a_64(src);
+  hash = cl_hash_includes(src, cl_include_dirs(args), hash, seen);
+  hash = fnv1a_64(std::string(args ? args : "") + '\0', hash);
+  hash = fnv1a_64(get_device_info(device_id, CL_DEVICE_NAME), hash);
+  hash = fnv1a_64(get_device_info(device_id, CL_DEVICE_VERSION), hash);
+  hash = fnv1a_64(get_device_info(device_id, CL_DRIVER_VERSION), hash);
+  hash = fnv1a_64(get_platform_info(platform, CL_PLATFORM_VERSION), hash);
+  return hash;
+}
+
+std::string cl_cache_path(uint64_t key_hash) {
+  return util::string_format("%s/%016llx.clbin", Path::cl_cache_root().c_str(), (unsigned long long)key_hash);
+}
+
+bool cl_cache_enabled() {
+  static const bool enabled = util::getenv("CL_CACHE_DISABLE", 0) == 0;
+  return enabled;
+}
+
+cl_program cl_cache_load(cl_context ctx, cl_device_id device_id, uint64_t key_hash, const char *args) {
+  const std::string path = cl_cache_path(key_hash);
+  std::string data = util::read_file(path);
+  if (data.empty()) return nullptr;
+
+  ClCacheHeader header = {};
+  if (data.size() < sizeof(header)) {
+    unlink(path.c_str());
+    return nullptr;
+  }
+  memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != CL_CACHE_MAGIC || header.version != CL_CACHE_VERSION || header.key_hash != key_hash ||
+      header.binary_size != data.size() - sizeof(header)) {
+    LOGW("discarding invalid cl cache entry %s", path.c_str());
+    unlink(path.c_str());
+    return nullptr;
+  }
+
+  size_t length = header.binary_size;
+  const uint8_t *binary = (const uint8_t *)data.data() + sizeof(header);
+  cl_int binary_status = CL_SUCCESS, err = CL_SUCCESS;
+  cl_program prg = clCreateProgramWithBinary(ctx, 1, &device_id, &length, &binary, &binary_status, &err);
+  if (err == CL_SUCCESS && binary_status == CL_SUCCESS) {
+    err = clBuildProgram(prg, 1, &device_id, args, NULL, NULL);
+  }
+  if (err != CL_SUCCESS || binary_status != CL_SUCCESS) {
+    // stale or corrupt binary, fall back to building from source
+    LOGW("failed to load cl cache entry %s: %s", path.c_str(), cl_get_error_string(err != CL_SUCCESS ? err : binary_status));
+    if (prg) clReleaseProgram(prg);
+    unlink(path.c_str());
+    return nullptr;
+  }
+  return prg;
+}
+
+void cl_cache_store(cl_program prg, uint64_t key_hash) {
+  size_t binary_size = 0;
+  if (clGetProgramInfo(prg, CL_PROGRAM_BINARY_SIZES, sizeof(binary_size), &binary_size, NULL) != CL_SUCCESS || binary_size == 0) {
+    return;
+  }
+
+  std::string data(sizeof(ClCacheHeader) + binary_size, '\0');
+  ClCacheHeader header = {CL_CACHE_MAGIC, CL_CACHE_VERSION, key_hash, binary_size};
+  memcpy(data.data(), &header, sizeof(header));
+  unsigned char *binary = (unsigned char *)data.data() + sizeof(header);
+  if (clGetProgramInfo(prg, CL_PROGRAM_BINARIES, sizeof(binary), &binary, NULL) != CL_SUCCESS) {
+    return;
+  }
+
+  // write to a temporary file and rename, so concurrent readers never see a partial entry
+  const std::string root = Path::cl_cache_root();
+  if (!util::create_directories(root, 0775)) {
+    LOGW("failed to create cl cache dir %s", root.c_str());
+    return;
+  }
+  const std::string path = cl_cache_path(key_hash);
+  // unique per thread, programs are built in parallel
+  const size_t tid = std::hash<std::thread::id>{}(std::this_thread::get_id());
+  const std::string tmp_path = path + util::string_format(".tmp%d.%zx", getpid(), tid);
+  if (util::write_file(tmp_path.c_str(), data.data(), data.size(), O_WRONLY | O_CREAT | O_TRUNC) != 0 ||
+      rename(tmp_path.c_str(), path.c_str()) != 0) {
+    LOGW("failed to write cl cache entry %s", path.c_str());
+    unlink(tmp_path.c_str());
+  }
+}
+
 }  // namespace
 
 cl_device_id cl_get_device_id(cl_device_type device_type) {
@@ -84,12 +244,26 @@ cl_program cl_program_from_file(cl_context ctx, cl_device_id device_id, const ch
 }
 
 cl_program cl_program_from_source(cl_context ctx, cl_device_id device_id, const std::string& src, const char* args) {
+  double start = millis_since_boot();
+  const bool use_cache = cl_cache_enabled();
+  const uint64_t key_hash = use_cache ? cl_cache_key(device_id, src, args) : 0;
+  if (use_cache) {
+    if (cl_program prg = cl_cache_load(ctx, device_id, key_hash, args)) {
+      LOGD("loaded cl program %016llx from cache in %.2f ms", (unsigned long long)key_hash, millis_since_boot() - start);
+      return prg;
+    }
+  }
+
   const char *csrc = src.c_str();
   cl_program prg = CL_CHECK_ERR(clCreateProgramWithSource(ctx, 1, &csrc, NULL, &err));
   if (int err = clBuildProgram(prg, 1, &device_id, args, NULL, NULL); err != 0) {
     cl_print_build_errors(prg, device_id);
     assert(0);
   }
+  if (use_cache) {
+    cl_cache_store(prg, key_hash);
+  }
+  LOGD("built cl program from source in %.2f ms", millis_since_boot() - start);
   return prg;
 }
 
@@ -0,0 +1,53 @@
+#include "common/decompress.h"
+
+#include <bzlib.h>
+#include <zstd.h>
+
+#include <algorithm>
+
+#include "common/util.h"
+
+namespace util {
+
+std::string decompress(const std::string &fn, const std::string &raw) {
+  std::string out;
+  if (util::ends_with(fn, ".bz2")) {
+    bz_stream bz = {};
+    BZ2_bzDecompressInit(&bz, 0, 0);
+    bz.next_in = (char *)raw.data();
+    bz.avail_in = raw.size();
+    int ret = BZ_OK;
+    while (ret == BZ_OK) {
+      out.resize(out.size() + std::max<size_t>(raw.size() * 4, 1 << 20));
+      bz.next_out = out.data() + bz.total_out_lo32 + ((size_t)bz.total_out_hi32 << 32);
+      bz.avail_out = out.data() + out.size() - bz.next_out;
+      ret = BZ2_bzDecompress(&bz);
+      // truncated, the input ran out before the end of the stream
+      if (ret == BZ_OK && bz.avail_in == 0 && bz.avail_out > 0) break;
+    }
+    out.resize(bz.total_out_lo32 + ((size_t)bz.total_out_hi32 << 32));
+    BZ2_bzDecompressEnd(&bz);
+    if (ret != BZ_STREAM_END) out.clear();
+  } else if (util::ends_with(fn, ".zst")) {
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    ZSTD_inBuffer in = {raw.data(), raw.size(), 0};
+    size_t ret = 1;
+    bool flushed = false;
+    // keep going while there's input left or the last call filled the output buffer
+    while ((in.pos < in.size || !flushed) && !ZSTD_isError(ret)) {
+      out.resize(out.size() + ZSTD_DStreamOutSize());
+      ZSTD_outBuffer o = {out.data(), out.size(), out.size() - ZSTD_DStreamOutSize()};
+      ret = ZSTD_decompressStream(dctx, &o, &in);
+      flushed = o.pos < o.size;
+      out.resize(o.pos);
+    }
+    ZSTD_freeDCtx(dctx);
+    // ret is 0 once a frame is complete, anything else is an error or a truncated frame
+    if (ret != 0) out.clear();
+  } else {
+    out = raw;
+  }
+  return out;
+}
+
+}  // namespace util
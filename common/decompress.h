@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+
+namespace util {
+
+// Decompresses the contents of a log by its file name, .bz2 and .zst files are decompressed
+// and anything else is returned as is. Returns an empty string if the data is corrupt.
+std::string decompress(const std::string &fn, const std::string &raw);
+
+}  // namespace util
@@ -1,11 +1,22 @@
 #include "common/params.h"
 
 #include <dirent.h>
+#include <pthread.h>
 #include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 
 #include <algorithm>
 #include <cassert>
 #include <csignal>
+#include <cstring>
+#include <ctime>
+#include <iterator>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 
 #include "common/queue.h"
@@ -13,6 +24,38 @@
 #include "common/util.h"
 #include "system/hardware/hw.h"
 
+// Values are cached in a segment in /dev/shm shared by every process using the same params path, so
+// reading a param is a copy instead of open/read/close, without any syscall. The files stay the source
+// of truth: slots are loaded from them on first read, and put/remove update the file, then the slot.
+// Files written behind Params' back (e.g. by launch_chffrplus.sh) are seen by a thread in every process
+// that inotify-watches the params directory and invalidates their slots, so those changes show up
+// once the event is handled, not right after the write.
+// Every slot is a seqlock, readers retry while seq is odd or changed during the copy.
+const uint32_t PARAMS_SHM_SLOTS = 2048;
+const size_t PARAMS_SHM_KEY_SIZE = 64;
+const size_t PARAMS_SHM_VALUE_SIZE = 512;
+
+enum ParamsSlotKey : uint32_t { SLOT_KEY_FREE = 0, SLOT_KEY_CLAIMING, SLOT_KEY_SET };
+// values larger than PARAMS_SHM_VALUE_SIZE are always read from the file
+enum ParamsSlotState : uint32_t { SLOT_UNLOADED = 0, SLOT_LOADED, SLOT_LARGE };
+
+struct ParamsSlot {
+  std::atomic<uint32_t> key_state;
+  std::atomic<uint32_t> seq;
+  std::atomic<uint32_t> version;  // bumped when the value changes
+  std::atomic<uint32_t> state;
+  std::atomic<uint32_t> size;
+  std::atomic<uint64_t> file_ino;  // of the file put() last renamed into place
+  char key[PARAMS_SHM_KEY_SIZE];
+  char value[PARAMS_SHM_VALUE_SIZE];
+};
+
+struct ParamsSegment {
+  std::atomic<uint64_t> dir_ino;
+  EventCount changes;
+  ParamsSlot slots[PARAMS_SHM_SLOTS];
+};
+
 namespace {
 
 volatile sig_atomic_t params_do_exit = 0;
@@ -87,6 +130,278 @@ private:
   int fd_ = -1;
 };
 
+uint32_t fnv1a(const std::string &s) {
+  uint32_t hash = 2166136261u;
+  for (unsigned char c : s) {
+    hash = (hash ^ c) * 16777619u;
+  }
+  return hash;
+}
+
+void invalidate_all(ParamsSegment *segment);
+bool watch_params_dir(ParamsSegment *segment, int lock_fd, const std::string &dir);
+
+// segments are mapped once per process and never unmapped. the shm fd stays open for the shared
+// flock that tells a starting watcher whether any other process was watching
+struct ParamsMapping {
+  std::string shm_path;
+  ParamsSegment *segment = nullptr;
+  int lock_fd = -1;  // set while a watcher runs
+};
+std::mutex segments_lock;
+std::unordered_map<std::string, ParamsMapping> segments;
+
+// a forked child has no watcher thread, and must not keep the parent's flock alive
+void segments_atfork_prepare() { segments_lock.lock(); }
+void segments_atfork_parent() { segments_lock.unlock(); }
+void segments_atfork_child() {
+  for (auto &[path, mapping] : segments) {
+    if (mapping.lock_fd >= 0) {
+      close(mapping.lock_fd);
+      mapping.lock_fd = -1;
+    }
+  }
+  segments_lock.unlock();
+}
+
+ParamsSegment *params_segment(const std::string &path) {
+#ifdef __linux__
+  static std::once_flag atfork_once;
+  std::call_once(atfork_once, [] { pthread_atfork(segments_atfork_prepare, segments_atfork_parent, segments_atfork_child); });
+
+  const char *failed = nullptr;
+  std::string failed_path;
+  int failed_errno = 0;
+  ParamsSegment *segment = nullptr;
+  {
+    std::lock_guard lk(segments_lock);
+    auto [it, inserted] = segments.try_emplace(path);
+    ParamsMapping &mapping = it->second;
+    if (inserted) {
+      const char *prefix = std::getenv("OPENPILOT_PREFIX");
+      mapping.shm_path = util::string_format("/dev/shm/%sparams_v3_%08x", prefix ? (std::string(prefix) + "/").c_str() : "", fnv1a(path));
+    }
+    if (!mapping.segment || mapping.lock_fd < 0) {
+      int fd = HANDLE_EINTR(open(mapping.shm_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0664));
+      if (fd >= 0 && !mapping.segment && ftruncate(fd, sizeof(ParamsSegment)) == 0) {
+        void *mem = mmap(NULL, sizeof(ParamsSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        mapping.segment = (mem == MAP_FAILED) ? nullptr : (ParamsSegment *)mem;
+      }
+      if (!mapping.segment) {
+        failed = "map params segment";
+        failed_path = mapping.shm_path;
+      } else if (fd < 0 || !watch_params_dir(mapping.segment, fd, path)) {
+        failed = "watch params directory";
+        failed_path = path;
+      } else {
+        mapping.lock_fd = fd;
+      }
+      if (failed) {
+        failed_errno = errno;
+        if (fd >= 0) close(fd);
+      }
+    }
+    // the cache isn't used without a watcher, other processes' watchers see the writes made without it
+    segment = mapping.lock_fd >= 0 ? mapping.segment : nullptr;
+  }
+  // logging may block, not while every Params constructor waits on the lock
+  if (failed) {
+    LOGW("Failed to %s %s, errno=%d", failed, failed_path.c_str(), failed_errno);
+  }
+  return segment;
+#else
+  return nullptr;
+#endif
+}
+
+// claims a free slot for the key unless it has one, or only looks it up if claim is false
+ParamsSlot *find_slot(ParamsSegment *segment, const std::string &key, bool claim = true) {
+  if (!segment || key.empty() || key.size() >= PARAMS_SHM_KEY_SIZE) return nullptr;
+
+  const uint32_t hash = fnv1a(key);
+  for (uint32_t i = 0; i < PARAMS_SHM_SLOTS; ++i) {
+    ParamsSlot &slot = segment->slots[(hash + i) % PARAMS_SHM_SLOTS];
+    uint32_t key_state = slot.key_state.load(std::memory_order_acquire);
+    if (key_state == SLOT_KEY_FREE && !claim) {
+      return nullptr;
+    }
+    if (key_state == SLOT_KEY_FREE && slot.key_state.compare_exchange_strong(key_state, SLOT_KEY_CLAIMING)) {
+      memcpy(slot.key, key.c_str(), key.size() + 1);
+      slot.key_state.store(SLOT_KEY_SET, std::memory_order_release);
+      return &slot;
+    }
+    for (int n = 0; key_state == SLOT_KEY_CLAIMING && n < 1000; ++n) {
+      std::this_thread::yield();
+      key_state = slot.key_state.load(std::memory_order_acquire);
+    }
+    if (key_state == SLOT_KEY_SET && strncmp(slot.key, key.c_str(), PARAMS_SHM_KEY_SIZE) == 0) {
+      return &slot;
+    }
+  }
+  return nullptr;
+}
+
+// returns the odd seq the slot is locked with. a writer that died holding the lock is taken over
+// after a while, the critical sections are just a copy of the value
+uint32_t lock_slot(ParamsSlot *slot) {
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+  uint32_t seq = slot->seq.load(std::memory_order_relaxed);
+  while (true) {
+    const bool stuck = (seq & 1) && std::chrono::steady_clock::now() > deadline;
+    if ((!(seq & 1) || stuck) && slot->seq.compare_exchange_weak(seq, seq + (stuck ? 2 : 1), std::memory_order_acquire)) {
+      return seq + (stuck ? 2 : 1);
+    }
+    std::this_thread::yield();
+    seq = slot->seq.load(std::memory_order_relaxed);
+  }
+}
+
+void unlock_slot(ParamsSegment *segment, ParamsSlot *slot, uint32_t seq, bool changed) {
+  if (changed) {
+    slot->version.fetch_add(1, std::memory_order_relaxed);
+  }
+  slot->seq.store(seq + 1, std::memory_order_release);
+  if (changed) {
+    segment->changes.notify();
+  }
+}
+
+void store_value(ParamsSlot *slot, const char *value, size_t size, uint64_t file_ino) {
+  const bool large = size > PARAMS_SHM_VALUE_SIZE;
+  if (!large) {
+    memcpy(slot->value, value, size);
+  }
+  slot->size.store(large ? 0 : size, std::memory_order_relaxed);
+  slot->file_ino.store(file_ino, std::memory_order_relaxed);
+  slot->state.store(large ? SLOT_LARGE : SLOT_LOADED, std::memory_order_relaxed);
+}
+
+void invalidate_slot(ParamsSegment *segment, ParamsSlot *slot, bool changed = true) {
+  const uint32_t seq = lock_slot(slot);
+  slot->state.store(SLOT_UNLOADED, std::memory_order_relaxed);
+  unlock_slot(segment, slot, seq, changed);
+}
+
+void invalidate_all(ParamsSegment *segment) {
+  for (auto &slot : segment->slots) {
+    if (slot.key_state.load(std::memory_order_acquire) == SLOT_KEY_SET) {
+      invalidate_slot(segment, &slot);
+    }
+  }
+}
+
+std::string read_param(ParamsSlot *slot, const std::string &fn) {
+  if (!slot) return util::read_file(fn);
+
+  for (int retries = 0;; ++retries) {
+    const uint32_t seq = slot->seq.load(std::memory_order_acquire);
+    if (seq & 1) {
+      // being written, or the writer is gone
+      if (retries > 1000) return util::read_file(fn);
+      std::this_thread::yield();
+      continue;
+    }
+
+    const uint32_t state = slot->state.load(std::memory_order_relaxed);
+    if (state == SLOT_LARGE) {
+      return util::read_file(fn);
+    } else if (state == SLOT_LOADED) {
+      const size_t size = std::min<size_t>(slot->size.load(std::memory_order_relaxed), PARAMS_SHM_VALUE_SIZE);
+      std::string value(slot->value, size);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot->seq.load(std::memory_order_relaxed) != seq) continue;
+      return value;
+    }
+
+    // only fill the slot if nobody wrote to or invalidated it while the file was read
+    std::string value = util::read_file(fn);
+    uint32_t expected = seq;
+    if (slot->seq.compare_exchange_strong(expected, seq + 1, std::memory_order_acquire)) {
+      store_value(slot, value.data(), value.size(), slot->file_ino.load(std::memory_order_relaxed));
+      slot->seq.store(seq + 2, std::memory_order_release);
+    }
+    return value;
+  }
+}
+
+#ifdef __linux__
+// the slot of a file changed in the params directory. Params only renames files into place, that's
+// checked by inode, everything else was done behind its back
+void invalidate_file(ParamsSegment *segment, const std::string &dir, const char *name, uint32_t mask) {
+  ParamsSlot *slot = find_slot(segment, name, false);
+  if (!slot) return;
+
+  struct stat st;
+  if ((mask & IN_MOVED_TO) && stat((dir + "/" + name).c_str(), &st) == 0 &&
+      (uint64_t)st.st_ino == slot->file_ino.load(std::memory_order_relaxed)) {
+    return;
+  }
+  invalidate_slot(segment, slot);
+}
+
+const uint32_t PARAMS_DIR_EVENTS = IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM |
+                                   IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+void params_watch_loop(ParamsSegment *segment, int fd, int parent_wd, int dir_wd, const std::string &dir) {
+  const std::string dir_name = dir.substr(dir.rfind('/') + 1);
+  alignas(struct inotify_event) char buf[4096];
+  while (true) {
+    const ssize_t len = HANDLE_EINTR(read(fd, buf, sizeof(buf)));
+    if (len <= 0) {
+      LOGE("params watcher stopped, errno=%d", errno);
+      break;
+    }
+
+    bool rewatch = false;
+    for (ssize_t i = 0; i < len;) {
+      const struct inotify_event *event = (const struct inotify_event *)(buf + i);
+      i += sizeof(struct inotify_event) + event->len;
+      if (event->mask & IN_Q_OVERFLOW) {
+        invalidate_all(segment);
+      } else if (event->wd == parent_wd) {
+        rewatch = rewatch || (event->len > 0 && dir_name == event->name);
+      } else if (event->wd == dir_wd) {
+        if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+          rewatch = true;
+        } else if (event->len > 0) {
+          invalidate_file(segment, dir, event->name, event->mask);
+        }
+      }
+    }
+
+    // the directory was replaced, every file may have changed
+    if (rewatch) {
+      if (dir_wd >= 0) inotify_rm_watch(fd, dir_wd);
+      dir_wd = inotify_add_watch(fd, dir.c_str(), PARAMS_DIR_EVENTS);
+      invalidate_all(segment);
+    }
+  }
+  close(fd);
+}
+
+// the watch and the invalidation for a watcher gap are set up before returning, so no change made
+// after this is missed and readers can't see the invalidation late
+bool watch_params_dir(ParamsSegment *segment, int lock_fd, const std::string &dir) {
+  int fd = inotify_init1(IN_CLOEXEC);
+  if (fd < 0) return false;
+
+  // the parent is watched for the params directory symlink being replaced
+  const std::string parent = dir.substr(0, dir.rfind('/'));
+  const int parent_wd = inotify_add_watch(fd, parent.c_str(), IN_CREATE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM | IN_ONLYDIR);
+  const int dir_wd = inotify_add_watch(fd, dir.c_str(), PARAMS_DIR_EVENTS);
+
+  // nobody was watching before this one, so changes since the last watcher went away weren't seen.
+  // the shared lock is held until the process exits
+  if (HANDLE_EINTR(flock(lock_fd, LOCK_EX | LOCK_NB)) == 0) {
+    invalidate_all(segment);
+  }
+  HANDLE_EINTR(flock(lock_fd, LOCK_SH));
+
+  std::thread(params_watch_loop, segment, fd, parent_wd, dir_wd, dir).detach();
+  return true;
+}
+#endif
+
 std::unordered_map<std::string, uint32_t> keys = {
     {"AccessToken", CLEAR_ON_MANAGER_START | DONT_LOG},
     {"AlwaysOnDM", PERSISTENT | FROGPILOT_STORAGE},
@@ -581,13 +896,23 @@ std::unordered_map<std::string, uint32_t> keys = {
 Params::Params(const std::string &path) {
   params_prefix = "/" + util::getenv("OPENPILOT_PREFIX", "d");
   params_path = ensure_params_path(params_prefix, path);
+
+  // the cached values are stale if the params directory was replaced
+  struct stat st;
+  if ((segment = params_segment(getParamPath())) && stat(getParamPath().c_str(), &st) == 0) {
+    uint64_t ino = segment->dir_ino.load();
+    if (ino != st.st_ino && segment->dir_ino.compare_exchange_strong(ino, st.st_ino)) {
+      invalidate_all(segment);
+    }
+  }
 }
 
 Params::~Params() {
+  std::lock_guard lk(future_lock);
   if (future.valid()) {
     future.wait();
   }
-  assert(queue.empty());
+  assert(queue.empty() && overflow.empty());
 }
 
 std::vector<std::string> Params::allKeys() const {
@@ -629,16 +954,39 @@ int Params::put(const char* key, const char* value, size_t value_size) {
     // fsync to force persist the changes.
     if ((result = fsync(tmp_fd)) < 0) break;
 
+    // the watcher tells this file apart from ones renamed into place by others
+    struct stat st;
+    if ((result = fstat(tmp_fd, &st)) < 0) break;
+    // closed before the rename, closing it after would look like a write behind Params' back
+    close(tmp_fd);
+    tmp_fd = -1;
+
     FileLock file_lock(params_path + "/.lock");
 
+    // Invalidate the cached value so it's read from the file if the rename fails or we die,
+    // then publish the new one once it's in place. the watcher skips the rename by the inode
+    ParamsSlot *slot = find_slot(segment, key);
+    if (slot) {
+      const uint32_t seq = lock_slot(slot);
+      slot->state.store(SLOT_UNLOADED, std::memory_order_relaxed);
+      slot->file_ino.store(st.st_ino, std::memory_order_relaxed);
+      unlock_slot(segment, slot, seq, false);
+    }
+
     // Move temp into place.
     if ((result = rename(tmp_path.c_str(), getParamPath(key).c_str())) < 0) break;
 
+    if (slot) {
+      const uint32_t seq = lock_slot(slot);
+      store_value(slot, value, value_size, st.st_ino);
+      unlock_slot(segment, slot, seq, true);
+    }
+
     // fsync parent directory
     result = fsync_dir(getParamPath());
   } while (false);
 
-  close(tmp_fd);
+  if (tmp_fd >= 0) close(tmp_fd);
   if (result != 0) {
     ::unlink(tmp_path.c_str());
   }
@@ -648,6 +996,9 @@ int Params::put(const char* key, const char* value, size_t value_size) {
 int Params::remove(const std::string &key) {
   FileLock file_lock(params_path + "/.lock");
   int result = unlink(getParamPath(key).c_str());
+  if (ParamsSlot *slot = find_slot(segment, key)) {
+    invalidate_slot(segment, slot);
+  }
   if (result != 0) {
     return result;
   }
@@ -655,8 +1006,10 @@ int Params::remove(const std::string &key) {
 }
 
 std::string Params::get(const std::string &key, bool block) {
+  ParamsSlot *slot = find_slot(segment, key);
+  const std::string path = getParamPath(key);
   if (!block) {
-    return util::read_file(getParamPath(key));
+    return read_param(slot, path);
   } else {
     // blocking read until successful
     params_do_exit = 0;
@@ -664,11 +1017,14 @@ std::string Params::get(const std::string &key, bool block) {
     void (*prev_handler_sigterm)(int) = std::signal(SIGTERM, params_sig_handler);
 
     std::string value;
-    while (!params_do_exit) {
-      if (value = util::read_file(getParamPath(key)); !value.empty()) {
-        break;
+    auto ready = [&] { return params_do_exit || !(value = read_param(slot, path)).empty(); };
+    while (!ready()) {
+      // woken by writers of the segment, signals interrupt the wait
+      if (slot) {
+        segment->changes.wait(ready, 100);
+      } else {
+        util::sleep_for(100);  // 0.1 s
       }
-      util::sleep_for(100);  // 0.1 s
     }
 
     std::signal(SIGINT, prev_handler_sigint);
@@ -699,23 +1055,101 @@ void Params::clearAll(ParamKeyType key_type) {
     }
     closedir(d);
   }
+  invalidateCache();
 
   fsync_dir(getParamPath());
 }
 
+void Params::invalidateCache() {
+  if (segment) {
+    invalidate_all(segment);
+  }
+}
+
 void Params::putNonBlocking(const std::string &key, const std::string &val) {
-   queue.push(std::make_pair(key, val));
-  // start thread on demand
-  if (!future.valid() || future.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
+  PendingWrite write{write_seq++, key, val};
+  if (!queue.try_push(std::move(write))) {
+    std::lock_guard lk(overflow_lock);
+    overflow.push_back(std::move(write));
+  }
+
+  // start a writer unless one is running. pairs with the fence in asyncWriteThread:
+  // either the writer sees this write or this sees the writer has stopped
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  bool running = false;
+  if (writer_running.compare_exchange_strong(running, true)) {
+    std::lock_guard lk(future_lock);
+    // the previous writer has nothing left to do, this only waits for it to return
     future = std::async(std::launch::async, &Params::asyncWriteThread, this);
   }
 }
 
 void Params::asyncWriteThread() {
-  // TODO: write the latest one if a key has multiple values in the queue.
-  std::pair<std::string, std::string> p;
-  while (queue.try_pop(p, 0)) {
-    // Params::put is Thread-Safe
-    put(p.first, p.second);
+  std::vector<PendingWrite> batch;
+  std::unordered_map<std::string, size_t> latest;
+  while (true) {
+    queue.pop_batch(batch);
+    {
+      std::lock_guard lk(overflow_lock);
+      std::move(overflow.begin(), overflow.end(), std::back_inserter(batch));
+      overflow.clear();
+    }
+
+    // only write the latest value if a key has multiple values in the queue
+    for (size_t i = 0; i < batch.size(); ++i) {
+      auto [it, inserted] = latest.try_emplace(batch[i].key, i);
+      if (!inserted && batch[it->second].seq < batch[i].seq) it->second = i;
+    }
+    for (auto &[key, i] : latest) {
+      // skip values older than one already written, written_seq is one past the seq of the last write
+      uint64_t &written = written_seq[key];
+      if (written <= batch[i].seq) {
+        // Params::put is Thread-Safe
+        put(key, batch[i].value);
+        written = batch[i].seq + 1;
+      }
+    }
+    batch.clear();
+    latest.clear();
+
+    if (!queue.empty()) continue;
+    writer_running.store(false);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool pending = !queue.empty();
+    if (!pending) {
+      std::lock_guard lk(overflow_lock);
+      pending = !overflow.empty();
+    }
+    // keep going if a write came in before putNonBlocking could see the writer stop, unless it started a new one
+    bool running = false;
+    if (!pending || !writer_running.compare_exchange_strong(running, true)) return;
+  }
+}
+
+ParamsWatch::ParamsWatch(Params &params, const std::vector<std::string> &watch_keys) : segment(params.segment) {
+  for (const auto &key : watch_keys) {
+    ParamsSlot *slot = find_slot(segment, key);
+    watched.push_back({key, slot, slot ? slot->version.load(std::memory_order_acquire) : 0});
+  }
+}
+
+std::vector<std::string> ParamsWatch::wait(int timeout_ms) {
+  std::vector<std::string> changed;
+  auto ready = [&] {
+    for (auto &k : watched) {
+      const uint32_t version = k.slot ? k.slot->version.load(std::memory_order_acquire) : k.version;
+      if (version != k.version) {
+        k.version = version;
+        changed.push_back(k.name);
+      }
+    }
+    return !changed.empty();
+  };
+  if (segment) {
+    segment->changes.wait(ready, timeout_ms);
+  } else {
+    // nothing to wait on without the segment
+    util::sleep_for(timeout_ms < 0 ? 100 : timeout_ms);
   }
+  return changed;
 }
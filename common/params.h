@@ -1,9 +1,13 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <future>
 #include <map>
+#include <mutex>
 #include <string>
 #include <tuple>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -25,6 +29,9 @@ enum ParamKeyType {
   ALL = 0xFFFFFFFF
 };
 
+struct ParamsSegment;
+struct ParamsSlot;
+
 class Params {
 public:
   explicit Params(const std::string &path = {});
@@ -43,6 +50,8 @@ public:
   // Delete a value
   int remove(const std::string &key);
   void clearAll(ParamKeyType type);
+  // Drops the values cached in shared memory, for when the params directory was changed without Params
+  void invalidateCache();
 
   // helpers for reading values
   std::string get(const std::string &key, bool block = false);
@@ -87,12 +96,44 @@ public:
   }
 
 private:
+  friend class ParamsWatch;
   void asyncWriteThread();
 
   std::string params_path;
   std::string params_prefix;
+  ParamsSegment *segment = nullptr;
 
-  // for nonblocking write
+  // for nonblocking write. writes that don't fit in the queue go to overflow, so putNonBlocking never waits.
+  // seq orders the writes of a key, they can be popped out of order when some of them overflowed
+  struct PendingWrite {
+    uint64_t seq;
+    std::string key, value;
+  };
+  std::atomic<uint64_t> write_seq = 0;
+  MPMCQueue<PendingWrite, 64> queue;
+  std::mutex overflow_lock;
+  std::vector<PendingWrite> overflow;
+  // set while a writer thread owns the queues. only the thread that sets it starts a writer
+  std::atomic<bool> writer_running = false;
+  std::unordered_map<std::string, uint64_t> written_seq;
+  std::mutex future_lock;
   std::future<void> future;
-  SafeQueue<std::pair<std::string, std::string>> queue;
+};
+
+// Waits for params to be written or removed by any process, without polling their files.
+// Keys longer than 63 characters can't be watched.
+class ParamsWatch {
+public:
+  ParamsWatch(Params &params, const std::vector<std::string> &keys);
+  // returns the keys that changed since the last call, waiting up to timeout_ms for one (forever if negative)
+  std::vector<std::string> wait(int timeout_ms = -1);
+
+private:
+  struct Key {
+    std::string name;
+    ParamsSlot *slot;
+    uint32_t version;
+  };
+  ParamsSegment *segment;
+  std::vector<Key> watched;
 };
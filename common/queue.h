@@ -1,8 +1,26 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <memory>
 #include <mutex>
+#include <new>
+#include <optional>
 #include <queue>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 template <class T>
 class SafeQueue {
@@ -50,3 +68,271 @@ private:
   std::condition_variable cv;
   std::queue<T> q;
 };
+
+// Lets threads sleep until a lock-free condition becomes true. Waiters set the low bit of a futex
+// word before sleeping on it, and notify() only makes the syscall if that bit is set, so a busy queue
+// costs a fence per notify() and one wakeup per sleep. It's a single futex word that is valid when
+// zeroed, so it also works across processes in shared memory. Without futexes (macOS) waiters poll.
+class EventCount {
+public:
+  // wakes everyone waiting, call after making the condition true
+  void notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t seq = seq_.load(std::memory_order_relaxed);
+    while (seq & 1) {
+      if (seq_.compare_exchange_weak(seq, (seq + 2) & ~1u, std::memory_order_seq_cst)) {
+        futex_wake(&seq_);
+        break;
+      }
+    }
+  }
+
+  // waits until ready() returns true, or timeout_ms has passed if it isn't negative
+  template <class Pred>
+  bool wait(Pred&& ready, int timeout_ms = -1) {
+    if (ready()) return true;
+    if (timeout_ms == 0) return false;
+
+    // a short yield loop first, the other side is usually just about to run
+    for (int i = 0; i < 4; ++i) {
+      std::this_thread::yield();
+      if (ready()) return true;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout_ms, 0));
+    while (true) {
+      const uint32_t seq = seq_.fetch_or(1, std::memory_order_seq_cst) | 1;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (ready()) return true;
+
+      int wait_ms = -1;
+      if (timeout_ms >= 0) {
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0) return false;
+        wait_ms = remaining.count();
+      }
+      futex_wait(&seq_, seq, wait_ms);
+    }
+  }
+
+private:
+  static void futex_wait(std::atomic<uint32_t>* addr, uint32_t val, int ms) {
+#ifdef __linux__
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000 * 1000};
+    syscall(SYS_futex, addr, FUTEX_WAIT, val, ms < 0 ? nullptr : &ts, nullptr, 0);
+#else
+    if (addr->load(std::memory_order_relaxed) == val) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+#endif
+  }
+
+  static void futex_wake(std::atomic<uint32_t>* addr) {
+#ifdef __linux__
+    syscall(SYS_futex, addr, FUTEX_WAKE, std::numeric_limits<int>::max(), nullptr, nullptr, 0);
+#endif
+  }
+
+  std::atomic<uint32_t> seq_ = 0;
+};
+
+// Bounded lock-free ring for exactly one producer thread and one consumer thread.
+// N must be a power of 2. push() and pop() block while the queue is full or empty,
+// the try_ versions don't, and pop_batch() takes everything available in one go.
+template <class T, size_t N>
+class SPSCQueue {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of 2");
+
+public:
+  SPSCQueue() = default;
+  SPSCQueue(const SPSCQueue&) = delete;
+  SPSCQueue& operator=(const SPSCQueue&) = delete;
+  ~SPSCQueue() {
+    for (size_t i = tail_.load(); i != head_.load(); ++i) slot(i)->~T();
+  }
+
+  template <class U = T>
+  bool try_push(U&& v) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_cache_ == N) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head - tail_cache_ == N) return false;
+    }
+    new (slot(head)) T(std::forward<U>(v));
+    head_.store(head + 1, std::memory_order_release);
+    not_empty_.notify();
+    return true;
+  }
+
+  template <class U = T>
+  void push(U&& v) {
+    not_full_.wait([&] { return head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_acquire) < N; });
+    try_push(std::forward<U>(v));
+  }
+
+  bool try_pop(T& v, int timeout_ms = 0) {
+    return not_empty_.wait([&] { return pop_one(v); }, timeout_ms);
+  }
+
+  T pop() {
+    not_empty_.wait([this] { return tail_.load(std::memory_order_relaxed) != head_.load(std::memory_order_acquire); });
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    T v = std::move(*slot(tail));
+    slot(tail)->~T();
+    release(tail + 1);
+    return v;
+  }
+
+  // appends up to max_count elements to out, returns how many
+  size_t pop_batch(std::vector<T>& out, size_t max_count = std::numeric_limits<size_t>::max()) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t count = std::min(head_.load(std::memory_order_acquire) - tail, max_count);
+    for (size_t i = tail; i != tail + count; ++i) {
+      out.push_back(std::move(*slot(i)));
+      slot(i)->~T();
+    }
+    if (count > 0) release(tail + count);
+    return count;
+  }
+
+  bool empty() const { return size() == 0; }
+  size_t size() const { return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire); }
+
+private:
+  T* slot(size_t i) { return std::launder(reinterpret_cast<T*>(&buf_[i & (N - 1)])); }
+
+  bool pop_one(T& v) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_cache_) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail == head_cache_) return false;
+    }
+    v = std::move(*slot(tail));
+    slot(tail)->~T();
+    release(tail + 1);
+    return true;
+  }
+
+  void release(size_t tail) {
+    tail_.store(tail, std::memory_order_release);
+    not_full_.notify();
+  }
+
+  std::unique_ptr<std::aligned_storage_t<sizeof(T), alignof(T)>[]> buf_ =
+      std::make_unique<std::aligned_storage_t<sizeof(T), alignof(T)>[]>(N);
+  // each side caches the other's index so the shared cache lines are only read when needed
+  alignas(64) std::atomic<size_t> head_ = 0;
+  size_t tail_cache_ = 0;
+  alignas(64) std::atomic<size_t> tail_ = 0;
+  size_t head_cache_ = 0;
+  alignas(64) EventCount not_empty_;
+  EventCount not_full_;
+};
+
+// Bounded lock-free queue for any number of producers and consumers, a ring of cells with
+// sequence numbers (Dmitry Vyukov's design). Same interface as SPSCQueue.
+template <class T, size_t N>
+class MPMCQueue {
+  static_assert(N > 1 && (N & (N - 1)) == 0, "N must be a power of 2");
+
+public:
+  MPMCQueue() {
+    for (size_t i = 0; i < N; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+  }
+  MPMCQueue(const MPMCQueue&) = delete;
+  MPMCQueue& operator=(const MPMCQueue&) = delete;
+  ~MPMCQueue() {
+    for (size_t i = dequeue_pos_.load(); i != enqueue_pos_.load(); ++i) cells_[i & (N - 1)].value()->~T();
+  }
+
+  template <class U = T>
+  bool try_push(U&& v) {
+    Cell* cell = nullptr;
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[pos & (N - 1)];
+      const intptr_t diff = (intptr_t)cell->seq.load(std::memory_order_acquire) - (intptr_t)pos;
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    new (cell->value()) T(std::forward<U>(v));
+    cell->seq.store(pos + 1, std::memory_order_release);
+    not_empty_.notify();
+    return true;
+  }
+
+  template <class U = T>
+  void push(U&& v) {
+    // the value is only moved from once try_push succeeds
+    not_full_.wait([&] { return try_push(std::forward<U>(v)); });
+  }
+
+  bool try_pop(T& v, int timeout_ms = 0) {
+    return not_empty_.wait([&] { return pop_one(v); }, timeout_ms);
+  }
+
+  T pop() {
+    std::optional<T> v;
+    not_empty_.wait([&] { return pop_one(v); });
+    return std::move(*v);
+  }
+
+  // appends up to max_count elements to out, returns how many
+  size_t pop_batch(std::vector<T>& out, size_t max_count = std::numeric_limits<size_t>::max()) {
+    size_t count = 0;
+    std::optional<T> v;
+    while (count < max_count && pop_one(v)) {
+      out.push_back(std::move(*v));
+      ++count;
+    }
+    return count;
+  }
+
+  bool empty() const { return size() == 0; }
+  size_t size() const {
+    const size_t dequeue_pos = dequeue_pos_.load(std::memory_order_acquire);
+    const size_t enqueue_pos = enqueue_pos_.load(std::memory_order_acquire);
+    return enqueue_pos > dequeue_pos ? std::min(enqueue_pos - dequeue_pos, N) : 0;
+  }
+
+private:
+  struct Cell {
+    T* value() { return std::launder(reinterpret_cast<T*>(&storage)); }
+    std::atomic<size_t> seq;
+    std::aligned_storage_t<sizeof(T), alignof(T)> storage;
+  };
+
+  // V is T& or std::optional<T>, so pop() doesn't need T to be default constructible
+  template <class V>
+  bool pop_one(V& v) {
+    Cell* cell = nullptr;
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[pos & (N - 1)];
+      const intptr_t diff = (intptr_t)cell->seq.load(std::memory_order_acquire) - (intptr_t)(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    v = std::move(*cell->value());
+    cell->value()->~T();
+    cell->seq.store(pos + N, std::memory_order_release);
+    not_full_.notify();
+    return true;
+  }
+
+  std::unique_ptr<Cell[]> cells_ = std::make_unique<Cell[]>(N);
+  alignas(64) std::atomic<size_t> enqueue_pos_ = 0;
+  alignas(64) std::atomic<size_t> dequeue_pos_ = 0;
+  alignas(64) EventCount not_empty_;
+  EventCount not_full_;
+};
@@ -1,28 +1,117 @@
 #include "common/ratekeeper.h"
 
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <cerrno>
+#include <cstring>
 
 #include "common/swaglog.h"
 #include "common/timing.h"
 #include "common/util.h"
 
+static_assert(sizeof(RateKeeperStats) == 256, "selfdrive/debug/ratekeeper_stats.py maps the slots as 256 bytes");
+
+RateKeeperStats *ratekeeper_stats() {
+  static RateKeeperStats *page = []() -> RateKeeperStats * {
+    int fd = HANDLE_EINTR(open(RATEKEEPER_STATS_FN, O_RDWR | O_CREAT | O_CLOEXEC, 0666));
+    if (fd < 0) return nullptr;
+
+    // a new file is zero filled, which has every slot free
+    const size_t size = RATEKEEPER_STATS_SLOTS * sizeof(RateKeeperStats);
+    void *mem = ftruncate(fd, size) == 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    return mem == MAP_FAILED ? nullptr : (RateKeeperStats *)mem;
+  }();
+  return page;
+}
+
+bool ratekeeper_stats_active(const RateKeeperStats &stats) {
+  const int32_t pid = stats.pid.load(std::memory_order_acquire);
+  return pid != 0 && !(kill(pid, 0) != 0 && errno == ESRCH);
+}
+
+// a free slot, or one whose process is gone
+static RateKeeperStats *claim_stats(const std::string &name, float rate) {
+  RateKeeperStats *page = ratekeeper_stats();
+  int fd = HANDLE_EINTR(open(RATEKEEPER_STATS_FN, O_RDONLY | O_CLOEXEC));
+  if (!page || fd < 0) return nullptr;
+
+  HANDLE_EINTR(flock(fd, LOCK_EX));
+  RateKeeperStats *stats = nullptr;
+  for (int i = 0; i < RATEKEEPER_STATS_SLOTS && !stats; ++i) {
+    if (!ratekeeper_stats_active(page[i])) {
+      stats = &page[i];
+    }
+  }
+  if (stats) {
+    stats->rate = rate;
+    strncpy(stats->name, name.c_str(), sizeof(stats->name) - 1);
+    stats->name[sizeof(stats->name) - 1] = '\0';
+    stats->frames = 0;
+    stats->lagged = 0;
+    for (int i = 0; i < RATEKEEPER_HIST_BUCKETS; ++i) {
+      stats->lateness[i] = 0;
+      stats->work[i] = 0;
+    }
+    stats->pid.store(getpid(), std::memory_order_release);
+  }
+  close(fd);
+  return stats;
+}
+
+// only the thread running the loop writes, so there's no need for atomic increments
+static void hist_add(std::atomic<uint32_t> *hist, double seconds) {
+  const uint64_t us = std::max(seconds, 0.0) * 1e6;
+  const int bucket = std::min(us == 0 ? 0 : 64 - __builtin_clzll(us), RATEKEEPER_HIST_BUCKETS - 1);
+  hist[bucket].store(hist[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
 RateKeeper::RateKeeper(const std::string &name, float rate, float print_delay_threshold)
     : name(name),
       print_delay_threshold(std::max(0.f, print_delay_threshold)) {
   interval = 1 / rate;
   last_monitor_time = seconds_since_boot();
   next_frame_time = last_monitor_time + interval;
+  stats = claim_stats(name, rate);
+}
+
+RateKeeper::~RateKeeper() {
+  if (stats) {
+    stats->pid.store(0, std::memory_order_release);
+  }
 }
 
 bool RateKeeper::keepTime() {
-  bool lagged = monitorTime();
+  bool lagged = update();
   if (remaining_ > 0) {
     util::sleep_for(remaining_ * 1000);
+    iteration_start = seconds_since_boot();
+    if (stats) {
+      // next_frame_time is already the one after this frame
+      hist_add(stats->lateness, iteration_start - (next_frame_time - interval));
+    }
+  } else {
+    iteration_start = last_monitor_time;
   }
   return lagged;
 }
 
 bool RateKeeper::monitorTime() {
+  bool lagged = update();
+  if (!lagged && stats) {
+    hist_add(stats->lateness, 0);
+  }
+  // the loop doesn't sleep here, so there's no telling how long its work takes
+  iteration_start = 0;
+  return lagged;
+}
+
+bool RateKeeper::update() {
   ++frame_;
   last_monitor_time = seconds_since_boot();
   remaining_ = next_frame_time - last_monitor_time;
@@ -36,5 +125,16 @@ bool RateKeeper::monitorTime() {
   } else {
     next_frame_time += interval;
   }
+
+  if (stats) {
+    stats->frames.store(frame_, std::memory_order_relaxed);
+    if (iteration_start > 0) {
+      hist_add(stats->work, last_monitor_time - iteration_start);
+    }
+    if (lagged) {
+      stats->lagged.store(stats->lagged.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      hist_add(stats->lateness, -remaining_);
+    }
+  }
   return lagged;
 }
@@ -1,23 +1,55 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <string>
 
+// Every RateKeeper keeps histograms of its loop timing in a page of shared memory, which
+// proclogd publishes as rateKeeperStats and selfdrive/debug/ratekeeper_stats.py prints.
+// Buckets are log2 of microseconds: bucket 0 counts values under 1us, bucket i values in
+// [2^(i-1), 2^i) us and the last bucket everything above that.
+const char RATEKEEPER_STATS_FN[] = "/dev/shm/ratekeeper";
+const int RATEKEEPER_STATS_SLOTS = 64;
+const int RATEKEEPER_HIST_BUCKETS = 24;
+
+struct alignas(64) RateKeeperStats {
+  std::atomic<int32_t> pid;  // 0 while the slot is free
+  float rate;
+  char name[32];
+  std::atomic<uint64_t> frames;
+  std::atomic<uint64_t> lagged;
+  // how late the loop woke up from its sleep, or how far behind it was when there was no time to sleep
+  std::atomic<uint32_t> lateness[RATEKEEPER_HIST_BUCKETS];
+  // from waking up to the next keepTime(), loops that only call monitorTime() don't have it
+  std::atomic<uint32_t> work[RATEKEEPER_HIST_BUCKETS];
+};
+
+// the mapped page, nullptr if it can't be opened
+RateKeeperStats *ratekeeper_stats();
+// the slot belongs to a running process. slots of processes that were killed keep their pid
+bool ratekeeper_stats_active(const RateKeeperStats &stats);
+
 class RateKeeper {
 public:
   RateKeeper(const std::string &name, float rate, float print_delay_threshold = 0);
-  ~RateKeeper() {}
+  RateKeeper(const RateKeeper &) = delete;
+  RateKeeper &operator=(const RateKeeper &) = delete;
+  ~RateKeeper();
   bool keepTime();
   bool monitorTime();
   inline uint64_t frame() const { return frame_; }
   inline double remaining() const { return remaining_; }
 
 private:
+  bool update();
+
   double interval;
   double next_frame_time;
   double last_monitor_time;
+  double iteration_start = 0;  // when keepTime() woke up, 0 if it didn't run last
   double remaining_ = 0;
   float print_delay_threshold = 0;
   uint64_t frame_ = 0;
   std::string name;
+  RateKeeperStats *stats = nullptr;
 };
@@ -4,27 +4,115 @@
 
 #include "common/swaglog.h"
 
+#include <pthread.h>
+
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstring>
+#include <exception>
 #include <limits>
+#include <memory>
 #include <mutex>
+#include <new>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <zmq.h>
 #include <stdarg.h>
 #include "third_party/json11/json11.hpp"
+#include "common/queue.h"
 #include "common/version.h"
 #include "system/hardware/hw.h"
 
+static_assert(sizeof(SwaglogRecord) == 34, "system/logmessaged.py decodes records with struct format <BBHHIIIQd");
+
+// Encoded records of one thread on their way to the sender thread. The logging thread is the
+// only writer and the sender the only reader, so there are no locks: head only moves past whole
+// records, and everything between tail and head can be sent as is.
+class LogRing {
+public:
+  static constexpr size_t SIZE = 16 << 10;
+
+  static size_t record_size(const SwaglogRecord &rec) {
+    return sizeof(rec) + rec.filename_len + rec.func_len + rec.msg_len;
+  }
+
+  bool write(const SwaglogRecord &rec, const char *filename, const char *func, const char *msg) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (SIZE - (head - tail_.load(std::memory_order_acquire)) < record_size(rec)) return false;
+
+    size_t pos = head;
+    copy(pos, &rec, sizeof(rec));
+    copy(pos, filename, rec.filename_len);
+    copy(pos, func, rec.func_len);
+    copy(pos, msg, rec.msg_len);
+    head_.store(pos, std::memory_order_release);
+    return true;
+  }
+
+  // appends everything written so far to out
+  void read(std::string &out) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t len = head_.load(std::memory_order_acquire) - tail;
+    const size_t begin = tail & (SIZE - 1), first = std::min(len, SIZE - begin);
+    out.append(buf_.get() + begin, first);
+    out.append(buf_.get(), len - first);
+    tail_.store(tail + len, std::memory_order_release);
+  }
+
+  bool empty() const { return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_relaxed); }
+
+  // drops everything written so far
+  void clear() { tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release); }
+
+  std::atomic<bool> finished = false;  // the thread exited, nothing more will be written
+  std::atomic<uint32_t> dropped = 0;   // records that didn't fit since the last read
+
+private:
+  void copy(size_t &pos, const void *src, size_t len) {
+    const size_t begin = pos & (SIZE - 1), first = std::min(len, SIZE - begin);
+    memcpy(buf_.get() + begin, src, first);
+    memcpy(buf_.get(), (const char *)src + first, len - first);
+    pos += len;
+  }
+
+  // not zeroed, so the pages of threads that rarely log are never touched
+  std::unique_ptr<char[]> buf_{new char[SIZE]};
+  alignas(64) std::atomic<size_t> head_ = 0;
+  alignas(64) std::atomic<size_t> tail_ = 0;
+};
+
+static void encode_record(std::string &out, const SwaglogRecord &rec, const char *filename, const char *func, const char *msg) {
+  out.append((const char *)&rec, sizeof(rec));
+  out.append(filename, rec.filename_len);
+  out.append(func, rec.func_len);
+  out.append(msg, rec.msg_len);
+}
+
+static SwaglogRecord make_record(int levelnum, const char *filename, int lineno, const char *func, size_t msg_len) {
+  SwaglogRecord rec = {};
+  rec.levelnum = levelnum;
+  rec.type = SWAGLOG_MSG;
+  rec.filename_len = std::min<size_t>(strlen(filename), std::numeric_limits<uint16_t>::max());
+  rec.func_len = std::min<size_t>(strlen(func), std::numeric_limits<uint16_t>::max());
+  rec.msg_len = msg_len;
+  rec.lineno = lineno;
+  rec.frame_id = std::numeric_limits<uint32_t>::max();
+  rec.created = seconds_since_epoch();
+  return rec;
+}
+
+// Delivery: records are batched by a sender thread every BATCH_INTERVAL_MS. Errors and anything
+// above are handed to zmq by the thread logging them before it returns, together with everything
+// logged before. On std::terminate and exit everything is sent and the socket lingers to deliver it.
+// A process that dies from a signal or abort() can lose its last BATCH_INTERVAL_MS below ERROR.
+// After a fork the child starts its own sender, records logged before the fork are sent by the parent.
 class SwaglogState {
 public:
   SwaglogState() {
-    zctx = zmq_ctx_new();
-    sock = zmq_socket(zctx, ZMQ_PUSH);
-
-    // Timeout on shutdown for messages to be received by the logging process
-    int timeout = 100;
-    zmq_setsockopt(sock, ZMQ_LINGER, &timeout, sizeof(timeout));
-    zmq_connect(sock, Path::swaglog_ipc().c_str());
+    connect();
 
     print_level = CLOUDLOG_WARNING;
     if (const char* print_lvl = getenv("LOGPRINT")) {
@@ -37,7 +125,7 @@ public:
       }
     }
 
-    ctx_j = json11::Json::object{};
+    json11::Json::object ctx_j;
     if (char* dongle_id = getenv("DONGLE_ID")) {
       ctx_j["dongle_id"] = dongle_id;
     }
@@ -56,83 +144,255 @@ public:
     ctx_j["version"] = COMMA_VERSION;
     ctx_j["dirty"] = !getenv("CLEAN");
     ctx_j["device"] = Hardware::get_name();
+
+    // every batch starts with the ctx, it's the same for the whole process
+    const std::string ctx_s = json11::Json(ctx_j).dump();
+    const uint32_t ctx_len = ctx_s.size();
+    batch_header += (char)SWAGLOG_BATCH;
+    batch_header.append((const char *)&ctx_len, sizeof(ctx_len));
+    batch_header += ctx_s;
+
+    sender = std::thread(&SwaglogState::send_thread, this);
+
+    // there is one SwaglogState per process
+    instance = this;
+    pthread_atfork(&SwaglogState::atfork_prepare, &SwaglogState::atfork_parent, &SwaglogState::atfork_child);
+    prev_terminate = std::set_terminate(&SwaglogState::on_terminate);
   }
 
   ~SwaglogState() {
-    zmq_close(sock);
+    exiting = true;
+    pending.notify();
+    stop.notify();
+    sender.join();
+    if (sock) zmq_close(sock);
     zmq_ctx_destroy(zctx);
   }
 
-  void log(int levelnum, const char* filename, int lineno, const char* func, const char* msg, const std::string& log_s) {
-    std::lock_guard lk(lock);
-    if (levelnum >= print_level) {
+  void log(const SwaglogRecord &rec, const char* filename, const char* func, const char* msg) {
+    if (rec.levelnum >= print_level) {
       printf("%s: %s\n", filename, msg);
     }
-    zmq_send(sock, log_s.data(), log_s.length(), ZMQ_NOBLOCK);
+
+    if (LogRing::record_size(rec) > LogRing::SIZE / 4) {
+      std::lock_guard lk(large_lock);
+      encode_record(large, rec, filename, func, msg);
+    } else {
+      LogRing &ring = thread_ring();
+      if (!ring.write(rec, filename, func, msg)) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    // errors are sent before returning, everything else is batched
+    if (rec.levelnum >= CLOUDLOG_ERROR) {
+      flush();
+    } else {
+      pending.notify();
+    }
+  }
+
+private:
+  struct ThreadRing {
+    ~ThreadRing() {
+      if (ring) ring->finished = true;
+    }
+    std::shared_ptr<LogRing> ring;
+  };
+
+  static ThreadRing &local_ring() {
+    thread_local ThreadRing t;
+    return t;
   }
 
-  std::mutex lock;
+  LogRing &thread_ring() {
+    ThreadRing &t = local_ring();
+    if (!t.ring) {
+      t.ring = std::make_shared<LogRing>();
+      std::lock_guard lk(rings_lock);
+      rings.push_back(t.ring);
+    }
+    return *t.ring;
+  }
+
+  void connect() {
+    zctx = zmq_ctx_new();
+    sock = zmq_socket(zctx, ZMQ_PUSH);
+
+    // Timeout on shutdown for messages to be received by the logging process
+    int timeout = 100;
+    zmq_setsockopt(sock, ZMQ_LINGER, &timeout, sizeof(timeout));
+    zmq_connect(sock, Path::swaglog_ipc().c_str());
+  }
+
+  bool has_records() {
+    {
+      std::lock_guard lk(rings_lock);
+      if (std::any_of(rings.begin(), rings.end(), [](auto &r) { return !r->empty() || r->dropped > 0; })) return true;
+    }
+    std::lock_guard lk(large_lock);
+    return !large.empty();
+  }
+
+  // sends everything logged so far. called by the sender thread, and by threads logging errors
+  void flush() {
+    std::lock_guard send_lk(send_lock);
+    batch = batch_header;
+    {
+      std::lock_guard lk(rings_lock);
+      for (auto it = rings.begin(); it != rings.end();) {
+        // checked before reading, so nothing written after the read is lost
+        const bool finished = (*it)->finished;
+        (*it)->read(batch);
+        if (uint32_t dropped = (*it)->dropped.exchange(0)) {
+          const std::string msg = "swaglog: " + std::to_string(dropped) + " messages dropped, ring full";
+          encode_record(batch, make_record(CLOUDLOG_WARNING, __FILE__, __LINE__, __func__, msg.size()), __FILE__, __func__, msg.c_str());
+        }
+        it = finished ? rings.erase(it) : it + 1;
+      }
+    }
+    {
+      std::lock_guard lk(large_lock);
+      batch += large;
+      large.clear();
+    }
+    if (sock && batch.size() > batch_header.size()) {
+      zmq_send(sock, batch.data(), batch.size(), ZMQ_NOBLOCK);
+    }
+  }
+
+  void send_thread() {
+    while (true) {
+      pending.wait([this] { return exiting || has_records(); });
+      const bool last = exiting;
+      flush();
+      if (last) break;
+
+      // let records pile up for a bit before the next batch
+      stop.wait([this] { return exiting.load(); }, BATCH_INTERVAL_MS);
+    }
+  }
+
+  // the locks are held across fork, so the child doesn't inherit them mid-update
+  static void atfork_prepare() {
+    instance->send_lock.lock();
+    instance->rings_lock.lock();
+    instance->large_lock.lock();
+  }
+
+  static void atfork_parent() {
+    instance->large_lock.unlock();
+    instance->rings_lock.unlock();
+    instance->send_lock.unlock();
+  }
+
+  static void atfork_child() {
+    SwaglogState *s = instance;
+    // only the forking thread exists in the child. the records are the parent's to send
+    for (auto &ring : s->rings) {
+      ring->clear();
+      ring->dropped = 0;
+      if (ring != local_ring().ring) ring->finished = true;
+    }
+    s->large.clear();
+    s->large_lock.unlock();
+    s->rings_lock.unlock();
+    s->send_lock.unlock();
+
+    // the zmq context and the sender thread belong to the parent, they can't be used or joined here.
+    // both handles are abandoned and replaced
+    s->connect();
+    new (&s->sender) std::thread(&SwaglogState::send_thread, s);
+  }
+
+  static void on_terminate() {
+    instance->flush();
+    {
+      // zmq sends from its own threads, closing the socket waits up to ZMQ_LINGER for them to deliver
+      std::lock_guard lk(instance->send_lock);
+      zmq_close(instance->sock);
+      instance->sock = nullptr;
+    }
+    zmq_ctx_term(instance->zctx);
+    if (instance->prev_terminate) instance->prev_terminate();
+    std::abort();
+  }
+
+  static constexpr int BATCH_INTERVAL_MS = 10;
+  static inline SwaglogState *instance = nullptr;
+
   void* zctx = nullptr;
   void* sock = nullptr;
   int print_level;
-  json11::Json::object ctx_j;
+  std::string batch_header;
+
+  std::mutex send_lock;  // the socket and batch
+  std::string batch;
+  std::mutex rings_lock;  // only taken by the logging threads when they first log
+  std::vector<std::shared_ptr<LogRing>> rings;
+  // records too big for the rings, sent after the ring contents
+  std::mutex large_lock;
+  std::string large;
+
+  std::atomic<bool> exiting = false;
+  EventCount pending, stop;
+  std::thread sender;
+  std::terminate_handler prev_terminate = nullptr;
 };
 
 bool LOG_TIMESTAMPS = getenv("LOG_TIMESTAMPS");
 uint32_t NO_FRAME_ID = std::numeric_limits<uint32_t>::max();
 
-static void cloudlog_common(int levelnum, const char* filename, int lineno, const char* func,
-                            char* msg_buf, const json11::Json::object &msg_j={}) {
-  static SwaglogState s;
-
-  json11::Json::object log_j = json11::Json::object {
-    {"ctx", s.ctx_j},
-    {"levelnum", levelnum},
-    {"filename", filename},
-    {"lineno", lineno},
-    {"funcname", func},
-    {"created", seconds_since_epoch()}
-  };
-  if (msg_j.empty()) {
-    log_j["msg"] = msg_buf;
-  } else {
-    log_j["msg"] = msg_j;
+// vsnprintf into a stack buffer, most messages fit
+class LogMessage {
+public:
+  LogMessage(const char* fmt, va_list args) {
+    va_list args_copy;
+    va_copy(args_copy, args);
+    len = vsnprintf(buf, sizeof(buf), fmt, args_copy);
+    va_end(args_copy);
+    if (len >= (int)sizeof(buf)) {
+      heap.resize(len + 1);
+      vsnprintf(heap.data(), heap.size(), fmt, args);
+    }
   }
+  const char* c_str() const { return heap.empty() ? buf : heap.data(); }
+
+  int len;
 
-  std::string log_s;
-  log_s += (char)levelnum;
-  ((json11::Json)log_j).dump(log_s);
-  s.log(levelnum, filename, lineno, func, msg_buf, log_s);
+private:
+  char buf[512];
+  std::string heap;
+};
 
-  free(msg_buf);
+static void cloudlog_common(const SwaglogRecord &rec, const char* filename, const char* func, const char* msg) {
+  static SwaglogState s;
+  s.log(rec, filename, func, msg);
 }
 
 void cloudlog_e(int levelnum, const char* filename, int lineno, const char* func,
                 const char* fmt, ...) {
   va_list args;
   va_start(args, fmt);
-  char* msg_buf = nullptr;
-  int ret = vasprintf(&msg_buf, fmt, args);
+  LogMessage msg(fmt, args);
   va_end(args);
-  if (ret <= 0 || !msg_buf) return;
-  cloudlog_common(levelnum, filename, lineno, func, msg_buf);
+  if (msg.len <= 0) return;
+
+  const SwaglogRecord rec = make_record(levelnum, filename, lineno, func, msg.len);
+  cloudlog_common(rec, filename, func, msg.c_str());
 }
 
 void cloudlog_t_common(int levelnum, const char* filename, int lineno, const char* func,
                        uint32_t frame_id, const char* fmt, va_list args) {
   if (!LOG_TIMESTAMPS) return;
-  char* msg_buf = nullptr;
-  int ret = vasprintf(&msg_buf, fmt, args);
-  if (ret <= 0 || !msg_buf) return;
-  json11::Json::object tspt_j = json11::Json::object{
-    {"event", msg_buf},
-    {"time", std::to_string(nanos_since_boot())}
-  };
-  if (frame_id < NO_FRAME_ID) {
-    tspt_j["frame_id"] = std::to_string(frame_id);
-  }
-  tspt_j = json11::Json::object{{"timestamp", tspt_j}};
-  cloudlog_common(levelnum, filename, lineno, func, msg_buf, tspt_j);
+  LogMessage msg(fmt, args);
+  if (msg.len <= 0) return;
+
+  SwaglogRecord rec = make_record(levelnum, filename, lineno, func, msg.len);
+  rec.type = SWAGLOG_TIMESTAMP;
+  rec.frame_id = frame_id;
+  rec.nanos = nanos_since_boot();
+  cloudlog_common(rec, filename, func, msg.c_str());
 }
 
 
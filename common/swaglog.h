@@ -8,6 +8,27 @@
 #define CLOUDLOG_ERROR 40
 #define CLOUDLOG_CRITICAL 50
 
+// C++ processes send logmessaged batches of binary records instead of a JSON string per call,
+// logmessaged does the JSON conversion. A message starting with SWAGLOG_BATCH, which isn't a
+// valid level, is a batch: the ctx JSON of the sender, as a uint32 length and the string, then
+// records. Each record is a SwaglogRecord followed by the filename, funcname and msg strings.
+#define SWAGLOG_BATCH 0
+
+#define SWAGLOG_MSG 0
+#define SWAGLOG_TIMESTAMP 1
+
+struct __attribute__((packed)) SwaglogRecord {
+  uint8_t levelnum;
+  uint8_t type;  // SWAGLOG_MSG or SWAGLOG_TIMESTAMP
+  uint16_t filename_len;
+  uint16_t func_len;
+  uint32_t msg_len;
+  uint32_t lineno;
+  uint32_t frame_id;  // timestamps only, UINT32_MAX if there's none
+  uint64_t nanos;     // timestamps only, nanos_since_boot
+  double created;     // seconds since epoch
+};
+
 
 #ifdef __GNUC__
 #define SWAG_LOG_CHECK_FMT(a, b) __attribute__ ((format (printf, a, b)))
@@ -0,0 +1,41 @@
+// Cost of reading params through the shared memory cache against reading their files, which is
+// what Params::get did before. Every iteration reads 100 keys, like the UI does every frame.
+// usage: ./bench_params [iterations]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "common/params.h"
+#include "common/util.h"
+
+template <class F>
+double run(int iterations, F &&f) {
+  const auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) f();
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count() / iterations;
+}
+
+int main(int argc, char *argv[]) {
+  const int iterations = argc > 1 ? atoi(argv[1]) : 1000;
+  char tmp_path[] = "/tmp/bench_params_XXXXXX";
+  Params params(mkdtemp(tmp_path));
+
+  std::vector<std::string> keys = params.allKeys();
+  keys.resize(std::min<size_t>(keys.size(), 100));
+  for (size_t i = 0; i < keys.size(); ++i) {
+    params.putBool(keys[i], i % 2);
+  }
+
+  int count = 0;
+  const double files_us = run(iterations, [&] {
+    for (const auto &key : keys) count += util::read_file(params.getParamPath(key)) == "1";
+  });
+  const double shm_us = run(iterations, [&] {
+    for (const auto &key : keys) count += params.getBool(key);
+  });
+  printf("%zu params: files %.1f us, shared memory %.1f us (%d)\n", keys.size(), files_us, shm_us, count);
+  return 0;
+}
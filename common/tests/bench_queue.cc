@@ -0,0 +1,56 @@
+// Throughput of SafeQueue against the lock-free MPMCQueue (and SPSCQueue with one producer),
+// with 1, 2 and 8 producer threads feeding one consumer through blocking push and pop.
+// usage: ./bench_queue [messages per producer]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "common/queue.h"
+
+const size_t CAPACITY = 1024;
+
+// SafeQueue is unbounded, its producers never block
+template <class Q>
+void push(Q &q, uint64_t v) { q.push(v); }
+
+template <class Q>
+double run(int producers, int count) {
+  Q q;
+  const auto begin = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < producers; ++i) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < count; ++j) push(q, j);
+    });
+  }
+  uint64_t sum = 0;
+  for (int i = 0; i < producers * count; ++i) {
+    sum += q.pop();
+  }
+  for (auto &t : threads) t.join();
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+  if (sum != (uint64_t)producers * count * (count - 1) / 2) {
+    fprintf(stderr, "lost messages\n");
+    exit(1);
+  }
+  return producers * count / seconds / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+  const int count = argc > 1 ? atoi(argv[1]) : 1000000;
+  printf("%-10s %12s %12s %12s\n", "producers", "SafeQueue", "MPMCQueue", "SPSCQueue");
+  for (int producers : {1, 2, 8}) {
+    const int n = count / producers;
+    printf("%-10d %9.2f M/s %9.2f M/s", producers, run<SafeQueue<uint64_t>>(producers, n),
+           run<MPMCQueue<uint64_t, CAPACITY>>(producers, n));
+    if (producers == 1) {
+      printf(" %9.2f M/s", run<SPSCQueue<uint64_t, CAPACITY>>(producers, n));
+    }
+    printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,122 @@
+// Cost of one log call at each level with 1 and 8 threads logging at once, against the old
+// transport that built a JSON object per call and sent it through a mutex guarded PUSH socket.
+// Threads log in bursts small enough for their ring, so dropped records don't make it look cheaper.
+// Levels from WARNING up are also printed, stdout goes to /dev/null and the results to stderr.
+// usage: ./bench_swaglog [calls per thread]
+
+#include <zmq.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common/swaglog.h"
+#include "common/util.h"
+#include "common/version.h"
+#include "system/hardware/hw.h"
+#include "third_party/json11/json11.hpp"
+
+const int BURST = 100;
+
+// what cloudlog_e did per call before the binary records
+struct JsonLog {
+  JsonLog() {
+    zctx = zmq_ctx_new();
+    sock = zmq_socket(zctx, ZMQ_PUSH);
+    int timeout = 100;
+    zmq_setsockopt(sock, ZMQ_LINGER, &timeout, sizeof(timeout));
+    zmq_connect(sock, Path::swaglog_ipc().c_str());
+    ctx_j["version"] = COMMA_VERSION;
+    ctx_j["dirty"] = !getenv("CLEAN");
+    ctx_j["device"] = Hardware::get_name();
+  }
+  ~JsonLog() {
+    zmq_close(sock);
+    zmq_ctx_destroy(zctx);
+  }
+
+  void log(int levelnum, const char *filename, int lineno, const char *func, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    char *msg_buf = nullptr;
+    int ret = vasprintf(&msg_buf, fmt, args);
+    va_end(args);
+    if (ret <= 0 || !msg_buf) return;
+
+    json11::Json::object log_j = json11::Json::object {
+      {"ctx", ctx_j},
+      {"levelnum", levelnum},
+      {"filename", filename},
+      {"lineno", lineno},
+      {"funcname", func},
+      {"created", seconds_since_epoch()},
+      {"msg", msg_buf},
+    };
+    std::string log_s;
+    log_s += (char)levelnum;
+    ((json11::Json)log_j).dump(log_s);
+
+    std::lock_guard lk(lock);
+    if (levelnum >= CLOUDLOG_WARNING) {
+      printf("%s: %s\n", filename, msg_buf);
+    }
+    zmq_send(sock, log_s.data(), log_s.length(), ZMQ_NOBLOCK);
+    free(msg_buf);
+  }
+
+  std::mutex lock;
+  void *zctx, *sock;
+  json11::Json::object ctx_j;
+};
+
+// average ns per call over all threads
+template <class F>
+double run(int threads, int calls, F log) {
+  std::vector<double> seconds(threads);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      for (int i = 0; i < calls; i += BURST) {
+        const auto begin = std::chrono::steady_clock::now();
+        for (int j = i; j < std::min(i + BURST, calls); ++j) log(t, j);
+        seconds[t] += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        util::sleep_for(20);
+      }
+    });
+  }
+  for (auto &w : workers) w.join();
+
+  double total = 0;
+  for (double s : seconds) total += s;
+  return total / (threads * calls) * 1e9;
+}
+
+int main(int argc, char *argv[]) {
+  const int calls = argc > 1 ? atoi(argv[1]) : 2000;
+  if (!freopen("/dev/null", "w", stdout)) return 1;
+
+  JsonLog json_log;
+  const std::pair<int, const char *> levels[] = {
+    {CLOUDLOG_DEBUG, "DEBUG"}, {CLOUDLOG_INFO, "INFO"}, {CLOUDLOG_WARNING, "WARNING"},
+    {CLOUDLOG_ERROR, "ERROR"}, {CLOUDLOG_CRITICAL, "CRITICAL"},
+  };
+
+  fprintf(stderr, "%-10s %8s %14s %14s\n", "level", "threads", "binary ns", "json ns");
+  for (auto [level, name] : levels) {
+    for (int threads : {1, 8}) {
+      const double binary = run(threads, calls, [lvl = level](int t, int i) {
+        cloudlog(lvl, "thread %d message %d: %s", t, i, "some text to log");
+      });
+      const double json = run(threads, calls, [&, lvl = level](int t, int i) {
+        json_log.log(lvl, __FILE__, __LINE__, __func__, "thread %d message %d: %s", t, i, "some text to log");
+      });
+      fprintf(stderr, "%-10s %8d %14.0f %14.0f\n", name, threads, binary, json);
+    }
+  }
+  return 0;
+}
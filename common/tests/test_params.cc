@@ -1,3 +1,5 @@
+#include <thread>
+
 #include "catch2/catch.hpp"
 #define private public
 #include "common/params.h"
@@ -25,3 +27,111 @@ TEST_CASE("params_nonblocking_put") {
     REQUIRE(p.get(name) == "1");
   }
 }
+
+TEST_CASE("params_nonblocking_put_burst") {
+  char tmp_path[] = "/tmp/asyncWriterBurst_XXXXXX";
+  const std::string param_path = mkdtemp(tmp_path);
+  const int writes = 1000;
+  {
+    Params params(param_path);
+    // many times the queue size, none of these wait for the writer
+    for (int i = 0; i < writes; ++i) {
+      params.putNonBlocking(i % 2 ? "CarParams" : "IsMetric", std::to_string(i));
+    }
+    REQUIRE(params.future.valid());
+
+    // bursts from several threads while the writer starts and stops
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&, t] {
+        for (int i = 0; i < writes; ++i) {
+          params.putNonBlocking("LongitudinalPersonality", std::to_string(t));
+          if (i % 100 == 0) util::sleep_for(1);
+        }
+      });
+    }
+    for (auto &t : threads) t.join();
+  }
+  // the latest value of each key is written
+  Params p(param_path);
+  REQUIRE(p.get("IsMetric") == std::to_string(writes - 2));
+  REQUIRE(p.get("CarParams") == std::to_string(writes - 1));
+  REQUIRE(p.get("LongitudinalPersonality").size() == 1);
+}
+
+TEST_CASE("params_shared_memory_cache") {
+  char tmp_path[] = "/tmp/paramsCache_XXXXXX";
+  const std::string param_path = mkdtemp(tmp_path);
+  Params writer(param_path), reader(param_path);
+  REQUIRE(reader.get("IsMetric").empty());
+
+  // visible to every Params on the path and persisted to the file
+  writer.putBool("IsMetric", true);
+  REQUIRE(reader.getBool("IsMetric"));
+  REQUIRE(util::read_file(reader.getParamPath("IsMetric")) == "1");
+
+  // values too large for the segment are read from the file
+  const std::string large(4096, 'x');
+  writer.put("CarParams", large);
+  REQUIRE(reader.get("CarParams") == large);
+
+  // files changed behind Params' back are read again once the watcher has seen the change
+  ParamsWatch watch(reader, {"IsMetric"});
+  auto picked_up = [&](const std::string &expected) {
+    for (int i = 0; i < 100 && reader.get("IsMetric") != expected; ++i) {
+      watch.wait(10);
+    }
+    return reader.get("IsMetric") == expected;
+  };
+  const std::string fn = reader.getParamPath("IsMetric");
+  REQUIRE(util::write_file(fn.c_str(), "0", 1) == 0);
+  REQUIRE(picked_up("0"));
+  REQUIRE(util::write_file(fn.c_str(), "1", 1) == 0);
+  REQUIRE(picked_up("1"));
+  REQUIRE(::unlink(fn.c_str()) == 0);
+  REQUIRE(picked_up(""));
+  REQUIRE(util::write_file(fn.c_str(), "1", 1, O_WRONLY | O_CREAT) == 0);
+  REQUIRE(picked_up("1"));
+  const std::string tmp_fn = param_path + "/IsMetric.tmp";
+  REQUIRE(util::write_file(tmp_fn.c_str(), "0", 1, O_WRONLY | O_CREAT) == 0);
+  REQUIRE(::rename(tmp_fn.c_str(), fn.c_str()) == 0);
+  REQUIRE(picked_up("0"));
+
+  // a value put by Params stays cached, its own rename doesn't invalidate it
+  writer.putBool("IsMetric", true);
+  REQUIRE(reader.getBool("IsMetric"));
+  watch.wait(0);
+  util::sleep_for(50);
+  REQUIRE(watch.wait(0).empty());
+
+  writer.remove("IsMetric");
+  REQUIRE(reader.get("IsMetric").empty());
+  writer.put("CarParams", "1");
+  writer.clearAll(ALL);
+  REQUIRE(reader.get("CarParams").empty());
+}
+
+TEST_CASE("params_watch") {
+  char tmp_path[] = "/tmp/paramsWatch_XXXXXX";
+  const std::string param_path = mkdtemp(tmp_path);
+  Params params(param_path);
+  ParamsWatch watch(params, {"IsMetric", "CarParams"});
+  REQUIRE(watch.wait(0).empty());
+
+  std::thread writer([&] {
+    util::sleep_for(50);
+    Params(param_path).putBool("IsMetric", true);
+  });
+  REQUIRE(watch.wait(5000) == std::vector<std::string>{"IsMetric"});
+  writer.join();
+  REQUIRE(params.getBool("IsMetric"));
+
+  // blocking gets are woken by the write
+  writer = std::thread([&] {
+    util::sleep_for(50);
+    Params(param_path).put("CarParams", "test");
+  });
+  REQUIRE(params.get("CarParams", true) == "test");
+  writer.join();
+  REQUIRE(watch.wait(0) == std::vector<std::string>{"CarParams"});
+}
@@ -0,0 +1,81 @@
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "common/queue.h"
+
+TEMPLATE_TEST_CASE("lock-free queues", "", (SPSCQueue<int, 4>), (MPMCQueue<int, 4>)) {
+  TestType q;
+  REQUIRE(q.empty());
+
+  SECTION("bounded fifo") {
+    for (int i = 0; i < 4; ++i) REQUIRE(q.try_push(i));
+    REQUIRE(!q.try_push(4));
+    REQUIRE(q.size() == 4);
+    int v = -1;
+    for (int i = 0; i < 4; ++i) {
+      REQUIRE(q.try_pop(v));
+      REQUIRE(v == i);
+    }
+    REQUIRE(!q.try_pop(v, 10));
+    REQUIRE(q.empty());
+  }
+  SECTION("pop_batch") {
+    for (int round = 0; round < 3; ++round) {
+      for (int i = 0; i < 3; ++i) q.push(round * 3 + i);
+      std::vector<int> out;
+      REQUIRE(q.pop_batch(out, 2) == 2);
+      REQUIRE(q.pop_batch(out) == 1);
+      REQUIRE(q.pop_batch(out) == 0);
+      REQUIRE(out == std::vector<int>{round * 3, round * 3 + 1, round * 3 + 2});
+    }
+  }
+  SECTION("blocking push and pop") {
+    const int count = 100000;
+    std::thread producer([&] {
+      for (int i = 0; i < count; ++i) q.push(i);
+    });
+    for (int i = 0; i < count; ++i) REQUIRE(q.pop() == i);
+    producer.join();
+  }
+}
+
+TEST_CASE("lock-free queues hold move-only types") {
+  SPSCQueue<std::unique_ptr<int>, 2> spsc;
+  MPMCQueue<std::unique_ptr<int>, 2> mpmc;
+  REQUIRE(spsc.try_push(std::make_unique<int>(1)));
+  REQUIRE(mpmc.try_push(std::make_unique<int>(2)));
+  REQUIRE(*spsc.pop() == 1);
+  REQUIRE(*mpmc.pop() == 2);
+
+  // remaining elements are destroyed with the queue
+  auto p = std::make_shared<int>(3);
+  {
+    MPMCQueue<std::shared_ptr<int>, 2> q;
+    q.push(p);
+    REQUIRE(p.use_count() == 2);
+  }
+  REQUIRE(p.use_count() == 1);
+}
+
+TEST_CASE("MPMCQueue with many producers and consumers") {
+  MPMCQueue<int, 64> q;
+  const int producers = 4, consumers = 4, count = 20000;
+  std::vector<std::thread> threads;
+  std::vector<long> sums(consumers, 0);
+  for (int i = 0; i < producers; ++i) {
+    threads.emplace_back([&] {
+      for (int j = 1; j <= count; ++j) q.push(j);
+    });
+  }
+  for (int i = 0; i < consumers; ++i) {
+    threads.emplace_back([&, i] {
+      for (int j = 0; j < producers * count / consumers; ++j) sums[i] += q.pop();
+    });
+  }
+  for (auto &t : threads) t.join();
+  REQUIRE(std::accumulate(sums.begin(), sums.end(), 0L) == (long)producers * count * (count + 1) / 2);
+  REQUIRE(q.empty());
+}
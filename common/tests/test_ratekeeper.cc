@@ -0,0 +1,77 @@
+#include <unistd.h>
+
+#include <cstring>
+#include <numeric>
+
+#include "catch2/catch.hpp"
+#include "common/ratekeeper.h"
+#include "common/timing.h"
+
+static RateKeeperStats *find_stats(const char *name) {
+  RateKeeperStats *page = ratekeeper_stats();
+  REQUIRE(page != nullptr);
+  for (int i = 0; i < RATEKEEPER_STATS_SLOTS; ++i) {
+    if (page[i].pid == getpid() && strcmp(page[i].name, name) == 0) return &page[i];
+  }
+  return nullptr;
+}
+
+static uint32_t total(const std::atomic<uint32_t> *hist, int first_bucket = 0) {
+  uint32_t sum = 0;
+  for (int i = first_bucket; i < RATEKEEPER_HIST_BUCKETS; ++i) sum += hist[i];
+  return sum;
+}
+
+static void busy_wait(double seconds) {
+  const double end = seconds_since_boot() + seconds;
+  while (seconds_since_boot() < end) {}
+}
+
+TEST_CASE("RateKeeper stats") {
+  SECTION("keepTime") {
+    {
+      RateKeeper rk("test_keep_time", 100);
+      RateKeeperStats *stats = find_stats("test_keep_time");
+      REQUIRE(stats != nullptr);
+      REQUIRE(stats->rate == 100);
+
+      for (int i = 0; i < 10; ++i) {
+        busy_wait(0.0015);
+        rk.keepTime();
+      }
+      REQUIRE(stats->frames == 10);
+      REQUIRE(total(stats->lateness) == 10);
+      // the first frame has nothing to measure its work from, the others spent at least 1024us
+      REQUIRE(total(stats->work) == 9);
+      REQUIRE(total(stats->work, 11) == 9);
+    }
+    // the slot is free again
+    REQUIRE(find_stats("test_keep_time") == nullptr);
+  }
+
+  SECTION("lagging") {
+    RateKeeper rk("test_lagging", 1000);
+    RateKeeperStats *stats = find_stats("test_lagging");
+    REQUIRE(stats != nullptr);
+    for (int i = 0; i < 5; ++i) {
+      busy_wait(0.003);
+      rk.keepTime();
+    }
+    REQUIRE(stats->lagged == 5);
+    // at least 2ms late every time
+    REQUIRE(total(stats->lateness, 11) == 5);
+  }
+
+  SECTION("monitorTime") {
+    RateKeeper rk("test_monitor_time", 100);
+    RateKeeperStats *stats = find_stats("test_monitor_time");
+    REQUIRE(stats != nullptr);
+    for (int i = 0; i < 5; ++i) {
+      rk.monitorTime();
+    }
+    REQUIRE(stats->frames == 5);
+    REQUIRE(stats->lagged == 0);
+    REQUIRE(stats->lateness[0] == 5);
+    REQUIRE(total(stats->work) == 0);
+  }
+}
@@ -1,6 +1,10 @@
+#include <sys/wait.h>
 #include <zmq.h>
 
+#include <csignal>
+#include <cstring>
 #include <iostream>
+#include <set>
 
 #include "catch2/catch.hpp"
 #include "common/swaglog.h"
@@ -21,33 +25,67 @@ void log_thread(int thread_id, int msg_cnt) {
   }
 }
 
-void recv_log(int thread_cnt, int thread_msg_cnt) {
+// too big for the per-thread rings, goes out on its own
+void log_long_msg(const std::string &msg) {
+  LOGD("%s", msg.c_str());
+}
+
+struct Record {
+  SwaglogRecord rec;
+  std::string filename, funcname, msg;
+};
+
+// splits a batch from swaglog.cc into its ctx and records
+json11::Json decode_batch(const std::string &batch, std::vector<Record> &records) {
+  REQUIRE(batch.size() > 1 + sizeof(uint32_t));
+  REQUIRE(batch[0] == SWAGLOG_BATCH);
+  uint32_t ctx_len = 0;
+  memcpy(&ctx_len, batch.data() + 1, sizeof(ctx_len));
+  size_t pos = 1 + sizeof(ctx_len);
+  std::string err;
+  auto ctx = json11::Json::parse(batch.substr(pos, ctx_len), err);
+  REQUIRE(!ctx.is_null());
+  pos += ctx_len;
+
+  while (pos < batch.size()) {
+    Record r;
+    REQUIRE(pos + sizeof(r.rec) <= batch.size());
+    memcpy(&r.rec, batch.data() + pos, sizeof(r.rec));
+    pos += sizeof(r.rec);
+    REQUIRE(pos + r.rec.filename_len + r.rec.func_len + r.rec.msg_len <= batch.size());
+    r.filename = batch.substr(pos, r.rec.filename_len);
+    pos += r.rec.filename_len;
+    r.funcname = batch.substr(pos, r.rec.func_len);
+    pos += r.rec.func_len;
+    r.msg = batch.substr(pos, r.rec.msg_len);
+    pos += r.rec.msg_len;
+    records.push_back(r);
+  }
+  return ctx;
+}
+
+void recv_log(int thread_cnt, int thread_msg_cnt, const std::string &long_msg) {
   void *zctx = zmq_ctx_new();
   void *sock = zmq_socket(zctx, ZMQ_PULL);
   zmq_bind(sock, Path::swaglog_ipc().c_str());
   std::vector<int> thread_msgs(thread_cnt);
-  int total_count = 0;
+  int total_count = 0, long_count = 0;
 
   for (auto start = std::chrono::steady_clock::now(), now = start;
-       now < start + std::chrono::seconds{1} && total_count < (thread_cnt * thread_msg_cnt);
+       now < start + std::chrono::seconds{1} && (total_count < (thread_cnt * thread_msg_cnt) || long_count == 0);
        now = std::chrono::steady_clock::now()) {
-    char buf[4096] = {};
-    if (zmq_recv(sock, buf, sizeof(buf), ZMQ_DONTWAIT) <= 0) {
+    zmq_msg_t zmsg;
+    zmq_msg_init(&zmsg);
+    if (zmq_msg_recv(&zmsg, sock, ZMQ_DONTWAIT) <= 0) {
+      zmq_msg_close(&zmsg);
       if (errno == EAGAIN || errno == EINTR || errno == EFSM) continue;
       break;
     }
+    std::string batch((char *)zmq_msg_data(&zmsg), zmq_msg_size(&zmsg));
+    zmq_msg_close(&zmsg);
 
-    REQUIRE(buf[0] == CLOUDLOG_DEBUG);
-    std::string err;
-    auto msg = json11::Json::parse(buf + 1, err);
-    REQUIRE(!msg.is_null());
-
-    REQUIRE(msg["levelnum"].int_value() == CLOUDLOG_DEBUG);
-    REQUIRE_THAT(msg["filename"].string_value(), Catch::Contains("test_swaglog.cc"));
-    REQUIRE(msg["funcname"].string_value() == "log_thread");
-    REQUIRE(msg["lineno"].int_value() == LINE_NO);
-
-    auto ctx = msg["ctx"];
+    std::vector<Record> records;
+    auto ctx = decode_batch(batch, records);
 
     REQUIRE(ctx["daemon"].string_value() == daemon_name);
     REQUIRE(ctx["dongle_id"].string_value() == dongle_id);
@@ -58,15 +96,34 @@ void recv_log(int thread_cnt, int thread_msg_cnt) {
     std::string device = Hardware::get_name();
     REQUIRE(ctx["device"].string_value() == device);
 
-    int thread_id = atoi(msg["msg"].string_value().c_str());
-    REQUIRE((thread_id >= 0 && thread_id < thread_cnt));
-    thread_msgs[thread_id]++;
-    total_count++;
+    for (auto &r : records) {
+      // the header is packed, copy the fields out before binding references to them
+      const int levelnum = r.rec.levelnum, type = r.rec.type, lineno = r.rec.lineno;
+      const double created = r.rec.created;
+      REQUIRE(levelnum == CLOUDLOG_DEBUG);
+      REQUIRE(type == SWAGLOG_MSG);
+      REQUIRE(created > 0);
+      REQUIRE_THAT(r.filename, Catch::Contains("test_swaglog.cc"));
+      if (r.msg == long_msg) {
+        REQUIRE(r.funcname == "log_long_msg");
+        long_count++;
+        continue;
+      }
+
+      REQUIRE(r.funcname == "log_thread");
+      REQUIRE(lineno == LINE_NO);
+
+      int thread_id = atoi(r.msg.c_str());
+      REQUIRE((thread_id >= 0 && thread_id < thread_cnt));
+      thread_msgs[thread_id]++;
+      total_count++;
+    }
   }
   for (int i = 0; i < thread_cnt; ++i) {
     INFO("thread :" << i);
     REQUIRE(thread_msgs[i] == thread_msg_cnt);
   }
+  REQUIRE(long_count == 1);
   zmq_close(sock);
   zmq_ctx_destroy(zctx);
 }
@@ -84,5 +141,69 @@ TEST_CASE("swaglog") {
   }
   for (auto &t : log_threads) t.join();
 
-  recv_log(thread_cnt, thread_msg_cnt);
+  const std::string long_msg(20000, 'x');
+  log_long_msg(long_msg);
+
+  recv_log(thread_cnt, thread_msg_cnt, long_msg);
+}
+
+// records received until every msg in msgs has been seen, or 1s has passed
+std::vector<Record> recv_records(void *sock, std::set<std::string> msgs) {
+  std::vector<Record> records;
+  for (auto start = std::chrono::steady_clock::now(); !msgs.empty() && std::chrono::steady_clock::now() < start + std::chrono::seconds{1};) {
+    zmq_msg_t zmsg;
+    zmq_msg_init(&zmsg);
+    if (zmq_msg_recv(&zmsg, sock, ZMQ_DONTWAIT) <= 0) {
+      zmq_msg_close(&zmsg);
+      util::sleep_for(1);
+      continue;
+    }
+    std::string batch((char *)zmq_msg_data(&zmsg), zmq_msg_size(&zmsg));
+    zmq_msg_close(&zmsg);
+    size_t begin = records.size();
+    decode_batch(batch, records);
+    for (size_t i = begin; i < records.size(); ++i) msgs.erase(records[i].msg);
+  }
+  return records;
+}
+
+TEST_CASE("swaglog_fork") {
+  void *zctx = zmq_ctx_new();
+  void *sock = zmq_socket(zctx, ZMQ_PULL);
+  zmq_bind(sock, Path::swaglog_ipc().c_str());
+
+  LOGD("before fork");
+  SECTION("child logs through its own sender") {
+    pid_t pid = fork();
+    if (pid == 0) {
+      LOGD("child");
+      exit(0);
+    }
+    int status = 0;
+    REQUIRE(waitpid(pid, &status, 0) == pid);
+    REQUIRE((WIFEXITED(status) && WEXITSTATUS(status) == 0));
+    LOGD("parent");
+    auto records = recv_records(sock, {"before fork", "child", "parent"});
+    // records from before the fork are only sent by the parent
+    std::multiset<std::string> msgs;
+    for (auto &r : records) msgs.insert(r.msg);
+    REQUIRE(msgs.count("before fork") == 1);
+    REQUIRE(msgs.count("child") == 1);
+    REQUIRE(msgs.count("parent") == 1);
+  }
+  SECTION("records are sent on std::terminate") {
+    pid_t pid = fork();
+    if (pid == 0) {
+      LOGD("terminate");
+      std::terminate();
+    }
+    int status = 0;
+    REQUIRE(waitpid(pid, &status, 0) == pid);
+    REQUIRE((WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT));
+    auto records = recv_records(sock, {"terminate"});
+    REQUIRE(std::any_of(records.begin(), records.end(), [](auto &r) { return r.msg == "terminate"; }));
+  }
+
+  zmq_close(sock);
+  zmq_ctx_destroy(zctx);
 }
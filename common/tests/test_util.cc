@@ -1,7 +1,9 @@
 
+#include <bzlib.h>
 #include <dirent.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <zstd.h>
 
 #include <algorithm>
 #include <climits>
@@ -10,6 +12,7 @@
 #include <string>
 
 #include "catch2/catch.hpp"
+#include "common/decompress.h"
 #include "common/util.h"
 
 std::string random_bytes(int size) {
@@ -145,3 +148,29 @@ TEST_CASE("util::create_directories") {
     REQUIRE(util::create_directories("", 0755) == false);
   }
 }
+
+TEST_CASE("util::decompress") {
+  // large enough for several output buffers
+  const std::string content = random_bytes(1024) + std::string(4 << 20, 'x') + random_bytes(1024);
+
+  SECTION("bz2") {
+    std::string compressed(content.size() * 2, '\0');
+    unsigned int size = compressed.size();
+    REQUIRE(BZ2_bzBuffToBuffCompress(compressed.data(), &size, (char *)content.data(), content.size(), 9, 0, 0) == BZ_OK);
+    compressed.resize(size);
+    REQUIRE(util::decompress("rlog.bz2", compressed) == content);
+    REQUIRE(util::decompress("rlog.bz2", compressed.substr(0, size / 2)).empty());
+  }
+  SECTION("zst") {
+    std::string compressed(ZSTD_compressBound(content.size()), '\0');
+    size_t size = ZSTD_compress(compressed.data(), compressed.size(), content.data(), content.size(), 1);
+    REQUIRE(!ZSTD_isError(size));
+    compressed.resize(size);
+    REQUIRE(util::decompress("rlog.zst", compressed) == content);
+    REQUIRE(util::decompress("rlog.zst", compressed.substr(0, size / 2)).empty());
+    REQUIRE(util::decompress("rlog.zst", random_bytes(1024)).empty());
+  }
+  SECTION("uncompressed") {
+    REQUIRE(util::decompress("rlog", content) == content);
+  }
+}
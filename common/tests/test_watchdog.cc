@@ -0,0 +1,38 @@
+#include <unistd.h>
+
+#include "catch2/catch.hpp"
+#include "common/watchdog.h"
+
+TEST_CASE("watchdog_kick") {
+  REQUIRE(watchdog_kick(1000));
+
+  WatchdogSlot *table = watchdog_table();
+  REQUIRE(table != nullptr);
+  WatchdogSlot *slot = nullptr;
+  for (int i = 0; i < WATCHDOG_SLOTS; ++i) {
+    if (table[i].pid == getpid()) {
+      REQUIRE(slot == nullptr);
+      slot = &table[i];
+    }
+  }
+  REQUIRE(slot != nullptr);
+  REQUIRE(slot->last_kick == 1000);
+  const uint32_t seq = slot->seq;
+
+  SECTION("kicks count and keep the worst gap") {
+    for (uint64_t ts : {3000, 3500, 4500}) {
+      REQUIRE(watchdog_kick(ts));
+    }
+    REQUIRE(slot->seq == seq + 3);
+    REQUIRE(slot->last_kick == 4500);
+    REQUIRE(slot->max_gap == 2000);
+  }
+
+  SECTION("a zero kick doesn't count as a gap") {
+    slot->max_gap = 0;
+    REQUIRE(watchdog_kick(0));
+    REQUIRE(slot->last_kick == 0);
+    REQUIRE(watchdog_kick(5000));
+    REQUIRE(slot->max_gap == 0);
+  }
+}
@@ -0,0 +1,38 @@
+import multiprocessing
+import os
+
+from openpilot.common.watchdog import Watchdog, WatchdogTable
+
+
+def kick_once():
+  Watchdog().kick(1000)
+
+
+class TestWatchdog:
+  def test_kick(self):
+    w = Watchdog()
+    for ts in (1000, 3000, 3500, 4500):
+      w.kick(ts)
+
+    slot = WatchdogTable().snapshot()[os.getpid()]
+    assert (slot['seq'], slot['last_kick'], slot['max_gap']) == (4, 4500, 2000)
+
+  def test_reset_max_gap(self):
+    w = Watchdog()
+    w.kick(1000)
+    w.kick(2000)
+
+    table = WatchdogTable()
+    assert table.snapshot(reset_max_gap=True)[os.getpid()]['max_gap'] == 1000
+    assert table.snapshot()[os.getpid()]['max_gap'] == 0
+
+  def test_slot_per_pid(self):
+    # a process claiming again gets its own slot back
+    assert Watchdog().idx == Watchdog().idx
+
+    p = multiprocessing.Process(target=kick_once)
+    p.start()
+    p.join()
+    slots = WatchdogTable().snapshot()
+    assert slots[p.pid]['last_kick'] == 1000
+    assert WatchdogTable().slots['pid'].tolist().count(os.getpid()) == 1
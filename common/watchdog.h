@@ -1,5 +1,22 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 
+// Each process that kicks the watchdog gets a slot in a table in shared memory, and the
+// manager reads the whole table in one pass. Slots are claimed by pid on the first kick.
+const char WATCHDOG_FN[] = "/dev/shm/watchdog";
+const int WATCHDOG_SLOTS = 128;
+
+struct alignas(64) WatchdogSlot {
+  std::atomic<int32_t> pid;         // 0 while the slot is free
+  std::atomic<uint32_t> seq;        // number of kicks
+  std::atomic<uint64_t> last_kick;  // timestamp of the last kick in ns
+  std::atomic<uint64_t> max_gap;    // worst time between two kicks in ns, the manager resets it
+};
+
+// call it from one thread only, the slot has a single writer
 bool watchdog_kick(uint64_t ts);
+
+// the mapped table, nullptr if it can't be opened
+WatchdogSlot *watchdog_table();
@@ -0,0 +1,74 @@
+import fcntl
+import mmap
+import os
+import time
+
+import numpy as np
+
+# same table as common/watchdog.h
+WATCHDOG_FN = "/dev/shm/watchdog"
+WATCHDOG_SLOTS = 128
+SLOT = np.dtype({'names': ['pid', 'seq', 'last_kick', 'max_gap'],
+                 'formats': ['<i4', '<u4', '<u8', '<u8'],
+                 'offsets': [0, 4, 8, 16],
+                 'itemsize': 64})
+
+
+def pid_alive(pid: int) -> bool:
+  try:
+    os.kill(pid, 0)
+  except ProcessLookupError:
+    return False
+  except PermissionError:
+    pass
+  return True
+
+
+class WatchdogTable:
+  def __init__(self):
+    fd = os.open(WATCHDOG_FN, os.O_RDWR | os.O_CREAT, 0o666)
+    try:
+      # a new file is zero filled, which is an empty table
+      os.ftruncate(fd, WATCHDOG_SLOTS * SLOT.itemsize)
+      self.mm = mmap.mmap(fd, WATCHDOG_SLOTS * SLOT.itemsize)
+    finally:
+      os.close(fd)
+    self.slots = np.frombuffer(self.mm, dtype=SLOT)
+
+  def claim(self, pid: int) -> int | None:
+    """Our slot from a previous process with the same pid, a free one, or one whose process is gone"""
+    with open(WATCHDOG_FN, 'rb') as f:
+      fcntl.flock(f, fcntl.LOCK_EX)
+      pids = self.slots['pid'].tolist()
+      idx = pids.index(pid) if pid in pids else next((i for i, p in enumerate(pids) if p == 0 or not pid_alive(p)), None)
+      if idx is not None:
+        self.slots[idx] = (0, 0, 0, 0)
+        self.slots['pid'][idx] = pid
+    return idx
+
+  def snapshot(self, reset_max_gap: bool = False) -> dict[int, np.void]:
+    """The claimed slots by pid, all read in one pass. Gaps reset after reading cover the time until the next snapshot"""
+    slots = self.slots.copy()
+    if reset_max_gap:
+      self.slots['max_gap'] = 0
+    return {int(s['pid']): s for s in slots if s['pid'] != 0}
+
+
+class Watchdog:
+  """Kicks the watchdog slot of this process, from one thread only"""
+  def __init__(self):
+    self.table = WatchdogTable()
+    self.idx = self.table.claim(os.getpid())
+
+  def kick(self, ts: int | None = None) -> None:
+    if self.idx is None:
+      return
+    if ts is None:
+      ts = time.monotonic_ns()
+
+    slot = self.table.slots[self.idx]
+    last = int(slot['last_kick'])
+    if last != 0 and ts - last > int(slot['max_gap']):
+      slot['max_gap'] = ts - last
+    slot['seq'] += 1
+    slot['last_kick'] = ts
@@ -21,6 +21,10 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <linux/futex.h>
+#endif
+
 #include <stdio.h>
 
 #include "msgq/msgq.h"
@@ -43,6 +47,119 @@ uint64_t msgq_get_uid(void){
   return uid;
 }
 
+static std::string msgq_shm_path(const char * path){
+  std::string full_path = "/dev/shm/";
+  const char* prefix = std::getenv("OPENPILOT_PREFIX");
+  if (prefix) {
+    full_path += std::string(prefix) + "/";
+  }
+  return full_path + path;
+}
+
+static void thread_signal(uint32_t tid) {
+  #ifndef SYS_tkill
+    // TODO: this won't work for multithreaded programs
+    kill(tid, SIGUSR2);
+  #else
+    syscall(SYS_tkill, tid, SIGUSR2);
+  #endif
+}
+
+// ***** notify slots *****
+// Readers that poll through a notify slot are woken with a futex instead of SIGUSR2.
+// Without futexes (macOS) or if the segment can't be mapped, everything falls back to signals.
+
+static msgq_notify_slot_t *msgq_notify_segment(){
+#ifdef __linux__
+  static msgq_notify_slot_t *slots = []() -> msgq_notify_slot_t * {
+    const size_t size = MSGQ_NOTIFY_SLOTS * sizeof(msgq_notify_slot_t);
+    std::string full_path = msgq_shm_path("msgq_notify");
+    int fd = open(full_path.c_str(), O_RDWR | O_CREAT, 0664);
+    if (fd < 0) {
+      std::cout << "Warning, could not open: " << full_path << std::endl;
+      return NULL;
+    }
+    if (ftruncate(fd, size) < 0) {
+      close(fd);
+      return NULL;
+    }
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return (mem == MAP_FAILED) ? NULL : (msgq_notify_slot_t *)mem;
+  }();
+  return slots;
+#else
+  return NULL;
+#endif
+}
+
+static bool msgq_thread_alive(uint64_t tid){
+  return kill(tid, 0) == 0 || errno != ESRCH;
+}
+
+// Returns the notify slot owned by the calling thread, or -1 if there is none.
+// Slots of threads that have exited are reclaimed.
+static int msgq_notify_slot_index(){
+#ifndef __linux__
+  return -1;
+#else
+  thread_local int index = -2;
+  if (index != -2) return index;
+
+  index = -1;
+  msgq_notify_slot_t *slots = msgq_notify_segment();
+  if (slots == NULL) return index;
+
+  uint64_t tid = syscall(SYS_gettid);
+  for (size_t i = 0; i < MSGQ_NOTIFY_SLOTS; i++){
+    size_t idx = (tid + i) % MSGQ_NOTIFY_SLOTS;
+    uint64_t owner = slots[idx].owner;
+    if ((owner == 0 || owner == tid || !msgq_thread_alive(owner)) &&
+        slots[idx].owner.compare_exchange_strong(owner, tid)){
+      index = idx;
+      break;
+    }
+  }
+  return index;
+#endif
+}
+
+static void msgq_futex_wait(std::atomic<uint32_t> *addr, uint32_t val, int ms){
+#ifdef __linux__
+  struct timespec ts;
+  ts.tv_sec = ms / 1000;
+  ts.tv_nsec = (ms % 1000) * 1000 * 1000;
+  syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0);
+#endif
+}
+
+static void msgq_futex_wake(std::atomic<uint32_t> *addr){
+#ifdef __linux__
+  syscall(SYS_futex, addr, FUTEX_WAKE, std::numeric_limits<int>::max(), NULL, NULL, 0);
+#endif
+}
+
+static void msgq_notify_reader(msgq_queue_t *q, uint64_t i){
+  uint64_t notify = *q->read_notifys[i];
+  uint64_t slot_index = (notify >> 32) - 1;
+  msgq_notify_slot_t *slots = msgq_notify_segment();
+
+  if (notify == 0 || slots == NULL || slot_index >= MSGQ_NOTIFY_SLOTS){
+    uint64_t reader_uid = *q->read_uids[i];
+    thread_signal(reader_uid & 0xFFFFFFFF);
+    return;
+  }
+
+  uint32_t bit = notify & 0xFF;
+  msgq_notify_slot_t *slot = &slots[slot_index];
+  slot->pending[(bit / 64) % (MSGQ_NOTIFY_BITS / 64)] |= (1ULL << (bit % 64));
+  slot->seq++;
+  // only pay for the syscall if the reader is actually sleeping
+  if (slot->waiting){
+    msgq_futex_wake(&slot->seq);
+  }
+}
+
 int msgq_msg_init_size(msgq_msg_t * msg, size_t size){
   msg->size = size;
   msg->data = new(std::nothrow) char[size];
@@ -87,12 +204,7 @@ int msgq_new_queue(msgq_queue_t * q, const char * path, size_t size){
   assert(size < 0xFFFFFFFF); // Buffer must be smaller than 2^32 bytes
   std::signal(SIGUSR2, sigusr2_handler);
 
-  std::string full_path = "/dev/shm/";
-  const char* prefix = std::getenv("OPENPILOT_PREFIX");
-  if (prefix) {
-    full_path += std::string(prefix) + "/";
-  }
-  full_path += path;
+  std::string full_path = msgq_shm_path(path);
 
   auto fd = open(full_path.c_str(), O_RDWR | O_CREAT, 0664);
   if (fd < 0) {
@@ -124,6 +236,7 @@ int msgq_new_queue(msgq_queue_t * q, const char * path, size_t size){
     q->read_pointers[i] = reinterpret_cast<std::atomic<uint64_t>*>(&header->read_pointers[i]);
     q->read_valids[i] = reinterpret_cast<std::atomic<uint64_t>*>(&header->read_valids[i]);
     q->read_uids[i] = reinterpret_cast<std::atomic<uint64_t>*>(&header->read_uids[i]);
+    q->read_notifys[i] = reinterpret_cast<std::atomic<uint64_t>*>(&header->read_notifys[i]);
   }
 
   q->data = mem + sizeof(msgq_header_t);
@@ -132,6 +245,8 @@ int msgq_new_queue(msgq_queue_t * q, const char * path, size_t size){
 
   q->endpoint = path;
   q->read_conflate = false;
+  q->notify_bit = -1;
+  q->notify_ready = true;
 
   return 0;
 }
@@ -153,26 +268,26 @@ void msgq_init_publisher(msgq_queue_t * q) {
   for (size_t i = 0; i < NUM_READERS; i++){
     *q->read_valids[i] = false;
     *q->read_uids[i] = 0;
+    *q->read_notifys[i] = 0;
   }
 
   q->write_uid_local = uid;
 }
 
-static void thread_signal(uint32_t tid) {
-  #ifndef SYS_tkill
-    // TODO: this won't work for multithreaded programs
-    kill(tid, SIGUSR2);
-  #else
-    syscall(SYS_tkill, tid, SIGUSR2);
-  #endif
-}
-
 void msgq_init_subscriber(msgq_queue_t * q) {
   assert(q != NULL);
   assert(q->num_readers != NULL);
 
   uint64_t uid = msgq_get_uid();
 
+  // Wake up this thread through its notify slot, if it has one
+  int slot_index = msgq_notify_slot_index();
+  if (q->notify_bit < 0){
+    thread_local int next_notify_bit = 0;
+    q->notify_bit = next_notify_bit++ % MSGQ_NOTIFY_BITS;
+  }
+  uint64_t notify = (slot_index < 0) ? 0 : ((uint64_t)(slot_index + 1) << 32) | q->notify_bit;
+
   // Get reader id
   while (true){
     uint64_t cur_num_readers = *q->num_readers;
@@ -186,11 +301,11 @@ void msgq_init_subscriber(msgq_queue_t * q) {
       for (size_t i = 0; i < NUM_READERS; i++){
         *q->read_valids[i] = false;
 
-        uint64_t old_uid = *q->read_uids[i];
-        *q->read_uids[i] = 0;
-
         // Wake up reader in case they are in a poll
-        thread_signal(old_uid & 0xFFFFFFFF);
+        msgq_notify_reader(q, i);
+
+        *q->read_uids[i] = 0;
+        *q->read_notifys[i] = 0;
       }
 
       continue;
@@ -208,6 +323,7 @@ void msgq_init_subscriber(msgq_queue_t * q) {
       // on the first read the read pointer will be synchronized with the write pointer
       *q->read_valids[cur_num_readers] = false;
       *q->read_pointers[cur_num_readers] = 0;
+      *q->read_notifys[cur_num_readers] = notify;
       *q->read_uids[cur_num_readers] = uid;
       break;
     }
@@ -215,6 +331,7 @@ void msgq_init_subscriber(msgq_queue_t * q) {
 
   //std::cout << "New subscriber id: " << q->reader_id << " uid: " << q->read_uid_local << " " << q->endpoint << std::endl;
   msgq_reset_reader(q);
+  q->notify_ready = true;
 }
 
 int msgq_msg_send(msgq_msg_t * msg, msgq_queue_t *q){
@@ -294,8 +411,7 @@ int msgq_msg_send(msgq_msg_t * msg, msgq_queue_t *q){
 
   // Notify readers
   for (uint64_t i = 0; i < num_readers; i++){
-    uint64_t reader_uid = *q->read_uids[i];
-    thread_signal(reader_uid & 0xFFFFFFFF);
+    msgq_notify_reader(q, i);
   }
 
   return msg->size;
@@ -420,7 +536,7 @@ int msgq_msg_recv(msgq_msg_t * msg, msgq_queue_t * q){
 
 
 
-int msgq_poll(msgq_pollitem_t * items, size_t nitems, int timeout){
+static int msgq_poll_signal(msgq_pollitem_t * items, size_t nitems, int timeout){
   int num = 0;
 
   // Check if messages ready
@@ -457,6 +573,68 @@ int msgq_poll(msgq_pollitem_t * items, size_t nitems, int timeout){
   return num;
 }
 
+// Max time between full scans of all polled queues. Notifications aren't sent while a reader
+// is being re-registered (e.g. after a publisher restart), this bounds how long those are missed.
+#define MSGQ_FULL_SCAN_MS 100
+
+int msgq_poll(msgq_pollitem_t * items, size_t nitems, int timeout){
+  int slot_index = msgq_notify_slot_index();
+  if (slot_index < 0){
+    return msgq_poll_signal(items, nitems, timeout);
+  }
+  msgq_notify_slot_t *slot = &msgq_notify_segment()[slot_index];
+
+  uint64_t mask[MSGQ_NOTIFY_BITS / 64] = {};
+  for (size_t i = 0; i < nitems; i++) {
+    int bit = items[i].q->notify_bit;
+    if (bit >= 0) mask[bit / 64] |= (1ULL << (bit % 64));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  auto last_scan = start;
+  bool full_scan = false;
+  int num = 0;
+
+  while (true) {
+    uint32_t seq = slot->seq;
+
+    // only take the bits of our queues, other pollers in this thread may own the rest
+    uint64_t pending[MSGQ_NOTIFY_BITS / 64];
+    for (size_t w = 0; w < MSGQ_NOTIFY_BITS / 64; w++) {
+      pending[w] = slot->pending[w].fetch_and(~mask[w]) & mask[w];
+    }
+
+    // Check queues that were notified, or were still ready on the last poll
+    for (size_t i = 0; i < nitems; i++) {
+      msgq_queue_t *q = items[i].q;
+      int bit = q->notify_bit;
+      bool notified = bit < 0 || (pending[bit / 64] >> (bit % 64)) & 1;
+      items[i].revents = (full_scan || notified || q->notify_ready) ? msgq_msg_ready(q) : 0;
+      q->notify_ready = items[i].revents;
+      num += items[i].revents;
+    }
+
+    if (num > 0 || timeout == 0) break;
+
+    auto now = std::chrono::steady_clock::now();
+    int elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
+    if (timeout != -1 && elapsed >= timeout) break;
+
+    int wait_ms = (timeout == -1) ? MSGQ_FULL_SCAN_MS : std::min(timeout - elapsed, MSGQ_FULL_SCAN_MS);
+    slot->waiting = 1;
+    if (slot->seq == seq) {
+      msgq_futex_wait(&slot->seq, seq, wait_ms);
+    }
+    slot->waiting = 0;
+
+    now = std::chrono::steady_clock::now();
+    full_scan = (now - last_scan) >= std::chrono::milliseconds(MSGQ_FULL_SCAN_MS);
+    if (full_scan) last_scan = now;
+  }
+
+  return num;
+}
+
 bool msgq_all_readers_updated(msgq_queue_t *q) {
   uint64_t num_readers = *q->num_readers;
   for (uint64_t i = 0; i < num_readers; i++) {
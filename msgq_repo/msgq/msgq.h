@@ -7,6 +7,8 @@
 
 #define DEFAULT_SEGMENT_SIZE (10 * 1024 * 1024)
 #define NUM_READERS 15
+#define MSGQ_NOTIFY_SLOTS 4096
+#define MSGQ_NOTIFY_BITS 128
 #define ALIGN(n) ((n + (8 - 1)) & -8)
 
 #define UNUSED(x) (void)x
@@ -20,6 +22,7 @@ struct  msgq_header_t {
   uint64_t read_pointers[NUM_READERS];
   uint64_t read_valids[NUM_READERS];
   uint64_t read_uids[NUM_READERS];
+  uint64_t read_notifys[NUM_READERS];
 };
 
 struct msgq_queue_t {
@@ -29,6 +32,7 @@ struct msgq_queue_t {
   std::atomic<uint64_t> *read_pointers[NUM_READERS];
   std::atomic<uint64_t> *read_valids[NUM_READERS];
   std::atomic<uint64_t> *read_uids[NUM_READERS];
+  std::atomic<uint64_t> *read_notifys[NUM_READERS];
   char * mmap_p;
   char * data;
   size_t size;
@@ -38,6 +42,20 @@ struct msgq_queue_t {
 
   bool read_conflate;
   std::string endpoint;
+
+  // bit in the reader thread's notify slot, and whether the last poll found this queue ready
+  int notify_bit;
+  bool notify_ready;
+};
+
+// Wakeup word for one reader thread, in a segment shared by all processes.
+// Publishers set the bit of the queue they wrote to and wake the futex, so msgq_poll
+// only has to look at the queues that changed instead of scanning all of them.
+struct alignas(64) msgq_notify_slot_t {
+  std::atomic<uint32_t> seq;
+  std::atomic<uint32_t> waiting;
+  std::atomic<uint64_t> owner;
+  std::atomic<uint64_t> pending[MSGQ_NOTIFY_BITS / 64];
 };
 
 struct msgq_msg_t {
@@ -1,3 +1,6 @@
+#include <chrono>
+#include <thread>
+
 #include "catch2/catch.hpp"
 #include "msgq/msgq.h"
 
@@ -422,3 +425,86 @@ TEST_CASE("1 publisher, 2 subscribers", "[integration]")
     msgq_msg_close(&msg2);
   }
 }
+
+TEST_CASE("msgq_poll only returns queues with messages", "[integration]")
+{
+  remove("/dev/shm/test_queue");
+  remove("/dev/shm/test_queue2");
+  msgq_queue_t writer1, writer2, reader1, reader2;
+
+  msgq_new_queue(&writer1, "test_queue", 1024);
+  msgq_new_queue(&writer2, "test_queue2", 1024);
+  msgq_new_queue(&reader1, "test_queue", 1024);
+  msgq_new_queue(&reader2, "test_queue2", 1024);
+
+  msgq_init_publisher(&writer1);
+  msgq_init_publisher(&writer2);
+  msgq_init_subscriber(&reader1);
+  msgq_init_subscriber(&reader2);
+
+  msgq_pollitem_t items[2];
+  items[0].q = &reader1;
+  items[1].q = &reader2;
+  REQUIRE(msgq_poll(items, 2, 0) == 0);
+
+  uint64_t i = 0;
+  for (int n = 0; n < 2; n++)
+  {
+    msgq_msg_t outgoing_msg;
+    msgq_msg_init_data(&outgoing_msg, (char *)&i, sizeof(uint64_t));
+    msgq_msg_send(&outgoing_msg, &writer2);
+    msgq_msg_close(&outgoing_msg);
+  }
+
+  REQUIRE(msgq_poll(items, 2, 0) == 1);
+  REQUIRE(items[0].revents == 0);
+  REQUIRE(items[1].revents == 1);
+
+  // A queue stays ready until it is drained, even without new notifications
+  msgq_msg_t msg;
+  REQUIRE(msgq_msg_recv(&msg, &reader2) == sizeof(uint64_t));
+  msgq_msg_close(&msg);
+  REQUIRE(msgq_poll(items, 2, 0) == 1);
+  REQUIRE(items[1].revents == 1);
+
+  REQUIRE(msgq_msg_recv(&msg, &reader2) == sizeof(uint64_t));
+  msgq_msg_close(&msg);
+  REQUIRE(msgq_poll(items, 2, 0) == 0);
+}
+
+TEST_CASE("msgq_poll wakes up on a message from another thread", "[integration]")
+{
+  remove("/dev/shm/test_queue");
+  msgq_queue_t writer, reader;
+
+  msgq_new_queue(&writer, "test_queue", 1024);
+  msgq_new_queue(&reader, "test_queue", 1024);
+
+  msgq_init_publisher(&writer);
+  msgq_init_subscriber(&reader);
+
+  std::thread publisher([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    uint64_t i = 1;
+    msgq_msg_t outgoing_msg;
+    msgq_msg_init_data(&outgoing_msg, (char *)&i, sizeof(uint64_t));
+    msgq_msg_send(&outgoing_msg, &writer);
+    msgq_msg_close(&outgoing_msg);
+  });
+
+  msgq_pollitem_t items[1];
+  items[0].q = &reader;
+
+  auto start = std::chrono::steady_clock::now();
+  REQUIRE(msgq_poll(items, 1, 5000) == 1);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  // well under MSGQ_FULL_SCAN_MS, so only the futex wake can get us here in time
+  REQUIRE(elapsed < std::chrono::milliseconds(50));
+  publisher.join();
+
+  REQUIRE(msgq_poll(items, 1, 10) == 1);
+  msgq_msg_t msg;
+  REQUIRE(msgq_msg_recv(&msg, &reader) == sizeof(uint64_t));
+  msgq_msg_close(&msg);
+  REQUIRE(msgq_poll(items, 1, 10) == 0);
+}
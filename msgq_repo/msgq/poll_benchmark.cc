@@ -0,0 +1,95 @@
+// Measures the CPU cost of a poller subscribed to many queues, like loggerd.
+// A publisher thread writes to every queue at its rate while the main thread polls and receives.
+// usage: ./poll_benchmark [seconds]
+
+#include <sys/resource.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "msgq/msgq.h"
+
+const int NUM_QUEUES = 100;
+
+static double thread_cpu_seconds() {
+  struct rusage usage;
+  getrusage(RUSAGE_THREAD, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+}
+
+int main(int argc, char *argv[]) {
+  const double duration = argc > 1 ? atof(argv[1]) : 5.0;
+
+  // roughly the mix of service rates loggerd sees
+  std::vector<int> rates;
+  for (int i = 0; i < NUM_QUEUES; i++) {
+    rates.push_back(i < 15 ? 100 : (i < 40 ? 20 : (i < 60 ? 10 : 2)));
+  }
+
+  std::vector<msgq_queue_t> writers(NUM_QUEUES), readers(NUM_QUEUES);
+  std::vector<msgq_pollitem_t> items(NUM_QUEUES);
+  for (int i = 0; i < NUM_QUEUES; i++) {
+    std::string name = "poll_benchmark_" + std::to_string(i);
+    msgq_new_queue(&writers[i], name.c_str(), 1024 * 1024);
+    msgq_new_queue(&readers[i], name.c_str(), 1024 * 1024);
+    msgq_init_publisher(&writers[i]);
+    msgq_init_subscriber(&readers[i]);
+    items[i].q = &readers[i];
+  }
+
+  std::atomic<bool> done = false;
+  std::atomic<uint64_t> sent = 0;
+  std::atomic<double> publisher_cpu = 0;
+  std::thread publisher([&]() {
+    double cpu_start = thread_cpu_seconds();
+    char data[256] = {};
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t tick = 0; !done; tick++) {
+      for (int i = 0; i < NUM_QUEUES; i++) {
+        if (tick % (1000 / rates[i]) == 0) {
+          msgq_msg_t msg;
+          msgq_msg_init_data(&msg, data, sizeof(data));
+          msgq_msg_send(&msg, &writers[i]);
+          msgq_msg_close(&msg);
+          sent++;
+        }
+      }
+      std::this_thread::sleep_until(start + std::chrono::milliseconds(tick + 1));
+    }
+    publisher_cpu = thread_cpu_seconds() - cpu_start;
+  });
+
+  uint64_t received = 0, wakeups = 0;
+  double cpu_start = thread_cpu_seconds();
+  auto start = std::chrono::steady_clock::now();
+  while (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < duration) {
+    if (msgq_poll(items.data(), items.size(), 100) == 0) continue;
+    wakeups++;
+    for (auto &item : items) {
+      if (!item.revents) continue;
+      msgq_msg_t msg;
+      while (msgq_msg_recv(&msg, item.q) > 0) {
+        msgq_msg_close(&msg);
+        received++;
+      }
+    }
+  }
+  double cpu = thread_cpu_seconds() - cpu_start;
+  done = true;
+  publisher.join();
+
+  printf("%d queues, %.1f s: sent %lu, received %lu, %lu wakeups\n", NUM_QUEUES, duration, sent.load(), received, wakeups);
+  printf("poller cpu: %.3f s (%.2f%% of one core), %.2f us per message\n", cpu, 100.0 * cpu / duration, 1e6 * cpu / received);
+  printf("publisher cpu: %.3f s, %.2f us per message\n", publisher_cpu.load(), 1e6 * publisher_cpu / sent);
+
+  for (int i = 0; i < NUM_QUEUES; i++) {
+    msgq_close_queue(&writers[i]);
+    msgq_close_queue(&readers[i]);
+  }
+  return 0;
+}
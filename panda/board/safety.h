@@ -56,6 +56,11 @@ uint16_t current_safety_mode = SAFETY_SILENT;
 uint16_t current_safety_param = 0;
 const safety_hooks *current_hooks = &nooutput_hooks;
 safety_config current_safety_config;
+SafetyLookupEntry rx_lookup[SAFETY_LOOKUP_SIZE];
+SafetyLookupEntry tx_lookup[SAFETY_LOOKUP_SIZE];
+// the rx checks rx_lookup was built from
+const RxCheck *rx_lookup_checks = NULL;
+int rx_lookup_checks_len = 0;
 
 bool safety_rx_hook(const CANPacket_t *to_push) {
   bool controls_allowed_prev = controls_allowed;
@@ -74,7 +79,7 @@ bool safety_rx_hook(const CANPacket_t *to_push) {
 }
 
 bool safety_tx_hook(CANPacket_t *to_send) {
-  bool whitelisted = msg_allowed(to_send, current_safety_config.tx_msgs, current_safety_config.tx_msgs_len);
+  bool whitelisted = msg_allowed(to_send, tx_lookup);
   if ((current_safety_mode == SAFETY_ALLOUTPUT) || (current_safety_mode == SAFETY_ELM327)) {
     whitelisted = true;
   }
@@ -121,46 +126,99 @@ void gen_crc_lookup_table_16(uint16_t poly, uint16_t crc_lut[]) {
   }
 }
 
-bool msg_allowed(const CANPacket_t *to_send, const CanMsg msg_list[], int len) {
+static uint32_t safety_lookup_slot(int addr, int bus, int len) {
+  // multiplicative hashing, the top bits depend on all bits of the key
+  uint32_t key = (uint32_t)addr ^ ((uint32_t)bus << 29) ^ ((uint32_t)len << 22);
+  return (key * 2654435761U) >> (32U - SAFETY_LOOKUP_BITS);
+}
+
+static void safety_lookup_insert(SafetyLookupEntry lookup[], int addr, int bus, int len, int index, int msg_index) {
+  // linear probing, entries with the same key stay in insertion order along the probe sequence.
+  // a full table drops the entry, which fails safe: the msg is never allowed or seen
+  uint32_t slot = safety_lookup_slot(addr, bus, len);
+  bool inserted = false;
+  for (uint32_t probe = 0U; !inserted && (probe < SAFETY_LOOKUP_SIZE); probe++) {
+    SafetyLookupEntry *entry = &lookup[(slot + probe) & (SAFETY_LOOKUP_SIZE - 1U)];
+    if (!entry->used) {
+      *entry = (SafetyLookupEntry){.used = true, .addr = addr, .bus = bus, .len = len, .index = index, .msg_index = msg_index};
+      inserted = true;
+    }
+  }
+}
+
+static void safety_lookup_clear(SafetyLookupEntry lookup[]) {
+  for (uint32_t i = 0U; i < SAFETY_LOOKUP_SIZE; i++) {
+    lookup[i].used = false;
+  }
+}
+
+void build_rx_lookup(SafetyLookupEntry lookup[], const RxCheck addr_list[], int len) {
+  safety_lookup_clear(lookup);
+  for (int i = 0; i < len; i++) {
+    for (uint8_t j = 0U; (j < MAX_ADDR_CHECK_MSGS) && (addr_list[i].msg[j].addr != 0); j++) {
+      const CanMsgCheck *msg = &addr_list[i].msg[j];
+      safety_lookup_insert(lookup, msg->addr, msg->bus, msg->len, i, j);
+    }
+  }
+}
+
+// rx_lookup for the rx checks of cfg. set_safety_hooks builds it for the installed config,
+// any other config has it rebuilt
+static const SafetyLookupEntry *get_rx_lookup(const safety_config *cfg) {
+  if ((cfg->rx_checks != rx_lookup_checks) || (cfg->rx_checks_len != rx_lookup_checks_len)) {
+    build_rx_lookup(rx_lookup, cfg->rx_checks, cfg->rx_checks_len);
+    rx_lookup_checks = cfg->rx_checks;
+    rx_lookup_checks_len = cfg->rx_checks_len;
+  }
+  return rx_lookup;
+}
+
+void build_tx_lookup(SafetyLookupEntry lookup[], const CanMsg msg_list[], int len) {
+  safety_lookup_clear(lookup);
+  for (int i = 0; i < len; i++) {
+    safety_lookup_insert(lookup, msg_list[i].addr, msg_list[i].bus, msg_list[i].len, i, 0);
+  }
+}
+
+bool msg_allowed(const CANPacket_t *to_send, const SafetyLookupEntry lookup[]) {
   int addr = GET_ADDR(to_send);
   int bus = GET_BUS(to_send);
   int length = GET_LEN(to_send);
 
   bool allowed = false;
-  for (int i = 0; i < len; i++) {
-    if ((addr == msg_list[i].addr) && (bus == msg_list[i].bus) && (length == msg_list[i].len)) {
-      allowed = true;
-      break;
-    }
+  bool empty = false;
+  uint32_t slot = safety_lookup_slot(addr, bus, length);
+  for (uint32_t probe = 0U; !allowed && !empty && (probe < SAFETY_LOOKUP_SIZE); probe++) {
+    const SafetyLookupEntry *entry = &lookup[(slot + probe) & (SAFETY_LOOKUP_SIZE - 1U)];
+    empty = !entry->used;
+    allowed = !empty && (addr == entry->addr) && (bus == entry->bus) && (length == entry->len);
   }
   return allowed;
 }
 
-int get_addr_check_index(const CANPacket_t *to_push, RxCheck addr_list[], const int len) {
+int get_addr_check_index(const CANPacket_t *to_push, RxCheck addr_list[], const SafetyLookupEntry lookup[]) {
   int bus = GET_BUS(to_push);
   int addr = GET_ADDR(to_push);
   int length = GET_LEN(to_push);
 
+  // only the rx checks with a msg matching this one are visited, in the order of addr_list
   int index = -1;
-  for (int i = 0; i < len; i++) {
-    // if multiple msgs are allowed, determine which one is present on the bus
-    if (!addr_list[i].status.msg_seen) {
-      for (uint8_t j = 0U; (j < MAX_ADDR_CHECK_MSGS) && (addr_list[i].msg[j].addr != 0); j++) {
-        if ((addr == addr_list[i].msg[j].addr) && (bus == addr_list[i].msg[j].bus) &&
-              (length == addr_list[i].msg[j].len)) {
-          addr_list[i].status.index = j;
-          addr_list[i].status.msg_seen = true;
-          break;
-        }
+  bool empty = false;
+  uint32_t slot = safety_lookup_slot(addr, bus, length);
+  for (uint32_t probe = 0U; (index == -1) && !empty && (probe < SAFETY_LOOKUP_SIZE); probe++) {
+    const SafetyLookupEntry *entry = &lookup[(slot + probe) & (SAFETY_LOOKUP_SIZE - 1U)];
+    empty = !entry->used;
+    if (!empty && (addr == entry->addr) && (bus == entry->bus) && (length == entry->len)) {
+      RxCheck *check = &addr_list[entry->index];
+      // if multiple msgs are allowed, determine which one is present on the bus
+      if (!check->status.msg_seen) {
+        check->status.index = entry->msg_index;
+        check->status.msg_seen = true;
       }
-    }
 
-    if (addr_list[i].status.msg_seen) {
-      int idx = addr_list[i].status.index;
-      if ((addr == addr_list[i].msg[idx].addr) && (bus == addr_list[i].msg[idx].bus) &&
-          (length == addr_list[i].msg[idx].len)) {
-        index = i;
-        break;
+      int idx = check->status.index;
+      if ((addr == check->msg[idx].addr) && (bus == check->msg[idx].bus) && (length == check->msg[idx].len)) {
+        index = entry->index;
       }
     }
   }
@@ -224,7 +282,7 @@ bool rx_msg_safety_check(const CANPacket_t *to_push,
                          const safety_config *cfg,
                          const safety_hooks *safety_hooks) {
 
-  int index = get_addr_check_index(to_push, cfg->rx_checks, cfg->rx_checks_len);
+  int index = get_addr_check_index(to_push, cfg->rx_checks, get_rx_lookup(cfg));
   update_addr_timestamp(cfg->rx_checks, index);
 
   if (index != -1) {
@@ -384,6 +442,10 @@ int set_safety_hooks(uint16_t mode, uint16_t param) {
       current_safety_config.rx_checks[j].status = (RxStatus){0};
     }
   }
+  build_rx_lookup(rx_lookup, current_safety_config.rx_checks, current_safety_config.rx_checks_len);
+  rx_lookup_checks = current_safety_config.rx_checks;
+  rx_lookup_checks_len = current_safety_config.rx_checks_len;
+  build_tx_lookup(tx_lookup, current_safety_config.tx_msgs, current_safety_config.tx_msgs_len);
   return set_status;
 }
 
@@ -144,6 +144,20 @@ typedef struct {
   int tx_msgs_len;
 } safety_config;
 
+// open addressing hash table from (addr, bus, len) to the rx checks or tx msgs of the current safety config,
+// built by set_safety_hooks so the rx and tx hooks don't scan the lists for every message
+#define SAFETY_LOOKUP_BITS 6U
+#define SAFETY_LOOKUP_SIZE (1U << SAFETY_LOOKUP_BITS)  // at least twice the longest rx checks or tx msgs list
+
+typedef struct {
+  bool used;      // false if the slot is unused, so a zeroed table is empty
+  int addr;
+  int bus;
+  int len;
+  int index;      // index in rx_checks or tx_msgs
+  int msg_index;  // rx checks only, the first msg in rx_checks[index].msg with this addr, bus and len
+} SafetyLookupEntry;
+
 typedef uint32_t (*get_checksum_t)(const CANPacket_t *to_push);
 typedef uint32_t (*compute_checksum_t)(const CANPacket_t *to_push);
 typedef uint8_t (*get_counter_t)(const CANPacket_t *to_push);
@@ -185,8 +199,10 @@ float interpolate(struct lookup_t xy, float x);
 int ROUND(float val);
 void gen_crc_lookup_table_8(uint8_t poly, uint8_t crc_lut[]);
 void gen_crc_lookup_table_16(uint16_t poly, uint16_t crc_lut[]);
-bool msg_allowed(const CANPacket_t *to_send, const CanMsg msg_list[], int len);
-int get_addr_check_index(const CANPacket_t *to_push, RxCheck addr_list[], const int len);
+bool msg_allowed(const CANPacket_t *to_send, const SafetyLookupEntry lookup[]);
+int get_addr_check_index(const CANPacket_t *to_push, RxCheck addr_list[], const SafetyLookupEntry lookup[]);
+void build_rx_lookup(SafetyLookupEntry lookup[], const RxCheck addr_list[], int len);
+void build_tx_lookup(SafetyLookupEntry lookup[], const CanMsg msg_list[], int len);
 void update_counter(RxCheck addr_list[], int index, uint8_t counter);
 void update_addr_timestamp(RxCheck addr_list[], int index);
 bool is_msg_valid(RxCheck addr_list[], int index);
@@ -75,6 +75,7 @@ class Panda(PandaSafety, Protocol):
   # safety
   def safety_rx_hook(self, to_send: CANPacket) -> int: ...
   def safety_tx_hook(self, to_push: CANPacket) -> int: ...
+  def test_rx_checks_rx(self, to_push: CANPacket) -> bool: ...
   def safety_fwd_hook(self, bus_num: int, addr: int) -> int: ...
   def set_safety_hooks(self, mode: int, param: int) -> int: ...
 
@@ -181,6 +181,35 @@ bool get_honda_fwd_brake(void){
   return honda_fwd_brake;
 }
 
+// rx checks of a config that isn't installed, with two msgs under one check
+RxCheck test_rx_checks[] = {
+  {.msg = {{0x123, 0, 8, .frequency = 10U}, { 0 }, { 0 }}},
+  {.msg = {{0x456, 1, 8, .frequency = 10U}, {0x457, 1, 6, .frequency = 10U}, { 0 }}},
+};
+
+void init_test_rx_checks(void) {
+  for (int i = 0; i < (int)(sizeof(test_rx_checks) / sizeof(test_rx_checks[0])); i++) {
+    test_rx_checks[i].status = (RxStatus){0};
+  }
+}
+
+bool test_rx_checks_rx(CANPacket_t *to_push) {
+  safety_config cfg = {.rx_checks = test_rx_checks, .rx_checks_len = sizeof(test_rx_checks) / sizeof(test_rx_checks[0])};
+  return rx_msg_safety_check(to_push, &cfg, &nooutput_hooks);
+}
+
+bool get_test_rx_check_seen(int index) {
+  return test_rx_checks[index].status.msg_seen;
+}
+
+int get_test_rx_check_msg_index(int index) {
+  return test_rx_checks[index].status.index;
+}
+
+uint32_t get_test_rx_check_last_timestamp(int index) {
+  return test_rx_checks[index].status.last_timestamp;
+}
+
 void init_tests(void){
   // get HW_TYPE from env variable set in test.sh
   if (getenv("HW_TYPE")) {
@@ -46,6 +46,12 @@ def setup_safety_helpers(ffi):
 
   void init_tests(void);
 
+  void init_test_rx_checks(void);
+  bool test_rx_checks_rx(CANPacket_t *to_push);
+  bool get_test_rx_check_seen(int index);
+  int get_test_rx_check_msg_index(int index);
+  uint32_t get_test_rx_check_last_timestamp(int index);
+
   void set_honda_fwd_brake(bool c);
   bool get_honda_fwd_brake(void);
   void set_honda_alt_brake_msg(bool c);
@@ -97,6 +103,11 @@ class PandaSafety(Protocol):
 
   def init_tests(self) -> None: ...
 
+  def init_test_rx_checks(self) -> None: ...
+  def get_test_rx_check_seen(self, index: int) -> bool: ...
+  def get_test_rx_check_msg_index(self, index: int) -> int: ...
+  def get_test_rx_check_last_timestamp(self, index: int) -> int: ...
+
   def set_honda_fwd_brake(self, c: bool) -> None: ...
   def get_honda_fwd_brake(self) -> bool: ...
   def set_honda_alt_brake_msg(self, c: bool) -> None: ...
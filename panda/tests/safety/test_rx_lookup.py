@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+import subprocess
+import sys
+import unittest
+
+import panda.tests.safety.common as common
+
+from panda import Panda
+from panda.tests.libpanda import libpanda_py
+
+
+class TestRxLookup(unittest.TestCase):
+  """rx_msg_safety_check looks msgs up in a hash table built from the config it's passed"""
+  TX_MSGS = None
+
+  def setUp(self):
+    self.safety = libpanda_py.libpanda
+    self.safety.set_safety_hooks(Panda.SAFETY_BODY, 0)
+    self.safety.init_tests()
+    self.safety.init_test_rx_checks()
+
+  def _test_rx(self, bus, addr, length):
+    return self.safety.test_rx_checks_rx(common.make_msg(bus, addr, length))
+
+  def test_lookup(self):
+    self.assertTrue(self._test_rx(0, 0x123, 8))
+    self.assertTrue(self.safety.get_test_rx_check_seen(0))
+    self.assertFalse(self.safety.get_test_rx_check_seen(1))
+
+    # second msg of a check with multiple msgs
+    self.assertTrue(self._test_rx(1, 0x457, 6))
+    self.assertTrue(self.safety.get_test_rx_check_seen(1))
+    self.assertEqual(self.safety.get_test_rx_check_msg_index(1), 1)
+
+  def test_missing_addr(self):
+    # not in the table, or in it on another bus or with another length
+    for bus, addr, length in ((0, 0x124, 8), (2, 0x123, 8), (1, 0x456, 6), (0, 0x201, 8)):
+      self.assertTrue(self._test_rx(bus, addr, length))
+    for i in range(2):
+      self.assertFalse(self.safety.get_test_rx_check_seen(i))
+      self.assertEqual(self.safety.get_test_rx_check_last_timestamp(i), 0)
+
+  def test_installed_config(self):
+    # looking up another config doesn't break lookups for the installed one
+    self.assertTrue(self._test_rx(0, 0x123, 8))
+    self.assertFalse(self.safety.safety_config_valid())
+    self.assertTrue(self.safety.safety_rx_hook(common.make_msg(0, 0x201, 8)))
+    self.assertTrue(self.safety.safety_config_valid())
+    self.assertTrue(self.safety.get_controls_allowed())
+
+  def test_boot_silent(self):
+    # at boot the table is zeroed and SILENT has no rx checks, a fresh libpanda matches that
+    code = ("from panda import Panda; from panda.tests.libpanda import libpanda_py; import panda.tests.safety.common as common; "
+            "libpanda_py.libpanda.set_safety_hooks(Panda.SAFETY_SILENT, 0); "
+            "libpanda_py.libpanda.safety_rx_hook(common.make_msg(0, 0, 0))")
+    subprocess.run([sys.executable, "-c", code], check=True)
+
+  def test_no_rx_checks(self):
+    # modes without rx checks get an empty table, a zeroed or stale entry would point into NULL rx_checks
+    for mode in (Panda.SAFETY_SILENT, Panda.SAFETY_NOOUTPUT, Panda.SAFETY_ALLOUTPUT, Panda.SAFETY_ELM327):
+      self.safety.set_safety_hooks(mode, 0)
+      for bus, addr, length in ((0, 0, 0), (0, 0x201, 8)):
+        self.safety.safety_rx_hook(common.make_msg(bus, addr, length))
+
+
+if __name__ == "__main__":
+  unittest.main()
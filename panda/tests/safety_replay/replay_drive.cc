@@ -0,0 +1,413 @@
+// Native version of replay_drive.py: replays the can and sendcan messages of rlogs through libpanda's
+// safety hooks and reports the same counters and verdict. Safety state is global in libpanda, so every
+// segment is replayed in its own forked worker, with at most --jobs running at a time.
+// usage: ./replay_drive [--mode N] [--param N] [--alternative-experience N] [--jobs N] [--libpanda PATH] rlog [rlog...]
+
+#include <dlfcn.h>
+#include <getopt.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "cereal/gen/cpp/log.capnp.h"
+#include "common/decompress.h"
+#include "common/util.h"
+#include "panda/board/can_definitions.h"
+
+// from board/safety.h and python/__init__.py
+const uint16_t SAFETY_HONDA_NIDEC = 1, SAFETY_TOYOTA = 2, SAFETY_GM = 4, SAFETY_FORD = 6, SAFETY_HYUNDAI = 8,
+               SAFETY_CHRYSLER = 9, SAFETY_SUBARU = 11, SAFETY_NISSAN = 14, SAFETY_HONDA_BOSCH = 20;
+const uint16_t FLAG_TOYOTA_LTA = 4 << 8;
+
+// libpanda is built with its own libc functions, it's loaded with RTLD_LOCAL like cffi does so they don't
+// interpose on the ones used here
+struct LibPanda {
+  bool load(const std::string &path) {
+    handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+      fprintf(stderr, "failed to load %s: %s\n", path.c_str(), dlerror());
+      return false;
+    }
+    bool ok = true;
+    auto sym = [&](auto &fn, const char *name) {
+      fn = (std::remove_reference_t<decltype(fn)>)dlsym(handle, name);
+      ok = ok && fn != nullptr;
+    };
+    sym(set_safety_hooks, "set_safety_hooks");
+    sym(set_alternative_experience, "set_alternative_experience");
+    sym(set_timer, "set_timer");
+    sym(safety_tick_current_safety_config, "safety_tick_current_safety_config");
+    sym(safety_config_valid, "safety_config_valid");
+    sym(safety_rx_hook, "safety_rx_hook");
+    sym(safety_tx_hook, "safety_tx_hook");
+    sym(get_controls_allowed, "get_controls_allowed");
+    sym(set_controls_allowed, "set_controls_allowed");
+    sym(set_desired_torque_last, "set_desired_torque_last");
+    sym(set_desired_angle_last, "set_desired_angle_last");
+    sym(set_angle_meas, "set_angle_meas");
+    sym(can_set_checksum, "can_set_checksum");
+    if (!ok) fprintf(stderr, "missing symbols in %s\n", path.c_str());
+    return ok;
+  }
+
+  void *handle = nullptr;
+  int (*set_safety_hooks)(uint16_t mode, uint16_t param);
+  void (*set_alternative_experience)(int mode);
+  void (*set_timer)(uint32_t t);
+  void (*safety_tick_current_safety_config)();
+  bool (*safety_config_valid)();
+  bool (*safety_rx_hook)(CANPacket_t *to_push);
+  bool (*safety_tx_hook)(CANPacket_t *to_send);
+  bool (*get_controls_allowed)();
+  void (*set_controls_allowed)(bool c);
+  void (*set_desired_torque_last)(int t);
+  void (*set_desired_angle_last)(int t);
+  void (*set_angle_meas)(int min, int max);
+  void (*can_set_checksum)(CANPacket_t *packet);
+};
+
+struct CanFrame {
+  uint32_t address;
+  uint8_t src;
+  uint8_t len;
+  uint8_t dat[CANPACKET_DATA_SIZE_MAX];
+};
+
+struct CanMessage {
+  uint64_t mono_time;
+  bool sendcan;
+  size_t begin, end;  // range in Segment::frames
+};
+
+struct Segment {
+  std::vector<CanFrame> frames;
+  std::vector<CanMessage> msgs;
+  std::optional<uint16_t> mode, param;
+  std::optional<int> alternative_experience;
+};
+
+struct Options {
+  std::optional<uint16_t> mode, param;
+  std::optional<int> alternative_experience;
+  int jobs = std::max(1u, std::thread::hardware_concurrency());
+  std::string libpanda;
+};
+
+static bool load_segment(const std::string &fn, Segment &seg) {
+  std::string data = util::decompress(fn, util::read_file(fn));
+  if (data.empty()) return false;
+
+  // copy into word aligned memory for capnp
+  kj::Array<capnp::word> buf = kj::heapArray<capnp::word>(data.size() / sizeof(capnp::word));
+  memcpy(buf.begin(), data.data(), buf.size() * sizeof(capnp::word));
+  kj::ArrayPtr<const capnp::word> words = buf.asPtr();
+  try {
+    while (words.size() > 0) {
+      capnp::FlatArrayMessageReader reader(words);
+      auto event = reader.getRoot<cereal::Event>();
+      words = kj::arrayPtr(reader.getEnd(), words.end());
+
+      if (event.isCan() || event.isSendcan()) {
+        auto can = event.isCan() ? event.getCan() : event.getSendcan();
+        CanMessage msg = {event.getLogMonoTime(), event.isSendcan(), seg.frames.size(), seg.frames.size()};
+        for (const auto &c : can) {
+          auto dat = c.getDat();
+          CanFrame f = {c.getAddress(), (uint8_t)c.getSrc(), (uint8_t)std::min<size_t>(dat.size(), CANPACKET_DATA_SIZE_MAX), {}};
+          memcpy(f.dat, dat.begin(), f.len);
+          seg.frames.push_back(f);
+        }
+        msg.end = seg.frames.size();
+        seg.msgs.push_back(msg);
+      } else if (event.isCarParams() && !seg.mode) {
+        auto cp = event.getCarParams();
+        if (cp.getSafetyConfigs().size() > 0) {
+          auto cfg = cp.getSafetyConfigs()[cp.getSafetyConfigs().size() - 1];
+          seg.mode = (uint16_t)cfg.getSafetyModel();
+          seg.param = cfg.getSafetyParam();
+          seg.alternative_experience = cp.getAlternativeExperience();
+        }
+      }
+    }
+  } catch (const kj::Exception &e) {
+    // a truncated log still has usable messages
+    fprintf(stderr, "%s: %s\n", fn.c_str(), e.getDescription().cStr());
+  }
+  return !seg.msgs.empty();
+}
+
+static CANPacket_t make_packet(LibPanda &lib, const CanFrame &f) {
+  CANPacket_t p = {};
+  p.extended = f.address >= 0x800 ? 1 : 0;
+  p.addr = f.address;
+  const size_t dlc = std::find(std::begin(dlc_to_len), std::end(dlc_to_len), f.len) - std::begin(dlc_to_len);
+  assert(dlc < std::size(dlc_to_len));
+  p.data_len_code = dlc;
+  p.bus = f.src % 4;
+  memcpy(p.data, f.dat, f.len);
+  lib.can_set_checksum(&p);
+  return p;
+}
+
+// see helpers.py
+static bool is_steering_msg(uint16_t mode, uint16_t param, uint32_t addr) {
+  switch (mode) {
+    case SAFETY_HONDA_NIDEC:
+    case SAFETY_HONDA_BOSCH: return addr == 0xE4 || addr == 0x194 || addr == 0x33D || addr == 0x33DA || addr == 0x33DB;
+    case SAFETY_TOYOTA: return addr == ((param & FLAG_TOYOTA_LTA) ? 0x191 : 0x2E4);
+    case SAFETY_GM: return addr == 384;
+    case SAFETY_HYUNDAI: return addr == 832;
+    case SAFETY_CHRYSLER: return addr == 0x292;
+    case SAFETY_SUBARU: return addr == 0x122;
+    case SAFETY_FORD: return addr == 0x3d3;
+    case SAFETY_NISSAN: return addr == 0x169;
+    default: return false;
+  }
+}
+
+static int to_signed(int d, int bits) {
+  return d >= (1 << (bits - 1)) ? d - (1 << bits) : d;
+}
+
+static std::pair<int, int> get_steer_value(uint16_t mode, uint16_t param, const uint8_t *d) {
+  int torque = 0, angle = 0;
+  if (mode == SAFETY_HONDA_NIDEC || mode == SAFETY_HONDA_BOSCH) {
+    torque = to_signed((d[0] << 8) | d[1], 16);
+  } else if (mode == SAFETY_TOYOTA) {
+    if (param & FLAG_TOYOTA_LTA) {
+      angle = to_signed((d[1] << 8) | d[2], 16);
+    } else {
+      torque = to_signed((d[1] << 8) | d[2], 16);
+    }
+  } else if (mode == SAFETY_GM) {
+    torque = to_signed(((d[0] & 0x7) << 8) | d[1], 11);
+  } else if (mode == SAFETY_HYUNDAI) {
+    torque = (((d[3] & 0x7) << 8) | d[2]) - 1024;
+  } else if (mode == SAFETY_CHRYSLER) {
+    torque = (((d[0] & 0x7) << 8) | d[1]) - 1024;
+  } else if (mode == SAFETY_SUBARU) {
+    torque = -to_signed(((d[3] & 0x1F) << 8) | d[2], 13);
+  } else if (mode == SAFETY_FORD) {
+    angle = ((d[0] << 3) | (d[1] >> 5)) - 1000;
+  } else if (mode == SAFETY_NISSAN) {
+    angle = -((d[0] << 10) | (d[1] << 2) | (d[2] >> 6)) + (1310 * 100);
+  }
+  return {torque, angle};
+}
+
+static bool init_segment(LibPanda &lib, const Segment &seg, uint16_t mode, uint16_t param) {
+  for (const auto &msg : seg.msgs) {
+    for (size_t i = msg.begin; msg.sendcan && i < msg.end; ++i) {
+      if (!is_steering_msg(mode, param, seg.frames[i].address)) continue;
+
+      CANPacket_t to_send = make_packet(lib, seg.frames[i]);
+      auto [torque, angle] = get_steer_value(mode, param, to_send.data);
+      if (torque != 0) {
+        lib.set_controls_allowed(true);
+        lib.set_desired_torque_last(torque);
+      } else if (angle != 0) {
+        lib.set_controls_allowed(true);
+        lib.set_desired_angle_last(angle);
+        lib.set_angle_meas(angle, angle);
+      }
+      return lib.safety_tx_hook(&to_send);
+    }
+  }
+  // no steering msgs
+  return true;
+}
+
+// exit code: 0 if the segment passes, 1 if it doesn't and 2 on errors
+static int replay_segment(const std::string &fn, const Options &opts) {
+  LibPanda lib;
+  Segment seg;
+  if (!lib.load(opts.libpanda)) return 2;
+  if (!load_segment(fn, seg)) {
+    fprintf(stderr, "%s: failed to load can messages\n", fn.c_str());
+    return 2;
+  }
+
+  const auto mode = opts.mode ? opts.mode : seg.mode;
+  const auto param = opts.param ? opts.param : seg.param;
+  const auto alternative_experience = opts.alternative_experience ? opts.alternative_experience : seg.alternative_experience;
+  if (!mode || !param || !alternative_experience) {
+    fprintf(stderr, "%s: carParams not found in log. Set safety mode and param manually.\n", fn.c_str());
+    return 2;
+  }
+  if (lib.set_safety_hooks(*mode, *param) != 0) {
+    fprintf(stderr, "%s: invalid safety mode: %d\n", fn.c_str(), *mode);
+    return 2;
+  }
+  lib.set_alternative_experience(*alternative_experience);
+  if (!init_segment(lib, seg, *mode, *param)) {
+    fprintf(stderr, "%s: failed to initialize panda safety for segment\n", fn.c_str());
+    return 2;
+  }
+
+  uint64_t rx_tot = 0, rx_invalid = 0, tx_tot = 0, tx_blocked = 0, tx_controls = 0, tx_controls_blocked = 0;
+  bool safety_tick_rx_invalid = false;
+  std::map<uint32_t, int> blocked_addrs;
+  std::set<uint32_t> invalid_addrs;
+  const bool debug = getenv("DEBUG") != nullptr;
+
+  const uint64_t start_t = seg.msgs.front().mono_time;
+  const uint64_t end_t = seg.msgs.back().mono_time;
+  for (const auto &msg : seg.msgs) {
+    lib.set_timer((msg.mono_time / 1000) % 0xFFFFFFFF);
+
+    // skip start and end of route, warm up/down period
+    if (msg.mono_time > start_t + 1000000000ULL && end_t > msg.mono_time + 1000000000ULL) {
+      lib.safety_tick_current_safety_config();
+      safety_tick_rx_invalid |= !lib.safety_config_valid();
+    }
+
+    for (size_t i = msg.begin; i < msg.end; ++i) {
+      const CanFrame &f = seg.frames[i];
+      if (msg.sendcan) {
+        CANPacket_t to_send = make_packet(lib, f);
+        if (!lib.safety_tx_hook(&to_send)) {
+          tx_blocked++;
+          tx_controls_blocked += lib.get_controls_allowed();
+          blocked_addrs[f.address]++;
+          if (debug) {
+            fprintf(stderr, "blocked bus %d msg %d at %f\n", f.src, f.address, (msg.mono_time - start_t) / 1e9);
+          }
+        }
+        tx_controls += lib.get_controls_allowed();
+        tx_tot++;
+      } else if (f.src < 128) {
+        // ignore msgs we sent
+        CANPacket_t to_push = make_packet(lib, f);
+        if (!lib.safety_rx_hook(&to_push)) {
+          rx_invalid++;
+          invalid_addrs.insert(f.address);
+        }
+        rx_tot++;
+      }
+    }
+  }
+
+  std::string invalid = "{", blocked = "{";
+  for (auto addr : invalid_addrs) invalid += (invalid.size() > 1 ? ", " : "") + std::to_string(addr);
+  for (auto &[addr, n] : blocked_addrs) blocked += (blocked.size() > 1 ? ", " : "") + std::to_string(addr) + ": " + std::to_string(n);
+  printf("%s: safety mode %d, param %d, alternative experience %d\n", fn.c_str(), *mode, *param, *alternative_experience);
+  printf("RX total %" PRIu64 ", invalid %" PRIu64 ", safety tick rx invalid %d, invalid addrs %s}\n", rx_tot, rx_invalid, safety_tick_rx_invalid, invalid.c_str());
+  printf("TX total %" PRIu64 ", with controls allowed %" PRIu64 ", blocked %" PRIu64 ", blocked with controls allowed %" PRIu64 ", blocked addrs %s}\n",
+         tx_tot, tx_controls, tx_blocked, tx_controls_blocked, blocked.c_str());
+  return (tx_controls_blocked == 0 && rx_invalid == 0 && !safety_tick_rx_invalid) ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+  Options opts;
+  const std::string exe = util::readlink("/proc/self/exe");
+  opts.libpanda = exe.substr(0, exe.rfind('/')) + "/../libpanda/libpanda.so";
+  const option long_options[] = {
+    {"mode", required_argument, nullptr, 'm'},
+    {"param", required_argument, nullptr, 'p'},
+    {"alternative-experience", required_argument, nullptr, 'a'},
+    {"jobs", required_argument, nullptr, 'j'},
+    {"libpanda", required_argument, nullptr, 'l'},
+    {nullptr, 0, nullptr, 0},
+  };
+  for (int opt; (opt = getopt_long(argc, argv, "j:", long_options, nullptr)) != -1;) {
+    switch (opt) {
+      case 'm': opts.mode = atoi(optarg); break;
+      case 'p': opts.param = atoi(optarg); break;
+      case 'a': opts.alternative_experience = atoi(optarg); break;
+      case 'j': opts.jobs = std::max(1, atoi(optarg)); break;
+      case 'l': opts.libpanda = optarg; break;
+      default: return 2;
+    }
+  }
+  const std::vector<std::string> segments(argv + optind, argv + argc);
+  if (segments.empty()) {
+    fprintf(stderr, "usage: %s [--mode N] [--param N] [--alternative-experience N] [--jobs N] [--libpanda PATH] rlog [rlog...]\n", argv[0]);
+    return 2;
+  }
+
+  // each worker writes its report into a pipe, reports are printed in the order of the segments
+  struct Worker {
+    pid_t pid = -1;
+    int fd = -1;
+    bool done = false;
+    int status = 0;
+    std::string output;
+  };
+  std::vector<Worker> workers(segments.size());
+  size_t next = 0, printed = 0, running = 0;
+  int failed = 0, errors = 0;
+  while (printed < segments.size()) {
+    for (; running < (size_t)opts.jobs && next < segments.size(); ++next, ++running) {
+      int fds[2];
+      if (pipe(fds) != 0) return 2;
+      fflush(stdout);
+      workers[next].pid = fork();
+      if (workers[next].pid == 0) {
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        int ret = replay_segment(segments[next], opts);
+        fflush(stdout);
+        _exit(ret);
+      }
+      close(fds[1]);
+      workers[next].fd = fds[0];
+    }
+
+    // drain the pipes while the workers run, a worker blocks on a full pipe until it's read.
+    // a worker is reaped once its pipe is closed
+    std::vector<pollfd> pfds;
+    std::vector<Worker *> polled;
+    for (size_t i = printed; i < next; ++i) {
+      if (workers[i].fd >= 0) {
+        pfds.push_back({workers[i].fd, POLLIN, 0});
+        polled.push_back(&workers[i]);
+      }
+    }
+    if (poll(pfds.data(), pfds.size(), -1) < 0) {
+      if (errno == EINTR) continue;
+      return 2;
+    }
+    for (size_t i = 0; i < pfds.size(); ++i) {
+      if (pfds[i].revents == 0) continue;
+      Worker &w = *polled[i];
+      char buf[4096];
+      ssize_t n = read(w.fd, buf, sizeof(buf));
+      if (n > 0) {
+        w.output.append(buf, n);
+        continue;
+      }
+      if (n < 0 && errno == EINTR) continue;
+      close(w.fd);
+      w.fd = -1;
+      int status = 0;
+      while (waitpid(w.pid, &status, 0) < 0 && errno == EINTR) {}
+      w.status = WIFEXITED(status) ? WEXITSTATUS(status) : 2;
+      w.done = true;
+      running--;
+    }
+    for (; printed < next && workers[printed].done; ++printed) {
+      printf("%s\n", workers[printed].output.c_str());
+      failed += workers[printed].status == 1;
+      errors += workers[printed].status > 1;
+    }
+  }
+
+  printf("%zu segments, %d failed, %d errors\n", segments.size(), failed, errors);
+  return errors > 0 ? 2 : (failed > 0 ? 1 : 0);
+}
@@ -7,6 +7,7 @@ from panda.tests.libpanda import libpanda_py
 from panda.tests.safety_replay.helpers import package_can_msg, init_segment
 
 # replay a drive to check for safety violations
+# replay_drive.cc does the same for many rlogs at once, replaying each as a segment in its own process
 def replay_drive(lr, safety_mode, param, alternative_experience, segment=False):
   safety = libpanda_py.libpanda
 
@@ -6,7 +6,7 @@ using namespace Eigen;
 
 EKFSym::EKFSym(std::string name, Map<MatrixXdr> Q, Map<VectorXd> x_initial, Map<MatrixXdr> P_initial, int dim_main,
     int dim_main_err, int N, int dim_augment, int dim_augment_err, std::vector<int> maha_test_kinds,
-    std::vector<int> quaternion_idxs, std::vector<std::string> global_vars, double max_rewind_age)
+    std::vector<int> quaternion_idxs, std::vector<std::string> global_vars, double max_rewind_age, int rewind_interval)
 {
   // TODO: add logger
   this->ekf = ekf_lookup(name);
@@ -39,6 +39,12 @@ EKFSym::EKFSym(std::string name, Map<MatrixXdr> Q, Map<VectorXd> x_initial, Map<
   this->Q = Q;
 
   this->max_rewind_age = max_rewind_age;
+  this->rewind_interval = std::max(rewind_interval, 1);
+  this->rewind_t.resize(REWIND_TO_KEEP);
+  this->rewind_has_state.resize(REWIND_TO_KEEP);
+  this->rewind_x.resize(REWIND_TO_KEEP * this->dim_x);
+  this->rewind_P.resize(REWIND_TO_KEEP * this->dim_err * this->dim_err);
+  this->rewind_obscache.resize(REWIND_TO_KEEP);
   this->init_state(x_initial, P_initial, NAN);
 }
 
@@ -85,103 +91,136 @@ std::optional<Estimate> EKFSym::predict_and_update_batch(double t, int kind, std
 {
   // TODO handle rewinding at this level
 
-  std::deque<Observation> rewound;
+  size_t rewound = 0;
   if (!std::isnan(this->filter_time) && t < this->filter_time) {
-    if (this->rewind_t.empty() || t < this->rewind_t.front() || t < this->rewind_t.back() - this->max_rewind_age) {
+    // the oldest stored state is as far back as we can go
+    size_t oldest = 0;
+    while (oldest < this->rewind_size && !this->rewind_has_state[this->rewind_slot(oldest)]) {
+      oldest++;
+    }
+    if (oldest == this->rewind_size || t < this->rewind_t[this->rewind_slot(oldest)] ||
+        t < this->rewind_t[this->rewind_slot(this->rewind_size - 1)] - this->max_rewind_age) {
       LOGD("observation too old at %f with filter at %f, ignoring!", t, this->filter_time);
       return std::nullopt;
     }
     rewound = this->rewind(t);
   }
 
-  Observation obs;
+  // assigning into the scratch observation reuses its buffers
+  Observation &obs = this->obs_scratch;
   obs.t = t;
   obs.kind = kind;
   obs.extra_args = extra_args;
-  for (Map<VectorXd> zi : z_map) {
-    obs.z.push_back(zi);
+  obs.z.resize(z_map.size());
+  for (size_t i = 0; i < z_map.size(); i++) {
+    obs.z[i] = z_map[i];
+  }
+  obs.R.resize(R_map.size());
+  for (size_t i = 0; i < R_map.size(); i++) {
+    obs.R[i] = R_map[i];
   }
-  for (Map<MatrixXdr> Ri : R_map) {
-    obs.R.push_back(Ri);
+
+  // observations between the restored state and t go first
+  size_t i = 0;
+  for (; i < rewound && this->rewind_replay[i].t <= t; i++) {
+    this->predict_and_update_batch(this->rewind_replay[i], false, nullptr);
   }
 
-  std::optional<Estimate> res = std::make_optional(this->predict_and_update_batch(obs, augment));
+  std::optional<Estimate> res = std::make_optional<Estimate>();
+  this->predict_and_update_batch(obs, augment, &res.value());
 
   // optional fast forward
-  while (!rewound.empty()) {
-    this->predict_and_update_batch(rewound.front(), false);
-    rewound.pop_front();
+  for (; i < rewound; i++) {
+    this->predict_and_update_batch(this->rewind_replay[i], false, nullptr);
   }
 
   return res;
 }
 
 void EKFSym::reset_rewind() {
-  this->rewind_obscache.clear();
-  this->rewind_t.clear();
-  this->rewind_states.clear();
+  this->rewind_head = 0;
+  this->rewind_size = 0;
+  this->rewind_since_state = 0;
 }
 
-std::deque<Observation> EKFSym::rewind(double t) {
-  std::deque<Observation> rewound;
+size_t EKFSym::rewind(double t) {
+  // rewind observations until t is after previous observation,
+  // and further back to the last one with a stored state
+  size_t end = this->rewind_size;
+  while (this->rewind_t[this->rewind_slot(this->rewind_size - 1)] > t ||
+         !this->rewind_has_state[this->rewind_slot(this->rewind_size - 1)]) {
+    this->rewind_size--;
+  }
 
-  // rewind observations until t is after previous observation
-  while (this->rewind_t.back() > t) {
-    rewound.push_front(this->rewind_obscache.back());
-    this->rewind_t.pop_back();
-    this->rewind_states.pop_back();
-    this->rewind_obscache.pop_back();
+  // checkpoint() overwrites these slots when they are replayed
+  size_t rewound = end - this->rewind_size;
+  if (this->rewind_replay.size() < rewound) {
+    this->rewind_replay.resize(rewound);
+  }
+  for (size_t i = 0; i < rewound; i++) {
+    this->rewind_replay[i] = this->rewind_obscache[this->rewind_slot(this->rewind_size + i)];
   }
 
   // set the state to the time right before that
-  this->filter_time = this->rewind_t.back();
-  this->x = this->rewind_states.back().first;
-  this->P = this->rewind_states.back().second;
+  size_t slot = this->rewind_slot(this->rewind_size - 1);
+  this->filter_time = this->rewind_t[slot];
+  this->x = Map<VectorXd>(&this->rewind_x[slot * this->dim_x], this->dim_x);
+  this->P = Map<MatrixXdr>(&this->rewind_P[slot * this->dim_err * this->dim_err], this->dim_err, this->dim_err);
+  this->rewind_since_state = 0;
 
   return rewound;
 }
 
-void EKFSym::checkpoint(Observation& obs) {
-  // push to rewinder
-  this->rewind_t.push_back(this->filter_time);
-  this->rewind_states.push_back(std::make_pair(this->x, this->P));
-  this->rewind_obscache.push_back(obs);
+void EKFSym::checkpoint(const Observation& obs) {
+  // push to rewinder, only keep a certain number around
+  size_t slot = this->rewind_slot(this->rewind_size);
+  if (this->rewind_size == REWIND_TO_KEEP) {
+    this->rewind_head = this->rewind_slot(1);
+  } else {
+    this->rewind_size++;
+  }
 
-  // only keep a certain number around
-  if (this->rewind_t.size() > REWIND_TO_KEEP) {
-    this->rewind_t.pop_front();
-    this->rewind_states.pop_front();
-    this->rewind_obscache.pop_front();
+  this->rewind_t[slot] = this->filter_time;
+  this->rewind_obscache[slot] = obs;
+  this->rewind_has_state[slot] = ++this->rewind_since_state >= this->rewind_interval;
+  if (this->rewind_has_state[slot]) {
+    Map<VectorXd>(&this->rewind_x[slot * this->dim_x], this->dim_x) = this->x;
+    Map<MatrixXdr>(&this->rewind_P[slot * this->dim_err * this->dim_err], this->dim_err, this->dim_err) = this->P;
+    this->rewind_since_state = 0;
   }
 }
 
-Estimate EKFSym::predict_and_update_batch(Observation& obs, bool augment) {
+void EKFSym::predict_and_update_batch(Observation& obs, bool augment, Estimate *res) {
   assert(obs.z.size() == obs.R.size());
   assert(obs.z.size() == obs.extra_args.size());
 
   this->predict(obs.t);
 
-  Estimate res;
-  res.t = obs.t;
-  res.kind = obs.kind;
-  res.z = obs.z;
-  res.extra_args = obs.extra_args;
-  res.xk1 = this->x;
-  res.Pk1 = this->P;
+  if (res) {
+    res->t = obs.t;
+    res->kind = obs.kind;
+    res->z = obs.z;
+    res->extra_args = obs.extra_args;
+    res->xk1 = this->x;
+    res->Pk1 = this->P;
+  }
 
   // update batch
-  std::vector<VectorXd> y;
-  for (int i = 0; i < obs.z.size(); i++) {
+  for (size_t i = 0; i < obs.z.size(); i++) {
     assert(obs.z[i].rows() == obs.R[i].rows());
     assert(obs.z[i].rows() == obs.R[i].cols());
 
     // update state
-    y.push_back(this->update(obs.kind, obs.z[i], obs.R[i], obs.extra_args[i]));
+    VectorXd y = this->update(obs.kind, obs.z[i], obs.R[i], obs.extra_args[i]);
+    if (res) {
+      res->y.push_back(y);
+    }
   }
 
-  res.xk = this->x;
-  res.Pk = this->P;
-  res.y = y;
+  if (res) {
+    res->xk = this->x;
+    res->Pk = this->P;
+  }
 
   assert(!augment); // TODO
   // if (augment) {
@@ -189,8 +228,6 @@ Estimate EKFSym::predict_and_update_batch(Observation& obs, bool augment) {
   // }
 
   this->checkpoint(obs);
-
-  return res;
 }
 
 void EKFSym::predict(double t) {
@@ -208,7 +245,9 @@ void EKFSym::predict(double t) {
   this->filter_time = t;
 }
 
-VectorXd EKFSym::update(int kind, VectorXd z, MatrixXdr R, std::vector<double> extra_args) {
+VectorXd EKFSym::update(int kind, const VectorXd &z_in, MatrixXdr &R, std::vector<double> &extra_args) {
+  // the update writes y to z
+  VectorXd z = z_in;
   this->ekf->updates.at(kind)(this->x.data(), this->P.data(), z.data(), R.data(), extra_args.data());
   this->normalize_quaternions();
 
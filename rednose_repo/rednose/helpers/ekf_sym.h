@@ -4,7 +4,6 @@
 #include <cassert>
 #include <string>
 #include <vector>
-#include <deque>
 #include <unordered_map>
 #include <map>
 #include <cmath>
@@ -47,7 +46,8 @@ public:
       Eigen::Map<MatrixXdr> P_initial, int dim_main, int dim_main_err, int N = 0, int dim_augment = 0,
       int dim_augment_err = 0, std::vector<int> maha_test_kinds = std::vector<int>(),
       std::vector<int> quaternion_idxs = std::vector<int>(),
-      std::vector<std::string> global_vars = std::vector<std::string>(), double max_rewind_age = 1.0);
+      std::vector<std::string> global_vars = std::vector<std::string>(), double max_rewind_age = 1.0,
+      int rewind_interval = 1);
   void init_state(Eigen::Map<Eigen::VectorXd> state, Eigen::Map<MatrixXdr> covs, double filter_time);
 
   Eigen::VectorXd state();
@@ -66,11 +66,12 @@ public:
   extra_routine_t get_extra_routine(const std::string& routine);
 
 private:
-  std::deque<Observation> rewind(double t);
-  void checkpoint(Observation& obs);
+  size_t rewind_slot(size_t i) const { return (this->rewind_head + i) % REWIND_TO_KEEP; }
+  size_t rewind(double t);
+  void checkpoint(const Observation& obs);
 
-  Estimate predict_and_update_batch(Observation& obs, bool augment);
-  Eigen::VectorXd update(int kind, Eigen::VectorXd z, MatrixXdr R, std::vector<double> extra_args);
+  void predict_and_update_batch(Observation& obs, bool augment, Estimate *res);
+  Eigen::VectorXd update(int kind, const Eigen::VectorXd &z, MatrixXdr &R, std::vector<double> &extra_args);
 
   // stuct with linked sympy generated functions
   const EKF *ekf = NULL;
@@ -99,11 +100,21 @@ private:
   // process noise
   MatrixXdr Q;
 
-  // rewind stuff
+  // rewind stuff, a ring of the last REWIND_TO_KEEP observations and the filter state after them.
+  // All storage is allocated up front and slots are overwritten in place. The state is only
+  // stored after every rewind_interval observations, rewinding replays the ones in between.
   double max_rewind_age;
-  std::deque<double> rewind_t;
-  std::deque<std::pair<Eigen::VectorXd, MatrixXdr>> rewind_states;
-  std::deque<Observation> rewind_obscache;
+  int rewind_interval;
+  size_t rewind_head = 0;  // slot of the oldest observation
+  size_t rewind_size = 0;
+  int rewind_since_state = 0;
+  std::vector<double> rewind_t;
+  std::vector<char> rewind_has_state;
+  std::vector<double> rewind_x;  // dim_x per slot
+  std::vector<double> rewind_P;  // dim_err * dim_err per slot
+  std::vector<Observation> rewind_obscache;
+  std::vector<Observation> rewind_replay;  // observations taken out by rewind(), to be replayed
+  Observation obs_scratch;
 
   Eigen::VectorXd augment_times;
 
@@ -53,7 +53,7 @@ cdef extern from "rednose/helpers/ekf_sym.h" namespace "EKFS":
   cdef cppclass EKFSym:
     EKFSym(string name, MapMatrixXdr Q, MapVectorXd x_initial, MapMatrixXdr P_initial, int dim_main,
         int dim_main_err, int N, int dim_augment, int dim_augment_err, vector[int] maha_test_kinds,
-        vector[int] quaternion_idxs, vector[string] global_vars, double max_rewind_age)
+        vector[int] quaternion_idxs, vector[string] global_vars, double max_rewind_age, int rewind_interval)
     void init_state(MapVectorXd state, MapMatrixXdr covs, double filter_time)
 
     VectorXd state()
@@ -87,7 +87,7 @@ cdef class EKF_sym_pyx:
   def __cinit__(self, str gen_dir, str name, np.ndarray[np.float64_t, ndim=2] Q,
       np.ndarray[np.float64_t, ndim=1] x_initial, np.ndarray[np.float64_t, ndim=2] P_initial, int dim_main,
       int dim_main_err, int N=0, int dim_augment=0, int dim_augment_err=0, list maha_test_kinds=[],
-      list quaternion_idxs=[], list global_vars=[], double max_rewind_age=1.0, logger=None):
+      list quaternion_idxs=[], list global_vars=[], double max_rewind_age=1.0, int rewind_interval=1, logger=None):
     # TODO logger
     ekf_load_and_register(gen_dir.encode('utf8'), name.encode('utf8'))
 
@@ -107,7 +107,8 @@ cdef class EKF_sym_pyx:
       maha_test_kinds,
       quaternion_idxs,
       [x.encode('utf8') for x in global_vars],
-      max_rewind_age
+      max_rewind_age,
+      rewind_interval
     )
 
   def init_state(self, np.ndarray[np.float64_t, ndim=1] state, np.ndarray[np.float64_t, ndim=2] covs, filter_time):
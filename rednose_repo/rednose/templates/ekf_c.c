@@ -32,20 +32,23 @@ void predict(double *in_x, double *in_P, double *in_Q, double dt) {
   memcpy(in_P, P.data(), EDIM * EDIM * sizeof(double));
 }
 
+// Null space projected update, y, H and R are projected onto the null space of Hea so the
+// observation no longer depends on the extra args. Their size is only known at runtime.
 // note: extra_args dim only correct when null space projecting
 // otherwise 1
 template <int ZDIM, int EADIM, bool MAHA_TEST>
-void update(double *in_x, double *in_P, Hfun h_fun, Hfun H_fun, Hfun Hea_fun, double *in_z, double *in_R, double *in_ea, double MAHA_THRESHOLD) {
+void update_null_space(double *in_x, double *in_P, Hfun h_fun, Hfun H_fun, Hfun Hea_fun, double *in_z, double *in_R, double *in_ea, double MAHA_THRESHOLD) {
   typedef Eigen::Matrix<double, ZDIM, ZDIM, Eigen::RowMajor> ZZM;
   typedef Eigen::Matrix<double, ZDIM, DIM, Eigen::RowMajor> ZDM;
   typedef Eigen::Matrix<double, Eigen::Dynamic, EDIM, Eigen::RowMajor> XEM;
-  //typedef Eigen::Matrix<double, EDIM, ZDIM, Eigen::RowMajor> EZM;
   typedef Eigen::Matrix<double, Eigen::Dynamic, 1> X1M;
   typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> XXM;
+  typedef Eigen::Matrix<double, ZDIM, EADIM, Eigen::RowMajor> ZAM;
 
   double in_hx[ZDIM] = {0};
   double in_H[ZDIM * DIM] = {0};
   double in_H_mod[EDIM * DIM] = {0};
+  double in_Hea[ZDIM * EADIM] = {0};
   double delta_x[EDIM] = {0};
   double x_new[DIM] = {0};
 
@@ -62,23 +65,14 @@ void update(double *in_x, double *in_P, Hfun h_fun, Hfun H_fun, Hfun Hea_fun, do
 
   // get y (y = z - hx)
   Eigen::Matrix<double, ZDIM, 1> pre_y(in_hx); pre_y = z - pre_y;
-  X1M y; XXM H; XXM R;
-  if (Hea_fun){
-    typedef Eigen::Matrix<double, ZDIM, EADIM, Eigen::RowMajor> ZAM;
-    double in_Hea[ZDIM * EADIM] = {0};
-    Hea_fun(in_x, in_ea, in_Hea);
-    ZAM Hea(in_Hea);
-    XXM A = Hea.transpose().fullPivLu().kernel();
-
-
-    y = A.transpose() * pre_y;
-    H = A.transpose() * pre_H;
-    R = A.transpose() * pre_R * A;
-  } else {
-    y = pre_y;
-    H = pre_H;
-    R = pre_R;
-  }
+  Hea_fun(in_x, in_ea, in_Hea);
+  ZAM Hea(in_Hea);
+  XXM A = Hea.transpose().fullPivLu().kernel();
+
+  X1M y = A.transpose() * pre_y;
+  XXM H = A.transpose() * pre_H;
+  XXM R = A.transpose() * pre_R * A;
+
   // get modified H
   H_mod_fun(in_x, in_H_mod);
   DEM H_mod(in_H_mod);
@@ -93,15 +87,9 @@ void update(double *in_x, double *in_P, Hfun h_fun, Hfun H_fun, Hfun Hea_fun, do
     }
   }
 
-  // Outlier resilient weighting
-  double weight = 1;//(1.5)/(1 + y.squaredNorm()/R.sum());
-
   // kalman gains and I_KH
-  XXM S = ((H_err * P) * H_err.transpose()) + R/weight;
+  XXM S = ((H_err * P) * H_err.transpose()) + R;
   XEM KT = S.fullPivLu().solve(H_err * P.transpose());
-  //EZM K = KT.transpose(); TODO: WHY DOES THIS NOT COMPILE?
-  //EZM K = S.fullPivLu().solve(H_err * P.transpose()).transpose();
-  //std::cout << "Here is the matrix rot:\n" << K << std::endl;
   EEM I_KH = Eigen::Matrix<double, EDIM, EDIM>::Identity() - (KT.transpose() * H_err);
 
   // update state by injecting dx
@@ -120,4 +108,64 @@ void update(double *in_x, double *in_P, Hfun h_fun, Hfun H_fun, Hfun Hea_fun, do
   memcpy(in_z, y.data(), y.rows() * sizeof(double));
 }
 
+// Without null space projection every size is known at compile time, so everything lives on the
+// stack. This runs for every observation, hundreds of times per second in locationd.
+template <int ZDIM, int EADIM, bool MAHA_TEST>
+void update(double *in_x, double *in_P, Hfun h_fun, Hfun H_fun, Hfun Hea_fun, double *in_z, double *in_R, double *in_ea, double MAHA_THRESHOLD) {
+  if (Hea_fun) {
+    update_null_space<ZDIM, EADIM, MAHA_TEST>(in_x, in_P, h_fun, H_fun, Hea_fun, in_z, in_R, in_ea, MAHA_THRESHOLD);
+    return;
+  }
 
+  typedef Eigen::Matrix<double, ZDIM, ZDIM, Eigen::RowMajor> ZZM;
+  typedef Eigen::Matrix<double, ZDIM, DIM, Eigen::RowMajor> ZDM;
+  typedef Eigen::Matrix<double, ZDIM, EDIM, Eigen::RowMajor> ZEM;
+  typedef Eigen::Matrix<double, ZDIM, 1> Z1M;
+  typedef Eigen::Matrix<double, EDIM, 1> E1M;
+
+  double in_hx[ZDIM] = {0};
+  double in_H[ZDIM * DIM] = {0};
+  double in_H_mod[EDIM * DIM] = {0};
+  double delta_x[EDIM] = {0};
+  double x_new[DIM] = {0};
+
+  // functions from sympy
+  h_fun(in_x, in_ea, in_hx);
+  H_fun(in_x, in_ea, in_H);
+  H_mod_fun(in_x, in_H_mod);
+
+  Eigen::Map<EEM> P(in_P);
+  ZZM R = Eigen::Map<ZZM>(in_R);
+  const Z1M y = Eigen::Map<Z1M>(in_z) - Eigen::Map<Z1M>(in_hx);
+  const ZEM H_err = Eigen::Map<ZDM>(in_H) * Eigen::Map<DEM>(in_H_mod);
+
+  // the innovation covariance S is symmetric positive definite, solve with LDLT instead of LU.
+  // P is symmetric too, so H_err * P is also H_err * P^T
+  const ZEM HP = H_err * P;
+  Eigen::LDLT<ZZM> S(HP * H_err.transpose() + R);
+
+  // Do mahalobis distance test
+  if (MAHA_TEST) {
+    const double maha_dist = y.dot(S.solve(y));
+    if (maha_dist > MAHA_THRESHOLD) {
+      R = 1.0e16 * R;
+      S.compute(HP * H_err.transpose() + R);
+    }
+  }
+
+  // kalman gains and I_KH
+  const ZEM KT = S.solve(HP);
+  const EEM I_KH = EEM::Identity() - KT.transpose() * H_err;
+
+  // update state by injecting dx
+  Eigen::Map<E1M> dx(delta_x);
+  dx = KT.transpose() * y;
+  err_fun(in_x, delta_x, x_new);
+
+  // update cov, Joseph form
+  P = I_KH * P * I_KH.transpose() + KT.transpose() * R * KT;
+
+  // copy out state
+  memcpy(in_x, x_new, DIM * sizeof(double));
+  memcpy(in_z, y.data(), ZDIM * sizeof(double));
+}
@@ -17,6 +17,7 @@ from openpilot.common.numpy_fast import clip
 from openpilot.common.params import Params
 from openpilot.common.realtime import config_realtime_process, Priority, Ratekeeper, DT_CTRL
 from openpilot.common.swaglog import cloudlog
+from openpilot.common.watchdog import Watchdog
 
 from openpilot.selfdrive.car.car_helpers import get_car_interface, get_startup_event
 from openpilot.selfdrive.controls.lib.alertmanager import AlertManager, set_offroad_alert
@@ -943,10 +944,12 @@ class Controls:
   def controlsd_thread(self):
     e = threading.Event()
     t = threading.Thread(target=self.params_thread, args=(e, ))
+    watchdog = Watchdog()
     try:
       t.start()
       while True:
         self.step()
+        watchdog.kick()
         self.rk.monitor_time()
     except SystemExit:
       e.set()
@@ -3,6 +3,7 @@ from cereal import car
 from openpilot.common.params import Params
 from openpilot.common.realtime import Priority, config_realtime_process
 from openpilot.common.swaglog import cloudlog
+from openpilot.common.watchdog import Watchdog
 from openpilot.selfdrive.controls.lib.longitudinal_planner import LongitudinalPlanner
 import cereal.messaging as messaging
 
@@ -42,9 +43,11 @@ def plannerd_thread():
 
   update_toggles = False
 
+  watchdog = Watchdog()
   while True:
     sm.update()
     if sm.updated['modelV2']:
+      watchdog.kick()
       longitudinal_planner.update(clairvoyant_model, e2e_longitudinal_model, sm, frogpilot_toggles)
       longitudinal_planner.publish(e2e_longitudinal_model, sm, pm)
       publish_ui_plan(sm, pm, longitudinal_planner)
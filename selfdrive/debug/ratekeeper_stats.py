@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+# Loop timing of every C++ RateKeeper on this device, straight from the shared page in
+# common/ratekeeper.h. With --interval it prints what happened during each interval.
+import argparse
+import mmap
+import os
+import time
+
+import numpy as np
+
+RATEKEEPER_STATS_FN = "/dev/shm/ratekeeper"
+RATEKEEPER_STATS_SLOTS = 64
+RATEKEEPER_HIST_BUCKETS = 24
+SLOT = np.dtype({'names': ['pid', 'rate', 'name', 'frames', 'lagged', 'lateness', 'work'],
+                 'formats': ['<i4', '<f4', 'S32', '<u8', '<u8', ('<u4', RATEKEEPER_HIST_BUCKETS), ('<u4', RATEKEEPER_HIST_BUCKETS)],
+                 'offsets': [0, 4, 8, 40, 48, 56, 56 + 4 * RATEKEEPER_HIST_BUCKETS],
+                 'itemsize': 256})
+
+
+def alive(pid: int) -> bool:
+  """Slots of processes that were killed keep their pid"""
+  try:
+    os.kill(pid, 0)
+  except ProcessLookupError:
+    return False
+  except PermissionError:
+    pass
+  return True
+
+
+def read_stats() -> dict[tuple[int, str], np.void]:
+  with open(RATEKEEPER_STATS_FN, 'rb') as f:
+    mm = mmap.mmap(f.fileno(), RATEKEEPER_STATS_SLOTS * SLOT.itemsize, access=mmap.ACCESS_READ)
+  slots = np.frombuffer(mm, dtype=SLOT).copy()
+  return {(int(s['pid']), s['name'].decode()): s for s in slots if s['pid'] != 0 and alive(int(s['pid']))}
+
+
+def percentile(hist: np.ndarray, q: float) -> str:
+  """Upper bound of the bucket the q-th percentile falls in"""
+  total = hist.sum()
+  if total == 0:
+    return "-"
+  bucket = int(np.searchsorted(np.cumsum(hist), q * total))
+  if bucket == RATEKEEPER_HIST_BUCKETS - 1:
+    return f">{2 ** (bucket - 1) / 1000:.0f}ms"
+  return f"<{2 ** bucket / 1000:.3g}ms"
+
+
+def print_stats(stats: dict, prev: dict) -> None:
+  print(f"{'name':24} {'pid':>7} {'rate':>6} {'frames':>8} {'lagged':>7}   {'late p50':>9} {'p99':>9} {'max':>9}   {'work p50':>9} {'p99':>9} {'max':>9}")
+  for key, s in sorted(stats.items(), key=lambda kv: kv[0][1]):
+    p = prev.get(key)
+    frames, lagged = int(s['frames']), int(s['lagged'])
+    lateness, work = s['lateness'].astype(np.int64), s['work'].astype(np.int64)
+    if p is not None:
+      frames, lagged = frames - int(p['frames']), lagged - int(p['lagged'])
+      lateness, work = lateness - p['lateness'], work - p['work']
+    print(f"{key[1]:24} {key[0]:7d} {s['rate']:6.0f} {frames:8d} {100 * lagged / max(frames, 1):6.1f}%  ",
+          " ".join(f"{percentile(lateness, q):>9}" for q in (0.5, 0.99, 1.0)), " ",
+          " ".join(f"{percentile(work, q):>9}" for q in (0.5, 0.99, 1.0)))
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(description="Loop timing of every C++ RateKeeper")
+  parser.add_argument("--interval", type=float, help="print every INTERVAL seconds, counting only that interval")
+  args = parser.parse_args()
+
+  if not os.path.exists(RATEKEEPER_STATS_FN):
+    print(f"{RATEKEEPER_STATS_FN} doesn't exist, no RateKeeper has run yet")
+    exit(1)
+
+  prev: dict = {}
+  while True:
+    stats = read_stats()
+    print_stats(stats, prev)
+    if args.interval is None:
+      break
+    prev = stats
+    time.sleep(args.interval)
+    print()
@@ -89,6 +89,11 @@ Localizer::Localizer(LocalizerGnssSource gnss_source) {
   VectorXd ecef_pos = this->kf->get_x().segment<STATE_ECEF_POS_LEN>(STATE_ECEF_POS_START);
   this->converter = std::make_unique<LocalCoord>((ECEF) { .x = ecef_pos[0], .y = ecef_pos[1], .z = ecef_pos[2] });
   this->configure_gnss_source(gnss_source);
+
+  const std::vector<std::string> critical_input_services = {"cameraOdometry", "liveCalibration", "accelerometer", "gyroscope"};
+  for (std::string service : critical_input_services) {
+    this->observation_values_invalid.insert({service, 0.0});
+  }
 }
 
 void Localizer::build_live_location(cereal::LiveLocationKalman::Builder& fix) {
@@ -229,6 +234,12 @@ void Localizer::observation_timings_invalid_reset(){
   this->observation_timings_invalid = false;
 }
 
+void Localizer::update_time_to_first_fix(double current_time, bool gps_ok) {
+  if (gps_ok && std::isnan(this->ttff) && !std::isnan(this->first_valid_log_time)) {
+    this->ttff = std::max(1e-3, current_time - this->first_valid_log_time);
+  }
+}
+
 void Localizer::handle_sensor(double current_time, const cereal::SensorEventData::Reader& log) {
   // TODO does not yet account for double sensor readings in the log
 
@@ -675,6 +686,10 @@ void Localizer::configure_gnss_source(const LocalizerGnssSource &source) {
   }
 }
 
+void Localizer::set_gps_std_factor(float factor) {
+  this->gps_std_factor = factor;
+}
+
 int Localizer::locationd_thread() {
   Params params;
   LocalizerGnssSource source;
@@ -694,18 +709,20 @@ int Localizer::locationd_thread() {
   SubMaster sm(service_list, {}, nullptr, {gps_location_socket});
   PubMaster pm({"liveLocationKalman"});
 
+  std::vector<SubMaster::Handle> service_handles;
+  for (const char* service : service_list) {
+    service_handles.push_back(sm.handle(service));
+  }
+  const SubMaster::Handle trigger_msg = sm.handle("cameraOdometry");
+
   uint64_t cnt = 0;
   bool filterInitialized = false;
-  const std::vector<std::string> critical_input_services = {"cameraOdometry", "liveCalibration", "accelerometer", "gyroscope"};
-  for (std::string service : critical_input_services) {
-    this->observation_values_invalid.insert({service, 0.0});
-  }
 
   while (!do_exit) {
     sm.update();
     if (filterInitialized){
       this->observation_timings_invalid_reset();
-      for (const char* service : service_list) {
+      for (const SubMaster::Handle &service : service_handles) {
         if (sm.updated(service) && sm.valid(service)){
           const cereal::Event::Reader log = sm[service];
           this->handle_msg(log);
@@ -715,16 +732,13 @@ int Localizer::locationd_thread() {
       filterInitialized = sm.allAliveAndValid();
     }
 
-    const char* trigger_msg = "cameraOdometry";
     if (sm.updated(trigger_msg)) {
       bool inputsOK = sm.allValid() && this->are_inputs_ok();
       bool gpsOK = this->is_gps_ok();
       bool sensorsOK = sm.allAliveAndValid({"accelerometer", "gyroscope"});
 
       // Log time to first fix
-      if (gpsOK && std::isnan(this->ttff) && !std::isnan(this->first_valid_log_time)) {
-        this->ttff = std::max(1e-3, (sm[trigger_msg].getLogMonoTime() * 1e-9) - this->first_valid_log_time);
-      }
+      this->update_time_to_first_fix(sm[trigger_msg].getLogMonoTime() * 1e-9, gpsOK);
 
       MessageBuilder msg_builder;
       kj::ArrayPtr<capnp::byte> bytes = this->get_message_bytes(msg_builder, inputsOK, sensorsOK, gpsOK, filterInitialized);
@@ -741,10 +755,3 @@ int Localizer::locationd_thread() {
   }
   return 0;
 }
-
-int main() {
-  util::set_realtime_priority(5);
-
-  Localizer localizer;
-  return localizer.locationd_thread();
-}
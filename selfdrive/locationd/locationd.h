@@ -22,6 +22,8 @@
 
 #define POSENET_STD_HIST_HALF 20
 
+extern ExitHandler do_exit;
+
 enum LocalizerGnssSource {
   UBLOX, QCOM
 };
@@ -44,6 +46,9 @@ public:
   void determine_gps_mode(double current_time);
   bool are_inputs_ok();
   void observation_timings_invalid_reset();
+  void update_time_to_first_fix(double current_time, bool gps_ok);
+  void configure_gnss_source(const LocalizerGnssSource &source);
+  void set_gps_std_factor(float factor);
 
   kj::ArrayPtr<capnp::byte> get_message_bytes(MessageBuilder& msg_builder,
     bool inputsOK, bool sensorsOK, bool gpsOK, bool msgValid);
@@ -95,6 +100,4 @@ private:
   float gps_vertical_variance_factor;
   double gps_time_offset;
   Eigen::VectorXd camodo_yawrate_distribution = Eigen::Vector2d(0.0, 10.0); // mean, std
-
-  void configure_gnss_source(const LocalizerGnssSource &source);
 };
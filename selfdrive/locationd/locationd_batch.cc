@@ -0,0 +1,201 @@
+// Runs locationd over logs faster than realtime, for retuning the filter on many segments.
+// Events are fed to a Localizer straight from the rlog in log order, the liveLocationKalman
+// messages are written to <output dir>/<segment>.rlog. Each worker thread has its own Localizer
+// and processes one segment at a time.
+// usage: ./locationd_batch [--jobs N] [--gps-std-factor F] [--output DIR] rlog [rlog...]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "cereal/services.h"
+#include "common/decompress.h"
+#include "selfdrive/locationd/locationd.h"
+
+struct Options {
+  int jobs = std::max(1u, std::thread::hardware_concurrency());
+  std::optional<float> gps_std_factor;
+  std::string output = ".";
+};
+
+// what SubMaster tracks for each service in locationd_thread, with log time instead of receive time
+struct Input {
+  Input(const char *service, bool ignore = false)
+    : name(service), freq(services.at(service).frequency), ignore_alive(ignore) {}
+  const char *name;
+  int freq;
+  bool ignore_alive;
+  bool valid = true, alive = false;
+  uint64_t rcv_time = 0;
+};
+
+// segment name from a path like .../2023-07-27--13-01-19--3/rlog.bz2
+static std::string segment_name(const std::string &fn) {
+  const size_t slash = fn.rfind('/');
+  if (slash == std::string::npos) return fn.substr(0, fn.find('.'));
+  const std::string dir = fn.substr(0, slash);
+  return dir.substr(dir.rfind('/') + 1);
+}
+
+static bool localize_segment(const std::string &fn, const Options &opts, std::string &report) {
+  std::string data = util::decompress(fn, util::read_file(fn));
+  if (data.empty()) {
+    report = "failed to read log";
+    return false;
+  }
+
+  // copy into word aligned memory for capnp
+  kj::Array<capnp::word> buf = kj::heapArray<capnp::word>(data.size() / sizeof(capnp::word));
+  memcpy(buf.begin(), data.data(), buf.size() * sizeof(capnp::word));
+  data.clear();
+
+  std::vector<kj::ArrayPtr<const capnp::word>> events;
+  bool ublox = false;
+  try {
+    kj::ArrayPtr<const capnp::word> words = buf.asPtr();
+    while (words.size() > 0) {
+      capnp::FlatArrayMessageReader reader(words);
+      ublox |= reader.getRoot<cereal::Event>().isGpsLocationExternal();
+      events.push_back(kj::arrayPtr(words.begin(), reader.getEnd()));
+      words = kj::arrayPtr(reader.getEnd(), words.end());
+    }
+  } catch (const kj::Exception &e) {
+    // a truncated log still has usable messages
+    fprintf(stderr, "%s: %s\n", fn.c_str(), e.getDescription().cStr());
+  }
+
+  // locationd picks the gps source from the UbloxAvailable param, here it's whatever the log has
+  Localizer localizer(ublox ? LocalizerGnssSource::UBLOX : LocalizerGnssSource::QCOM);
+  if (opts.gps_std_factor) {
+    localizer.set_gps_std_factor(*opts.gps_std_factor);
+  }
+
+  std::vector<Input> inputs = {{ublox ? "gpsLocationExternal" : "gpsLocation", true}, {"cameraOdometry"},
+                               {"liveCalibration"}, {"carState"}, {"accelerometer"}, {"gyroscope"}};
+  auto alive_and_valid = [](const Input &in) { return in.valid && (in.alive || in.ignore_alive); };
+
+  const std::string out_fn = opts.output + "/" + segment_name(fn) + ".rlog";
+  std::ofstream out(out_fn, std::ios::binary);
+  if (!out) {
+    report = "failed to open " + out_fn;
+    return false;
+  }
+
+  const auto begin = std::chrono::steady_clock::now();
+  bool filter_initialized = false;
+  size_t outputs = 0;
+  uint64_t first_time = 0, last_time = 0;
+  for (auto words : events) {
+    capnp::FlatArrayMessageReader reader(words);
+    cereal::Event::Reader event = reader.getRoot<cereal::Event>();
+    const uint64_t mono_time = event.getLogMonoTime();
+    if (first_time == 0) first_time = mono_time;
+    last_time = mono_time;
+
+    // index into inputs
+    int updated = -1;
+    switch (event.which()) {
+      case cereal::Event::GPS_LOCATION_EXTERNAL: updated = ublox ? 0 : -1; break;
+      case cereal::Event::GPS_LOCATION: updated = ublox ? -1 : 0; break;
+      case cereal::Event::CAMERA_ODOMETRY: updated = 1; break;
+      case cereal::Event::LIVE_CALIBRATION: updated = 2; break;
+      case cereal::Event::CAR_STATE: updated = 3; break;
+      case cereal::Event::ACCELEROMETER: updated = 4; break;
+      case cereal::Event::GYROSCOPE: updated = 5; break;
+      default: break;
+    }
+    if (updated < 0) continue;
+
+    inputs[updated].valid = event.getValid();
+    inputs[updated].rcv_time = mono_time;
+    for (auto &in : inputs) {
+      in.alive = in.freq <= 1e-5 || (int64_t)(mono_time - in.rcv_time) * 1e-9 < 10.0 / in.freq;
+    }
+
+    if (filter_initialized) {
+      localizer.observation_timings_invalid_reset();
+      if (inputs[updated].valid) {
+        localizer.handle_msg(event);
+      }
+    } else {
+      filter_initialized = std::all_of(inputs.begin(), inputs.end(), alive_and_valid);
+    }
+
+    if (event.isCameraOdometry()) {
+      bool inputs_ok = std::all_of(inputs.begin(), inputs.end(), [](auto &in) { return in.valid; }) && localizer.are_inputs_ok();
+      bool gps_ok = localizer.is_gps_ok();
+      bool sensors_ok = alive_and_valid(inputs[4]) && alive_and_valid(inputs[5]);
+      localizer.update_time_to_first_fix(mono_time * 1e-9, gps_ok);
+
+      MessageBuilder msg;
+      cereal::Event::Builder evt = msg.initEvent(filter_initialized);
+      evt.setLogMonoTime(mono_time);
+      cereal::LiveLocationKalman::Builder live_loc = evt.initLiveLocationKalman();
+      localizer.build_live_location(live_loc);
+      live_loc.setSensorsOK(sensors_ok);
+      live_loc.setGpsOK(gps_ok);
+      live_loc.setInputsOK(inputs_ok);
+      auto bytes = msg.toBytes();
+      out.write((const char *)bytes.begin(), bytes.size());
+      outputs++;
+    }
+  }
+  out.close();
+
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  const double log_seconds = (last_time - first_time) * 1e-9;
+  report = util::string_format("%zu events, %zu liveLocationKalman in %.2fs (%.0fx realtime) -> %s",
+                               events.size(), outputs, seconds, log_seconds / std::max(seconds, 1e-9), out_fn.c_str());
+  return out.good();
+}
+
+int main(int argc, char *argv[]) {
+  Options opts;
+  const option long_options[] = {
+    {"jobs", required_argument, nullptr, 'j'},
+    {"gps-std-factor", required_argument, nullptr, 'g'},
+    {"output", required_argument, nullptr, 'o'},
+    {nullptr, 0, nullptr, 0},
+  };
+  for (int opt; (opt = getopt_long(argc, argv, "j:o:", long_options, nullptr)) != -1;) {
+    switch (opt) {
+      case 'j': opts.jobs = std::max(1, atoi(optarg)); break;
+      case 'g': opts.gps_std_factor = atof(optarg); break;
+      case 'o': opts.output = optarg; break;
+      default: return 2;
+    }
+  }
+  const std::vector<std::string> segments(argv + optind, argv + argc);
+  if (segments.empty()) {
+    fprintf(stderr, "usage: %s [--jobs N] [--gps-std-factor F] [--output DIR] rlog [rlog...]\n", argv[0]);
+    return 2;
+  }
+  if (!util::create_directories(opts.output, 0775)) {
+    fprintf(stderr, "failed to create %s\n", opts.output.c_str());
+    return 2;
+  }
+
+  std::atomic<size_t> next = 0;
+  std::atomic<int> errors = 0;
+  std::mutex print_lock;
+  std::vector<std::thread> workers;
+  for (int i = 0; i < std::min<int>(opts.jobs, segments.size()); ++i) {
+    workers.emplace_back([&] {
+      for (size_t n; !do_exit && (n = next++) < segments.size();) {
+        std::string report;
+        bool ok = localize_segment(segments[n], opts, report);
+        errors += !ok;
+        std::lock_guard lk(print_lock);
+        printf("%s: %s\n", segments[n].c_str(), report.c_str());
+        fflush(stdout);
+      }
+    });
+  }
+  for (auto &t : workers) t.join();
+  return errors > 0 || do_exit ? 1 : 0;
+}
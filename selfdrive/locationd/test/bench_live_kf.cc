@@ -0,0 +1,54 @@
+// Updates per second of every observation kind of the generated live filter, straight through
+// the EKF function table. Each update starts from the initial state, with a measurement close to h(x).
+// Kinds whose noise is only given at runtime (camera odometry translation) are skipped.
+// usage: ./bench_live_kf [updates per kind]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "rednose/helpers/ekf.h"
+#include "rednose/helpers/ekf_load.h"
+#include "selfdrive/locationd/models/generated/live_kf_constants.h"
+
+int main(int argc, char *argv[]) {
+  const int count = argc > 1 ? atoi(argv[1]) : 100000;
+  const EKF *ekf = ekf_lookup("live");
+  if (!ekf) {
+    fprintf(stderr, "live filter not loaded\n");
+    return 1;
+  }
+
+  const int dim = live_initial_x.size(), edim = live_initial_P_diag.size();
+  std::vector<double> x0(live_initial_x.data(), live_initial_x.data() + dim);
+  std::vector<double> P0(edim * edim, 0.0);
+  for (int i = 0; i < edim; ++i) P0[i * edim + i] = live_initial_P_diag[i];
+
+  printf("%-6s %6s %14s\n", "kind", "zdim", "updates/s");
+  for (int kind : ekf->kinds) {
+    if (live_obs_noise_diag.count(kind) == 0) continue;
+
+    const auto &noise = live_obs_noise_diag.at(kind);
+    const int zdim = noise.size();
+    std::vector<double> z0(zdim), R(zdim * zdim, 0.0), ea(1, 0.0);
+    ekf->hs.at(kind)(x0.data(), ea.data(), z0.data());
+    for (int i = 0; i < zdim; ++i) {
+      z0[i] += 0.01;
+      R[i * zdim + i] = noise(i);
+    }
+
+    std::vector<double> x(dim), P(edim * edim), z(zdim);
+    const auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+      memcpy(x.data(), x0.data(), dim * sizeof(double));
+      memcpy(P.data(), P0.data(), P0.size() * sizeof(double));
+      memcpy(z.data(), z0.data(), zdim * sizeof(double));
+      ekf->updates.at(kind)(x.data(), P.data(), z.data(), R.data(), ea.data());
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    printf("%-6d %6d %14.0f\n", kind, zdim, count / seconds);
+  }
+  return 0;
+}
@@ -0,0 +1,31 @@
+// measures modeld's time-to-first-inference for a thneed file
+// usage: ./benchmark models/supercombo.thneed [iterations]
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "common/timing.h"
+#include "selfdrive/modeld/thneed/thneed.h"
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    printf("usage: %s <model.thneed> [iterations]\n", argv[0]);
+    return 1;
+  }
+  const int iterations = argc > 2 ? atoi(argv[2]) : 5;
+
+  for (int i = 0; i < iterations; i++) {
+    double t_start = millis_since_boot();
+    Thneed thneed(true);
+    double t_init = millis_since_boot();
+    thneed.load(argv[1]);
+    double t_load = millis_since_boot();
+    thneed.clexec();
+    double t_exec = millis_since_boot();
+
+    printf("run %d: clinit %7.2f ms, load %7.2f ms, first exec %7.2f ms, total %7.2f ms\n",
+           i, t_init - t_start, t_load - t_init, t_exec - t_load, t_exec - t_start);
+  }
+  return 0;
+}
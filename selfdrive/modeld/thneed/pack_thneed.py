@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Convert a json thneed (as written by tinygrad's extra/thneed.py) into the binary manifest format.
+
+The binary format is read in place from an mmap by Thneed::load, see serialize.cc for the record layout.
+"""
+import argparse
+import json
+import os
+import struct
+
+MAGIC = b"THNB"
+VERSION = 1
+
+HEADER = struct.Struct("<4sIIIIIIIII")
+OBJECT = struct.Struct("<QQQQIIIIII")
+PROGRAM = struct.Struct("<QQQQ")
+IO = struct.Struct("<QQQQ")
+KERNEL = struct.Struct("<QQII3Q3QQ")
+ARG = struct.Struct("<QQII")
+
+ARG_TYPES = {"image2d_t": 1, "image1d_t": 2}
+DATA_ALIGN = 64
+
+
+def unpack_id(s: str) -> int:
+  return struct.unpack("<Q", s.encode("latin_1"))[0] if s else 0
+
+
+def read_json_thneed(fn: str):
+  with open(fn, "rb") as f:
+    json_len = struct.unpack("<I", f.read(4))[0]
+    jdat = json.loads(f.read(json_len).decode("latin_1"))
+    data = f.read()
+  return jdat, data
+
+
+class Blob:
+  def __init__(self, base: int):
+    self.base = base
+    self.buf = bytearray()
+
+  def add(self, data: bytes, align: int = 1) -> tuple[int, int]:
+    self.buf += b"\x00" * (-(self.base + len(self.buf)) % align)
+    offset = self.base + len(self.buf)
+    self.buf += data
+    return offset, len(data)
+
+
+def pack(jdat, data: bytes) -> bytes:
+  num_args = sum(k["num_args"] for k in jdat["kernels"])
+  counts = [len(jdat["objects"]), len(jdat["programs"]), len(jdat["binaries"]), len(jdat["inputs"]), len(jdat["outputs"]),
+            len(jdat["kernels"]), num_args]
+  records_size = HEADER.size + sum(n * s.size for n, s in zip(counts, [OBJECT, PROGRAM, PROGRAM, IO, IO, KERNEL, ARG], strict=True))
+  blob = Blob(records_size)
+  records = [HEADER.pack(MAGIC, VERSION, *counts, 0)]
+
+  ptr = 0
+  for o in jdat["objects"]:
+    data_offset = 0
+    if o["needs_load"]:
+      data_offset, _ = blob.add(data[ptr:ptr + o["size"]], DATA_ALIGN)
+      ptr += o["size"]
+    records.append(OBJECT.pack(unpack_id(o["id"]), unpack_id(o.get("buffer_id", "")), o["size"], data_offset, int(o["needs_load"]),
+                               ARG_TYPES.get(o["arg_type"], 0), int(o.get("float32", False)), o.get("width", 0), o.get("height", 0),
+                               o.get("row_pitch", 0)))
+
+  for name, source in jdat["programs"].items():
+    records.append(PROGRAM.pack(*blob.add(name.encode("latin_1")), *blob.add(source.encode("latin_1"))))
+
+  for b in jdat["binaries"]:
+    binary = data[ptr:ptr + b["length"]]
+    ptr += b["length"]
+    records.append(PROGRAM.pack(*blob.add(b["name"].encode("latin_1")), *blob.add(binary, DATA_ALIGN)))
+  assert ptr == len(data), "trailing data in thneed"
+
+  for i in jdat["inputs"]:
+    records.append(IO.pack(unpack_id(i["buffer_id"]), i["size"], *blob.add(i["name"].encode("latin_1"))))
+  for o in jdat["outputs"]:
+    records.append(IO.pack(unpack_id(o["buffer_id"]), o["size"], 0, 0))
+
+  args = []
+  for k in jdat["kernels"]:
+    gws = list(k["global_work_size"]) + [0] * (3 - k["work_dim"])
+    lws = list(k["local_work_size"]) + [0] * (3 - k["work_dim"])
+    records.append(KERNEL.pack(*blob.add(k["name"].encode("latin_1")), k["work_dim"], k["num_args"], *gws, *lws, len(args)))
+    for a, sz in zip(k["args"], k["args_size"], strict=True):
+      args.append(ARG.pack(*blob.add(a.encode("latin_1")), sz, 0))
+  records += args
+
+  out = b"".join(records)
+  assert len(out) == records_size
+  return out + bytes(blob.buf)
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__)
+  parser.add_argument("input", help="json thneed")
+  parser.add_argument("output", nargs="?", help="binary thneed, defaults to converting in place")
+  args = parser.parse_args()
+
+  with open(args.input, "rb") as f:
+    if f.read(len(MAGIC)) == MAGIC:
+      print(f"{args.input} is already a binary thneed")
+      return
+
+  out = pack(*read_json_thneed(args.input))
+  output_fn = args.output or args.input
+  with open(output_fn + ".tmp", "wb") as f:
+    f.write(out)
+  os.replace(output_fn + ".tmp", output_fn)
+  print(f"saved binary thneed to {output_fn} ({len(out)} bytes)")
+
+
+if __name__ == "__main__":
+  main()
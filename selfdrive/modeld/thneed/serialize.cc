@@ -1,73 +1,390 @@
+#include <sys/mman.h>
+
 #include <cassert>
+#include <cerrno>
+#include <cstring>
 #include <set>
+#include <thread>
 
 #include "third_party/json11/json11.hpp"
 #include "common/util.h"
 #include "common/clutil.h"
 #include "common/swaglog.h"
+#include "common/timing.h"
 #include "selfdrive/modeld/thneed/thneed.h"
 using namespace json11;
 
 extern map<cl_program, string> g_program_source;
 
+namespace {
+
+// ***** in-memory manifest, shared by the json and binary formats *****
+// all pointers point into the loaded file, which outlives the manifest
+
+enum ThneedArgType : uint32_t {
+  THNEED_ARG_BUFFER = 0,
+  THNEED_ARG_IMAGE2D = 1,
+  THNEED_ARG_IMAGE1D = 2,
+};
+
+struct ThneedObject {
+  uint64_t id;
+  uint64_t buffer_id;
+  size_t size;
+  const char *data;  // NULL if the object doesn't need to be loaded
+  ThneedArgType arg_type;
+  bool float32;
+  size_t width, height, row_pitch;
+};
+
+struct ThneedProgram {
+  string name;
+  const char *data;
+  size_t size;
+};
+
+struct ThneedIO {
+  uint64_t buffer_id;
+  size_t size;
+  string name;
+};
+
+struct ThneedKernel {
+  string name;
+  cl_uint work_dim;
+  size_t global_work_size[3];
+  size_t local_work_size[3];
+  vector<string> args;
+  vector<int> args_size;
+};
+
+struct ThneedManifest {
+  vector<ThneedObject> objects;
+  vector<ThneedProgram> programs;
+  vector<ThneedProgram> binaries;
+  vector<ThneedIO> inputs;
+  vector<ThneedIO> outputs;
+  vector<ThneedKernel> kernels;
+};
+
+// ***** binary manifest, see pack_thneed.py for the writer *****
+// the file is mmap'd and the records are read in place, so every record is naturally aligned
+
+const char THNEED_BIN_MAGIC[4] = {'T', 'H', 'N', 'B'};
+const uint32_t THNEED_BIN_VERSION = 1;
+
+struct ThneedBinHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t num_objects;
+  uint32_t num_programs;
+  uint32_t num_binaries;
+  uint32_t num_inputs;
+  uint32_t num_outputs;
+  uint32_t num_kernels;
+  uint32_t num_args;
+  uint32_t reserved;
+};
+
+struct ThneedBinObject {
+  uint64_t id;
+  uint64_t buffer_id;
+  uint64_t size;
+  uint64_t data_offset;
+  uint32_t needs_load;
+  uint32_t arg_type;
+  uint32_t float32;
+  uint32_t width;
+  uint32_t height;
+  uint32_t row_pitch;
+};
+
+struct ThneedBinProgram {
+  uint64_t name_offset;
+  uint64_t name_size;
+  uint64_t data_offset;
+  uint64_t data_size;
+};
+
+struct ThneedBinIO {
+  uint64_t buffer_id;
+  uint64_t size;
+  uint64_t name_offset;
+  uint64_t name_size;
+};
+
+struct ThneedBinKernel {
+  uint64_t name_offset;
+  uint64_t name_size;
+  uint32_t work_dim;
+  uint32_t num_args;
+  uint64_t global_work_size[3];
+  uint64_t local_work_size[3];
+  uint64_t first_arg;
+};
+
+struct ThneedBinArg {
+  uint64_t value_offset;
+  uint64_t value_size;
+  uint32_t size;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(ThneedBinHeader) == 40);
+static_assert(sizeof(ThneedBinObject) == 56);
+static_assert(sizeof(ThneedBinProgram) == 32);
+static_assert(sizeof(ThneedBinIO) == 32);
+static_assert(sizeof(ThneedBinKernel) == 80);
+static_assert(sizeof(ThneedBinArg) == 24);
+
+uint64_t json_id(const Json &j) {
+  const string &s = j.string_value();
+  if (s.empty()) return 0;
+  assert(s.size() == sizeof(uint64_t));
+  uint64_t id;
+  memcpy(&id, s.data(), sizeof(id));
+  return id;
+}
+
+// the legacy format: [int json_size][json][weights][binaries]
+ThneedManifest parse_json_manifest(const char *buf, size_t buf_size, Json &jdat) {
+  int jsz = *(int *)buf;
+  string jsonerr;
+  jdat = Json::parse(string(buf + sizeof(int), jsz), jsonerr);
+  assert(jsonerr.empty());
+
+  ThneedManifest m;
+  size_t ptr = sizeof(int) + jsz;
+  for (auto &obj : jdat["objects"].array_items()) {
+    ThneedObject o = {};
+    o.id = json_id(obj["id"]);
+    o.buffer_id = json_id(obj["buffer_id"]);
+    o.size = obj["size"].int_value();
+    if (obj["needs_load"].bool_value()) {
+      o.data = buf + ptr;
+      ptr += o.size;
+    }
+    if (obj["arg_type"] == "image2d_t") {
+      o.arg_type = THNEED_ARG_IMAGE2D;
+    } else if (obj["arg_type"] == "image1d_t") {
+      o.arg_type = THNEED_ARG_IMAGE1D;
+    } else {
+      o.arg_type = THNEED_ARG_BUFFER;
+    }
+    o.float32 = obj["float32"].bool_value();
+    o.width = obj["width"].int_value();
+    o.height = obj["height"].int_value();
+    o.row_pitch = obj["row_pitch"].int_value();
+    m.objects.push_back(o);
+  }
+
+  for (const auto &[name, source] : jdat["programs"].object_items()) {
+    m.programs.push_back({name, source.string_value().data(), source.string_value().size()});
+  }
+
+  for (auto &obj : jdat["inputs"].array_items()) {
+    m.inputs.push_back({json_id(obj["buffer_id"]), (size_t)obj["size"].int_value(), obj["name"].string_value()});
+  }
+  for (auto &obj : jdat["outputs"].array_items()) {
+    m.outputs.push_back({json_id(obj["buffer_id"]), (size_t)obj["size"].int_value(), ""});
+  }
+
+  for (auto &obj : jdat["binaries"].array_items()) {
+    size_t length = obj["length"].int_value();
+    m.binaries.push_back({obj["name"].string_value(), buf + ptr, length});
+    ptr += length;
+  }
+  assert(ptr <= buf_size);
+
+  for (auto &obj : jdat["kernels"].array_items()) {
+    ThneedKernel k = {};
+    k.name = obj["name"].string_value();
+    k.work_dim = obj["work_dim"].int_value();
+    for (int i = 0; i < k.work_dim; i++) {
+      k.global_work_size[i] = obj["global_work_size"][i].int_value();
+      k.local_work_size[i] = obj["local_work_size"][i].int_value();
+    }
+    int num_args = obj["num_args"].int_value();
+    for (int i = 0; i < num_args; i++) {
+      k.args.push_back(obj["args"].array_items()[i].string_value());
+      k.args_size.push_back(obj["args_size"].array_items()[i].int_value());
+    }
+    m.kernels.push_back(std::move(k));
+  }
+  return m;
+}
+
+const char *bin_at(const char *buf, size_t buf_size, uint64_t offset, uint64_t size) {
+  assert(offset <= buf_size && size <= buf_size - offset);
+  return buf + offset;
+}
+
+template <typename T>
+const T *bin_records(const char *buf, size_t buf_size, size_t &ptr, uint32_t count) {
+  const T *ret = (const T *)bin_at(buf, buf_size, ptr, (uint64_t)count * sizeof(T));
+  ptr += count * sizeof(T);
+  return ret;
+}
+
+ThneedManifest parse_binary_manifest(const char *buf, size_t buf_size) {
+  auto at = [&](uint64_t offset, uint64_t size) { return bin_at(buf, buf_size, offset, size); };
+  auto str = [&](uint64_t offset, uint64_t size) { return string(at(offset, size), size); };
+
+  const ThneedBinHeader *hdr = (const ThneedBinHeader *)at(0, sizeof(ThneedBinHeader));
+  assert(hdr->version == THNEED_BIN_VERSION);
+
+  size_t ptr = sizeof(ThneedBinHeader);
+  const ThneedBinObject *objects = bin_records<ThneedBinObject>(buf, buf_size, ptr, hdr->num_objects);
+  const ThneedBinProgram *programs = bin_records<ThneedBinProgram>(buf, buf_size, ptr, hdr->num_programs);
+  const ThneedBinProgram *binaries = bin_records<ThneedBinProgram>(buf, buf_size, ptr, hdr->num_binaries);
+  const ThneedBinIO *inputs = bin_records<ThneedBinIO>(buf, buf_size, ptr, hdr->num_inputs);
+  const ThneedBinIO *outputs = bin_records<ThneedBinIO>(buf, buf_size, ptr, hdr->num_outputs);
+  const ThneedBinKernel *kernels = bin_records<ThneedBinKernel>(buf, buf_size, ptr, hdr->num_kernels);
+  const ThneedBinArg *args = bin_records<ThneedBinArg>(buf, buf_size, ptr, hdr->num_args);
+
+  ThneedManifest m;
+  m.objects.reserve(hdr->num_objects);
+  for (int i = 0; i < hdr->num_objects; i++) {
+    const ThneedBinObject &bo = objects[i];
+    ThneedObject o = {};
+    o.id = bo.id;
+    o.buffer_id = bo.buffer_id;
+    o.size = bo.size;
+    o.data = bo.needs_load ? at(bo.data_offset, bo.size) : NULL;
+    o.arg_type = (ThneedArgType)bo.arg_type;
+    o.float32 = bo.float32 != 0;
+    o.width = bo.width;
+    o.height = bo.height;
+    o.row_pitch = bo.row_pitch;
+    m.objects.push_back(o);
+  }
+  for (int i = 0; i < hdr->num_programs; i++) {
+    const ThneedBinProgram &p = programs[i];
+    m.programs.push_back({str(p.name_offset, p.name_size), at(p.data_offset, p.data_size), p.data_size});
+  }
+  for (int i = 0; i < hdr->num_binaries; i++) {
+    const ThneedBinProgram &p = binaries[i];
+    m.binaries.push_back({str(p.name_offset, p.name_size), at(p.data_offset, p.data_size), p.data_size});
+  }
+  for (int i = 0; i < hdr->num_inputs; i++) {
+    m.inputs.push_back({inputs[i].buffer_id, inputs[i].size, str(inputs[i].name_offset, inputs[i].name_size)});
+  }
+  for (int i = 0; i < hdr->num_outputs; i++) {
+    m.outputs.push_back({outputs[i].buffer_id, outputs[i].size, ""});
+  }
+  m.kernels.reserve(hdr->num_kernels);
+  for (int i = 0; i < hdr->num_kernels; i++) {
+    const ThneedBinKernel &bk = kernels[i];
+    assert(bk.work_dim <= 3 && bk.first_arg + bk.num_args <= hdr->num_args);
+    ThneedKernel k = {};
+    k.name = str(bk.name_offset, bk.name_size);
+    k.work_dim = bk.work_dim;
+    for (int j = 0; j < k.work_dim; j++) {
+      k.global_work_size[j] = bk.global_work_size[j];
+      k.local_work_size[j] = bk.local_work_size[j];
+    }
+    for (int j = 0; j < bk.num_args; j++) {
+      const ThneedBinArg &a = args[bk.first_arg + j];
+      k.args.push_back(str(a.value_offset, a.value_size));
+      k.args_size.push_back(a.size);
+    }
+    m.kernels.push_back(std::move(k));
+  }
+  return m;
+}
+
+// builds all programs, spread over a few threads since the driver compile/link dominates
+void build_programs(const vector<ThneedProgram> &progs, bool binary, cl_context context, cl_device_id device_id,
+                    map<string, cl_program> &out) {
+  vector<cl_program> built(progs.size());
+  const int num_threads = std::clamp<int>(std::min<size_t>(progs.size(), std::thread::hardware_concurrency()), 1, 8);
+  vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = t; i < progs.size(); i += num_threads) {
+        const ThneedProgram &p = progs[i];
+        built[i] = binary ? cl_program_from_binary(context, device_id, (const uint8_t *)p.data, p.size)
+                          : cl_program_from_source(context, device_id, string(p.data, p.size));
+      }
+    });
+  }
+  for (auto &t : threads) t.join();
+  for (size_t i = 0; i < progs.size(); i++) {
+    out[progs[i].name] = built[i];
+  }
+}
+
+}  // namespace
+
 void Thneed::load(const char *filename) {
   LOGD("Thneed::load: loading from %s\n", filename);
+  double t_start = millis_since_boot();
 
-  string buf = util::read_file(filename);
-  int jsz = *(int *)buf.data();
-  string jsonerr;
-  string jj(buf.data() + sizeof(int), jsz);
-  Json jdat = Json::parse(jj, jsonerr);
+  unique_fd fd(HANDLE_EINTR(open(filename, O_RDONLY | O_CLOEXEC)));
+  assert(fd != -1);
+  struct stat st = {};
+  if (fstat(fd, &st) != 0 || st.st_size <= (off_t)sizeof(int)) {
+    LOGE("Thneed::load: can't load %s, errno=%d size=%lld\n", filename, errno, (long long)st.st_size);
+    return;
+  }
+  size_t buf_size = st.st_size;
+  // the mapping is only read from, and is kept until all uploads out of it have finished
+  char *buf = (char *)mmap(NULL, buf_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  assert(buf != MAP_FAILED);
+  madvise(buf, buf_size, MADV_WILLNEED);
 
-  map<cl_mem, cl_mem> real_mem;
-  real_mem[NULL] = NULL;
+  Json jdat;
+  const bool binary_manifest = memcmp(buf, THNEED_BIN_MAGIC, sizeof(THNEED_BIN_MAGIC)) == 0;
+  ThneedManifest m = binary_manifest ? parse_binary_manifest(buf, buf_size) : parse_json_manifest(buf, buf_size, jdat);
+  double t_parsed = millis_since_boot();
 
-  int ptr = sizeof(int)+jsz;
-  for (auto &obj : jdat["objects"].array_items()) {
-    auto mobj = obj.object_items();
-    int sz = mobj["size"].int_value();
+  map<uint64_t, cl_mem> real_mem;
+  real_mem[0] = NULL;
+
+  const cl_uchar zero = 0;
+  for (const ThneedObject &obj : m.objects) {
+    const bool is_image = obj.arg_type == THNEED_ARG_IMAGE2D || obj.arg_type == THNEED_ARG_IMAGE1D;
     cl_mem clbuf = NULL;
+    cl_int errcode = CL_SUCCESS;
 
-    if (mobj["buffer_id"].string_value().size() > 0) {
+    if (obj.buffer_id != 0) {
       // image buffer must already be allocated
-      clbuf = real_mem[*(cl_mem*)(mobj["buffer_id"].string_value().data())];
-      assert(mobj["needs_load"].bool_value() == false);
+      clbuf = real_mem[obj.buffer_id];
+      assert(obj.data == NULL);
+#ifndef QCOM2
+    } else if (is_image) {
+      // images on PC are created with their own storage below
+#endif
     } else {
-      if (mobj["needs_load"].bool_value()) {
-        clbuf = clCreateBuffer(context, CL_MEM_COPY_HOST_PTR | CL_MEM_READ_WRITE, sz, &buf[ptr], NULL);
-        if (debug >= 1) printf("loading %p %d @ 0x%X\n", clbuf, sz, ptr);
-        ptr += sz;
+      clbuf = clCreateBuffer(context, CL_MEM_READ_WRITE, obj.size, NULL, &errcode);
+      assert(clbuf != NULL);
+      // both are non-blocking, the mapped file is read by the driver while we keep creating objects
+      if (obj.data) {
+        if (debug >= 1) printf("loading %p %zu @ 0x%zX\n", clbuf, obj.size, (size_t)(obj.data - buf));
+        CL_CHECK(clEnqueueWriteBuffer(command_queue, clbuf, CL_FALSE, 0, obj.size, obj.data, 0, NULL, NULL));
       } else {
-        // TODO: is there a faster way to init zeroed out buffers?
-        void *host_zeros = calloc(sz, 1);
-        clbuf = clCreateBuffer(context, CL_MEM_COPY_HOST_PTR | CL_MEM_READ_WRITE, sz, host_zeros, NULL);
-        free(host_zeros);
+        CL_CHECK(clEnqueueFillBuffer(command_queue, clbuf, &zero, sizeof(zero), 0, obj.size, 0, NULL, NULL));
       }
     }
-    assert(clbuf != NULL);
 
-    if (mobj["arg_type"] == "image2d_t" || mobj["arg_type"] == "image1d_t") {
+    if (is_image) {
       cl_image_desc desc = {0};
-      desc.image_type = (mobj["arg_type"] == "image2d_t") ? CL_MEM_OBJECT_IMAGE2D : CL_MEM_OBJECT_IMAGE1D_BUFFER;
-      desc.image_width = mobj["width"].int_value();
-      desc.image_height = mobj["height"].int_value();
-      desc.image_row_pitch = mobj["row_pitch"].int_value();
-      assert(sz == desc.image_height*desc.image_row_pitch);
+      desc.image_type = (obj.arg_type == THNEED_ARG_IMAGE2D) ? CL_MEM_OBJECT_IMAGE2D : CL_MEM_OBJECT_IMAGE1D_BUFFER;
+      desc.image_width = obj.width;
+      desc.image_height = obj.height;
+      desc.image_row_pitch = obj.row_pitch;
+      assert(obj.size == desc.image_height*desc.image_row_pitch);
 #ifdef QCOM2
+      assert(clbuf != NULL);
       desc.buffer = clbuf;
-#else
-      // TODO: we are creating unused buffers on PC
-      clReleaseMemObject(clbuf);
 #endif
       cl_image_format format = {0};
       format.image_channel_order = CL_RGBA;
-      format.image_channel_data_type = mobj["float32"].bool_value() ? CL_FLOAT : CL_HALF_FLOAT;
-
-      cl_int errcode;
+      format.image_channel_data_type = obj.float32 ? CL_FLOAT : CL_HALF_FLOAT;
 
 #ifndef QCOM2
-      if (mobj["needs_load"].bool_value()) {
-        clbuf = clCreateImage(context, CL_MEM_COPY_HOST_PTR | CL_MEM_READ_WRITE, &format, &desc, &buf[ptr-sz], &errcode);
+      if (obj.data) {
+        clbuf = clCreateImage(context, CL_MEM_COPY_HOST_PTR | CL_MEM_READ_WRITE, &format, &desc, (void *)obj.data, &errcode);
       } else {
         clbuf = clCreateImage(context, CL_MEM_READ_WRITE, &format, &desc, NULL, &errcode);
       }
@@ -78,70 +395,58 @@ void Thneed::load(const char *filename) {
         LOGE("clError: %s create image %zux%zu rp %zu with buffer %p\n", cl_get_error_string(errcode),
              desc.image_width, desc.image_height, desc.image_row_pitch, desc.buffer);
       }
-      assert(clbuf != NULL);
     }
+    assert(clbuf != NULL);
 
-    real_mem[*(cl_mem*)(mobj["id"].string_value().data())] = clbuf;
+    real_mem[obj.id] = clbuf;
   }
+  double t_objects = millis_since_boot();
 
   map<string, cl_program> g_programs;
-  for (const auto &[name, source] : jdat["programs"].object_items()) {
-    if (debug >= 1) printf("building %s with size %zu\n", name.c_str(), source.string_value().size());
-    g_programs[name] = cl_program_from_source(context, device_id, source.string_value());
-  }
+  if (debug >= 1) printf("building %zu programs and %zu binaries\n", m.programs.size(), m.binaries.size());
+  build_programs(m.programs, false, context, device_id, g_programs);
+  build_programs(m.binaries, true, context, device_id, g_programs);
+  double t_programs = millis_since_boot();
 
-  for (auto &obj : jdat["inputs"].array_items()) {
-    auto mobj = obj.object_items();
-    int sz = mobj["size"].int_value();
-    cl_mem aa = real_mem[*(cl_mem*)(mobj["buffer_id"].string_value().data())];
+  for (const ThneedIO &io : m.inputs) {
+    cl_mem aa = real_mem[io.buffer_id];
     input_clmem.push_back(aa);
-    input_sizes.push_back(sz);
-    LOGD("Thneed::load: adding input %s with size %d\n", mobj["name"].string_value().data(), sz);
+    input_sizes.push_back(io.size);
+    LOGD("Thneed::load: adding input %s with size %zu\n", io.name.c_str(), io.size);
 
     cl_int cl_err;
-    void *ret = clEnqueueMapBuffer(command_queue, aa, CL_TRUE, CL_MAP_WRITE, 0, sz, 0, NULL, NULL, &cl_err);
-    if (cl_err != CL_SUCCESS) LOGE("clError: %s map %p %d\n", cl_get_error_string(cl_err), aa, sz);
+    void *ret = clEnqueueMapBuffer(command_queue, aa, CL_TRUE, CL_MAP_WRITE, 0, io.size, 0, NULL, NULL, &cl_err);
+    if (cl_err != CL_SUCCESS) LOGE("clError: %s map %p %zu\n", cl_get_error_string(cl_err), aa, io.size);
     assert(cl_err == CL_SUCCESS);
     inputs.push_back(ret);
   }
 
-  for (auto &obj : jdat["outputs"].array_items()) {
-    auto mobj = obj.object_items();
-    int sz = mobj["size"].int_value();
-    LOGD("Thneed::save: adding output with size %d\n", sz);
+  for (const ThneedIO &io : m.outputs) {
+    LOGD("Thneed::save: adding output with size %zu\n", io.size);
     // TODO: support multiple outputs
-    output = real_mem[*(cl_mem*)(mobj["buffer_id"].string_value().data())];
+    output = real_mem[io.buffer_id];
     assert(output != NULL);
   }
 
-  for (auto &obj : jdat["binaries"].array_items()) {
-    string name = obj["name"].string_value();
-    size_t length = obj["length"].int_value();
-    if (debug >= 1) printf("binary %s with size %zu\n", name.c_str(), length);
-    g_programs[name] = cl_program_from_binary(context, device_id, (const uint8_t*)&buf[ptr], length);
-    ptr += length;
-  }
-
-  for (auto &obj : jdat["kernels"].array_items()) {
-    auto gws = obj["global_work_size"];
-    auto lws = obj["local_work_size"];
+  for (const ThneedKernel &k : m.kernels) {
     auto kk = shared_ptr<CLQueuedKernel>(new CLQueuedKernel(this));
 
-    kk->name = obj["name"].string_value();
+    kk->name = k.name;
     kk->program = g_programs[kk->name];
-    kk->work_dim = obj["work_dim"].int_value();
+    kk->work_dim = k.work_dim;
     for (int i = 0; i < kk->work_dim; i++) {
-      kk->global_work_size[i] = gws[i].int_value();
-      kk->local_work_size[i] = lws[i].int_value();
+      kk->global_work_size[i] = k.global_work_size[i];
+      kk->local_work_size[i] = k.local_work_size[i];
     }
-    kk->num_args = obj["num_args"].int_value();
+    kk->num_args = k.args.size();
     for (int i = 0; i < kk->num_args; i++) {
-      string arg = obj["args"].array_items()[i].string_value();
-      int arg_size = obj["args_size"].array_items()[i].int_value();
+      const string &arg = k.args[i];
+      int arg_size = k.args_size[i];
       kk->args_size.push_back(arg_size);
       if (arg_size == 8) {
-        cl_mem val = *(cl_mem*)(arg.data());
-        val = real_mem[val];
+        uint64_t id;
+        memcpy(&id, arg.data(), sizeof(id));
+        cl_mem val = real_mem[id];
         kk->args.push_back(string((char*)&val, sizeof(val)));
       } else {
         kk->args.push_back(arg);
@@ -151,4 +456,9 @@ void Thneed::load(const char *filename) {
   }
 
   clFinish(command_queue);
+  munmap(buf, buf_size);
+
+  double t_end = millis_since_boot();
+  LOGD("Thneed::load: %s manifest, parse %.2f ms, objects %.2f ms, programs %.2f ms, total %.2f ms",
+       binary_manifest ? "binary" : "json", t_parsed - t_start, t_objects - t_parsed, t_programs - t_objects, t_end - t_start);
 }
@@ -1,5 +1,6 @@
 #include "selfdrive/navd/map_renderer.h"
 
+#include <algorithm>
 #include <cmath>
 #include <string>
 #include <QApplication>
@@ -40,10 +41,15 @@ QMapLibre::Coordinate get_point_along_line(float lat, float lon, float bearing,
 MapRenderer::MapRenderer(const QMapLibre::Settings &settings, bool online) : m_settings(settings) {
   QSurfaceFormat fmt;
   fmt.setRenderableType(QSurfaceFormat::OpenGLES);
+  fmt.setVersion(3, 0);
 
   ctx = std::make_unique<QOpenGLContext>();
   ctx->setFormat(fmt);
-  ctx->create();
+  if (!ctx->create()) {
+    fmt.setVersion(2, 0);
+    ctx->setFormat(fmt);
+    ctx->create();
+  }
   assert(ctx->isValid());
 
   surface = std::make_unique<QOffscreenSurface>();
@@ -59,6 +65,25 @@ MapRenderer::MapRenderer(const QMapLibre::Settings &settings, bool online) : m_s
   QOpenGLFramebufferObjectFormat fbo_format;
   fbo.reset(new QOpenGLFramebufferObject(WIDTH, HEIGHT, fbo_format));
 
+  // pixel buffers need GLES 3
+  const bool use_pbo = ctx->format().majorVersion() >= 3;
+  LOGD("map renderer readback through %s", use_pbo ? "pixel buffers" : "glReadPixels");
+  if (use_pbo) {
+    gl_extra = ctx->extraFunctions();
+  }
+  for (auto &rb : readbacks) {
+    if (use_pbo) {
+      rb.pbo = std::make_unique<QOpenGLBuffer>(QOpenGLBuffer::PixelPackBuffer);
+      rb.pbo->setUsagePattern(QOpenGLBuffer::StreamRead);
+      rb.pbo->create();
+      rb.pbo->bind();
+      rb.pbo->allocate(WIDTH * HEIGHT * 4);
+      rb.pbo->release();
+    } else {
+      rb.rgba.resize(WIDTH * HEIGHT * 4);
+    }
+  }
+
   std::string style = util::read_file(STYLE_PATH);
   m_map.reset(new QMapLibre::Map(nullptr, m_settings, fbo->size(), 1));
   m_map->setCoordinateZoom(QMapLibre::Coordinate(0, 0), DEFAULT_ZOOM);
@@ -103,7 +128,16 @@ MapRenderer::MapRenderer(const QMapLibre::Settings &settings, bool online) : m_s
 }
 
 void MapRenderer::msgUpdate() {
-  sm->update(1000);
+  // frames rendered in the last update go out as their copies finish, while waiting for the next location.
+  // a copy still in flight after that keeps going while the next frame renders.
+  const double deadline = millis_since_boot() + 1000;
+  while (true) {
+    sendDoneReadbacks();
+    const bool in_flight = std::any_of(readbacks.begin(), readbacks.end(), [](auto &rb) { return rb.pending; });
+    const double now = millis_since_boot();
+    sm->update(in_flight ? 1 : std::max(0.0, deadline - now));
+    if (sm->updated("liveLocationKalman") || sm->updated("navRoute") || now >= deadline) break;
+  }
 
   if (sm->updated("liveLocationKalman")) {
     auto location = (*sm)["liveLocationKalman"].getLiveLocationKalman();
@@ -187,43 +221,117 @@ void MapRenderer::sendThumbnail(const uint64_t ts, const kj::Array<capnp::byte>
 }
 
 void MapRenderer::publish(const double render_time, const bool loaded) {
-  QImage cap = fbo->toImage().convertToFormat(QImage::Format_RGB888, Qt::AutoColor);
+  Readback &rb = readbacks[next_readback];
+  // both frames are still in flight, the older one goes out first
+  if (rb.pending) {
+    sendReadback(rb);
+  }
 
   auto location = (*sm)["liveLocationKalman"].getLiveLocationKalman();
-  bool valid = loaded && (location.getStatus() == cereal::LiveLocationKalman::Status::VALID) && location.getPositionGeodetic().getValid();
+  rb.valid = loaded && (location.getStatus() == cereal::LiveLocationKalman::Status::VALID) && location.getPositionGeodetic().getValid();
+  rb.render_time = render_time;
+  rb.render_end = millis_since_boot();
+  rb.location_mono_time = (*sm)["liveLocationKalman"].getLogMonoTime();
   ever_loaded = ever_loaded || loaded;
+
+  // the map keeps track of its own framebuffer binding, put back whatever it left bound
+  GLint prev_fbo = 0;
+  gl_functions->glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prev_fbo);
+  gl_functions->glBindFramebuffer(GL_FRAMEBUFFER, fbo->handle());
+  if (rb.pbo) {
+    rb.pbo->bind();
+    gl_functions->glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    rb.pbo->release();
+    rb.fence = gl_extra->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  } else {
+    gl_functions->glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, rb.rgba.data());
+  }
+  gl_functions->glBindFramebuffer(GL_FRAMEBUFFER, prev_fbo);
+  gl_functions->glFlush();
+
+  rb.pending = true;
+  next_readback = (next_readback + 1) % readbacks.size();
+}
+
+bool MapRenderer::readbackDone(const Readback &rb) {
+  if (!rb.fence) return true;
+  const GLenum ret = gl_extra->glClientWaitSync(rb.fence, 0, 0);
+  return ret == GL_ALREADY_SIGNALED || ret == GL_CONDITION_SATISFIED || ret == GL_WAIT_FAILED;
+}
+
+// sends the frames whose copies are done, oldest first
+void MapRenderer::sendDoneReadbacks() {
+  for (size_t i = 0; i < readbacks.size(); i++) {
+    Readback &rb = readbacks[(next_readback + i) % readbacks.size()];
+    if (rb.pending) {
+      if (!readbackDone(rb)) break;
+      sendReadback(rb);
+    }
+  }
+}
+
+void MapRenderer::sendReadback(Readback &rb) {
+  rb.pending = false;
+  if (rb.fence) {
+    gl_extra->glDeleteSync(rb.fence);
+    rb.fence = nullptr;
+  }
+  if (!rb.pbo) {
+    sendFrame(rb.rgba.data(), rb);
+    return;
+  }
+
+  rb.pbo->bind();
+  if (auto rgba = (const uint8_t *)rb.pbo->mapRange(0, WIDTH * HEIGHT * 4, QOpenGLBuffer::RangeRead)) {
+    sendFrame(rgba, rb);
+    rb.pbo->unmap();
+  } else {
+    LOGE("failed to map readback buffer");
+  }
+  rb.pbo->release();
+}
+
+void MapRenderer::sendFrame(const uint8_t *rgba, const Readback &rb) {
   uint64_t ts = nanos_since_boot();
   VisionBuf* buf = vipc_server->get_buffer(VisionStreamType::VISION_STREAM_MAP);
   VisionIpcBufExtra extra = {
     .frame_id = frame_id,
-    .timestamp_sof = (*sm)["liveLocationKalman"].getLogMonoTime(),
+    .timestamp_sof = rb.location_mono_time,
     .timestamp_eof = ts,
-    .valid = valid,
+    .valid = rb.valid,
   };
 
-  assert(cap.sizeInBytes() >= buf->len);
-  uint8_t* dst = (uint8_t*)buf->addr;
-  uint8_t* src = cap.bits();
-
-  // RGB to greyscale
-  memset(dst, 128, buf->len);
-  for (int i = 0; i < WIDTH * HEIGHT; i++) {
-    dst[i] = src[i * 3];
+  // red channel into the Y plane, which is all navmodeld looks at. GL rows start at the bottom
+  for (int row = 0; row < HEIGHT; row++) {
+    const uint8_t *src = rgba + (HEIGHT - 1 - row) * WIDTH * 4;
+    uint8_t *dst = buf->y + row * buf->stride;
+    for (int col = 0; col < WIDTH; col++) {
+      dst[col] = src[col * 4];
+    }
   }
+  memset(buf->uv, 128, buf->len - buf->uv_offset);
 
   vipc_server->send(buf, &extra);
+  const double publish_delay = (millis_since_boot() - rb.render_end) / 1000.0;
 
   // Send thumbnail
   if (TEST_MODE) {
-    // Full image in thumbnails in test mode
-    kj::Array<capnp::byte> buffer_kj = kj::heapArray<capnp::byte>((const capnp::byte*)cap.bits(), cap.sizeInBytes());
+    // Full RGB image in thumbnails in test mode
+    kj::Array<capnp::byte> buffer_kj = kj::heapArray<capnp::byte>(WIDTH * HEIGHT * 3);
+    for (int row = 0; row < HEIGHT; row++) {
+      const uint8_t *src = rgba + (HEIGHT - 1 - row) * WIDTH * 4;
+      capnp::byte *dst = buffer_kj.begin() + row * WIDTH * 3;
+      for (int col = 0; col < WIDTH; col++) {
+        memcpy(dst + col * 3, src + col * 4, 3);
+      }
+    }
     sendThumbnail(ts, buffer_kj);
   } else if (frame_id % 100 == 0) {
     // Write jpeg into buffer
     QByteArray buffer_bytes;
     QBuffer buffer(&buffer_bytes);
     buffer.open(QIODevice::WriteOnly);
-    cap.save(&buffer, "JPG", 50);
+    QImage(rgba, WIDTH, HEIGHT, QImage::Format_RGBX8888).mirrored().save(&buffer, "JPG", 50);
 
     kj::Array<capnp::byte> buffer_kj = kj::heapArray<capnp::byte>((const capnp::byte*)buffer_bytes.constData(), buffer_bytes.size());
     sendThumbnail(ts, buffer_kj);
@@ -233,9 +341,10 @@ void MapRenderer::publish(const double render_time, const bool loaded) {
   MessageBuilder msg;
   auto evt = msg.initEvent();
   auto state = evt.initMapRenderState();
-  evt.setValid(valid);
-  state.setLocationMonoTime((*sm)["liveLocationKalman"].getLogMonoTime());
-  state.setRenderTime(render_time);
+  evt.setValid(rb.valid);
+  state.setLocationMonoTime(rb.location_mono_time);
+  state.setRenderTime(rb.render_time);
+  state.setPublishDelay(publish_delay);
   state.setFrameId(frame_id);
   pm->send("mapRenderState", msg);
 
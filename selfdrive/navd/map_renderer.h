@@ -1,6 +1,8 @@
 #pragma once
 
+#include <array>
 #include <memory>
+#include <vector>
 
 #include <QOpenGLContext>
 #include <QMapLibre/Map>
@@ -8,6 +10,7 @@
 #include <QTimer>
 #include <QGeoCoordinate>
 #include <QOpenGLBuffer>
+#include <QOpenGLExtraFunctions>
 #include <QOffscreenSurface>
 #include <QOpenGLFunctions>
 #include <QOpenGLFramebufferObject>
@@ -38,6 +41,29 @@ private:
   void publish(const double render_time, const bool loaded);
   void sendThumbnail(const uint64_t ts, const kj::Array<capnp::byte> &buf);
 
+  // A rendered frame on its way from the fbo to VisionIPC. glReadPixels into a pixel buffer
+  // returns right away, and the frame is sent once its fence says the copy is done, while
+  // waiting for the next location or while the next frame renders. Mapping the buffer
+  // before that would wait for the GPU.
+  // Without pixel buffers (GLES 2) the pixels are read into rgba as soon as the frame is rendered.
+  struct Readback {
+    std::unique_ptr<QOpenGLBuffer> pbo;
+    GLsync fence = nullptr;
+    std::vector<uint8_t> rgba;
+    bool pending = false;
+    bool valid = false;
+    double render_time = 0;
+    double render_end = 0;  // millis_since_boot, when the readback was started
+    uint64_t location_mono_time = 0;
+  };
+  std::array<Readback, 2> readbacks;
+  int next_readback = 0;  // also the oldest pending one
+  void sendReadback(Readback &rb);
+  void sendFrame(const uint8_t *rgba, const Readback &rb);
+  bool readbackDone(const Readback &rb);
+  void sendDoneReadbacks();
+  QOpenGLExtraFunctions *gl_extra = nullptr;  // GLES 3, owned by ctx
+
   QMapLibre::Settings m_settings;
   QScopedPointer<QMapLibre::Map> m_map;
 
@@ -103,6 +103,7 @@ class TestMapRenderer:
     starting_frame_id = None
 
     render_times = []
+    self.publish_delays = []
 
     # run test
     prev_frame_id = -1
@@ -146,6 +147,9 @@ class TestMapRenderer:
       else:
         assert 0. < self.sm['mapRenderState'].renderTime < 0.1
         render_times.append(self.sm['mapRenderState'].renderTime)
+      # readback to publish under llvmpipe: median 0.2 ms, p99 1-2 ms, max 10 ms
+      assert 0. <= self.sm['mapRenderState'].publishDelay < 0.05
+      self.publish_delays.append(self.sm['mapRenderState'].publishDelay)
 
       # check vision ipc output
       assert self.vipc.recv() is not None
@@ -198,6 +202,7 @@ class TestMapRenderer:
     _stddev = np.std(render_times)
 
     print(f"Stats: min: {_min}, max: {_max}, mean: {_mean}, median: {_median}, stddev: {_stddev}, count: {len(render_times)}")
+    print(f"Publish delay: median: {np.median(self.publish_delays)}, p99: {np.percentile(self.publish_delays, 99)}, max: {np.max(self.publish_delays)}")
 
     def assert_stat(stat, nominal, tol=0.3):
       tol = (nominal / (1+tol)), (nominal * (1+tol))
@@ -3,6 +3,7 @@
 #include <unistd.h>
 
 #include <cassert>
+#include <cstring>
 #include <stdexcept>
 #include <vector>
 
@@ -212,7 +213,7 @@ void Panda::can_send(capnp::List<cereal::CanData>::Reader can_data_list) {
   });
 }
 
-bool Panda::can_receive(std::vector<can_frame>& out_vec) {
+bool Panda::can_receive(std::vector<can_frame_raw>& out_vec) {
   // Check if enough space left in buffer to store RECV_SIZE data
   assert(receive_buffer_size + RECV_SIZE <= sizeof(receive_buffer));
 
@@ -238,7 +239,26 @@ void Panda::can_reset_communications() {
   handle->control_write(0xc0, 0, 0);
 }
 
+static inline void set_frame_data(can_frame &frame, const uint8_t *dat, uint8_t len) {
+  frame.busTime = 0;
+  frame.dat.assign((const char *)dat, len);
+}
+
+static inline void set_frame_data(can_frame_raw &frame, const uint8_t *dat, uint8_t len) {
+  frame.len = len;
+  memcpy(frame.dat, dat, len);
+}
+
 bool Panda::unpack_can_buffer(uint8_t *data, uint32_t &size, std::vector<can_frame> &out_vec) {
+  return unpack_can_buffer_impl(data, size, out_vec);
+}
+
+bool Panda::unpack_can_buffer(uint8_t *data, uint32_t &size, std::vector<can_frame_raw> &out_vec) {
+  return unpack_can_buffer_impl(data, size, out_vec);
+}
+
+template <class T>
+bool Panda::unpack_can_buffer_impl(uint8_t *data, uint32_t &size, std::vector<T> &out_vec) {
   int pos = 0;
 
   while (pos <= size - sizeof(can_header)) {
@@ -258,8 +278,7 @@ bool Panda::unpack_can_buffer(uint8_t *data, uint32_t &size, std::vector<can_fra
       return false;
     }
 
-    can_frame &canData = out_vec.emplace_back();
-    canData.busTime = 0;
+    T &canData = out_vec.emplace_back();
     canData.address = header.addr;
     canData.src = header.bus + bus_offset;
     if (header.rejected) {
@@ -269,7 +288,7 @@ bool Panda::unpack_can_buffer(uint8_t *data, uint32_t &size, std::vector<can_fra
       canData.src += CAN_RETURNED_BUS_OFFSET;
     }
 
-    canData.dat.assign((char *)&data[pos + sizeof(can_header)], data_len);
+    set_frame_data(canData, &data[pos + sizeof(can_header)], data_len);
 
     pos += sizeof(can_header) + data_len;
   }
@@ -288,3 +307,49 @@ uint8_t Panda::calculate_checksum(uint8_t *data, uint32_t len) {
   }
   return checksum;
 }
+
+void CanEventBuilder::reserve(size_t words) {
+  // the first segment of a MessageBuilder must be zeroed
+  scratch_ = kj::heapArray<capnp::word>(words);
+  memset(scratch_.begin(), 0, words * sizeof(capnp::word));
+}
+
+void CanEventBuilder::build(const std::vector<can_frame_raw> &frames, bool valid, std::function<void(capnp::byte *, size_t)> send) {
+  // event and list overhead plus per frame: list element, data pointer target
+  size_t words = 64 + frames.size() * 2;
+  for (const auto &f : frames) words += (f.len + 7) / 8;
+  // word 0 is reserved for the stream framing header, the message starts right after it
+  if (scratch_.size() < words + 1) {
+    reserve((words + 1) * 2);
+  }
+
+  bool fits;
+  {
+    MessageBuilder msg(kj::arrayPtr(scratch_.begin() + 1, scratch_.size() - 1));
+    auto evt = msg.initEvent(valid);
+    auto canData = evt.initCan(frames.size());
+    for (uint i = 0; i < frames.size(); i++) {
+      canData[i].setAddress(frames[i].address);
+      canData[i].setDat(kj::arrayPtr(frames[i].dat, frames[i].len));
+      canData[i].setSrc(frames[i].src);
+    }
+
+    auto segments = msg.getSegmentsForOutput();
+    fits = segments.size() == 1 && segments[0].begin() == scratch_.begin() + 1;
+    if (fits) {
+      // single segment stream framing: segment count - 1, then the segment size in words
+      uint32_t *header = (uint32_t *)scratch_.begin();
+      header[0] = 0;
+      header[1] = segments[0].size();
+      send((capnp::byte *)scratch_.begin(), (segments[0].size() + 1) * sizeof(capnp::word));
+    } else {
+      auto bytes = msg.toBytes();
+      send(bytes.begin(), bytes.size());
+    }
+  }  // msg zeroes the used part of scratch_ here, so it must not be resized before
+
+  if (!fits) {
+    LOGW("can event did not fit in %zu words", scratch_.size());
+    reserve(scratch_.size() * 2);
+  }
+}
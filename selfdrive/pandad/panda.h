@@ -43,6 +43,26 @@ struct can_frame {
   long src;
 };
 
+// fixed size frame for the receive path, a reused vector of these never touches the heap
+struct can_frame_raw {
+  uint32_t address;
+  uint8_t src;
+  uint8_t len;
+  uint8_t dat[64];
+};
+
+// serializes "can" events into a reused scratch segment, so steady state cycles don't allocate
+class CanEventBuilder {
+public:
+  // calls send with the serialized event, the data is only valid during the call
+  void build(const std::vector<can_frame_raw> &frames, bool valid, std::function<void(capnp::byte *, size_t)> send);
+
+private:
+  // capnp::word can't be copied or moved, so this grows by allocating a new array
+  void reserve(size_t words);
+  kj::Array<capnp::word> scratch_;
+};
+
 
 class Panda {
 private:
@@ -54,6 +74,9 @@ public:
   cereal::PandaState::PandaType hw_type = cereal::PandaState::PandaType::UNKNOWN;
   const uint32_t bus_offset;
 
+  // upper bound of frames a single can_receive call can append
+  static constexpr size_t MAX_RECV_FRAMES = (RECV_SIZE + sizeof(can_header) + 64) / sizeof(can_header);
+
   bool connected();
   bool comms_healthy();
   std::string hw_serial();
@@ -81,7 +104,7 @@ public:
   void set_data_speed_kbps(uint16_t bus, uint16_t speed);
   void set_canfd_non_iso(uint16_t bus, bool non_iso);
   void can_send(capnp::List<cereal::CanData>::Reader can_data_list);
-  bool can_receive(std::vector<can_frame>& out_vec);
+  bool can_receive(std::vector<can_frame_raw>& out_vec);
   void can_reset_communications();
 
 protected:
@@ -90,8 +113,12 @@ protected:
   uint32_t receive_buffer_size = 0;
 
   Panda(uint32_t bus_offset) : bus_offset(bus_offset) {}
+  Panda(std::unique_ptr<PandaCommsHandle> handle, uint32_t bus_offset) : handle(std::move(handle)), bus_offset(bus_offset) {}
   void pack_can_buffer(const capnp::List<cereal::CanData>::Reader &can_data_list,
                          std::function<void(uint8_t *, size_t)> write_func);
   bool unpack_can_buffer(uint8_t *data, uint32_t &size, std::vector<can_frame> &out_vec);
+  bool unpack_can_buffer(uint8_t *data, uint32_t &size, std::vector<can_frame_raw> &out_vec);
+  template <class T>
+  bool unpack_can_buffer_impl(uint8_t *data, uint32_t &size, std::vector<T> &out_vec);
   uint8_t calculate_checksum(uint8_t *data, uint32_t len);
 };
@@ -204,7 +204,9 @@ void can_recv_thread(std::vector<Panda *> pandas) {
 
   // run at 100Hz
   RateKeeper rk("pandad_can_recv", 100);
-  std::vector<can_frame> raw_can_data;
+  std::vector<can_frame_raw> raw_can_data;
+  raw_can_data.reserve(pandas.size() * Panda::MAX_RECV_FRAMES);
+  CanEventBuilder can_builder;
 
   while (!do_exit && check_all_connected(pandas)) {
     bool comms_healthy = true;
@@ -213,17 +215,9 @@ void can_recv_thread(std::vector<Panda *> pandas) {
       comms_healthy &= panda->can_receive(raw_can_data);
     }
 
-    MessageBuilder msg;
-    auto evt = msg.initEvent();
-    evt.setValid(comms_healthy);
-    auto canData = evt.initCan(raw_can_data.size());
-    for (uint i = 0; i<raw_can_data.size(); i++) {
-      canData[i].setAddress(raw_can_data[i].address);
-      canData[i].setBusTime(raw_can_data[i].busTime);
-      canData[i].setDat(kj::arrayPtr((uint8_t*)raw_can_data[i].dat.data(), raw_can_data[i].dat.size()));
-      canData[i].setSrc(raw_can_data[i].src);
-    }
-    pm.send("can", msg);
+    can_builder.build(raw_can_data, comms_healthy, [&](capnp::byte *data, size_t size) {
+      pm.send("can", data, size);
+    });
 
     rk.keepTime();
   }
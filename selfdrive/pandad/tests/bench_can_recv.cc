@@ -0,0 +1,146 @@
+// CAN receive throughput and heap allocations per cycle, against a fake comms handle that replays packed frames.
+// Compares the previous path (std::string frames + MessageBuilder + toBytes) with can_frame_raw + CanEventBuilder.
+// usage: ./bench_can_recv [cycles] [frames per cycle] [pandas]
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "cereal/messaging/messaging.h"
+#include "common/util.h"
+#include "selfdrive/pandad/panda.h"
+
+static std::atomic<uint64_t> allocations = 0;
+
+void *operator new(size_t size) {
+  allocations++;
+  void *p = malloc(size);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+// replays the same packed receive buffer on every bulk read
+class FakePandaCommsHandle : public PandaCommsHandle {
+public:
+  FakePandaCommsHandle(const std::vector<uint8_t> &data) : PandaCommsHandle(""), data(data) {}
+  void cleanup() override {}
+  int control_write(uint8_t request, uint16_t param1, uint16_t param2, unsigned int timeout) override { return 0; }
+  int control_read(uint8_t request, uint16_t param1, uint16_t param2, unsigned char *buf, uint16_t length, unsigned int timeout) override { return 0; }
+  int bulk_write(unsigned char endpoint, unsigned char *buf, int length, unsigned int timeout) override { return length; }
+  int bulk_read(unsigned char endpoint, unsigned char *buf, int length, unsigned int timeout) override {
+    assert(data.size() <= length);
+    memcpy(buf, data.data(), data.size());
+    return data.size();
+  }
+
+  const std::vector<uint8_t> data;
+};
+
+class BenchPanda : public Panda {
+public:
+  BenchPanda(FakePandaCommsHandle *h, uint32_t bus_offset) : Panda(std::unique_ptr<PandaCommsHandle>(h), bus_offset), fake(h) {}
+
+  static std::vector<uint8_t> pack(uint32_t bus_offset, int num_frames) {
+    BenchPanda packer(bus_offset);
+    MessageBuilder msg;
+    auto can_list = msg.initEvent().initSendcan(num_frames);
+    uint8_t dat[64] = {};
+    for (int i = 0; i < num_frames; i++) {
+      // mostly classic CAN, every fifth frame is a full CAN FD frame
+      int len = (i % 5 == 4) ? 64 : 8;
+      for (int j = 0; j < len; j++) dat[j] = util::random_int(0, 255);
+      can_list[i].setAddress(util::random_int(0, 0x7ff));
+      can_list[i].setSrc(bus_offset + i % 3);
+      can_list[i].setDat(kj::arrayPtr(dat, len));
+    }
+    std::vector<uint8_t> out;
+    packer.pack_can_buffer(can_list.asReader(), [&](uint8_t *data, size_t size) {
+      out.insert(out.end(), data, data + size);
+    });
+    assert(out.size() <= RECV_SIZE);
+    return out;
+  }
+
+  // what can_receive did before can_frame_raw
+  bool can_receive_legacy(std::vector<can_frame> &out_vec) {
+    int recv = fake->bulk_read(0x81, &receive_buffer[receive_buffer_size], RECV_SIZE);
+    receive_buffer_size += recv;
+    return unpack_can_buffer(receive_buffer, receive_buffer_size, out_vec);
+  }
+
+  FakePandaCommsHandle *fake;
+
+private:
+  BenchPanda(uint32_t bus_offset) : Panda(bus_offset) {}
+};
+
+template <class F>
+static void run(const char *name, std::vector<std::unique_ptr<BenchPanda>> &pandas, int cycles, int frames_per_cycle, F cycle) {
+  const int warmup = 10;
+  for (int i = 0; i < warmup; i++) cycle();
+
+  uint64_t alloc_start = allocations;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < cycles; i++) cycle();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  uint64_t allocs = allocations - alloc_start;
+
+  uint64_t frames = (uint64_t)cycles * frames_per_cycle * pandas.size();
+  printf("%-8s %10.0f frames/s %8.2f us/cycle %8.2f allocations/cycle\n",
+         name, frames / seconds, seconds * 1e6 / cycles, (double)allocs / cycles);
+}
+
+int main(int argc, char *argv[]) {
+  const int cycles = argc > 1 ? atoi(argv[1]) : 10000;
+  const int frames_per_cycle = argc > 2 ? atoi(argv[2]) : 300;
+  const int num_pandas = argc > 3 ? atoi(argv[3]) : 2;
+
+  std::vector<std::unique_ptr<BenchPanda>> pandas;
+  for (int i = 0; i < num_pandas; i++) {
+    uint32_t bus_offset = i * PANDA_BUS_OFFSET;
+    auto handle = new FakePandaCommsHandle(BenchPanda::pack(bus_offset, frames_per_cycle));
+    pandas.push_back(std::make_unique<BenchPanda>(handle, bus_offset));
+  }
+  printf("%d pandas, %d frames per panda per cycle, %zu bytes per read\n",
+         num_pandas, frames_per_cycle, pandas[0]->fake->data.size());
+
+  size_t total_size = 0;
+  std::vector<can_frame> legacy_frames;
+  run("legacy", pandas, cycles, frames_per_cycle, [&]() {
+    legacy_frames.clear();
+    for (auto &p : pandas) p->can_receive_legacy(legacy_frames);
+    assert(legacy_frames.size() == frames_per_cycle * pandas.size());
+
+    MessageBuilder msg;
+    auto canData = msg.initEvent(true).initCan(legacy_frames.size());
+    for (uint i = 0; i < legacy_frames.size(); i++) {
+      canData[i].setAddress(legacy_frames[i].address);
+      canData[i].setBusTime(legacy_frames[i].busTime);
+      canData[i].setDat(kj::arrayPtr((uint8_t *)legacy_frames[i].dat.data(), legacy_frames[i].dat.size()));
+      canData[i].setSrc(legacy_frames[i].src);
+    }
+    total_size += msg.toBytes().size();
+  });
+
+  std::vector<can_frame_raw> frames;
+  frames.reserve(pandas.size() * Panda::MAX_RECV_FRAMES);
+  CanEventBuilder builder;
+  run("raw", pandas, cycles, frames_per_cycle, [&]() {
+    frames.clear();
+    for (auto &p : pandas) p->can_receive(frames);
+    assert(frames.size() == frames_per_cycle * pandas.size());
+
+    builder.build(frames, true, [&](capnp::byte *data, size_t size) {
+      total_size += size;
+    });
+  });
+
+  return total_size == 0;
+}
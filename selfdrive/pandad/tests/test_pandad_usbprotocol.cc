@@ -10,6 +10,7 @@ struct PandaTest : public Panda {
   PandaTest(uint32_t bus_offset, int can_list_size, cereal::PandaState::PandaType hw_type);
   void test_can_send();
   void test_can_recv(uint32_t chunk_size = 0);
+  void test_can_recv_raw();
   void test_chunked_can_recv();
 
   std::map<int, std::string> test_data;
@@ -102,6 +103,34 @@ void PandaTest::test_can_recv(uint32_t rx_chunk_size) {
   }
 }
 
+void PandaTest::test_can_recv_raw() {
+  std::vector<can_frame_raw> frames;
+  this->pack_can_buffer(can_data_list, [&](uint8_t *data, uint32_t size) {
+    REQUIRE(this->unpack_can_buffer(data, size, frames));
+  });
+  REQUIRE(frames.size() == can_list_size);
+
+  // build twice to check the reused scratch segment is cleared in between
+  CanEventBuilder builder;
+  for (int round = 0; round < 2; ++round) {
+    builder.build(frames, true, [&](capnp::byte *data, size_t size) {
+      REQUIRE(size % sizeof(capnp::word) == 0);
+      kj::ArrayPtr<const capnp::word> words((const capnp::word *)data, size / sizeof(capnp::word));
+      capnp::FlatArrayMessageReader reader(words);
+      auto can = reader.getRoot<cereal::Event>().getCan();
+      REQUIRE(can.size() == can_list_size);
+      for (int i = 0; i < can.size(); ++i) {
+        REQUIRE(can[i].getAddress() == can_data_list[i].getAddress());
+        REQUIRE(can[i].getSrc() == can_data_list[i].getSrc());
+        auto dat = can[i].getDat();
+        auto expected = can_data_list[i].getDat();
+        REQUIRE(dat.size() == expected.size());
+        REQUIRE(memcmp(dat.begin(), expected.begin(), dat.size()) == 0);
+      }
+    });
+  }
+}
+
 TEST_CASE("send/recv CAN 2.0 packets") {
   auto bus_offset = GENERATE(0, 4);
   auto can_list_size = GENERATE(1, 3, 5, 10, 30, 60, 100, 200);
@@ -116,6 +145,9 @@ TEST_CASE("send/recv CAN 2.0 packets") {
   SECTION("chunked_can_receive") {
     test.test_can_recv(0x40);
   }
+  SECTION("can_receive_raw") {
+    test.test_can_recv_raw();
+  }
 }
 
 TEST_CASE("send/recv CAN FD packets") {
@@ -132,4 +164,7 @@ TEST_CASE("send/recv CAN FD packets") {
   SECTION("chunked_can_receive") {
     test.test_can_recv(0x40);
   }
+  SECTION("can_receive_raw") {
+    test.test_can_recv_raw();
+  }
 }
@@ -633,6 +633,7 @@ DevicePanel::DevicePanel(SettingsWindow *parent) : ListWidget(parent) {
               int restoreResult = std::system(restoreCommand.c_str());
 
               if (restoreResult == 0) {
+                params.invalidateCache();
                 toggleBackupBtn->setValue(tr("Success!"));
                 updateFrogPilotToggles();
                 std::system(("rm -rf " + tempBackupPath).c_str());
@@ -638,7 +638,7 @@ void AnnotatedCameraWidget::paintEvent(QPaintEvent *event) {
   {
     std::lock_guard lk(frame_lock);
 
-    if (frames.empty()) {
+    if (!hasFrame()) {
       if (skip_frame_count > 0) {
         skip_frame_count--;
         qDebug() << "skipping frame, not ready";
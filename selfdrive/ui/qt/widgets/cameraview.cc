@@ -7,6 +7,7 @@
 #endif
 
 #include <cmath>
+#include <cstring>
 #include <set>
 #include <string>
 #include <utility>
@@ -115,7 +116,12 @@ CameraWidget::~CameraWidget() {
     glDeleteVertexArrays(1, &frame_vao);
     glDeleteBuffers(1, &frame_vbo);
     glDeleteBuffers(1, &frame_ibo);
-    glDeleteBuffers(2, textures);
+#ifndef QCOM2
+    for (auto &slot : upload_slots) {
+      glDeleteTextures(2, slot.textures);
+      glDeleteBuffers(1, &slot.pbo);
+    }
+#endif
   }
   doneCurrent();
 }
@@ -174,7 +180,10 @@ void CameraWidget::initializeGL() {
 #ifdef QCOM2
   glUniform1i(program->uniformLocation("uTexture"), 0);
 #else
-  glGenTextures(2, textures);
+  for (auto &slot : upload_slots) {
+    glGenTextures(2, slot.textures);
+    glGenBuffers(1, &slot.pbo);
+  }
   glUniform1i(program->uniformLocation("uTextureY"), 0);
   glUniform1i(program->uniformLocation("uTextureUV"), 1);
 #endif
@@ -274,8 +283,9 @@ void CameraWidget::paintGL() {
   glClear(GL_STENCIL_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 
   std::lock_guard lk(frame_lock);
-  if (frames.empty()) return;
+  if (!hasFrame()) return;
 
+#ifdef QCOM2
   int frame_idx = frames.size() - 1;
 
   // Always draw latest frame until sync logic is more stable
@@ -283,15 +293,22 @@ void CameraWidget::paintGL() {
   //   if (frames[frame_idx].first == draw_frame_id) break;
   // }
 
-  // Log duplicate/dropped frames
-  if (frames[frame_idx].first == prev_frame_id) {
-    qDebug() << "Drawing same frame twice" << frames[frame_idx].first;
-  } else if (frames[frame_idx].first != prev_frame_id + 1) {
-    qDebug() << "Skipped frame" << frames[frame_idx].first;
-  }
-  prev_frame_id = frames[frame_idx].first;
+  const uint32_t frame_id = frames[frame_idx].first;
   VisionBuf *frame = frames[frame_idx].second;
   assert(frame != nullptr);
+#else
+  uploadNewestFrame();
+  if (!drawn_slot) return;
+  const uint32_t frame_id = drawn_slot->frame_id;
+#endif
+
+  // Log duplicate/dropped frames
+  if (frame_id == prev_frame_id) {
+    qDebug() << "Drawing same frame twice" << frame_id;
+  } else if (frame_id != prev_frame_id + 1) {
+    qDebug() << "Skipped frame" << frame_id;
+  }
+  prev_frame_id = frame_id;
 
   updateFrameMat();
 
@@ -306,18 +323,10 @@ void CameraWidget::paintGL() {
   glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, egl_images[frame->idx]);
   assert(glGetError() == GL_NO_ERROR);
 #else
-  // fallback to copy
-  glPixelStorei(GL_UNPACK_ROW_LENGTH, stream_stride);
   glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, textures[0]);
-  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, stream_width, stream_height, GL_RED, GL_UNSIGNED_BYTE, frame->y);
-  assert(glGetError() == GL_NO_ERROR);
-
-  glPixelStorei(GL_UNPACK_ROW_LENGTH, stream_stride/2);
+  glBindTexture(GL_TEXTURE_2D, drawn_slot->textures[0]);
   glActiveTexture(GL_TEXTURE0 + 1);
-  glBindTexture(GL_TEXTURE_2D, textures[1]);
-  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, stream_width/2, stream_height/2, GL_RG, GL_UNSIGNED_BYTE, frame->uv);
-  assert(glGetError() == GL_NO_ERROR);
+  glBindTexture(GL_TEXTURE_2D, drawn_slot->textures[1]);
 #endif
 
   glUniformMatrix4fv(program->uniformLocation("uTransform"), 1, GL_TRUE, frame_mat.v);
@@ -331,6 +340,95 @@ void CameraWidget::paintGL() {
   glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 }
 
+#ifndef QCOM2
+void CameraWidget::mapSlot(UploadSlot &slot) {
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+  slot.ptr = (uint8_t *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, upload_size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  assert(slot.ptr != nullptr);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  slot.state = UploadSlot::FREE;
+}
+
+// called from the vipc thread, never blocks on the UI
+void CameraWidget::stageFrame(uint32_t frame_id, const VisionBuf *buf) {
+  UploadSlot *slot = nullptr;
+  {
+    std::lock_guard lk(frame_lock);
+    // frame ids went back (e.g. a replay seek), the staged frames after this one are stale
+    for (auto &s : upload_slots) {
+      if (s.state == UploadSlot::READY && s.frame_id > frame_id) {
+        s.state = UploadSlot::FREE;
+      }
+    }
+    // a free buffer, or else the oldest frame the UI didn't get to
+    for (auto &s : upload_slots) {
+      if (s.state == UploadSlot::FREE) {
+        slot = &s;
+        break;
+      }
+      if (s.state == UploadSlot::READY && (!slot || s.frame_id < slot->frame_id)) {
+        slot = &s;
+      }
+    }
+    if (!slot) return;
+    slot->state = UploadSlot::WRITING;
+  }
+
+  const size_t y_size = buf->stride * buf->height;
+  memcpy(slot->ptr, buf->y, y_size);
+  memcpy(slot->ptr + y_size, buf->uv, y_size / 2);
+
+  std::lock_guard lk(frame_lock);
+  slot->frame_id = frame_id;
+  slot->state = UploadSlot::READY;
+  has_frame = true;
+}
+
+// starts the upload of the newest staged frame, the ones before it are dropped
+void CameraWidget::uploadNewestFrame() {
+  UploadSlot *ready = nullptr;
+  for (auto &s : upload_slots) {
+    if (s.state == UploadSlot::READY && (!ready || s.frame_id > ready->frame_id)) {
+      ready = &s;
+    }
+  }
+  if (!ready) return;
+
+  for (auto &s : upload_slots) {
+    if (s.state == UploadSlot::READY && &s != ready) {
+      s.state = UploadSlot::FREE;  // still mapped
+    }
+  }
+  if (drawn_slot) {
+    mapSlot(*drawn_slot);
+  }
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ready->pbo);
+  glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  ready->ptr = nullptr;
+
+  // from the pbo, these return before the copy is done
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, stream_stride);
+  glBindTexture(GL_TEXTURE_2D, ready->textures[0]);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, stream_width, stream_height, GL_RED, GL_UNSIGNED_BYTE, (const void *)0);
+  assert(glGetError() == GL_NO_ERROR);
+
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, stream_stride/2);
+  glBindTexture(GL_TEXTURE_2D, ready->textures[1]);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, stream_width/2, stream_height/2, GL_RG, GL_UNSIGNED_BYTE, (const void *)(size_t)(stream_stride * stream_height));
+  assert(glGetError() == GL_NO_ERROR);
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+  ready->state = UploadSlot::DRAWN;
+  drawn_slot = ready;
+}
+#endif
+
 void CameraWidget::vipcConnected(VisionIpcClient *vipc_client) {
   makeCurrent();
   stream_width = vipc_client->buffers[0].width;
@@ -363,21 +461,36 @@ void CameraWidget::vipcConnected(VisionIpcClient *vipc_client) {
     assert(eglGetError() == EGL_SUCCESS);
   }
 #else
-  glBindTexture(GL_TEXTURE_2D, textures[0]);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, stream_width, stream_height, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
-  assert(glGetError() == GL_NO_ERROR);
-
-  glBindTexture(GL_TEXTURE_2D, textures[1]);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, stream_width/2, stream_height/2, 0, GL_RG, GL_UNSIGNED_BYTE, nullptr);
-  assert(glGetError() == GL_NO_ERROR);
+  // the vipc thread is waiting on this, so none of the slots are being written
+  std::lock_guard lk(frame_lock);
+  upload_size = stream_stride * stream_height * 3 / 2;
+  drawn_slot = nullptr;
+  for (auto &slot : upload_slots) {
+    glBindTexture(GL_TEXTURE_2D, slot.textures[0]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, stream_width, stream_height, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+    assert(glGetError() == GL_NO_ERROR);
+
+    glBindTexture(GL_TEXTURE_2D, slot.textures[1]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, stream_width/2, stream_height/2, 0, GL_RG, GL_UNSIGNED_BYTE, nullptr);
+    assert(glGetError() == GL_NO_ERROR);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+    if (slot.ptr) {
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, upload_size, nullptr, GL_STREAM_DRAW);
+    assert(glGetError() == GL_NO_ERROR);
+    mapSlot(slot);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
 #endif
 }
 
@@ -416,6 +529,7 @@ void CameraWidget::vipcThread() {
     }
 
     if (VisionBuf *buf = vipc_client->recv(&meta_main, 1000)) {
+#ifdef QCOM2
       {
         std::lock_guard lk(frame_lock);
         frames.push_back(std::make_pair(meta_main.frame_id, buf));
@@ -423,6 +537,9 @@ void CameraWidget::vipcThread() {
           frames.pop_front();
         }
       }
+#else
+      stageFrame(meta_main.frame_id, buf);
+#endif
       emit vipcThreadFrameReceived();
     } else {
       if (!isVisible()) {
@@ -434,6 +551,23 @@ void CameraWidget::vipcThread() {
 
 void CameraWidget::clearFrames() {
   std::lock_guard lk(frame_lock);
-  frames.clear();
   available_streams.clear();
+#ifdef QCOM2
+  frames.clear();
+#else
+  has_frame = false;
+  for (auto &slot : upload_slots) {
+    if (slot.state == UploadSlot::READY) {
+      slot.state = UploadSlot::FREE;
+    }
+  }
+#endif
+}
+
+bool CameraWidget::hasFrame() {
+#ifdef QCOM2
+  return !frames.empty();
+#else
+  return has_frame;
+#endif
 }
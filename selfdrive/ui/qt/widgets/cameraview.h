@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <deque>
 #include <map>
 #include <memory>
@@ -58,19 +59,41 @@ protected:
   void updateCalibration(const mat3 &calib);
   void vipcThread();
   void clearFrames();
+  bool hasFrame();  // call with frame_lock held
+#ifndef QCOM2
+  void stageFrame(uint32_t frame_id, const VisionBuf *buf);
+  void uploadNewestFrame();
+#endif
 
   int glWidth();
   int glHeight();
 
   bool zoomed_view;
   GLuint frame_vao, frame_vbo, frame_ibo;
-  GLuint textures[2];
   mat4 frame_mat = {};
   std::unique_ptr<QOpenGLShaderProgram> program;
   QColor bg = QColor("#000000");
 
 #ifdef QCOM2
   std::map<int, EGLImageKHR> egl_images;
+  std::deque<std::pair<uint32_t, VisionBuf*>> frames;  // guarded by frame_lock
+#else
+  // Frames on their way to the textures, guarded by frame_lock. The vipc thread copies each
+  // frame into a mapped pixel buffer, paintGL() starts the upload of the newest one into the
+  // textures of its slot and draws from them until the next frame is ready.
+  struct UploadSlot {
+    enum State { UNMAPPED, FREE, WRITING, READY, DRAWN };
+    State state = UNMAPPED;
+    uint32_t frame_id = 0;
+    GLuint pbo = 0;
+    GLuint textures[2] = {};
+    uint8_t *ptr = nullptr;  // the mapped pbo, while FREE, WRITING or READY
+  };
+  std::array<UploadSlot, 3> upload_slots;
+  UploadSlot *drawn_slot = nullptr;
+  bool has_frame = false;  // a frame was staged since the stream was (re)connected
+  size_t upload_size = 0;
+  void mapSlot(UploadSlot &slot);
 #endif
 
   std::string stream_name;
@@ -90,7 +113,6 @@ protected:
   mat3 intrinsic_matrix = FCAM_INTRINSIC_MATRIX;
 
   std::recursive_mutex frame_lock;
-  std::deque<std::pair<uint32_t, VisionBuf*>> frames;
   uint32_t draw_frame_id = 0;
   uint32_t prev_frame_id = 0;
 
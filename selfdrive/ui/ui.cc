@@ -8,6 +8,7 @@
 
 #include "common/transformations/orientation.hpp"
 #include "common/params.h"
+#include "common/ratekeeper.h"
 #include "common/swaglog.h"
 #include "common/util.h"
 #include "common/watchdog.h"
@@ -522,6 +523,10 @@ UIState::UIState(QObject *parent) : QObject(parent) {
 }
 
 void UIState::update() {
+  // the timer drives the loop, this only records how late it fires
+  static RateKeeper rk("ui", UI_FREQ);
+  rk.monitorTime();
+
   update_sockets(this);
   update_state(this);
   updateStatus();
@@ -1,10 +1,39 @@
 #include <QApplication>
 #include <QtWidgets>
 
+#include "common/timing.h"
 #include "selfdrive/ui/qt/qt_window.h"
 #include "selfdrive/ui/qt/util.h"
 #include "selfdrive/ui/qt/widgets/cameraview.h"
 
+// with PRINT_FRAME_TIMES set, prints how long paintGL() takes and the time between frames,
+// for checking the camera upload path
+class TimedCameraWidget : public CameraWidget {
+public:
+  TimedCameraWidget(std::string stream_name, VisionStreamType stream_type) : CameraWidget(stream_name, stream_type, false), name(stream_name + ":" + std::to_string(stream_type)) {}
+
+protected:
+  void paintGL() override {
+    const double start_t = millis_since_boot();
+    CameraWidget::paintGL();
+    const double end_t = millis_since_boot();
+
+    paint_ms += end_t - start_t;
+    count++;
+    if (count == 1) {
+      first_t = start_t;
+    } else if (end_t - first_t > 5000) {
+      printf("%s: paint %.2f ms, frame %.2f ms\n", name.c_str(), paint_ms / count, (start_t - first_t) / (count - 1));
+      count = 0;
+      paint_ms = 0;
+    }
+  }
+
+  std::string name;
+  int count = 0;
+  double first_t = 0, paint_ms = 0;
+};
+
 int main(int argc, char *argv[]) {
   initApp(argc, argv);
 
@@ -12,6 +41,12 @@ int main(int argc, char *argv[]) {
   QWidget w;
   setMainWindow(&w);
 
+  const bool print_frame_times = getenv("PRINT_FRAME_TIMES") != nullptr;
+  auto camera = [=](const std::string &stream_name, VisionStreamType stream_type) -> CameraWidget * {
+    if (print_frame_times) return new TimedCameraWidget(stream_name, stream_type);
+    return new CameraWidget(stream_name, stream_type, false);
+  };
+
   QVBoxLayout *layout = new QVBoxLayout(&w);
   layout->setMargin(0);
   layout->setSpacing(0);
@@ -19,15 +54,15 @@ int main(int argc, char *argv[]) {
   {
     QHBoxLayout *hlayout = new QHBoxLayout();
     layout->addLayout(hlayout);
-    hlayout->addWidget(new CameraWidget("navd", VISION_STREAM_MAP, false));
-    hlayout->addWidget(new CameraWidget("camerad", VISION_STREAM_ROAD, false));
+    hlayout->addWidget(camera("navd", VISION_STREAM_MAP));
+    hlayout->addWidget(camera("camerad", VISION_STREAM_ROAD));
   }
 
   {
     QHBoxLayout *hlayout = new QHBoxLayout();
     layout->addLayout(hlayout);
-    hlayout->addWidget(new CameraWidget("camerad", VISION_STREAM_DRIVER, false));
-    hlayout->addWidget(new CameraWidget("camerad", VISION_STREAM_WIDE_ROAD, false));
+    hlayout->addWidget(camera("camerad", VISION_STREAM_DRIVER));
+    hlayout->addWidget(camera("camerad", VISION_STREAM_WIDE_ROAD));
   }
 
   return a.exec();
@@ -47,4 +47,11 @@ namespace Path {
     }
     return "/tmp/comma_download_cache" + Path::openpilot_prefix() + "/";
   }
+
+  inline std::string cl_cache_root() {
+    if (const char *env = getenv("CL_CACHE_DIR")) {
+      return env;
+    }
+    return Hardware::PC() ? Path::comma_home() + "/cl_cache" : "/data/cl_cache";
+  }
 }  // namespace Path
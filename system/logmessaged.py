@@ -1,5 +1,9 @@
 #!/usr/bin/env python3
+import functools
+import json
+import struct
 import zmq
+from collections.abc import Iterator
 from typing import NoReturn
 
 import cereal.messaging as messaging
@@ -7,6 +11,41 @@ from openpilot.common.logging_extra import SwagLogFileFormatter
 from openpilot.system.hardware.hw import Paths
 from openpilot.common.swaglog import get_file_handler
 
+# binary records from C++ processes, see common/swaglog.h
+SWAGLOG_BATCH = 0
+SWAGLOG_TIMESTAMP = 1
+NO_FRAME_ID = 0xffffffff
+RECORD = struct.Struct("<BBHHIIIQd")
+
+
+@functools.lru_cache(maxsize=128)
+def parse_ctx(ctx: bytes) -> dict:
+  return json.loads(ctx)
+
+
+def decode_batch(dat: bytes) -> Iterator[tuple[int, str]]:
+  """Turns a batch of binary records into (level, JSON) like the ones Python processes send"""
+  ctx_len, = struct.unpack_from("<I", dat, 1)
+  ctx = parse_ctx(dat[5:5 + ctx_len])
+  pos = 5 + ctx_len
+  while pos + RECORD.size <= len(dat):
+    levelnum, record_type, filename_len, func_len, msg_len, lineno, frame_id, nanos, created = RECORD.unpack_from(dat, pos)
+    pos += RECORD.size
+    strings = dat[pos:pos + filename_len + func_len + msg_len]
+    pos += len(strings)
+    filename = strings[:filename_len].decode("utf-8", "replace")
+    funcname = strings[filename_len:filename_len + func_len].decode("utf-8", "replace")
+    msg: str | dict = strings[filename_len + func_len:].decode("utf-8", "replace")
+
+    if record_type == SWAGLOG_TIMESTAMP:
+      tspt = {"event": msg, "time": str(nanos)}
+      if frame_id != NO_FRAME_ID:
+        tspt["frame_id"] = str(frame_id)
+      msg = {"timestamp": tspt}
+
+    yield levelnum, json.dumps({"ctx": ctx, "levelnum": levelnum, "filename": filename, "lineno": lineno,
+                                "funcname": funcname, "created": created, "msg": msg})
+
 
 def main() -> NoReturn:
   log_handler = get_file_handler()
@@ -24,23 +63,27 @@ def main() -> NoReturn:
   try:
     while True:
       dat = b''.join(sock.recv_multipart())
-      level = dat[0]
-      record = dat[1:].decode("utf-8")
-      if level >= log_level:
-        log_handler.emit(record)
-
-      if len(record) > 2*1024*1024:
-        print("WARNING: log too big to publish", len(record))
-        print(print(record[:100]))
-        continue
-
-      # then we publish them
-      msg = messaging.new_message(None, valid=True, logMessage=record)
-      log_message_sock.send(msg.to_bytes())
-
-      if level >= 40:  # logging.ERROR
-        msg = messaging.new_message(None, valid=True, errorLogMessage=record)
-        error_log_message_sock.send(msg.to_bytes())
+      if dat[0] == SWAGLOG_BATCH:
+        records = decode_batch(dat)
+      else:
+        records = [(dat[0], dat[1:].decode("utf-8"))]
+
+      for level, record in records:
+        if level >= log_level:
+          log_handler.emit(record)
+
+        if len(record) > 2*1024*1024:
+          print("WARNING: log too big to publish", len(record))
+          print(print(record[:100]))
+          continue
+
+        # then we publish them
+        msg = messaging.new_message(None, valid=True, logMessage=record)
+        log_message_sock.send(msg.to_bytes())
+
+        if level >= 40:  # logging.ERROR
+          msg = messaging.new_message(None, valid=True, errorLogMessage=record)
+          error_log_message_sock.send(msg.to_bytes())
   finally:
     sock.close()
     ctx.term()
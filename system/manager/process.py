@@ -1,7 +1,6 @@
 import importlib
 import os
 import signal
-import struct
 import time
 import subprocess
 from collections.abc import Callable, ValuesView
@@ -16,8 +15,8 @@ import openpilot.system.sentry as sentry
 from openpilot.common.basedir import BASEDIR
 from openpilot.common.params import Params
 from openpilot.common.swaglog import cloudlog
+from openpilot.common.watchdog import WatchdogTable
 
-WATCHDOG_FN = "/dev/shm/wd_"
 ENABLE_WATCHDOG = os.getenv("NO_WATCHDOG") is None
 
 
@@ -74,6 +73,7 @@ class ManagerProcess(ABC):
   last_watchdog_time = 0
   watchdog_max_dt: int | None = None
   watchdog_seen = False
+  watchdog_max_gap = 0.
   shutting_down = False
 
   started_time = 0
@@ -90,17 +90,18 @@ class ManagerProcess(ABC):
     self.stop(sig=signal.SIGKILL)
     self.start()
 
-  def check_watchdog(self, started: bool, params: Params) -> None:
-    if self.watchdog_max_dt is None or self.proc is None:
+  def check_watchdog(self, started: bool, params: Params, watchdog: dict) -> None:
+    if self.proc is None:
+      return
+
+    # any process that kicks gets its loop jitter reported, not only the ones with a timeout
+    slot = watchdog.get(self.proc.pid)
+    self.watchdog_max_gap = float(slot['max_gap']) / 1e9 if slot is not None else 0.
+    if self.watchdog_max_dt is None:
       return
 
-    try:
-      fn = WATCHDOG_FN + str(self.proc.pid)
-      with open(fn, "rb") as f:
-        # TODO: why can't pylint find struct.unpack?
-        self.last_watchdog_time = struct.unpack('Q', f.read())[0]
-    except Exception:
-      pass
+    if slot is not None:
+      self.last_watchdog_time = int(slot['last_kick'])
 
     dt = time.monotonic() - self.last_watchdog_time / 1e9
     self.started_time = (self.started_time + 1) if started else 0
@@ -169,6 +170,7 @@ class ManagerProcess(ABC):
       state.shouldBeRunning = self.proc is not None and not self.shutting_down
       state.pid = self.proc.pid or 0
       state.exitCode = self.proc.exitcode or 0
+      state.watchdogMaxGap = self.watchdog_max_gap
     return state
 
 
@@ -278,11 +280,28 @@ class DaemonProcess(ManagerProcess):
     pass
 
 
+watchdog_table: WatchdogTable | None = None
+
+
+def read_watchdog() -> dict:
+  global watchdog_table
+  try:
+    if watchdog_table is None:
+      watchdog_table = WatchdogTable()
+    return watchdog_table.snapshot(reset_max_gap=True)
+  except OSError:
+    cloudlog.exception("failed to read watchdog table")
+    return {}
+
+
 def ensure_running(procs: ValuesView[ManagerProcess], started: bool, params=None, CP: car.CarParams=None,
                    not_run: list[str] | None=None) -> list[ManagerProcess]:
   if not_run is None:
     not_run = []
 
+  # one pass over the table for all processes
+  watchdog = read_watchdog()
+
   running = []
   for p in procs:
     if p.enabled and p.name not in not_run and p.should_run(started, params, CP):
@@ -290,7 +309,7 @@ def ensure_running(procs: ValuesView[ManagerProcess], started: bool, params=None
     else:
       p.stop(block=False)
 
-    p.check_watchdog(started, params)
+    p.check_watchdog(started, params, watchdog)
 
   for p in running:
     p.start()
@@ -10,13 +10,28 @@ ExitHandler do_exit;
 int main(int argc, char **argv) {
   setpriority(PRIO_PROCESS, 0, -15);
 
-  RateKeeper rk("proclogd", 0.5);
-  PubMaster publisher({"procLog"});
+  RateKeeper rk("proclogd", 10);
+  PubMaster publisher({"procLog", "procLogDelta", "rateKeeperStats"});
+  ThreadSampler sampler;
 
   while (!do_exit) {
-    MessageBuilder msg;
-    buildProcLogMessage(msg);
-    publisher.send("procLog", msg);
+    MessageBuilder delta_msg;
+    buildProcLogDeltaMessage(delta_msg, sampler);
+    publisher.send("procLogDelta", delta_msg);
+
+    // the full procLog at 0.5Hz
+    if (rk.frame() % 20 == 0) {
+      MessageBuilder msg;
+      buildProcLogMessage(msg);
+      publisher.send("procLog", msg);
+    }
+
+    // loop timing of every RateKeeper at 1Hz, this one included
+    if (rk.frame() % 10 == 0) {
+      MessageBuilder msg;
+      buildRateKeeperStatsMessage(msg);
+      publisher.send("rateKeeperStats", msg);
+    }
 
     rk.keepTime();
   }
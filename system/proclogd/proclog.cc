@@ -1,12 +1,20 @@
 #include "system/proclogd/proclog.h"
 
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
 
+#include <array>
 #include <cassert>
+#include <charconv>
+#include <cstring>
 #include <fstream>
 #include <iterator>
 #include <sstream>
+#include <unordered_set>
 
+#include "common/ratekeeper.h"
 #include "common/swaglog.h"
 #include "common/util.h"
 
@@ -62,51 +70,91 @@ enum StatPos {
   MAX_FIELD = 52,
 };
 
-// parse /proc/pid/stat
-std::optional<ProcStat> procStat(std::string stat) {
-  // To avoid being fooled by names containing a closing paren, scan backwards.
+using StatFields = std::array<std::string_view, StatPos::MAX_FIELD + 1>;
+
+// split /proc/pid/stat into fields without copying, returns how many there are.
+// To avoid being fooled by names containing a closing paren, scan backwards.
+static size_t splitStat(std::string_view stat, StatFields &fields) {
   auto open_paren = stat.find('(');
   auto close_paren = stat.rfind(')');
-  if (open_paren == std::string::npos || close_paren == std::string::npos || open_paren > close_paren) {
-    return std::nullopt;
-  }
-
-  std::string name = stat.substr(open_paren + 1, close_paren - open_paren - 1);
-  // replace space in name with _
-  std::replace(&stat[open_paren], &stat[close_paren], ' ', '_');
-  std::istringstream iss(stat);
-  std::vector<std::string> v{std::istream_iterator<std::string>(iss),
-                             std::istream_iterator<std::string>()};
-  try {
-    if (v.size() != StatPos::MAX_FIELD) {
-      throw std::invalid_argument("stat");
-    }
-    ProcStat p = {
-      .name = name,
-      .pid = stoi(v[StatPos::pid - 1]),
-      .state = v[StatPos::state - 1][0],
-      .ppid = stoi(v[StatPos::ppid - 1]),
-      .utime = stoul(v[StatPos::utime - 1]),
-      .stime = stoul(v[StatPos::stime - 1]),
-      .cutime = stol(v[StatPos::cutime - 1]),
-      .cstime = stol(v[StatPos::cstime - 1]),
-      .priority = stol(v[StatPos::priority - 1]),
-      .nice = stol(v[StatPos::nice - 1]),
-      .num_threads = stol(v[StatPos::num_threads - 1]),
-      .starttime = stoull(v[StatPos::starttime - 1]),
-      .vms = stoul(v[StatPos::vsize - 1]),
-      .rss = stol(v[StatPos::rss - 1]),
-      .processor = stoi(v[StatPos::processor - 1]),
-    };
+  if (open_paren == std::string_view::npos || close_paren == std::string_view::npos || open_paren > close_paren) {
+    return 0;
+  }
+
+  size_t n = 0;
+  fields[n++] = stat.substr(0, stat.find_last_not_of(' ', open_paren - 1) + 1);
+  fields[n++] = stat.substr(open_paren + 1, close_paren - open_paren - 1);
+  for (size_t pos = close_paren + 1; n < fields.size();) {
+    pos = stat.find_first_not_of(" \n", pos);
+    if (pos == std::string_view::npos) break;
+    size_t end = stat.find_first_of(" \n", pos);
+    fields[n++] = stat.substr(pos, end - pos);
+    pos = end;
+  }
+  return n;
+}
+
+template <class T>
+static bool parse(std::string_view field, T &val) {
+  auto [end, ec] = std::from_chars(field.data(), field.data() + field.size(), val);
+  return ec == std::errc() && end == field.data() + field.size();
+}
+
+// parse /proc/pid/stat
+std::optional<ProcStat> procStat(std::string_view stat) {
+  StatFields v;
+  ProcStat p = {};
+  if (splitStat(stat, v) == StatPos::MAX_FIELD &&
+      parse(v[StatPos::pid - 1], p.pid) &&
+      parse(v[StatPos::ppid - 1], p.ppid) &&
+      parse(v[StatPos::utime - 1], p.utime) &&
+      parse(v[StatPos::stime - 1], p.stime) &&
+      parse(v[StatPos::cutime - 1], p.cutime) &&
+      parse(v[StatPos::cstime - 1], p.cstime) &&
+      parse(v[StatPos::priority - 1], p.priority) &&
+      parse(v[StatPos::nice - 1], p.nice) &&
+      parse(v[StatPos::num_threads - 1], p.num_threads) &&
+      parse(v[StatPos::starttime - 1], p.starttime) &&
+      parse(v[StatPos::vsize - 1], p.vms) &&
+      parse(v[StatPos::rss - 1], p.rss) &&
+      parse(v[StatPos::processor - 1], p.processor)) {
+    p.name = v[1];
+    p.state = v[StatPos::state - 1][0];
     return p;
-  } catch (const std::invalid_argument &e) {
-    LOGE("failed to parse procStat (%s) :%s", e.what(), stat.c_str());
-  } catch (const std::out_of_range &e) {
-    LOGE("failed to parse procStat (%s) :%s", e.what(), stat.c_str());
   }
+  LOGE("failed to parse procStat :%.*s", (int)stat.size(), stat.data());
   return std::nullopt;
 }
 
+// parse /proc/pid/task/tid/stat, the fields of a thread that change
+bool threadStat(std::string_view stat, ThreadStat &t) {
+  StatFields v;
+  if (splitStat(stat, v) == StatPos::MAX_FIELD &&
+      parse(v[StatPos::pid - 1], t.tid) &&
+      parse(v[StatPos::utime - 1], t.utime) &&
+      parse(v[StatPos::stime - 1], t.stime) &&
+      parse(v[StatPos::processor - 1], t.processor)) {
+    t.state = v[StatPos::state - 1][0];
+    if (t.name != v[1]) t.name = v[1];
+    return true;
+  }
+  return false;
+}
+
+// parse /proc/pid/task/tid/schedstat: time on cpu, time waiting on a runqueue, timeslices
+bool schedStat(std::string_view schedstat, ThreadStat &t) {
+  uint64_t *vals[] = {&t.run_time, &t.wait_time, &t.timeslices};
+  size_t pos = 0;
+  for (uint64_t *val : vals) {
+    size_t end = schedstat.find_first_of(" \n", pos);
+    if (end == std::string_view::npos || !parse(schedstat.substr(pos, end - pos), *val)) {
+      return false;
+    }
+    pos = end + 1;
+  }
+  return true;
+}
+
 // return list of PIDs from /proc
 std::vector<int> pids() {
   std::vector<int> ids;
@@ -138,8 +186,9 @@ std::vector<std::string> cmdline(std::istream &stream) {
   return ret;
 }
 
+static std::unordered_map<pid_t, ProcCache> proc_cache;
+
 const ProcCache &getProcExtraInfo(int pid, const std::string &name) {
-  static std::unordered_map<pid_t, ProcCache> proc_cache;
   ProcCache &cache = proc_cache[pid];
   if (cache.pid != pid || cache.name != name) {
     cache.pid = pid;
@@ -152,8 +201,122 @@ const ProcCache &getProcExtraInfo(int pid, const std::string &name) {
   return cache;
 }
 
+// drop the processes that are not in pids anymore
+void evictProcExtraInfo(const std::vector<int> &pids) {
+  std::unordered_set<int> alive(pids.begin(), pids.end());
+  for (auto it = proc_cache.begin(); it != proc_cache.end();) {
+    it = alive.count(it->first) ? std::next(it) : proc_cache.erase(it);
+  }
+}
+
 }  // namespace Parser
 
+// read a file in /proc into buf, returns what was read
+static std::string_view readProcFile(int fd, char *buf, size_t size) {
+  ssize_t n = pread(fd, buf, size, 0);
+  return std::string_view(buf, std::max<ssize_t>(n, 0));
+}
+
+static std::string_view readProcFile(const char *path, char *buf, size_t size) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return {};
+  std::string_view ret = readProcFile(fd, buf, size);
+  close(fd);
+  return ret;
+}
+
+ThreadSampler::ThreadSampler(int rescan_interval) : rescan_interval_(std::max(rescan_interval, 1)) {
+  // two files per thread, there can be more than the default limit of 1024
+  struct rlimit lim;
+  if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+    lim.rlim_cur = lim.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &lim);
+  }
+}
+
+ThreadSampler::~ThreadSampler() {
+  for (auto &[tid, t] : threads_) {
+    close(t.stat_fd);
+    if (t.schedstat_fd >= 0) close(t.schedstat_fd);
+  }
+}
+
+// Reading the files of a thread that exited fails with ESRCH. schedstat is much cheaper for the kernel
+// to generate than stat, and the fields of stat only change if the thread ran, so stat is only read
+// when the run time changed. Without schedstat (it needs CONFIG_SCHED_INFO) stat is read every time.
+bool ThreadSampler::read(Thread &t, bool &changed) {
+  ThreadStat &s = t.stat;
+  if (t.schedstat_fd >= 0) {
+    const uint64_t run_time = s.run_time;
+    if (!Parser::schedStat(readProcFile(t.schedstat_fd, buf_, sizeof(buf_)), s)) return false;
+    changed = s.run_time != run_time;
+    if (!changed) return true;
+  }
+
+  const unsigned long utime = s.utime, stime = s.stime;
+  const char state = s.state;
+  const int processor = s.processor;
+  if (!Parser::threadStat(readProcFile(t.stat_fd, buf_, sizeof(buf_)), s)) return false;
+  changed = t.schedstat_fd >= 0 || s.utime != utime || s.stime != stime || s.state != state || s.processor != processor;
+  return true;
+}
+
+void ThreadSampler::rescan() {
+  char path[64];
+  for (int pid : Parser::pids()) {
+    snprintf(path, sizeof(path), "/proc/%d/task", pid);
+    DIR *d = opendir(path);
+    if (!d) continue;
+
+    while (struct dirent *de = readdir(d)) {
+      int tid = 0;
+      if (!Parser::parse(std::string_view(de->d_name), tid) || threads_.count(tid)) continue;
+
+      Thread t;
+      snprintf(path, sizeof(path), "/proc/%d/task/%d/stat", pid, tid);
+      t.stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+      if (t.stat_fd < 0) continue;
+      snprintf(path, sizeof(path), "/proc/%d/task/%d/schedstat", pid, tid);
+      t.schedstat_fd = open(path, O_RDONLY | O_CLOEXEC);
+      t.stat.pid = pid;
+
+      bool changed = true;
+      if (read(t, changed)) {
+        changed_.push_back(&(threads_[tid] = std::move(t)).stat);
+      } else {
+        close(t.stat_fd);
+        if (t.schedstat_fd >= 0) close(t.schedstat_fd);
+      }
+    }
+    closedir(d);
+  }
+}
+
+const std::vector<const ThreadStat *> &ThreadSampler::sample() {
+  changed_.clear();
+  exited_.clear();
+  for (auto it = threads_.begin(); it != threads_.end();) {
+    Thread &t = it->second;
+    bool changed = false;
+    if (!read(t, changed)) {
+      close(t.stat_fd);
+      if (t.schedstat_fd >= 0) close(t.schedstat_fd);
+      exited_.push_back(it->first);
+      it = threads_.erase(it);
+      continue;
+    }
+    if (changed) {
+      changed_.push_back(&t.stat);
+    }
+    ++it;
+  }
+
+  if (samples_++ % rescan_interval_ == 0) {
+    rescan();
+  }
+  return changed_;
+}
+
 const double jiffy = sysconf(_SC_CLK_TCK);
 const size_t page_size = sysconf(_SC_PAGE_SIZE);
 
@@ -193,12 +356,17 @@ void buildMemInfo(cereal::ProcLog::Builder &builder) {
 
 void buildProcs(cereal::ProcLog::Builder &builder) {
   auto pids = Parser::pids();
+  Parser::evictProcExtraInfo(pids);
+
   std::vector<ProcStat> proc_stats;
   proc_stats.reserve(pids.size());
+  char path[64], buf[4096];
   for (int pid : pids) {
-    std::string path = "/proc/" + std::to_string(pid) + "/stat";
-    if (auto stat = Parser::procStat(util::read_file(path))) {
-      proc_stats.push_back(*stat);
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    std::string_view stat = readProcFile(path, buf, sizeof(buf));
+    if (stat.empty()) continue;
+    if (auto p = Parser::procStat(stat)) {
+      proc_stats.push_back(*p);
     }
   }
 
@@ -237,3 +405,56 @@ void buildProcLogMessage(MessageBuilder &msg) {
   buildCPUTimes(procLog);
   buildMemInfo(procLog);
 }
+
+void buildProcLogDeltaMessage(MessageBuilder &msg, ThreadSampler &sampler) {
+  auto delta = msg.initEvent().initProcLogDelta();
+  const auto &changed = sampler.sample();
+
+  auto threads = delta.initThreads(changed.size());
+  for (size_t i = 0; i < changed.size(); i++) {
+    auto l = threads[i];
+    const ThreadStat &r = *changed[i];
+    l.setTid(r.tid);
+    l.setPid(r.pid);
+    l.setName(r.name);
+    l.setState(r.state);
+    l.setProcessor(r.processor);
+    l.setCpuUser(r.utime / jiffy);
+    l.setCpuSystem(r.stime / jiffy);
+    l.setRunTime(r.run_time);
+    l.setWaitTime(r.wait_time);
+    l.setTimeslices(r.timeslices);
+  }
+
+  const auto &exited = sampler.exited();
+  auto lexited = delta.initExited(exited.size());
+  for (size_t i = 0; i < exited.size(); i++) {
+    lexited.set(i, exited[i]);
+  }
+}
+
+void buildRateKeeperStatsMessage(MessageBuilder &msg) {
+  std::vector<const RateKeeperStats *> active;
+  if (const RateKeeperStats *page = ratekeeper_stats()) {
+    for (int i = 0; i < RATEKEEPER_STATS_SLOTS; ++i) {
+      if (ratekeeper_stats_active(page[i])) active.push_back(&page[i]);
+    }
+  }
+
+  auto rate_keepers = msg.initEvent().initRateKeeperStats().initRateKeepers(active.size());
+  for (size_t i = 0; i < active.size(); ++i) {
+    auto l = rate_keepers[i];
+    const RateKeeperStats &s = *active[i];
+    l.setName(std::string(s.name, strnlen(s.name, sizeof(s.name))));
+    l.setPid(s.pid);
+    l.setRate(s.rate);
+    l.setFrames(s.frames);
+    l.setLagged(s.lagged);
+    auto lateness = l.initLateness(RATEKEEPER_HIST_BUCKETS);
+    auto work = l.initWorkTime(RATEKEEPER_HIST_BUCKETS);
+    for (int j = 0; j < RATEKEEPER_HIST_BUCKETS; ++j) {
+      lateness.set(j, s.lateness[j]);
+      work.set(j, s.work[j]);
+    }
+  }
+}
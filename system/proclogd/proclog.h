@@ -1,5 +1,6 @@
 #include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -26,15 +27,57 @@ struct ProcStat {
   std::string name;
 };
 
+struct ThreadStat {
+  int tid, pid, processor;
+  char state;
+  unsigned long utime, stime;
+  uint64_t run_time, wait_time, timeslices;
+  std::string name;
+};
+
 namespace Parser {
 
 std::vector<int> pids();
-std::optional<ProcStat> procStat(std::string stat);
+std::optional<ProcStat> procStat(std::string_view stat);
+bool threadStat(std::string_view stat, ThreadStat &t);
+bool schedStat(std::string_view schedstat, ThreadStat &t);
 std::vector<std::string> cmdline(std::istream &stream);
 std::vector<CPUTime> cpuTimes(std::istream &stream);
 std::unordered_map<std::string, uint64_t> memInfo(std::istream &stream);
 const ProcCache &getProcExtraInfo(int pid, const std::string &name);
+void evictProcExtraInfo(const std::vector<int> &pids);
 
 };  // namespace Parser
 
+// Samples every thread at a high rate. /proc/<pid>/task/<tid>/stat and schedstat stay open and
+// are read with pread into one buffer, only new threads are looked up in /proc, every
+// rescan_interval samples. Threads that exited are dropped when their files fail to read.
+class ThreadSampler {
+public:
+  ThreadSampler(int rescan_interval = 10);
+  ~ThreadSampler();
+
+  // returns the threads that are new or changed since the previous sample
+  const std::vector<const ThreadStat *> &sample();
+  const std::vector<int> &exited() const { return exited_; }
+  size_t size() const { return threads_.size(); }
+
+private:
+  struct Thread {
+    ThreadStat stat = {};
+    int stat_fd = -1, schedstat_fd = -1;
+  };
+  bool read(Thread &t, bool &changed);
+  void rescan();
+
+  std::unordered_map<int, Thread> threads_;
+  std::vector<const ThreadStat *> changed_;
+  std::vector<int> exited_;
+  int rescan_interval_;
+  uint64_t samples_ = 0;
+  char buf_[4096];
+};
+
 void buildProcLogMessage(MessageBuilder &msg);
+void buildProcLogDeltaMessage(MessageBuilder &msg, ThreadSampler &sampler);
+void buildRateKeeperStatsMessage(MessageBuilder &msg);
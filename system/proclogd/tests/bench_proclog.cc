@@ -0,0 +1,51 @@
+// CPU time per sample of the full procLog against the per-thread ThreadSampler,
+// with a rescan of /proc for new threads on every sample and on every 10th.
+// usage: ./bench_proclog [samples]
+
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+#include "common/util.h"
+#include "system/proclogd/proclog.h"
+
+static double cpu_time() {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// returns the average cpu time of f in us, samples are 10ms apart
+static double run(int samples, const std::function<void()> &f) {
+  double total = 0;
+  for (int i = 0; i < samples; ++i) {
+    const double begin = cpu_time();
+    f();
+    total += cpu_time() - begin;
+    util::sleep_for(10);
+  }
+  return total / samples * 1e6;
+}
+
+int main(int argc, char *argv[]) {
+  const int samples = argc > 1 ? atoi(argv[1]) : 200;
+
+  printf("%-34s %12.1f us\n", "procLog", run(samples, [] {
+    MessageBuilder msg;
+    buildProcLogMessage(msg);
+  }));
+
+  for (int rescan_interval : {1, 10}) {
+    ThreadSampler sampler(rescan_interval);
+    size_t changed = 0;
+    const double us = run(samples, [&] {
+      MessageBuilder msg;
+      buildProcLogDeltaMessage(msg, sampler);
+      changed += msg.getRoot<cereal::Event>().getProcLogDelta().getThreads().size();
+    });
+    const std::string name = "procLogDelta, rescan every " + std::to_string(rescan_interval);
+    printf("%-34s %12.1f us, %zu threads, %zu changed per sample\n", name.c_str(), us, sampler.size(), changed / samples);
+  }
+  return 0;
+}
@@ -1,5 +1,13 @@
 #define CATCH_CONFIG_MAIN
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include <atomic>
+#include <csignal>
+#include <thread>
+
 #include "catch2/catch.hpp"
+#include "common/ratekeeper.h"
 #include "common/util.h"
 #include "system/proclogd/proclog.h"
 
@@ -46,6 +54,29 @@ TEST_CASE("Parser::procStat") {
   }
 }
 
+TEST_CASE("Parser::threadStat") {
+  const std::string stat_str =
+      "33013 (code )) R 32978 6620 6620 0 -1 4194368 2042377 0 144 0 24510 11627 0 "
+      "0 20 0 39 0 53077 830029824 62214 18446744073709551615 94257242783744 94257366235808 "
+      "140735738643248 0 0 0 0 4098 1073808632 0 0 0 17 3 0 0 2 0 0 94257370858656 94257371248232 "
+      "94257404952576 140735738648768 140735738648823 140735738648823 140735738650595 0\n";
+  ThreadStat t = {};
+  REQUIRE(Parser::threadStat(stat_str, t));
+  REQUIRE(t.tid == 33013);
+  REQUIRE(t.name == "code )");
+  REQUIRE(t.state == 'R');
+  REQUIRE(t.utime == 24510);
+  REQUIRE(t.stime == 11627);
+  REQUIRE(t.processor == 3);
+  REQUIRE(!Parser::threadStat("33013 (code) R 1 2 3", t));
+
+  REQUIRE(Parser::schedStat("1204321 5678 12\n", t));
+  REQUIRE(t.run_time == 1204321);
+  REQUIRE(t.wait_time == 5678);
+  REQUIRE(t.timeslices == 12);
+  REQUIRE(!Parser::schedStat("1204321 5678", t));
+}
+
 TEST_CASE("Parser::cpuTimes") {
   SECTION("from string") {
     std::string stat =
@@ -109,6 +140,44 @@ TEST_CASE("Parser::cmdline") {
   test_cmdline(std::string("a\0b\0c\0\0\0", 9), {"a", "b", "c"});
 }
 
+TEST_CASE("ThreadSampler") {
+  ThreadSampler sampler(1);
+  const int tid = syscall(SYS_gettid);
+  auto find = [&](const std::vector<const ThreadStat *> &threads, int id) {
+    auto it = std::find_if(threads.begin(), threads.end(), [=](auto t) { return t->tid == id; });
+    return it != threads.end() ? *it : nullptr;
+  };
+
+  // everything is new in the first sample
+  const ThreadStat *self = find(sampler.sample(), tid);
+  REQUIRE(self);
+  REQUIRE(self->pid == ::getpid());
+  REQUIRE(self->name == "test_proclog");
+  REQUIRE(sampler.size() > 1);
+
+  std::atomic<int> worker_tid = 0;
+  std::atomic<bool> stop = false;
+  std::thread worker([&] {
+    worker_tid = syscall(SYS_gettid);
+    while (!stop) {}
+  });
+  while (worker_tid == 0) {}
+  REQUIRE(find(sampler.sample(), worker_tid));
+
+  // a busy thread shows up every time, an idle one only when something changed
+  util::sleep_for(50);
+  const ThreadStat *busy = find(sampler.sample(), worker_tid);
+  REQUIRE(busy);
+  REQUIRE(busy->pid == ::getpid());
+  REQUIRE(busy->run_time > 0);
+
+  stop = true;
+  worker.join();
+  sampler.sample();
+  REQUIRE(std::find(sampler.exited().begin(), sampler.exited().end(), worker_tid) != sampler.exited().end());
+  REQUIRE(!find(sampler.sample(), worker_tid));
+}
+
 TEST_CASE("buildProcLoggerMessage") {
   MessageBuilder msg;
   buildProcLogMessage(msg);
@@ -140,3 +209,65 @@ TEST_CASE("buildProcLoggerMessage") {
     }
   }
 }
+
+TEST_CASE("buildProcLogDeltaMessage") {
+  ThreadSampler sampler;
+  MessageBuilder msg;
+  buildProcLogDeltaMessage(msg, sampler);
+
+  kj::Array<capnp::word> buf = capnp::messageToFlatArray(msg);
+  capnp::FlatArrayMessageReader reader(buf);
+  auto threads = reader.getRoot<cereal::Event>().getProcLogDelta().getThreads();
+  REQUIRE(threads.size() == sampler.size());
+  auto self = std::find_if(threads.begin(), threads.end(), [](auto t) { return t.getTid() == ::getpid(); });
+  REQUIRE(self != threads.end());
+  REQUIRE((*self).getName() == "test_proclog");
+  REQUIRE((*self).getPid() == ::getpid());
+}
+
+TEST_CASE("buildRateKeeperStatsMessage") {
+  RateKeeper rk("test_proclog_rk", 1000);
+  for (int i = 0; i < 3; ++i) rk.keepTime();
+
+  MessageBuilder msg;
+  buildRateKeeperStatsMessage(msg);
+
+  kj::Array<capnp::word> buf = capnp::messageToFlatArray(msg);
+  capnp::FlatArrayMessageReader reader(buf);
+  auto rate_keepers = reader.getRoot<cereal::Event>().getRateKeeperStats().getRateKeepers();
+  auto self = std::find_if(rate_keepers.begin(), rate_keepers.end(), [](auto r) {
+    return r.getPid() == ::getpid() && r.getName() == "test_proclog_rk";
+  });
+  REQUIRE(self != rate_keepers.end());
+  REQUIRE((*self).getRate() == 1000);
+  REQUIRE((*self).getFrames() == 3);
+  REQUIRE((*self).getLateness().size() == RATEKEEPER_HIST_BUCKETS);
+  REQUIRE((*self).getWorkTime().size() == RATEKEEPER_HIST_BUCKETS);
+  uint32_t frames = 0;
+  for (auto n : (*self).getLateness()) frames += n;
+  REQUIRE(frames == 3);
+}
+
+TEST_CASE("buildRateKeeperStatsMessage skips killed processes") {
+  pid_t pid = fork();
+  if (pid == 0) {
+    RateKeeper rk("test_proclog_killed", 1000);
+    rk.keepTime();
+    raise(SIGKILL);
+  }
+  // reaped, a zombie still exists for kill(pid, 0)
+  int status = 0;
+  REQUIRE(waitpid(pid, &status, 0) == pid);
+  REQUIRE((WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL));
+  const RateKeeperStats *page = ratekeeper_stats();
+  REQUIRE(std::any_of(page, page + RATEKEEPER_STATS_SLOTS, [=](auto &s) { return s.pid == pid; }));
+
+  MessageBuilder msg;
+  buildRateKeeperStatsMessage(msg);
+
+  kj::Array<capnp::word> buf = capnp::messageToFlatArray(msg);
+  capnp::FlatArrayMessageReader reader(buf);
+  for (auto r : reader.getRoot<cereal::Event>().getRateKeeperStats().getRateKeepers()) {
+    REQUIRE(r.getPid() != pid);
+  }
+}
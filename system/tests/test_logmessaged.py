@@ -1,11 +1,14 @@
 import glob
+import json
 import os
+import struct
 import time
 
 import cereal.messaging as messaging
 from openpilot.system.manager.process_config import managed_processes
 from openpilot.system.hardware.hw import Paths
 from openpilot.common.swaglog import cloudlog, ipchandler
+from openpilot.system.logmessaged import RECORD, SWAGLOG_BATCH
 
 
 class TestLogmessaged:
@@ -40,6 +43,23 @@ class TestLogmessaged:
     assert len(m) == len(msgs)
     assert len(self._get_log_files()) >= 1
 
+  def test_binary_batch(self):
+    ctx = json.dumps({"daemon": "testy"}).encode()
+    batch = bytes([SWAGLOG_BATCH]) + struct.pack("<I", len(ctx)) + ctx
+    for i in range(10):
+      msg = f"abc {i}".encode()
+      batch += RECORD.pack(40, 0, len(b"test.cc"), len(b"main"), len(msg), i, 0xffffffff, 0, time.time()) + b"test.cc" + b"main" + msg
+    ipchandler.sock.send(batch)
+    time.sleep(3)
+
+    msgs = messaging.drain_sock(self.sock)
+    assert len(msgs) == 10
+    for i, m in enumerate(msgs):
+      record = json.loads(m.logMessage)
+      assert record["ctx"]["daemon"] == "testy"
+      assert (record["levelnum"], record["filename"], record["funcname"]) == (40, "test.cc", "main")
+      assert (record["lineno"], record["msg"]) == (i, f"abc {i}")
+
   def test_big_log(self):
     n = 10
     msg = "a"*3*1024*1024
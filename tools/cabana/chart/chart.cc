@@ -1,6 +1,7 @@
 #include "tools/cabana/chart/chart.h"
 
 #include <algorithm>
+#include <cmath>
 #include <limits>
 
 #include <QActionGroup>
@@ -219,6 +220,10 @@ void ChartView::updatePlotArea(int left_pos, bool force) {
     x_label_size += QSizeF{5, 5};
     chart()->setPlotArea(rect().adjusted(align_to + left, adjust_top + top, -x_label_size.width() / 2 - right, -x_label_size.height() - bottom));
     chart()->layout()->invalidate();
+    // the number of pixel columns changed
+    for (auto &s : sigs) {
+      updateSeriesData(s);
+    }
     resetChartCache();
   }
 }
@@ -249,6 +254,9 @@ void ChartView::updatePlot(double cur, double min, double max) {
   cur_sec = cur;
   if (min != axis_x->min() || max != axis_x->max()) {
     axis_x->setRange(min, max);
+    for (auto &s : sigs) {
+      updateSeriesData(s);
+    }
     updateAxisY();
     updateSeriesPoints();
     // update tooltip
@@ -283,20 +291,14 @@ void ChartView::updateSeriesPoints() {
   }
 }
 
-void ChartView::appendCanEvents(const cabana::Signal *sig, const std::vector<const CanEvent *> &events,
-                                std::vector<QPointF> &vals, std::vector<QPointF> &step_vals) {
-  vals.reserve(vals.size() + events.capacity());
-  step_vals.reserve(step_vals.size() + events.capacity() * 2);
+void ChartView::appendSignalValues(const SignalValues &v, size_t first, std::vector<QPointF> &vals) {
+  vals.reserve(vals.size() + v.values.size() - first);
 
-  double value = 0;
   const uint64_t begin_mono_time = can->routeStartTime() * 1e9;
-  for (const CanEvent *e : events) {
-    if (sig->getValue(e->dat, e->size, &value)) {
-      const double ts = (e->mono_time - std::min(e->mono_time, begin_mono_time)) / 1e9;
-      vals.emplace_back(ts, value);
-      if (!step_vals.empty())
-        step_vals.emplace_back(ts, step_vals.back().y());
-      step_vals.emplace_back(ts, value);
+  for (size_t i = first; i < v.values.size(); ++i) {
+    if (!std::isnan(v.values[i])) {
+      const uint64_t mono_time = v.mono_times[i];
+      vals.emplace_back((mono_time - std::min(mono_time, begin_mono_time)) / 1e9, v.values[i]);
     }
   }
 }
@@ -306,27 +308,26 @@ void ChartView::updateSeries(const cabana::Signal *sig, const MessageEventsMap *
     if (!sig || s.sig == sig) {
       if (!msg_new_events) {
         s.vals.clear();
-        s.step_vals.clear();
       }
       auto events = msg_new_events ? msg_new_events : &can->eventsMap();
       auto it = events->find(s.msg_id);
       if (it == events->end() || it->second.empty()) continue;
 
-      if (s.vals.empty() || (it->second.back()->mono_time / 1e9 - can->routeStartTime()) > s.vals.back().x()) {
-        appendCanEvents(s.sig, it->second, s.vals, s.step_vals);
-      } else {
-        std::vector<QPointF> vals, step_vals;
-        appendCanEvents(s.sig, it->second, vals, step_vals);
-        s.vals.insert(std::lower_bound(s.vals.begin(), s.vals.end(), vals.front().x(), xLessThan),
-                      vals.begin(), vals.end());
-        s.step_vals.insert(std::lower_bound(s.step_vals.begin(), s.step_vals.end(), step_vals.front().x(), xLessThan),
-                           step_vals.begin(), step_vals.end());
+      // the stream has already decoded the new events. if they were appended only the tail is new,
+      // otherwise rebuild from the decoded values
+      auto values = can->signalValues(s.msg_id, s.sig);
+      const auto &times = values->mono_times;
+      const size_t num_new = it->second.size();
+      const bool appended = msg_new_events && times.size() >= num_new && times[times.size() - num_new] == it->second.front()->mono_time;
+      if (!appended) {
+        s.vals.clear();
       }
+      appendSignalValues(*values, appended ? times.size() - num_new : 0, s.vals);
 
       if (!can->liveStreaming()) {
         s.segment_tree.build(s.vals);
       }
-      s.series->replace(QVector<QPointF>::fromStdVector(series_type == SeriesType::StepLine ? s.step_vals : s.vals));
+      updateSeriesData(s);
     }
   }
   updateAxisY();
@@ -334,6 +335,27 @@ void ChartView::updateSeries(const cabana::Signal *sig, const MessageEventsMap *
   QMetaObject::invokeMethod(this, &ChartView::resetChartCache, Qt::QueuedConnection);
 }
 
+// Feed Qt at most two points (the min and the max) per pixel column of the visible range.
+// The full resolution data stays in vals, so zooming in refines the series.
+void ChartView::updateSeriesData(SigItem &s) {
+  QVector<QPointF> points;
+  const int columns = std::max<int>(chart()->plotArea().width(), CHART_MIN_WIDTH);
+  // the pyramid is only built for replays, live streams are still growing
+  const bool use_tree = !can->liveStreaming() && s.segment_tree.count() == (int)s.vals.size();
+  decimateSeries(s.vals, use_tree ? &s.segment_tree : nullptr, axis_x->min(), axis_x->max(), columns, points);
+
+  if (series_type == SeriesType::StepLine) {
+    QVector<QPointF> steps;
+    steps.reserve(points.size() * 2);
+    for (const auto &pt : points) {
+      if (!steps.empty()) steps.push_back({pt.x(), steps.back().y()});
+      steps.push_back(pt);
+    }
+    points.swap(steps);
+  }
+  s.series->replace(points);
+}
+
 // auto zoom on yaxis
 void ChartView::updateAxisY() {
   if (sigs.empty()) return;
@@ -360,7 +382,7 @@ void ChartView::updateAxisY() {
         if (it->y() > s.max) s.max = it->y();
       }
     } else {
-      std::tie(s.min, s.max) = s.segment_tree.minmax(std::distance(s.vals.cbegin(), first), std::distance(s.vals.cbegin(), last));
+      std::tie(s.min, s.max) = s.segment_tree.minmax(s.vals, std::distance(s.vals.cbegin(), first), std::distance(s.vals.cbegin(), last));
     }
     min = std::min(min, s.min);
     max = std::max(max, s.max);
@@ -848,7 +870,7 @@ void ChartView::setSeriesType(SeriesType type) {
     }
     for (auto &s : sigs) {
       s.series = createSeries(series_type, s.sig->color);
-      s.series->replace(QVector<QPointF>::fromStdVector(series_type == SeriesType::StepLine ? s.step_vals : s.vals));
+      updateSeriesData(s);
     }
     updateSeriesPoints();
     updateTitle();
@@ -45,7 +45,6 @@ public:
     const cabana::Signal *sig = nullptr;
     QXYSeries *series = nullptr;
     std::vector<QPointF> vals;
-    std::vector<QPointF> step_vals;
     QPointF track_pt{};
     SegmentTree segment_tree;
     double min = 0;
@@ -64,8 +63,8 @@ private slots:
   void signalRemoved(const cabana::Signal *sig) { removeIf([=](auto &s) { return s.sig == sig; }); }
 
 private:
-  void appendCanEvents(const cabana::Signal *sig, const std::vector<const CanEvent *> &events,
-                       std::vector<QPointF> &vals, std::vector<QPointF> &step_vals);
+  void appendSignalValues(const SignalValues &v, size_t first, std::vector<QPointF> &vals);
+  void updateSeriesData(SigItem &s);
   void createToolButtons();
   void addSeries(QXYSeries *series);
   void contextMenuEvent(QContextMenuEvent *event) override;
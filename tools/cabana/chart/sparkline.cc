@@ -1,6 +1,7 @@
 #include "tools/cabana/chart/sparkline.h"
 
 #include <algorithm>
+#include <cmath>
 #include <limits>
 #include <QPainter>
 
@@ -19,10 +20,12 @@ void Sparkline::update(const MessageId &msg_id, const cabana::Signal *sig, doubl
   }
 
   points.clear();
-  double value = 0;
-  for (auto it = first; it != last; ++it) {
-    if (sig->getValue((*it)->dat, (*it)->size, &value)) {
-      points.emplace_back(((*it)->mono_time - (*first)->mono_time) / 1e9, value);
+  auto sig_values = can->signalValues(msg_id, sig);
+  const size_t first_idx = std::distance(msgs.cbegin(), first);
+  const size_t last_idx = std::distance(msgs.cbegin(), last);
+  for (size_t i = first_idx; i < last_idx; ++i) {
+    if (double value = sig_values->values[i]; !std::isnan(value)) {
+      points.emplace_back((sig_values->mono_times[i] - (*first)->mono_time) / 1e9, value);
     }
   }
 
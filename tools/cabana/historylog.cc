@@ -1,8 +1,10 @@
 #include "tools/cabana/historylog.h"
 
+#include <cmath>
 #include <functional>
 
 #include <QFileDialog>
+#include <QMessageBox>
 #include <QPainter>
 #include <QVBoxLayout>
 
@@ -100,13 +102,19 @@ void HistoryLogModel::fetchData(std::deque<Message>::iterator insert_pos, uint64
     return ts > e->mono_time;
   });
 
+  std::vector<std::shared_ptr<const SignalValues>> sig_values;
+  for (auto sig : sigs) {
+    sig_values.push_back(can->signalValues(msg_id, sig));
+  }
+
   std::vector<HistoryLogModel::Message> msgs;
   std::vector<double> values(sigs.size());
   msgs.reserve(batch_size);
   for (; first != events.rend() && (*first)->mono_time > min_time; ++first) {
     const CanEvent *e = *first;
+    const size_t idx = std::distance(first, events.rend()) - 1;
     for (int i = 0; i < sigs.size(); ++i) {
-      sigs[i]->getValue(e->dat, e->size, &values[i]);
+      if (double v = sig_values[i]->values[idx]; !std::isnan(v)) values[i] = v;
     }
     if (!filter_cmp || filter_cmp(values[filter_sig_idx], filter_value)) {
        msgs.emplace_back(Message{e->mono_time, values, {e->dat, e->dat + e->size}});
@@ -178,7 +186,7 @@ LogsWidget::LogsWidget(QWidget *parent) : QFrame(parent) {
   filter_layout->addWidget(value_edit = new QLineEdit(this));
   h->addWidget(filters_widget);
   h->addStretch(0);
-  export_btn = new ToolButton("filetype-csv", tr("Export to CSV file..."));
+  export_btn = new ToolButton("filetype-csv", tr("Export to CSV or Arrow file..."));
   h->addWidget(export_btn, 0, Qt::AlignRight);
 
   display_type_cb->addItems({"Signal", "Hex"});
@@ -205,7 +213,7 @@ LogsWidget::LogsWidget(QWidget *parent) : QFrame(parent) {
   QObject::connect(signals_cb, SIGNAL(activated(int)), this, SLOT(filterChanged()));
   QObject::connect(comp_box, SIGNAL(activated(int)), this, SLOT(filterChanged()));
   QObject::connect(value_edit, &QLineEdit::textEdited, this, &LogsWidget::filterChanged);
-  QObject::connect(export_btn, &QToolButton::clicked, this, &LogsWidget::exportToCSV);
+  QObject::connect(export_btn, &QToolButton::clicked, this, &LogsWidget::exportToFile);
   QObject::connect(can, &AbstractStream::seekedTo, model, &HistoryLogModel::reset);
   QObject::connect(dbc(), &DBCManager::DBCFileChanged, model, &HistoryLogModel::reset);
   QObject::connect(UndoStack::instance(), &QUndoStack::indexChanged, model, &HistoryLogModel::reset);
@@ -237,12 +245,22 @@ void LogsWidget::filterChanged() {
   model->setFilter(signals_cb->currentIndex(), value_edit->text(), cmp);
 }
 
-void LogsWidget::exportToCSV() {
+void LogsWidget::exportToFile() {
   QString dir = QString("%1/%2_%3.csv").arg(settings.last_dir).arg(can->routeName()).arg(msgName(model->msg_id));
-  QString fn = QFileDialog::getSaveFileName(this, QString("Export %1 to CSV file").arg(msgName(model->msg_id)),
-                                            dir, tr("csv (*.csv)"));
-  if (!fn.isEmpty()) {
-    model->isHexMode() ? utils::exportToCSV(fn, model->msg_id)
-                       : utils::exportSignalsToCSV(fn, model->msg_id);
+  QString filter;
+  QString fn = QFileDialog::getSaveFileName(this, QString("Export %1 to file").arg(msgName(model->msg_id)),
+                                            dir, utils::EXPORT_FILE_FILTERS, &filter);
+  if (fn.isEmpty()) return;
+
+  bool ok;
+  if (utils::isArrowFile(fn, filter)) {
+    ok = model->isHexMode() ? utils::exportToArrow(fn, model->msg_id)
+                            : utils::exportSignalsToArrow(fn, model->msg_id);
+  } else {
+    ok = model->isHexMode() ? utils::exportToCSV(fn, model->msg_id)
+                            : utils::exportSignalsToCSV(fn, model->msg_id);
+  }
+  if (!ok) {
+    QMessageBox::warning(this, tr("Export failed"), tr("Failed to write %1").arg(fn));
   }
 }
@@ -67,7 +67,7 @@ public:
 
 private slots:
   void filterChanged();
-  void exportToCSV();
+  void exportToFile();
   void modelReset();
 
 private:
@@ -87,9 +87,9 @@ void MainWindow::createActions() {
   QMenu *file_menu = menuBar()->addMenu(tr("&File"));
   file_menu->addAction(tr("Open Stream..."), this, &MainWindow::openStream);
   close_stream_act = file_menu->addAction(tr("Close stream"), this, &MainWindow::closeStream);
-  export_to_csv_act = file_menu->addAction(tr("Export to CSV..."), this, &MainWindow::exportToCSV);
+  export_act = file_menu->addAction(tr("Export..."), this, &MainWindow::exportToFile);
   close_stream_act->setEnabled(false);
-  export_to_csv_act->setEnabled(false);
+  export_act->setEnabled(false);
   file_menu->addSeparator();
 
   file_menu->addAction(tr("New DBC File"), [this]() { newFile(); }, QKeySequence::New);
@@ -277,11 +277,14 @@ void MainWindow::closeStream() {
   statusBar()->showMessage(tr("stream closed"));
 }
 
-void MainWindow::exportToCSV() {
+void MainWindow::exportToFile() {
   QString dir = QString("%1/%2.csv").arg(settings.last_dir).arg(can->routeName());
-  QString fn = QFileDialog::getSaveFileName(this, "Export stream to CSV file", dir, tr("csv (*.csv)"));
+  QString filter;
+  QString fn = QFileDialog::getSaveFileName(this, "Export stream to file", dir, utils::EXPORT_FILE_FILTERS, &filter);
   if (!fn.isEmpty()) {
-    utils::exportToCSV(fn);
+    if (!(utils::isArrowFile(fn, filter) ? utils::exportToArrow(fn) : utils::exportToCSV(fn))) {
+      QMessageBox::warning(this, tr("Export failed"), tr("Failed to write %1").arg(fn));
+    }
   }
 }
 
@@ -359,7 +362,7 @@ void MainWindow::changingStream() {
 void MainWindow::streamStarted() {
   bool has_stream = dynamic_cast<DummyStream *>(can) == nullptr;
   close_stream_act->setEnabled(has_stream);
-  export_to_csv_act->setEnabled(has_stream);
+  export_act->setEnabled(has_stream);
   tools_menu->setEnabled(has_stream);
   createDockWidgets();
 
@@ -56,6 +56,8 @@ MessagesWidget::MessagesWidget(QWidget *parent) : menu(new QMenu(this)), QWidget
   QObject::connect(header, &MessageViewHeader::customContextMenuRequested, this, &MessagesWidget::headerContextMenuEvent);
   QObject::connect(view->horizontalScrollBar(), &QScrollBar::valueChanged, header, &MessageViewHeader::updateHeaderPositions);
   QObject::connect(can, &AbstractStream::msgsReceived, model, &MessageListModel::msgsReceived);
+  QObject::connect(can, &AbstractStream::msgsReceived, this, &MessagesWidget::updateVisibleMessages);
+  QObject::connect(view->verticalScrollBar(), &QScrollBar::valueChanged, this, &MessagesWidget::updateVisibleMessages);
   QObject::connect(dbc(), &DBCManager::DBCFileChanged, model, &MessageListModel::dbcModified);
   QObject::connect(UndoStack::instance(), &QUndoStack::indexChanged, model, &MessageListModel::dbcModified);
   QObject::connect(model, &MessageListModel::modelReset, [this]() {
@@ -70,6 +72,7 @@ MessagesWidget::MessagesWidget(QWidget *parent) : menu(new QMenu(this)), QWidget
       const auto &id = model->items_[current.row()].id;
       if (!current_msg_id || id != *current_msg_id) {
         current_msg_id = id;
+        updateVisibleMessages();
         emit msgSelectionChanged(*current_msg_id);
       }
     }
@@ -125,6 +128,22 @@ void MessagesWidget::updateTitle() {
                       .arg(model->items_.size()).arg(stats.first).arg(stats.second));
 }
 
+// only the rows in the viewport and the selected message need the byte change tracking
+void MessagesWidget::updateVisibleMessages() {
+  std::vector<MessageId> ids;
+  if (current_msg_id) ids.push_back(*current_msg_id);
+
+  QModelIndex top = view->indexAt(QPoint(0, 0));
+  if (top.isValid()) {
+    QModelIndex bottom = view->indexAt(QPoint(0, view->viewport()->height() - 1));
+    int last_row = bottom.isValid() ? bottom.row() : model->rowCount() - 1;
+    for (int row = top.row(); row <= last_row && row < model->items_.size(); ++row) {
+      ids.push_back(model->items_[row].id);
+    }
+  }
+  can->setVisibleMessages(ids);
+}
+
 void MessagesWidget::selectMessage(const MessageId &msg_id) {
   auto it = std::find_if(model->items_.cbegin(), model->items_.cend(),
                          [&msg_id](auto &item) { return item.id == msg_id; });
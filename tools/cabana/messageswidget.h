@@ -110,6 +110,7 @@ protected:
   void menuAboutToShow();
   void setMultiLineBytes(bool multi);
   void updateTitle();
+  void updateVisibleMessages();
 
   MessageView *view;
   MessageViewHeader *header;
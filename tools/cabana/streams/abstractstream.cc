@@ -1,9 +1,12 @@
 #include "tools/cabana/streams/abstractstream.h"
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
 #include <utility>
 
 #include <QApplication>
+#include <QtConcurrent>
 #include "common/timing.h"
 #include "tools/cabana/settings.h"
 
@@ -25,6 +28,17 @@ AbstractStream::AbstractStream(QObject *parent) : QObject(parent) {
   QObject::connect(this, &AbstractStream::seekedTo, this, &AbstractStream::updateLastMsgsTo);
   QObject::connect(dbc(), &DBCManager::DBCFileChanged, this, &AbstractStream::updateMasks);
   QObject::connect(dbc(), &DBCManager::maskUpdated, this, &AbstractStream::updateMasks);
+  QObject::connect(dbc(), &DBCManager::DBCFileChanged, this, [this]() { removeSignalValues([](auto &, auto) { return true; }); });
+  QObject::connect(dbc(), &DBCManager::signalUpdated, this, [this](const cabana::Signal *sig) {
+    removeSignalValues([=](auto &, auto s) { return s == sig; });
+  });
+  QObject::connect(dbc(), &DBCManager::signalRemoved, this, [this](const cabana::Signal *sig) {
+    removeSignalValues([=](auto &, auto s) { return s == sig; });
+  });
+  // the signals of a removed message are gone for every source sharing the DBC file
+  QObject::connect(dbc(), &DBCManager::msgRemoved, this, [this](MessageId id) {
+    removeSignalValues([=](auto &msg_id, auto) { return msg_id.address == id.address; });
+  });
   QObject::connect(this, &AbstractStream::streamStarted, [this]() {
     emit StreamNotifier::instance()->changingStream();
     delete can;
@@ -108,9 +122,36 @@ void AbstractStream::updateLastMessages() {
   emit msgsReceived(&msgs, prev_msg_size != last_msgs.size());
 }
 
+void AbstractStream::setVisibleMessages(const std::vector<MessageId> &ids) {
+  std::lock_guard lk(mutex_);
+  visible_msgs_.emplace(ids.begin(), ids.end());
+}
+
 void AbstractStream::updateEvent(const MessageId &id, double sec, const uint8_t *data, uint8_t size) {
   std::lock_guard lk(mutex_);
-  messages_[id].compute(id, data, size, sec, getSpeed(), masks_[id]);
+  updateMessage(id, sec, data, size, getSpeed(), true);
+}
+
+void AbstractStream::updateEventRange(std::vector<const CanEvent *>::const_iterator first,
+                                      std::vector<const CanEvent *>::const_iterator last, uint64_t begin_mono_time) {
+  const double speed = getSpeed();
+  std::lock_guard lk(mutex_);
+  for (auto it = first; it != last; ++it) {
+    const CanEvent *e = *it;
+    const MessageId id = {.source = e->src, .address = e->address};
+    updateMessage(id, (e->mono_time - begin_mono_time) / 1e9, e->dat, e->size, speed, !visible_msgs_ || visible_msgs_->count(id));
+  }
+}
+
+// called with mutex_ held
+void AbstractStream::updateMessage(const MessageId &id, double sec, const uint8_t *data, uint8_t size, double playback_speed,
+                                   bool track_changes) {
+  auto &m = messages_[id];
+  if (track_changes) {
+    m.compute(id, data, size, sec, playback_speed, masks_[id]);
+  } else {
+    m.update(id, data, size, sec);
+  }
   new_msgs_.insert(id);
 }
 
@@ -120,6 +161,63 @@ const std::vector<const CanEvent *> &AbstractStream::events(const MessageId &id)
   return it != events_.end() ? it->second : empty_events;
 }
 
+static void insertSignalValues(const cabana::Signal *sig, const std::vector<const CanEvent *> &events, SignalValues &v) {
+  SignalValues new_values;
+  new_values.mono_times.reserve(events.size());
+  new_values.values.reserve(events.size());
+  for (const CanEvent *e : events) {
+    double value = std::numeric_limits<double>::quiet_NaN();
+    sig->getValue(e->dat, e->size, &value);
+    new_values.mono_times.push_back(e->mono_time);
+    new_values.values.push_back(value);
+  }
+
+  if (v.mono_times.empty() || v.mono_times.back() <= new_values.mono_times.front()) {
+    v.mono_times.insert(v.mono_times.end(), new_values.mono_times.begin(), new_values.mono_times.end());
+    v.values.insert(v.values.end(), new_values.values.begin(), new_values.values.end());
+    return;
+  }
+
+  // same order as mergeEvents: the existing values first if the times are equal
+  SignalValues merged;
+  merged.mono_times.reserve(v.mono_times.size() + events.size());
+  merged.values.reserve(v.values.size() + events.size());
+  size_t i = 0, j = 0;
+  while (i < v.mono_times.size() || j < new_values.mono_times.size()) {
+    if (j == new_values.mono_times.size() || (i < v.mono_times.size() && v.mono_times[i] <= new_values.mono_times[j])) {
+      merged.mono_times.push_back(v.mono_times[i]);
+      merged.values.push_back(v.values[i++]);
+    } else {
+      merged.mono_times.push_back(new_values.mono_times[j]);
+      merged.values.push_back(new_values.values[j++]);
+    }
+  }
+  v = std::move(merged);
+}
+
+std::shared_ptr<const SignalValues> AbstractStream::signalValues(const MessageId &id, const cabana::Signal *sig) {
+  const auto key = std::make_pair(id, sig);
+  {
+    std::lock_guard lk(signal_values_mutex_);
+    if (auto it = signal_values_.find(key); it != signal_values_.end()) return it->second;
+  }
+
+  // decode outside of the lock, charts build their series concurrently
+  auto v = std::make_shared<SignalValues>();
+  const auto &evts = events(id);
+  if (!evts.empty()) insertSignalValues(sig, evts, *v);
+
+  std::lock_guard lk(signal_values_mutex_);
+  return signal_values_.try_emplace(key, v).first->second;
+}
+
+void AbstractStream::removeSignalValues(std::function<bool(const MessageId &, const cabana::Signal *)> predicate) {
+  std::lock_guard lk(signal_values_mutex_);
+  for (auto it = signal_values_.begin(); it != signal_values_.end(); /**/) {
+    it = predicate(it->first.first, it->first.second) ? signal_values_.erase(it) : std::next(it);
+  }
+}
+
 const CanData &AbstractStream::lastMessage(const MessageId &id) {
   static CanData empty_data = {};
   auto it = last_msgs.find(id);
@@ -164,8 +262,12 @@ void AbstractStream::updateLastMsgsTo(double sec) {
 }
 
 const CanEvent *AbstractStream::newEvent(uint64_t mono_time, const cereal::CanData::Reader &c) {
+  return newEvent(event_buffer_.get(), mono_time, c);
+}
+
+const CanEvent *AbstractStream::newEvent(MonotonicBuffer *buffer, uint64_t mono_time, const cereal::CanData::Reader &c) {
   auto dat = c.getDat();
-  CanEvent *e = (CanEvent *)event_buffer_->allocate(sizeof(CanEvent) + sizeof(uint8_t) * dat.size());
+  CanEvent *e = (CanEvent *)buffer->allocate(sizeof(CanEvent) + sizeof(uint8_t) * dat.size());
   e->src = c.getSrc();
   e->address = c.getAddress();
   e->mono_time = mono_time;
@@ -174,6 +276,70 @@ const CanEvent *AbstractStream::newEvent(uint64_t mono_time, const cereal::CanDa
   return e;
 }
 
+typedef std::vector<const std::vector<const CanEvent *> *> EventRuns;
+
+// Merges the sorted runs into the sorted dst without inserting in the middle of it. Events with the same
+// time keep the order dst, runs[0], runs[1]... The runs are appended in place if they come after dst and each other.
+static void mergeRuns(std::vector<const CanEvent *> &dst, const EventRuns &runs) {
+  size_t total = dst.size();
+  bool ordered = true;
+  uint64_t last_ts = dst.empty() ? 0 : dst.back()->mono_time;
+  for (auto run : runs) {
+    total += run->size();
+    if (run->empty()) continue;
+    ordered = ordered && run->front()->mono_time >= last_ts;
+    last_ts = run->back()->mono_time;
+  }
+
+  if (ordered) {
+    dst.reserve(total);
+    for (auto run : runs) dst.insert(dst.end(), run->cbegin(), run->cend());
+    return;
+  }
+
+  // cursor 0 is the previous content of dst, the rest are the runs
+  std::vector<const CanEvent *> prev;
+  prev.swap(dst);
+  dst.reserve(total);
+  std::vector<std::pair<const CanEvent *const *, const CanEvent *const *>> cursors;
+  cursors.emplace_back(prev.data(), prev.data() + prev.size());
+  for (auto run : runs) cursors.emplace_back(run->data(), run->data() + run->size());
+
+  while (true) {
+    // the cursor with the oldest event, the first one if several have the same time
+    int c = -1;
+    for (int i = 0; i < cursors.size(); ++i) {
+      if (cursors[i].first != cursors[i].second &&
+          (c == -1 || (*cursors[i].first)->mono_time < (*cursors[c].first)->mono_time)) {
+        c = i;
+      }
+    }
+    if (c == -1) break;
+
+    // copy everything from it that goes before the next event of every other cursor
+    auto &[begin, end] = cursors[c];
+    const CanEvent *const *block_end = end;
+    for (int i = 0; i < cursors.size(); ++i) {
+      if (i == c || cursors[i].first == cursors[i].second) continue;
+      uint64_t ts = (*cursors[i].first)->mono_time;
+      block_end = i > c ? std::upper_bound(begin, block_end, ts, CompareCanEvent())
+                        : std::lower_bound(begin, block_end, ts, CompareCanEvent());
+    }
+    dst.insert(dst.end(), begin, block_end);
+    begin = block_end;
+  }
+}
+
+void AbstractStream::updateSignalValues(const MessageEventsMap &new_events) {
+  std::lock_guard lk(signal_values_mutex_);
+  for (auto &[key, values] : signal_values_) {
+    auto it = new_events.find(key.first);
+    if (it != new_events.end() && !it->second.empty()) {
+      insertSignalValues(key.second, it->second, *values);
+    }
+  }
+}
+
 void AbstractStream::mergeEvents(const std::vector<const CanEvent *> &events) {
   static MessageEventsMap msg_events;
   std::for_each(msg_events.begin(), msg_events.end(), [](auto &e) { e.second.clear(); });
@@ -186,18 +352,51 @@ void AbstractStream::mergeEvents(const std::vector<const CanEvent *> &events) {
   if (!events.empty()) {
     for (const auto &[id, new_e] : msg_events) {
       if (!new_e.empty()) {
-        auto &e = events_[id];
-        auto pos = std::upper_bound(e.cbegin(), e.cend(), new_e.front()->mono_time, CompareCanEvent());
-        e.insert(pos, new_e.cbegin(), new_e.cend());
+        mergeRuns(events_[id], {&new_e});
       }
     }
-    auto pos = std::upper_bound(all_events_.cbegin(), all_events_.cend(), events.front()->mono_time, CompareCanEvent());
-    all_events_.insert(pos, events.cbegin(), events.cend());
+    mergeRuns(all_events_, {&events});
+
+    // extend the decoded signals with the new events, the views read them on eventsMerged
+    updateSignalValues(msg_events);
     emit eventsMerged(msg_events);
   }
   lastest_event_ts = all_events_.empty() ? 0 : all_events_.back()->mono_time;
 }
 
+void AbstractStream::mergeEvents(std::vector<CanEventBatch> &&batches) {
+  EventRuns runs;
+  std::unordered_map<MessageId, EventRuns> msg_runs;
+  for (const auto &batch : batches) {
+    if (batch.events.empty()) continue;
+    runs.push_back(&batch.events);
+    for (const auto &[id, e] : batch.msg_events) {
+      if (!e.empty()) msg_runs[id].push_back(&e);
+    }
+  }
+
+  if (!runs.empty()) {
+    // messages are independent of each other, merge them in parallel with all_events_
+    MessageEventsMap new_events;
+    std::vector<std::pair<std::vector<const CanEvent *> *, const EventRuns *>> msg_merges;
+    for (const auto &[id, id_runs] : msg_runs) {
+      msg_merges.emplace_back(&events_[id], &id_runs);
+      msg_merges.emplace_back(&new_events[id], &id_runs);
+    }
+    QFuture<void> future = QtConcurrent::map(msg_merges, [](auto &m) { mergeRuns(*m.first, *m.second); });
+    mergeRuns(all_events_, runs);
+    future.waitForFinished();
+
+    updateSignalValues(new_events);
+    emit eventsMerged(new_events);
+  }
+
+  for (auto &batch : batches) {
+    if (batch.buffer) batch_buffers_.push_back(std::move(batch.buffer));
+  }
+  lastest_event_ts = all_events_.empty() ? 0 : all_events_.back()->mono_time;
+}
+
 namespace {
 
 enum Color { GREYISH_BLUE, CYAN, RED};
@@ -232,21 +431,38 @@ double calc_freq(const MessageId &msg_id, double current_sec) {
 
 }  // namespace
 
-void CanData::compute(const MessageId &msg_id, const uint8_t *can_data, const int size, double current_sec,
-                      double playback_speed, const std::vector<uint8_t> &mask, double in_freq) {
-  ts = current_sec;
-  ++count;
-
+void CanData::updateFreq(const MessageId &msg_id, double in_freq) {
   if (auto sec = seconds_since_boot(); (sec - last_freq_update_ts) >= 1) {
     last_freq_update_ts = sec;
     freq = !in_freq ? calc_freq(msg_id, ts) : in_freq;
   }
+}
+
+void CanData::resize(int size, double current_sec) {
+  dat.resize(size);
+  colors.assign(size, QColor(0, 0, 0, 0));
+  last_changes.resize(size);
+  std::for_each(last_changes.begin(), last_changes.end(), [current_sec](auto &c) { c.ts = current_sec; });
+}
+
+void CanData::update(const MessageId &msg_id, const uint8_t *can_data, const int size, double current_sec) {
+  ts = current_sec;
+  ++count;
+  updateFreq(msg_id, 0);
+  if (dat.size() != size) {
+    resize(size, current_sec);
+  }
+  memcpy(dat.data(), can_data, size);
+}
+
+void CanData::compute(const MessageId &msg_id, const uint8_t *can_data, const int size, double current_sec,
+                      double playback_speed, const std::vector<uint8_t> &mask, double in_freq) {
+  ts = current_sec;
+  ++count;
+  updateFreq(msg_id, in_freq);
 
   if (dat.size() != size) {
-    dat.resize(size);
-    colors.assign(size, QColor(0, 0, 0, 0));
-    last_changes.resize(size);
-    std::for_each(last_changes.begin(), last_changes.end(), [current_sec](auto &c) { c.ts = current_sec; });
+    resize(size, current_sec);
   } else {
     constexpr int periodic_threshold = 10;
     constexpr float fade_time = 2.0;
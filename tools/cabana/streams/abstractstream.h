@@ -1,10 +1,15 @@
 #pragma once
 
 #include <array>
+#include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <set>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include <QColor>
@@ -18,6 +23,8 @@
 struct CanData {
   void compute(const MessageId &msg_id, const uint8_t *dat, const int size, double current_sec,
                double playback_speed, const std::vector<uint8_t> &mask, double in_freq = 0);
+  // compute without the byte change tracking (colors, bit change counts)
+  void update(const MessageId &msg_id, const uint8_t *dat, const int size, double current_sec);
 
   double ts = 0.;
   uint32_t count = 0;
@@ -34,6 +41,10 @@ struct CanData {
   };
   std::vector<ByteLastChange> last_changes;
   double last_freq_update_ts = 0;
+
+private:
+  void updateFreq(const MessageId &msg_id, double in_freq);
+  void resize(int size, double current_sec);
 };
 
 struct CanEvent {
@@ -49,6 +60,13 @@ struct CompareCanEvent {
   constexpr bool operator()(uint64_t ts, const CanEvent *const e) const { return ts < e->mono_time; }
 };
 
+// Decoded values of a signal, index aligned with AbstractStream::events(id).
+// NaN where a multiplexed signal is not present in the event.
+struct SignalValues {
+  std::vector<uint64_t> mono_times;
+  std::vector<double> values;
+};
+
 struct BusConfig {
   int can_speed_kbps = 500;
   int data_speed_kbps = 2000;
@@ -57,6 +75,14 @@ struct BusConfig {
 
 typedef std::unordered_map<MessageId, std::vector<const CanEvent *>> MessageEventsMap;
 
+// Events sorted by time, and the same events grouped by message. Built in a worker thread,
+// the events are allocated from buffer which the stream keeps once the batch is merged.
+struct CanEventBatch {
+  std::unique_ptr<MonotonicBuffer> buffer;
+  std::vector<const CanEvent *> events;
+  MessageEventsMap msg_events;
+};
+
 class AbstractStream : public QObject {
   Q_OBJECT
 
@@ -83,10 +109,14 @@ public:
   inline const std::vector<const CanEvent *> &allEvents() const { return all_events_; }
   const CanData &lastMessage(const MessageId &id);
   const std::vector<const CanEvent *> &events(const MessageId &id) const;
+  // decoded on first use, extended by mergeEvents and dropped when the signal or the DBC changes
+  std::shared_ptr<const SignalValues> signalValues(const MessageId &id, const cabana::Signal *sig);
 
   size_t suppressHighlighted();
   void clearSuppressed();
   void suppressDefinedSignals(bool suppress);
+  // messages shown in the UI. updateEventRange only tracks the byte changes of these, all messages until it's called
+  void setVisibleMessages(const std::vector<MessageId> &ids);
 
 signals:
   void paused();
@@ -104,8 +134,15 @@ public:
 
 protected:
   void mergeEvents(const std::vector<const CanEvent *> &events);
+  // k-way merge of the batches into the stream
+  void mergeEvents(std::vector<CanEventBatch> &&batches);
   const CanEvent *newEvent(uint64_t mono_time, const cereal::CanData::Reader &c);
+  static const CanEvent *newEvent(MonotonicBuffer *buffer, uint64_t mono_time, const cereal::CanData::Reader &c);
   void updateEvent(const MessageId &id, double sec, const uint8_t *data, uint8_t size);
+  // updateEvent for every event in [first, last) under one lock, tracking byte changes for the visible messages only.
+  // LiveStream's fast path; ReplayStream goes through updateEvent so every message keeps its change history
+  void updateEventRange(std::vector<const CanEvent *>::const_iterator first,
+                        std::vector<const CanEvent *>::const_iterator last, uint64_t begin_mono_time);
   uint64_t lastEventMonoTime() const { return lastest_event_ts; }
 
   std::vector<const CanEvent *> all_events_;
@@ -116,16 +153,25 @@ private:
   void updateLastMessages();
   void updateLastMsgsTo(double sec);
   void updateMasks();
+  void updateMessage(const MessageId &id, double sec, const uint8_t *data, uint8_t size, double playback_speed,
+                     bool track_changes);
+  void updateSignalValues(const MessageEventsMap &new_events);
+  void removeSignalValues(std::function<bool(const MessageId &, const cabana::Signal *)> predicate);
 
   MessageEventsMap events_;
   std::unordered_map<MessageId, CanData> last_msgs;
   std::unique_ptr<MonotonicBuffer> event_buffer_;
+  std::vector<std::unique_ptr<MonotonicBuffer>> batch_buffers_;
 
   // Members accessed in multiple threads. (mutex protected)
   std::mutex mutex_;
   std::set<MessageId> new_msgs_;
   std::unordered_map<MessageId, CanData> messages_;
   std::unordered_map<MessageId, std::vector<uint8_t>> masks_;
+  std::optional<std::unordered_set<MessageId>> visible_msgs_;
+
+  std::mutex signal_values_mutex_;
+  std::map<std::pair<MessageId, const cabana::Signal *>, std::shared_ptr<SignalValues>> signal_values_;
 };
 
 class AbstractOpenStreamWidget : public QWidget {
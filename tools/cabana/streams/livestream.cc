@@ -79,21 +79,22 @@ void LiveStream::handleEvent(kj::ArrayPtr<capnp::word> data) {
   auto event = reader.getRoot<cereal::Event>();
   if (event.which() == cereal::Event::Which::CAN) {
     const uint64_t mono_time = event.getLogMonoTime();
-    std::lock_guard lk(lock);
     for (const auto &c : event.getCan()) {
-      received_events_.push_back(newEvent(mono_time, c));
+      const CanEvent *e = newEvent(mono_time, c);
+      // only full if the UI thread is stalled
+      while (!received_events_.try_push(e) && !QThread::currentThread()->isInterruptionRequested()) {
+        QThread::msleep(1);
+      }
     }
   }
 }
 
 void LiveStream::timerEvent(QTimerEvent *event) {
   if (event->timerId() == timer_id) {
-    {
-      // merge events received from live stream thread.
-      std::lock_guard lk(lock);
-      mergeEvents(received_events_);
-      received_events_.clear();
-    }
+    // merge events received from live stream thread.
+    received_events_.pop_batch(merge_events_);
+    mergeEvents(merge_events_);
+    merge_events_.clear();
     if (!all_events_.empty()) {
       begin_event_ts = all_events_.front()->mono_time;
       updateEvents();
@@ -124,11 +125,9 @@ void LiveStream::updateEvents() {
   auto first = std::upper_bound(all_events_.cbegin(), all_events_.cend(), current_event_ts, CompareCanEvent());
   auto last = std::upper_bound(first, all_events_.cend(), last_ts, CompareCanEvent());
 
-  for (auto it = first; it != last; ++it) {
-    const CanEvent *e = *it;
-    MessageId id = {.source = e->src, .address = e->address};
-    updateEvent(id, (e->mono_time - begin_event_ts) / 1e9, e->dat, e->size);
-    current_event_ts = e->mono_time;
+  if (first != last) {
+    updateEventRange(first, last, begin_event_ts);
+    current_event_ts = (*std::prev(last))->mono_time;
   }
   emit privateUpdateLastMsgsSignal();
 }
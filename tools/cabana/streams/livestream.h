@@ -5,6 +5,7 @@
 
 #include <QBasicTimer>
 
+#include "common/queue.h"
 #include "tools/cabana/streams/abstractstream.h"
 
 class LiveStream : public AbstractStream {
@@ -32,9 +33,10 @@ private:
   void timerEvent(QTimerEvent *event) override;
   void updateEvents();
 
-  std::mutex lock;
   QThread *stream_thread;
-  std::vector<const CanEvent *> received_events_;
+  // minutes of traffic at full bus load, the UI thread drains it every frame
+  SPSCQueue<const CanEvent *, 1 << 20> received_events_;
+  std::vector<const CanEvent *> merge_events_;
 
   int timer_id;
   QBasicTimer update_timer;
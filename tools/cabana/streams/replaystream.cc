@@ -1,14 +1,23 @@
 #include "tools/cabana/streams/replaystream.h"
 
+#include <deque>
+#include <numeric>
+#include <utility>
+
 #include <QLabel>
 #include <QFileDialog>
 #include <QGridLayout>
 #include <QMessageBox>
 #include <QPushButton>
+#include <QThread>
+#include <QtConcurrent>
 
 #include "common/timing.h"
 #include "tools/cabana/streams/routes.h"
 
+// small segments (e.g. qlogs) aren't worth splitting
+static const size_t MIN_CHUNK_EVENTS = 2000;
+
 ReplayStream::ReplayStream(QObject *parent) : AbstractStream(parent) {
   unsetenv("ZMQ");
   setenv("COMMA_CACHE", "/tmp/comma_download_cache", 1);
@@ -28,24 +37,56 @@ static bool event_filter(const Event *e, void *opaque) {
 }
 
 void ReplayStream::mergeSegments() {
+  // split the new segments into chunks of events, and convert them into sorted runs of CanEvents in parallel
+  struct Chunk {
+    const std::vector<Event> *events;
+    size_t begin, end;
+  };
+  std::vector<Chunk> chunks;
   for (auto &[n, seg] : replay->segments()) {
     if (seg && seg->isLoaded() && !processed_segments.count(n)) {
       processed_segments.insert(n);
-
-      std::vector<const CanEvent *> new_events;
-      new_events.reserve(seg->log->events.size());
-      for (const Event &e : seg->log->events) {
-        if (e.which == cereal::Event::Which::CAN) {
-          capnp::FlatArrayMessageReader reader(e.data);
-          auto event = reader.getRoot<cereal::Event>();
-          for (const auto &c : event.getCan()) {
-            new_events.push_back(newEvent(e.mono_time, c));
-          }
-        }
+      const auto &events = seg->log->events;
+      const size_t chunk_size = std::max<size_t>(MIN_CHUNK_EVENTS, events.size() / QThread::idealThreadCount() + 1);
+      for (size_t begin = 0; begin < events.size(); begin += chunk_size) {
+        chunks.push_back({&events, begin, std::min(events.size(), begin + chunk_size)});
       }
-      mergeEvents(new_events);
     }
   }
+  if (chunks.empty()) return;
+
+  std::vector<CanEventBatch> batches(chunks.size());
+  std::vector<int> indexes(chunks.size());
+  std::iota(indexes.begin(), indexes.end(), 0);
+  QtConcurrent::blockingMap(indexes, [&](int i) {
+    const Chunk &chunk = chunks[i];
+    // parse each event once, the readers are kept for building the CanEvents below
+    std::deque<capnp::FlatArrayMessageReader> readers;
+    std::vector<std::pair<uint64_t, capnp::List<cereal::CanData>::Reader>> cans;
+    size_t count = 0;
+    for (size_t j = chunk.begin; j < chunk.end; ++j) {
+      const Event &e = (*chunk.events)[j];
+      if (e.which == cereal::Event::Which::CAN) {
+        auto can = readers.emplace_back(e.data).getRoot<cereal::Event>().getCan();
+        cans.emplace_back(e.mono_time, can);
+        count += can.size();
+      }
+    }
+    if (count == 0) return;
+
+    // room for every frame with a classic CAN payload in one allocation, CAN FD frames grow the buffer
+    CanEventBatch &batch = batches[i];
+    batch.buffer = std::make_unique<MonotonicBuffer>(count * MonotonicBuffer::alignedSize(sizeof(CanEvent) + 8));
+    batch.events.reserve(count);
+    for (const auto &[mono_time, can] : cans) {
+      for (const auto &c : can) {
+        const CanEvent *can_event = newEvent(batch.buffer.get(), mono_time, c);
+        batch.events.push_back(can_event);
+        batch.msg_events[{.source = can_event->src, .address = can_event->address}].push_back(can_event);
+      }
+    }
+  });
+  mergeEvents(std::move(batches));
 }
 
 bool ReplayStream::loadRoute(const QString &route, const QString &data_dir, uint32_t replay_flags) {
@@ -0,0 +1,72 @@
+// Redraw time of a large series in a QChartView, feeding Qt every point vs the min/max points per pixel column.
+// usage: QT_QPA_PLATFORM=offscreen ./bench_chart [points]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <QApplication>
+#include <QtCharts/QChartView>
+#include <QtCharts/QLineSeries>
+#include <QtCharts/QValueAxis>
+using namespace QtCharts;
+
+#include "tools/cabana/utils/util.h"
+
+template <class F>
+static double time_ms(F f, int iterations = 5) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) f();
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+int main(int argc, char *argv[]) {
+  QApplication app(argc, argv);
+  const int num_points = argc > 1 ? atoi(argv[1]) : 1000000;
+
+  // a 100Hz signal with noise and a few spikes
+  std::mt19937 rng(0);
+  std::vector<QPointF> vals;
+  vals.reserve(num_points);
+  for (int i = 0; i < num_points; ++i) {
+    double y = 50 * std::sin(i * 1e-3) + (rng() % 100) / 10.0 + (i % 100000 == 0 ? 200 : 0);
+    vals.emplace_back(i / 100.0, y);
+  }
+
+  SegmentTree tree;
+  double build_ms = time_ms([&]() { tree.build(vals); }, 1);
+
+  QChartView view;
+  auto series = new QLineSeries();
+  view.chart()->addSeries(series);
+  view.chart()->createDefaultAxes();
+  view.resize(1200, 300);
+  auto axis_x = (QValueAxis *)view.chart()->axes(Qt::Horizontal)[0];
+  auto axis_y = (QValueAxis *)view.chart()->axes(Qt::Vertical)[0];
+  axis_y->setRange(-100, 300);
+  const double duration = vals.back().x();
+
+  printf("%d points, pyramid build %.2f ms\n", num_points, build_ms);
+  axis_x->setRange(0, duration);
+  double full_ms = time_ms([&]() {
+    series->replace(QVector<QPointF>::fromStdVector(vals));
+    view.grab();
+  }, 1);
+  printf("%-24s %10.2f ms\n", "all points", full_ms);
+
+  for (double zoom : {1.0, 10.0, 100.0, 1000.0}) {
+    const double max_x = duration / zoom;
+    axis_x->setRange(0, max_x);
+    QVector<QPointF> points;
+    double ms = time_ms([&]() {
+      decimateSeries(vals, &tree, 0, max_x, view.chart()->plotArea().width(), points);
+      series->replace(points);
+      view.grab();
+    });
+    printf("decimated, zoom %-8.0f %10.2f ms (%d points)\n", zoom, ms, points.size());
+  }
+  return 0;
+}
@@ -0,0 +1,69 @@
+// Sustained ingestion rate of LiveStream: a stream thread pushes synthetic CAN FD frames as fast as it can
+// while the UI thread merges them on the update timer, reports the frames/s merged and the backlog left.
+// usage: QT_QPA_PLATFORM=offscreen ./bench_livestream [seconds] [frames per message] [visible messages]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include <QApplication>
+#include <QThread>
+#include <QTimer>
+
+#include "tools/cabana/streams/livestream.h"
+
+class BenchStream : public LiveStream {
+public:
+  BenchStream(QObject *parent, int frames_per_msg) : LiveStream(parent), frames_per_msg(frames_per_msg) {}
+  QString routeName() const override { return "bench"; }
+  size_t merged() const { return allEvents().size(); }
+
+  std::atomic<uint64_t> sent = 0;
+
+protected:
+  void streamThread() override {
+    uint8_t dat[64] = {};
+    while (!QThread::currentThread()->isInterruptionRequested()) {
+      MessageBuilder msg;
+      auto can_data = msg.initEvent().initCan(frames_per_msg);
+      for (int i = 0; i < frames_per_msg; ++i) {
+        dat[i % 64]++;
+        // 100 ids spread over 3 buses, a quarter of them 64 byte CAN FD frames
+        can_data[i].setAddress(0x100 + i % 100);
+        can_data[i].setSrc(i % 3);
+        can_data[i].setDat(kj::arrayPtr(dat, i % 4 == 0 ? 64 : 8));
+      }
+      handleEvent(capnp::messageToFlatArray(msg));
+      sent += frames_per_msg;
+    }
+  }
+
+  const int frames_per_msg;
+};
+
+int main(int argc, char *argv[]) {
+  QApplication app(argc, argv);
+  const double seconds = argc > 1 ? atof(argv[1]) : 5.0;
+  const int frames_per_msg = argc > 2 ? atoi(argv[2]) : 100;
+  const int visible = argc > 3 ? atoi(argv[3]) : 40;
+
+  auto stream = new BenchStream(&app, frames_per_msg);
+  if (visible >= 0) {
+    // what the message list reports with that many rows on screen
+    std::vector<MessageId> ids;
+    for (int i = 0; i < visible; ++i) ids.push_back({.source = (uint8_t)(i % 3), .address = (uint32_t)(0x100 + i)});
+    stream->setVisibleMessages(ids);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  stream->start();
+  QTimer::singleShot(seconds * 1000, [&]() {
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t sent = stream->sent, merged = stream->merged();
+    printf("sent %10.0f frames/s, merged %10.0f frames/s, backlog %lu frames\n", sent / elapsed, merged / elapsed, sent - merged);
+    stream->stop();
+    app.quit();
+  });
+  return app.exec();
+}
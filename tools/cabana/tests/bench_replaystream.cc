@@ -0,0 +1,41 @@
+// Time until every segment of a route is merged into cabana's ReplayStream, i.e. the whole route is
+// available to charts, the history log and the find tools.
+// usage: QT_QPA_PLATFORM=offscreen ./bench_replaystream <route> [data_dir]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include <QApplication>
+
+#include "tools/cabana/streams/replaystream.h"
+
+int main(int argc, char *argv[]) {
+  QApplication app(argc, argv);
+  if (argc < 2) {
+    printf("usage: %s <route> [data_dir]\n", argv[0]);
+    return 1;
+  }
+
+  // keep every segment of the route
+  settings.max_cached_minutes = 1000;
+  auto stream = new ReplayStream(&app);
+  auto start = std::chrono::steady_clock::now();
+  if (!stream->loadRoute(argv[1], argc > 2 ? argv[2] : "", REPLAY_FLAG_NO_VIPC | REPLAY_FLAG_NO_FILE_CACHE)) {
+    printf("failed to load route %s\n", argv[1]);
+    return 1;
+  }
+
+  QObject::connect(stream, &AbstractStream::eventsMerged, [&]() {
+    auto now = std::chrono::steady_clock::now();
+    const auto &segments = stream->getReplay()->segments();
+    bool all_loaded = std::all_of(segments.begin(), segments.end(), [](auto &s) { return s.second && s.second->isLoaded(); });
+    if (all_loaded) {
+      double total = std::chrono::duration<double>(now - start).count();
+      printf("%zu segments, %zu CAN frames merged in %.2f s\n", segments.size(), stream->allEvents().size(), total);
+      app.quit();
+    }
+  });
+  stream->start();
+  return app.exec();
+}
@@ -3,7 +3,10 @@
 #include <QDir>
 
 #include "catch2/catch.hpp"
+#include "common/util.h"
 #include "tools/cabana/dbc/dbcmanager.h"
+#include "tools/cabana/tools/bitplanes.h"
+#include "tools/cabana/utils/util.h"
 
 const std::string TEST_RLOG_URL = "https://commadataci.blob.core.windows.net/openpilotci/0c94aa1e1296d7c6/2021-05-05--19-48-37/0/rlog.bz2";
 
@@ -155,3 +158,76 @@ TEST_CASE("parse_opendbc") {
   INFO(errors.join("\n").toStdString());
   REQUIRE(errors.empty());
 }
+
+TEST_CASE("SegmentTree") {
+  std::vector<QPointF> vals;
+  for (int i = 0; i < 1000; ++i) {
+    vals.emplace_back(i / 100.0, util::random_int(-100, 100));
+  }
+  SegmentTree tree;
+  tree.build(vals);
+
+  for (int i = 0; i < 100; ++i) {
+    int left = util::random_int(0, vals.size() - 1);
+    int right = util::random_int(left, vals.size() - 1);
+    auto [min_it, max_it] = std::minmax_element(vals.begin() + left, vals.begin() + right + 1,
+                                                [](auto &a, auto &b) { return a.y() < b.y(); });
+    auto [min, max] = tree.minmax(vals, left, right);
+    REQUIRE(min == min_it->y());
+    REQUIRE(max == max_it->y());
+  }
+
+  SECTION("decimateSeries") {
+    vals[500].setY(1000);
+    tree.build(vals);
+    QVector<QPointF> points, linear_points;
+    decimateSeries(vals, &tree, 0, 10, 100, points);
+    decimateSeries(vals, nullptr, 0, 10, 100, linear_points);
+    REQUIRE(points.size() <= 200);
+    REQUIRE(points.size() == linear_points.size());
+    REQUIRE(std::is_sorted(points.begin(), points.end(), [](auto &a, auto &b) { return a.x() < b.x(); }));
+    REQUIRE(std::any_of(points.begin(), points.end(), [](auto &p) { return p.y() == 1000; }));
+
+    // zoomed in far enough, all points in range plus one on each side
+    decimateSeries(vals, &tree, 1.0, 1.5, 100, points);
+    REQUIRE(points.size() == 52);
+  }
+}
+
+TEST_CASE("BitPlanes") {
+  const int num_events = 500;
+  std::vector<std::vector<uint8_t>> buffers(num_events, std::vector<uint8_t>(sizeof(CanEvent) + 8));
+  std::vector<const CanEvent *> events;
+  for (auto &buf : buffers) {
+    CanEvent *e = (CanEvent *)buf.data();
+    e->size = 8;
+    for (int i = 0; i < e->size; ++i) e->dat[i] = util::random_int(0, 3) == 0 ? util::random_int(0, 255) : i;
+    events.push_back(e);
+  }
+  BitPlanes planes(events);
+
+  for (int size = 1; size <= 32; ++size) {
+    for (int start = 0; start <= 64 - size; ++start) {
+      cabana::Signal sig{};
+      sig.start_bit = start;
+      sig.size = size;
+      sig.is_signed = size % 2 == 0;
+      sig.is_little_endian = start % 3 != 0;
+      updateMsbLsb(sig);
+      if (planes.signalBits(sig).empty()) continue;
+
+      auto value = [&](int i) { return (int64_t)get_raw_value(events[i]->dat, events[i]->size, sig); };
+      auto [lo, hi] = std::minmax(value(util::random_int(0, num_events - 1)), value(util::random_int(0, num_events - 1)));
+      bool negate = start % 2 == 0;
+      size_t first = util::random_int(0, num_events - 1);
+      int64_t expected = -1;
+      for (int i = first; i < num_events; ++i) {
+        if ((value(i) >= lo && value(i) <= hi) != negate) {
+          expected = i;
+          break;
+        }
+      }
+      REQUIRE(planes.findFirst(sig, lo, hi, negate, first, num_events) == expected);
+    }
+  }
+}
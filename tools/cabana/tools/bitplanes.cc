@@ -0,0 +1,89 @@
+#include "tools/cabana/tools/bitplanes.h"
+
+#include <algorithm>
+
+BitPlanes::BitPlanes(const std::vector<const CanEvent *> &events) : num_events(events.size()) {
+  num_words = (num_events + 63) / 64;
+  min_size = events.empty() ? 0 : 64;
+  for (const CanEvent *e : events) {
+    max_size = std::max<int>(max_size, e->size);
+    min_size = std::min<int>(min_size, e->size);
+  }
+
+  planes.resize(max_size * 8 * num_words);
+  present_masks.resize(max_size * num_words);
+  for (size_t k = 0; k < num_events; ++k) {
+    const CanEvent *e = events[k];
+    const size_t word = k / 64;
+    const uint64_t bit = 1ULL << (k % 64);
+    for (int i = 0; i < e->size; ++i) {
+      present_masks[i * num_words + word] |= bit;
+      for (uint8_t b = e->dat[i]; b != 0; b &= b - 1) {
+        planes[(i * 8 + __builtin_ctz(b)) * num_words + word] |= bit;
+      }
+    }
+  }
+}
+
+std::vector<int> BitPlanes::signalBits(const cabana::Signal &sig) const {
+  // raw values are compared as int64, and short events are decoded differently by get_raw_value
+  if (sig.size <= 0 || sig.size > 63 || std::max(sig.msb, sig.lsb) / 8 >= min_size) return {};
+
+  // same walk over the bytes as get_raw_value
+  std::vector<int> bits(sig.size);
+  int i = sig.msb / 8;
+  int remaining = sig.size;
+  while (i >= 0 && i < min_size && remaining > 0) {
+    int lsb = (int)(sig.lsb / 8) == i ? sig.lsb : i * 8;
+    int msb = (int)(sig.msb / 8) == i ? sig.msb : (i + 1) * 8 - 1;
+    int size = msb - lsb + 1;
+    for (int j = 0; j < size; ++j) {
+      bits[remaining - size + j] = lsb + j;
+    }
+    remaining -= size;
+    i = sig.is_little_endian ? i - 1 : i + 1;
+  }
+  if (remaining != 0) return {};
+  return bits;
+}
+
+int64_t BitPlanes::findFirst(const cabana::Signal &sig, int64_t lo, int64_t hi, bool negate, size_t first, size_t last) const {
+  const std::vector<int> bits = signalBits(sig);
+  if (bits.empty() || first >= last) return -1;
+
+  // signed values compare as unsigned after flipping the sign bit
+  const uint64_t bias = sig.is_signed ? 1ULL << (sig.size - 1) : 0;
+  const uint64_t ulo = lo + bias, uhi = hi + bias;
+  const uint64_t sign_flip = sig.is_signed ? ~0ULL : 0;
+
+  for (size_t w = first / 64; w <= (last - 1) / 64; ++w) {
+    uint64_t range_mask = ~0ULL;
+    if (w == first / 64) range_mask &= ~0ULL << (first % 64);
+    if (w == (last - 1) / 64 && last % 64 != 0) range_mask &= ~0ULL >> (64 - last % 64);
+
+    // bit-sliced compare of 64 values against lo and hi, msb first
+    uint64_t gt_lo = 0, eq_lo = ~0ULL, lt_hi = 0, eq_hi = ~0ULL;
+    for (int b = sig.size - 1; b >= 0; --b) {
+      uint64_t p = plane(bits[b])[w];
+      if (b == sig.size - 1) p ^= sign_flip;
+      if ((ulo >> b) & 1) {
+        eq_lo &= p;
+      } else {
+        gt_lo |= eq_lo & p;
+        eq_lo &= ~p;
+      }
+      if ((uhi >> b) & 1) {
+        lt_hi |= eq_hi & ~p;
+        eq_hi &= p;
+      } else {
+        eq_hi &= ~p;
+      }
+    }
+    uint64_t in_range = (gt_lo | eq_lo) & (lt_hi | eq_hi);
+    uint64_t match = (negate ? ~in_range : in_range) & range_mask;
+    if (match) {
+      return w * 64 + __builtin_ctzll(match);
+    }
+  }
+  return -1;
+}
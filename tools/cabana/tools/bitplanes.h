@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "tools/cabana/dbc/dbc.h"
+#include "tools/cabana/streams/abstractstream.h"
+
+// Transposed copy of the payloads of one message: for every payload bit a packed bitset over the events,
+// bit k of word w belongs to event w * 64 + k. Searches evaluate 64 events per word operation on it.
+class BitPlanes {
+public:
+  BitPlanes(const std::vector<const CanEvent *> &events);
+  inline size_t count() const { return num_events; }
+  inline size_t words() const { return num_words; }
+  inline int maxSize() const { return max_size; }
+  // bits are numbered like cabana::Signal: byte * 8 + bit, bit 0 is the lsb
+  inline const uint64_t *plane(int bit) const { return &planes[bit * num_words]; }
+  // events longer than byte
+  inline const uint64_t *present(int byte) const { return &present_masks[byte * num_words]; }
+
+  // payload bit of every raw value bit of sig (lsb first), empty if it can't be evaluated on the planes
+  std::vector<int> signalBits(const cabana::Signal &sig) const;
+  // index of the first event in [first, last) whose raw value is in [lo, hi] (outside of it if negate), -1 if none
+  int64_t findFirst(const cabana::Signal &sig, int64_t lo, int64_t hi, bool negate, size_t first, size_t last) const;
+
+private:
+  size_t num_events = 0;
+  size_t num_words = 0;
+  int max_size = 0;
+  int min_size = 0;
+  std::vector<uint64_t> planes;
+  std::vector<uint64_t> present_masks;
+};
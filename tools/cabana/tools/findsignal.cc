@@ -1,5 +1,9 @@
 #include "tools/cabana/tools/findsignal.h"
 
+#include <numeric>
+#include <optional>
+#include <unordered_set>
+
 #include <QFormLayout>
 #include <QHBoxLayout>
 #include <QHeaderView>
@@ -8,6 +12,84 @@
 #include <QTimer>
 #include <QVBoxLayout>
 
+// SearchCondition
+
+bool SearchCondition::operator()(double v) const {
+  switch (op) {
+    case Equal: return v == v1;
+    case Greater: return v > v1;
+    case GreaterEqual: return v >= v1;
+    case NotEqual: return v != v1;
+    case Less: return v < v1;
+    case LessEqual: return v <= v1;
+    case Between: return v >= v1 && v <= v2;
+  }
+  return false;
+}
+
+// first raw value in [lo, hi] for which pred holds, hi + 1 if none. pred has to be false then true over the range
+template <class Pred>
+static int64_t partitionPoint(int64_t lo, int64_t hi, Pred pred) {
+  while (lo <= hi) {
+    int64_t mid = lo + (hi - lo) / 2;
+    if (pred(mid)) {
+      hi = mid - 1;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return lo;
+}
+
+bool SearchCondition::rawRange(const cabana::Signal &sig, int64_t &lo, int64_t &hi, bool &negate) const {
+  const int64_t min_raw = sig.is_signed ? -(1LL << (sig.size - 1)) : 0;
+  const int64_t max_raw = sig.is_signed ? (1LL << (sig.size - 1)) - 1 : (1LL << sig.size) - 1;
+  // same expression as get_raw_value, so the boundaries are exact
+  auto value = [&sig](int64_t raw) { return raw * sig.factor + sig.offset; };
+
+  lo = min_raw;
+  hi = max_raw;
+  negate = false;
+  if (sig.factor == 0) {
+    return (*this)(sig.offset);
+  }
+
+  double lower = -std::numeric_limits<double>::infinity();
+  double upper = std::numeric_limits<double>::infinity();
+  bool lower_inclusive = true, upper_inclusive = true;
+  switch (op) {
+    case Equal: lower = upper = v1; break;
+    case Greater: lower = v1; lower_inclusive = false; break;
+    case GreaterEqual: lower = v1; break;
+    case NotEqual: lower = upper = v1; negate = true; break;
+    case Less: upper = v1; upper_inclusive = false; break;
+    case LessEqual: upper = v1; break;
+    case Between: lower = v1; upper = v2; break;
+  }
+  auto above_lower = [&](int64_t raw) { double v = value(raw); return lower_inclusive ? v >= lower : v > lower; };
+  auto above_upper = [&](int64_t raw) { double v = value(raw); return upper_inclusive ? v > upper : v >= upper; };
+  auto below_upper = [&](int64_t raw) { return !above_upper(raw); };
+  auto below_lower = [&](int64_t raw) { return !above_lower(raw); };
+
+  // the decoded value is monotonic in the raw value, so the matching raw values are one interval
+  if (sig.factor > 0) {
+    lo = partitionPoint(min_raw, max_raw, above_lower);
+    hi = partitionPoint(min_raw, max_raw, above_upper) - 1;
+  } else {
+    lo = partitionPoint(min_raw, max_raw, below_upper);
+    hi = partitionPoint(min_raw, max_raw, below_lower) - 1;
+  }
+
+  if (lo > hi) {
+    // nothing decodes to a value in the interval
+    if (!negate) return false;
+    lo = min_raw;
+    hi = max_raw;
+    negate = false;
+  }
+  return true;
+}
+
 // FindSignalModel
 
 QVariant FindSignalModel::headerData(int section, Qt::Orientation orientation, int role) const {
@@ -22,35 +104,85 @@ QVariant FindSignalModel::data(const QModelIndex &index, int role) const {
     switch (index.column()) {
       case 0: return s.id.toString();
       case 1: return QString("%1, %2").arg(s.sig.start_bit).arg(s.sig.size);
-      case 2: return s.values.join(" ");
+      case 2: {
+        QStringList values;
+        for (const auto &[sec, value] : s.values) {
+          values += QString("(%1, %2)").arg(sec, 0, 'f', 2).arg(value);
+        }
+        return values.join(" ");
+      }
     }
   }
   return {};
 }
 
-void FindSignalModel::search(std::function<bool(double)> cmp) {
+void FindSignalModel::updateBitPlanes(const QList<SearchSignal> &sigs) {
+  std::unordered_set<MessageId> ids;
+  for (const auto &s : sigs) ids.insert(s.id);
+
+  std::vector<MessageId> outdated;
+  for (const auto &id : ids) {
+    auto it = bit_planes.find(id);
+    if (it == bit_planes.end() || it->second->count() != can->events(id).size()) {
+      outdated.push_back(id);
+    }
+  }
+
+  std::vector<int> indexes(outdated.size());
+  std::iota(indexes.begin(), indexes.end(), 0);
+  std::vector<std::shared_ptr<BitPlanes>> planes(outdated.size());
+  QtConcurrent::blockingMap(indexes, [&](int i) { planes[i] = std::make_shared<BitPlanes>(can->events(outdated[i])); });
+  for (size_t i = 0; i < outdated.size(); ++i) {
+    bit_planes[outdated[i]] = planes[i];
+  }
+}
+
+void FindSignalModel::search(const SearchCondition &cond) {
   beginResetModel();
 
-  std::mutex lock;
   const auto prev_sigs = !histories.isEmpty() ? histories.back() : initial_signals;
-  filtered_signals.clear();
-  filtered_signals.reserve(prev_sigs.size());
-  QtConcurrent::blockingMap(prev_sigs, [&](auto &s) {
+  updateBitPlanes(prev_sigs);
+
+  // one slot per candidate, so the results keep the order of the previous find
+  std::vector<std::optional<SearchSignal>> found(prev_sigs.size());
+  std::vector<int> indexes(prev_sigs.size());
+  std::iota(indexes.begin(), indexes.end(), 0);
+  QtConcurrent::blockingMap(indexes, [&](int i) {
+    const auto &s = prev_sigs[i];
     const auto &events = can->events(s.id);
-    auto first = std::upper_bound(events.cbegin(), events.cend(), s.mono_time, CompareCanEvent());
-    auto last = events.cend();
+    size_t first = std::upper_bound(events.cbegin(), events.cend(), s.mono_time, CompareCanEvent()) - events.cbegin();
+    size_t last = events.size();
     if (last_time < std::numeric_limits<uint64_t>::max()) {
-      last = std::upper_bound(events.cbegin(), events.cend(), last_time, CompareCanEvent());
+      last = std::upper_bound(events.cbegin(), events.cend(), last_time, CompareCanEvent()) - events.cbegin();
     }
 
-    auto it = std::find_if(first, last, [&](const CanEvent *e) { return cmp(get_raw_value(e->dat, e->size, s.sig)); });
-    if (it != last) {
+    int64_t idx = -1;
+    const BitPlanes *planes = bit_planes.at(s.id).get();
+    // raw values need to be exact in a double to turn the condition into a raw interval
+    if (s.sig.size <= std::numeric_limits<double>::digits && !planes->signalBits(s.sig).empty()) {
+      int64_t lo, hi;
+      bool negate;
+      if (cond.rawRange(s.sig, lo, hi, negate)) {
+        idx = planes->findFirst(s.sig, lo, hi, negate, first, last);
+      }
+    } else {
+      auto it = std::find_if(events.cbegin() + first, events.cbegin() + last, [&](const CanEvent *e) { return cond(get_raw_value(e->dat, e->size, s.sig)); });
+      if (it != events.cbegin() + last) idx = it - events.cbegin();
+    }
+
+    if (idx >= 0) {
+      const CanEvent *e = events[idx];
       auto values = s.values;
-      values += QString("(%1, %2)").arg((*it)->mono_time / 1e9 - can->routeStartTime(), 0, 'f', 2).arg(get_raw_value((*it)->dat, (*it)->size, s.sig));
-      std::lock_guard lk(lock);
-      filtered_signals.push_back({.id = s.id, .mono_time = (*it)->mono_time, .sig = s.sig, .values = values});
+      values.emplace_back(e->mono_time / 1e9 - can->routeStartTime(), get_raw_value(e->dat, e->size, s.sig));
+      found[i] = SearchSignal{.id = s.id, .mono_time = e->mono_time, .sig = s.sig, .values = values};
     }
   });
+
+  filtered_signals.clear();
+  filtered_signals.reserve(prev_sigs.size());
+  for (auto &s : found) {
+    if (s) filtered_signals.push_back(*s);
+  }
   histories.push_back(filtered_signals);
 
   endResetModel();
@@ -71,6 +203,7 @@ void FindSignalModel::reset() {
   histories.clear();
   filtered_signals.clear();
   initial_signals.clear();
+  bit_planes.clear();
   endResetModel();
 }
 
@@ -175,24 +308,15 @@ void FindSignalDlg::search() {
   if (model->histories.isEmpty()) {
     setInitialSignals();
   }
-  auto v1 = value1->text().toDouble();
-  auto v2 = value2->text().toDouble();
-  std::function<bool(double)> cmp = nullptr;
-  switch (compare_cb->currentIndex()) {
-    case 0: cmp = [v1](double v) { return v == v1;}; break;
-    case 1: cmp = [v1](double v) { return v > v1;}; break;
-    case 2: cmp = [v1](double v) { return v >= v1;}; break;
-    case 3: cmp = [v1](double v) { return v != v1;}; break;
-    case 4: cmp = [v1](double v) { return v < v1;}; break;
-    case 5: cmp = [v1](double v) { return v <= v1;}; break;
-    case 6: cmp = [v1, v2](double v) { return v >= v1 && v <= v2;}; break;
-  }
+  SearchCondition cond{.op = (SearchCondition::Op)compare_cb->currentIndex(),
+                       .v1 = value1->text().toDouble(),
+                       .v2 = value2->text().toDouble()};
   properties_group->setEnabled(false);
   message_group->setEnabled(false);
   search_btn->setEnabled(false);
   stats_label->setVisible(false);
   search_btn->setText("Finding ....");
-  QTimer::singleShot(0, this, [=]() { model->search(cmp); });
+  QTimer::singleShot(0, this, [=]() { model->search(cond); });
 }
 
 void FindSignalDlg::setInitialSignals() {
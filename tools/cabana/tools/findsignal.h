@@ -2,6 +2,10 @@
 
 #include <algorithm>
 #include <limits>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <QAbstractTableModel>
 #include <QCheckBox>
@@ -11,6 +15,16 @@
 
 #include "tools/cabana/commands.h"
 #include "tools/cabana/settings.h"
+#include "tools/cabana/tools/bitplanes.h"
+
+struct SearchCondition {
+  enum Op { Equal, Greater, GreaterEqual, NotEqual, Less, LessEqual, Between };
+  Op op = Equal;
+  double v1 = 0., v2 = 0.;
+  bool operator()(double v) const;
+  // the raw values of sig matching the condition as [lo, hi] (the complement of it if negate). false if there are none
+  bool rawRange(const cabana::Signal &sig, int64_t &lo, int64_t &hi, bool &negate) const;
+};
 
 class FindSignalModel : public QAbstractTableModel {
 public:
@@ -19,7 +33,7 @@ public:
     uint64_t mono_time = 0;
     cabana::Signal sig = {};
     double value = 0.;
-    QStringList values;
+    std::vector<std::pair<double, double>> values;  // (seconds, value) of every find
   };
 
   FindSignalModel(QObject *parent) : QAbstractTableModel(parent) {}
@@ -27,7 +41,7 @@ public:
   QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
   int columnCount(const QModelIndex &parent = QModelIndex()) const override { return 3; }
   int rowCount(const QModelIndex &parent = QModelIndex()) const override { return std::min(filtered_signals.size(), 300); }
-  void search(std::function<bool(double)> cmp);
+  void search(const SearchCondition &cond);
   void reset();
   void undo();
 
@@ -35,6 +49,10 @@ public:
   QList<SearchSignal> initial_signals;
   QList<QList<SearchSignal>> histories;
   uint64_t last_time = std::numeric_limits<uint64_t>::max();
+
+private:
+  void updateBitPlanes(const QList<SearchSignal> &sigs);
+  std::unordered_map<MessageId, std::shared_ptr<BitPlanes>> bit_planes;
 };
 
 class FindSignalDlg : public QDialog {
@@ -1,6 +1,8 @@
 #include "tools/cabana/tools/findsimilarbits.h"
 
 #include <algorithm>
+#include <numeric>
+#include <vector>
 
 #include <QGridLayout>
 #include <QHeaderView>
@@ -9,9 +11,11 @@
 #include <QLabel>
 #include <QPushButton>
 #include <QRadioButton>
+#include <QtConcurrent>
 
 #include "tools/cabana/dbc/dbcmanager.h"
 #include "tools/cabana/streams/abstractstream.h"
+#include "tools/cabana/tools/bitplanes.h"
 
 FindSimilarBitsDlg::FindSimilarBitsDlg(QWidget *parent) : QDialog(parent, Qt::WindowFlags() | Qt::Window) {
   setWindowTitle(tr("Find similar bits"));
@@ -116,45 +120,55 @@ void FindSimilarBitsDlg::find() {
 
 QList<FindSimilarBitsDlg::mismatched_struct> FindSimilarBitsDlg::calcBits(uint8_t bus, uint32_t selected_address, int byte_idx,
                                                                           int bit_idx, uint8_t find_bus, bool equal, int min_msgs_cnt) {
-  QHash<uint32_t, QVector<uint32_t>> mismatches;
-  QHash<uint32_t, uint32_t> msg_count;
-  const auto &events = can->allEvents();
-  int bit_to_find = -1;
-  for (const CanEvent *e : events) {
-    if (e->src == bus) {
-      if (e->address == selected_address && e->size > byte_idx) {
-        bit_to_find = ((e->dat[byte_idx] >> (7 - bit_idx)) & 1) != 0;
+  const auto &src_events = can->events({.source = bus, .address = selected_address});
+  std::vector<MessageId> ids;
+  for (const auto &[id, _] : can->lastMessages()) {
+    if (id.source == find_bus) ids.push_back(id);
+  }
+
+  std::vector<QList<mismatched_struct>> results(ids.size());
+  std::vector<int> indexes(ids.size());
+  std::iota(indexes.begin(), indexes.end(), 0);
+  QtConcurrent::blockingMap(indexes, [&](int n) {
+    const auto &events = can->events(ids[n]);
+    uint32_t cnt = events.size();
+    if (cnt <= min_msgs_cnt) return;
+
+    // value of the selected bit at the time of every event, and which events come after the first one of it
+    BitPlanes planes(events);
+    std::vector<uint64_t> selected(planes.words()), valid(planes.words());
+    int bit_to_find = -1, max_size = 0;
+    auto src = src_events.cbegin();
+    for (size_t k = 0; k < events.size(); ++k) {
+      for (; src != src_events.cend() && (*src)->mono_time <= events[k]->mono_time; ++src) {
+        if ((*src)->size > byte_idx) bit_to_find = ((*src)->dat[byte_idx] >> (7 - bit_idx)) & 1;
       }
-    }
-    if (e->src == find_bus) {
-      ++msg_count[e->address];
       if (bit_to_find == -1) continue;
 
-      auto &mismatched = mismatches[e->address];
-      if (mismatched.size() < e->size * 8) {
-        mismatched.resize(e->size * 8);
-      }
-      for (int i = 0; i < e->size; ++i) {
-        for (int j = 0; j < 8; ++j) {
-          int bit = ((e->dat[i] >> (7 - j)) & 1) != 0;
-          mismatched[i * 8 + j] += equal ? (bit != bit_to_find) : (bit == bit_to_find);
-        }
-      }
+      valid[k / 64] |= 1ULL << (k % 64);
+      if (bit_to_find) selected[k / 64] |= 1ULL << (k % 64);
+      max_size = std::max<int>(max_size, events[k]->size);
     }
-  }
 
-  QList<mismatched_struct> result;
-  result.reserve(mismatches.size());
-  for (auto it = mismatches.begin(); it != mismatches.end(); ++it) {
-    if (auto cnt = msg_count[it.key()]; cnt > min_msgs_cnt) {
-      auto &mismatched = it.value();
-      for (int i = 0; i < mismatched.size(); ++i) {
-        if (float perc = (mismatched[i] / (double)cnt) * 100; perc < 50) {
-          result.push_back({it.key(), (uint32_t)i / 8, (uint32_t)i % 8, mismatched[i], cnt, perc});
+    for (int i = 0; i < max_size; ++i) {
+      const uint64_t *present = planes.present(i);
+      for (int j = 0; j < 8; ++j) {
+        // bit_idx counts from the msb, planes from the lsb
+        const uint64_t *plane = planes.plane(i * 8 + 7 - j);
+        uint32_t mismatched = 0;
+        for (size_t w = 0; w < planes.words(); ++w) {
+          uint64_t diff = plane[w] ^ selected[w];
+          mismatched += __builtin_popcountll((equal ? diff : ~diff) & valid[w] & present[w]);
+        }
+        if (float perc = (mismatched / (double)cnt) * 100; perc < 50) {
+          results[n].push_back({ids[n].address, (uint32_t)i, (uint32_t)j, mismatched, cnt, perc});
         }
       }
     }
-  }
+  });
+
+  QList<mismatched_struct> result;
+  for (const auto &r : results) result += r;
   std::sort(result.begin(), result.end(), [](auto &l, auto &r) { return l.perc < r.perc; });
   return result;
 }
@@ -1,27 +1,39 @@
 #include "tools/cabana/utils/export.h"
 
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
 #include <QFile>
 #include <QTextStream>
+#include <QtConcurrent>
 
 #include "tools/cabana/streams/abstractstream.h"
+#include "tools/replay/arrow_writer.h"
 
 namespace utils {
 
-void exportToCSV(const QString &file_name, std::optional<MessageId> msg_id) {
+static bool finishCSV(QFile &file, QTextStream &stream) {
+  stream.flush();
+  return stream.status() == QTextStream::Ok && file.error() == QFileDevice::NoError;
+}
+
+bool exportToCSV(const QString &file_name, std::optional<MessageId> msg_id) {
   QFile file(file_name);
-  if (file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
-    const uint64_t start_time = can->routeStartTime();
-    QTextStream stream(&file);
-    stream << "time,addr,bus,data\n";
-    for (auto e : msg_id ? can->events(*msg_id) : can->allEvents()) {
-      stream << QString::number((e->mono_time / 1e9) - start_time, 'f', 2) << ","
-             << "0x" << QString::number(e->address, 16) << "," << e->src << ","
-             << "0x" << QByteArray::fromRawData((const char *)e->dat, e->size).toHex().toUpper() << "\n";
-    }
+  if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate)) return false;
+
+  const uint64_t start_time = can->routeStartTime();
+  QTextStream stream(&file);
+  stream << "time,addr,bus,data\n";
+  for (auto e : msg_id ? can->events(*msg_id) : can->allEvents()) {
+    stream << QString::number((e->mono_time / 1e9) - start_time, 'f', 2) << ","
+           << "0x" << QString::number(e->address, 16) << "," << e->src << ","
+           << "0x" << QByteArray::fromRawData((const char *)e->dat, e->size).toHex().toUpper() << "\n";
   }
+  return finishCSV(file, stream);
 }
 
-void exportSignalsToCSV(const QString &file_name, const MessageId &msg_id) {
+bool exportSignalsToCSV(const QString &file_name, const MessageId &msg_id) {
   QFile file(file_name);
   if (auto msg = dbc()->msg(msg_id); msg && msg->sigs.size() && file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
     QTextStream stream(&file);
@@ -30,18 +42,97 @@ void exportSignalsToCSV(const QString &file_name, const MessageId &msg_id) {
       stream << "," << s->name;
     stream << "\n";
 
+    std::vector<std::shared_ptr<const SignalValues>> sig_values;
+    for (auto s : msg->sigs)
+      sig_values.push_back(can->signalValues(msg_id, s));
+
     const uint64_t start_time = can->routeStartTime();
-    for (auto e : can->events(msg_id)) {
+    const auto &events = can->events(msg_id);
+    for (size_t i = 0; i < events.size(); ++i) {
+      const CanEvent *e = events[i];
       stream << QString::number((e->mono_time / 1e9) - start_time, 'f', 2) << ","
              << "0x" << QString::number(e->address, 16) << "," << e->src;
-      for (auto s : msg->sigs) {
-        double value = 0;
-        s->getValue(e->dat, e->size, &value);
-        stream << "," << QString::number(value, 'f', s->precision);
+      for (int j = 0; j < msg->sigs.size(); ++j) {
+        const double value = sig_values[j]->values[i];
+        stream << "," << QString::number(std::isnan(value) ? 0 : value, 'f', msg->sigs[j]->precision);
       }
       stream << "\n";
     }
+    return finishCSV(file, stream);
+  }
+  return false;
+}
+
+bool exportToArrow(const QString &file_name, std::optional<MessageId> msg_id) {
+  ArrowWriter writer(file_name.toStdString(), {{"time", ArrowWriter::Type::Float64}, {"addr", ArrowWriter::Type::UInt32},
+                                               {"bus", ArrowWriter::Type::UInt8}, {"data", ArrowWriter::Type::Binary}});
+  const double start_time = can->routeStartTime();
+  const auto &events = msg_id ? can->events(*msg_id) : can->allEvents();
+
+  std::vector<double> times;
+  std::vector<uint32_t> addrs;
+  std::vector<uint8_t> buses, data;
+  std::vector<int32_t> offsets;
+  for (size_t begin = 0; begin < events.size(); begin += EXPORT_BATCH_SIZE) {
+    const size_t length = std::min<size_t>(EXPORT_BATCH_SIZE, events.size() - begin);
+    times.clear();
+    addrs.clear();
+    buses.clear();
+    data.clear();
+    offsets.assign(1, 0);
+    for (size_t i = begin; i < begin + length; ++i) {
+      const CanEvent *e = events[i];
+      times.push_back(e->mono_time / 1e9 - start_time);
+      addrs.push_back(e->address);
+      buses.push_back(e->src);
+      data.insert(data.end(), e->dat, e->dat + e->size);
+      offsets.push_back(data.size());
+    }
+    if (!writer.writeBatch(length, {ArrowWriter::column(times.data(), length), ArrowWriter::column(addrs.data(), length),
+                                    ArrowWriter::column(buses.data(), length), ArrowWriter::column(data, offsets)})) {
+      return false;
+    }
+  }
+  return writer.finish();
+}
+
+bool exportSignalsToArrow(const QString &file_name, const MessageId &msg_id) {
+  auto msg = dbc()->msg(msg_id);
+  if (!msg || msg->sigs.empty()) return false;
+
+  std::vector<ArrowWriter::Field> fields = {{"time", ArrowWriter::Type::Float64}, {"addr", ArrowWriter::Type::UInt32},
+                                            {"bus", ArrowWriter::Type::UInt8}};
+  for (auto s : msg->sigs) {
+    fields.push_back({s->name.toStdString(), ArrowWriter::Type::Float64});
+  }
+  ArrowWriter writer(file_name.toStdString(), fields);
+
+  // decode the signals in parallel, the batches below are slices of the decoded values
+  std::vector<int> indexes(msg->sigs.size());
+  std::iota(indexes.begin(), indexes.end(), 0);
+  std::vector<std::shared_ptr<const SignalValues>> sig_values(msg->sigs.size());
+  QtConcurrent::blockingMap(indexes, [&](int i) { sig_values[i] = can->signalValues(msg_id, msg->sigs[i]); });
+
+  const double start_time = can->routeStartTime();
+  const auto &events = can->events(msg_id);
+  std::vector<double> times;
+  std::vector<uint32_t> addrs(std::min<size_t>(EXPORT_BATCH_SIZE, events.size()), msg_id.address);
+  std::vector<uint8_t> buses(addrs.size(), msg_id.source);
+  std::vector<ArrowWriter::Column> columns;
+  for (size_t begin = 0; begin < events.size(); begin += EXPORT_BATCH_SIZE) {
+    const size_t length = std::min<size_t>(EXPORT_BATCH_SIZE, events.size() - begin);
+    times.clear();
+    for (size_t i = begin; i < begin + length; ++i) {
+      times.push_back(events[i]->mono_time / 1e9 - start_time);
+    }
+    columns = {ArrowWriter::column(times.data(), length), ArrowWriter::column(addrs.data(), length),
+               ArrowWriter::column(buses.data(), length)};
+    for (auto &v : sig_values) {
+      columns.push_back(ArrowWriter::column(v->values.data() + begin, length));
+    }
+    if (!writer.writeBatch(length, columns)) return false;
   }
+  return writer.finish();
 }
 
 }  // namespace utils
@@ -2,9 +2,23 @@
 
 #include <optional>
 
+#include <QFileInfo>
+
 #include "tools/cabana/dbc/dbcmanager.h"
 
 namespace utils {
-void exportToCSV(const QString &file_name, std::optional<MessageId> msg_id = std::nullopt);
-void exportSignalsToCSV(const QString &file_name, const MessageId &msg_id);
+// the exports return false if the file couldn't be written completely
+bool exportToCSV(const QString &file_name, std::optional<MessageId> msg_id = std::nullopt);
+bool exportSignalsToCSV(const QString &file_name, const MessageId &msg_id);
+// Arrow IPC (Feather v2) files, written in record batches of EXPORT_BATCH_SIZE events.
+// unlike the CSV export, signals not present in a multiplexed message are NaN.
+const int EXPORT_BATCH_SIZE = 64 * 1024;
+bool exportToArrow(const QString &file_name, std::optional<MessageId> msg_id = std::nullopt);
+bool exportSignalsToArrow(const QString &file_name, const MessageId &msg_id);
+const QString EXPORT_FILE_FILTERS = "csv (*.csv);;Arrow IPC (*.arrow *.feather)";
+// the format from the file suffix, or from the filter chosen in the save dialog
+inline bool isArrowFile(const QString &file_name, const QString &selected_filter = {}) {
+  const QString suffix = QFileInfo(file_name).suffix().toLower();
+  return suffix == "arrow" || suffix == "feather" || (suffix != "csv" && selected_filter.startsWith("Arrow"));
+}
 }  // namespace utils
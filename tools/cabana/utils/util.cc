@@ -2,9 +2,11 @@
 
 #include <algorithm>
 #include <csignal>
+#include <iterator>
 #include <limits>
 #include <memory>
 #include <string>
+#include <tuple>
 #include <sys/socket.h>
 #include <unistd.h>
 
@@ -20,33 +22,75 @@
 
 void SegmentTree::build(const std::vector<QPointF> &arr) {
   size = arr.size();
-  tree.resize(4 * size);  // size of the tree is 4 times the size of the array
-  if (size > 0) {
-    build_tree(arr, 1, 0, size - 1);
+  tree.resize(2 * size);
+  for (int i = 0; i < size; ++i) {
+    tree[size + i] = {(uint32_t)i, (uint32_t)i};
+  }
+  for (int n = size - 1; n > 0; --n) {
+    const auto &l = tree[2 * n], &r = tree[2 * n + 1];
+    tree[n] = {arr[l.first].y() <= arr[r.first].y() ? l.first : r.first,
+               arr[l.second].y() >= arr[r.second].y() ? l.second : r.second};
   }
 }
 
-void SegmentTree::build_tree(const std::vector<QPointF> &arr, int n, int left, int right) {
-  if (left == right) {
-    const double y = arr[left].y();
-    tree[n] = {y, y};
-  } else {
-    const int mid = (left + right) >> 1;
-    build_tree(arr, 2 * n, left, mid);
-    build_tree(arr, 2 * n + 1, mid + 1, right);
-    tree[n] = {std::min(tree[2 * n].first, tree[2 * n + 1].first), std::max(tree[2 * n].second, tree[2 * n + 1].second)};
+std::pair<int, int> SegmentTree::minmaxIndex(const std::vector<QPointF> &arr, int left, int right) const {
+  left = std::max(left, 0);
+  right = std::min(right, size);
+  if (left >= right) return {-1, -1};
+
+  int min_idx = left, max_idx = left;
+  auto merge = [&](const std::pair<uint32_t, uint32_t> &node) {
+    if (arr[node.first].y() < arr[min_idx].y()) min_idx = node.first;
+    if (arr[node.second].y() > arr[max_idx].y()) max_idx = node.second;
+  };
+  for (int l = left + size, r = right + size; l < r; l >>= 1, r >>= 1) {
+    if (l & 1) merge(tree[l++]);
+    if (r & 1) merge(tree[--r]);
   }
+  return {min_idx, max_idx};
+}
+
+std::pair<double, double> SegmentTree::minmax(const std::vector<QPointF> &arr, int left, int right) const {
+  auto [min_idx, max_idx] = minmaxIndex(arr, left, right + 1);
+  if (min_idx < 0) return {std::numeric_limits<double>::max(), std::numeric_limits<double>::lowest()};
+  return {arr[min_idx].y(), arr[max_idx].y()};
 }
 
-std::pair<double, double> SegmentTree::get_minmax(int n, int left, int right, int range_left, int range_right) const {
-  if (range_left > right || range_right < left)
-    return {std::numeric_limits<double>::max(), std::numeric_limits<double>::lowest()};
-  if (range_left <= left && range_right >= right)
-    return tree[n];
-  int mid = (left + right) >> 1;
-  auto l = get_minmax(2 * n, left, mid, range_left, range_right);
-  auto r = get_minmax(2 * n + 1, mid + 1, right, range_left, range_right);
-  return {std::min(l.first, r.first), std::max(l.second, r.second)};
+void decimateSeries(const std::vector<QPointF> &arr, const SegmentTree *tree, double min_x, double max_x, int columns, QVector<QPointF> &out) {
+  auto x_less = [](const QPointF &p, double x) { return p.x() < x; };
+  const int begin = std::lower_bound(arr.cbegin(), arr.cend(), min_x, x_less) - arr.cbegin();
+  const int end = std::lower_bound(arr.cbegin() + begin, arr.cend(), max_x, x_less) - arr.cbegin();
+  const int first = std::max(begin - 1, 0);
+  const int last = std::min<int>(end + 1, arr.size());
+
+  out.clear();
+  if (last - first <= columns * 2) {
+    out.reserve(last - first);
+    std::copy(arr.cbegin() + first, arr.cbegin() + last, std::back_inserter(out));
+    return;
+  }
+
+  const double column_width = (max_x - min_x) / columns;
+  out.reserve(columns * 2 + 2);
+  if (first < begin) out.push_back(arr[first]);
+  for (int i = 1, left = begin; i <= columns && left < end; ++i) {
+    int right = i == columns ? end : std::lower_bound(arr.cbegin() + left, arr.cbegin() + end, min_x + column_width * i, x_less) - arr.cbegin();
+    if (right > left) {
+      int min_idx = left, max_idx = left;
+      if (tree) {
+        std::tie(min_idx, max_idx) = tree->minmaxIndex(arr, left, right);
+      } else {
+        for (int j = left + 1; j < right; ++j) {
+          if (arr[j].y() < arr[min_idx].y()) min_idx = j;
+          if (arr[j].y() > arr[max_idx].y()) max_idx = j;
+        }
+      }
+      out.push_back(arr[std::min(min_idx, max_idx)]);
+      if (min_idx != max_idx) out.push_back(arr[std::max(min_idx, max_idx)]);
+    }
+    left = right;
+  }
+  if (end < last) out.push_back(arr[end]);
 }
 
 // MessageBytesDelegate
@@ -17,6 +17,7 @@
 #include <QStringBuilder>
 #include <QStyledItemDelegate>
 #include <QToolButton>
+#include <QVector>
 
 #include "tools/cabana/dbc/dbc.h"
 #include "tools/cabana/settings.h"
@@ -52,19 +53,27 @@ enum {
   BytesRole = Qt::UserRole + 2
 };
 
+// Min/max pyramid over the y values of a series: a bottom-up segment tree of point indexes,
+// the leaves are the points and every level above covers twice the range of the one below.
 class SegmentTree {
 public:
   SegmentTree() = default;
   void build(const std::vector<QPointF> &arr);
-  inline std::pair<double, double> minmax(int left, int right) const { return get_minmax(1, 0, size - 1, left, right); }
+  // min/max y value of arr[left, right], arr is the vector the tree was last built over
+  std::pair<double, double> minmax(const std::vector<QPointF> &arr, int left, int right) const;
+  // indexes of the min and max y value in arr[left, right)
+  std::pair<int, int> minmaxIndex(const std::vector<QPointF> &arr, int left, int right) const;
+  inline int count() const { return size; }
 
 private:
-  std::pair<double, double> get_minmax(int n, int left, int right, int range_left, int range_right) const;
-  void build_tree(const std::vector<QPointF> &arr, int n, int left, int right);
-  std::vector<std::pair<double, double>> tree;
+  std::vector<std::pair<uint32_t, uint32_t>> tree;
   int size = 0;
 };
 
+// Reduces the points of arr within [min_x, max_x] to at most two (the min and the max) per pixel column,
+// plus the closest point outside the range on each side. Uses tree for the lookups if it's built over arr.
+void decimateSeries(const std::vector<QPointF> &arr, const SegmentTree *tree, double min_x, double max_x, int columns, QVector<QPointF> &out);
+
 class MessageBytesDelegate : public QStyledItemDelegate {
   Q_OBJECT
 public:
@@ -35,6 +35,7 @@ function install_ubuntu_common_requirements() {
     libavutil-dev \
     libavfilter-dev \
     libbz2-dev \
+    libzstd-dev \
     libeigen3-dev \
     libffi-dev \
     libglew-dev \
@@ -49,6 +49,7 @@ brew "cppcheck"
 brew "git-lfs"
 brew "zlib"
 brew "bzip2"
+brew "zstd"
 brew "capnp"
 brew "coreutils"
 brew "eigen"
@@ -0,0 +1,306 @@
+#include "tools/replay/arrow_writer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace {
+
+// https://github.com/apache/arrow/blob/main/format/Schema.fbs and Message.fbs
+const int16_t METADATA_V5 = 4;
+const uint8_t TYPE_INT = 2, TYPE_FLOATING_POINT = 3, TYPE_BINARY = 4;
+const uint8_t HEADER_SCHEMA = 1, HEADER_RECORD_BATCH = 3;
+const int16_t PRECISION_DOUBLE = 2;
+const char MAGIC[8] = "ARROW1";
+const uint32_t CONTINUATION = 0xFFFFFFFF;
+
+struct FieldNode {
+  int64_t length;
+  int64_t null_count;
+};
+
+struct Buffer {
+  int64_t offset;
+  int64_t length;
+};
+
+struct FooterBlock {
+  int64_t offset;
+  int32_t meta_data_length;
+  int32_t padding;
+  int64_t body_length;
+};
+
+inline size_t padded(size_t size) { return (size + 7) & ~size_t(7); }
+
+// just enough of a flatbuffers builder for the Arrow metadata. like the real one, the buffer is built
+// back to front so that every referenced object is finished before the object referring to it.
+// offsets returned are counted from the end of the buffer.
+class FlatBufferBuilder {
+public:
+  uint32_t size() const { return buf_.size() - head_; }
+
+  template <class T>
+  void add(T v) {
+    align(sizeof(T));
+    prepend(&v, sizeof(T));
+  }
+
+  uint32_t createString(const std::string &s) {
+    align(sizeof(uint32_t), s.size() + 1);
+    fill(1);
+    prepend(s.data(), s.size());
+    add<uint32_t>(s.size());
+    return size();
+  }
+
+  // vector of structs, data is the serialized elements in order
+  uint32_t createVector(const void *data, size_t count, size_t elem_size, size_t alignment) {
+    align(sizeof(uint32_t), count * elem_size);
+    align(alignment, count * elem_size);
+    prepend(data, count * elem_size);
+    add<uint32_t>(count);
+    return size();
+  }
+
+  uint32_t createVector(const std::vector<uint32_t> &tables) {
+    align(sizeof(uint32_t), tables.size() * sizeof(uint32_t));
+    for (auto it = tables.rbegin(); it != tables.rend(); ++it) {
+      add<uint32_t>(size() + sizeof(uint32_t) - *it);
+    }
+    add<uint32_t>(tables.size());
+    return size();
+  }
+
+  void startTable() {
+    fields_.clear();
+    table_start_ = size();
+  }
+
+  template <class T>
+  void addField(uint16_t id, T v) {
+    add(v);
+    fields_.push_back({id, size()});
+  }
+
+  void addOffset(uint16_t id, uint32_t ref) {
+    align(sizeof(uint32_t));
+    add<uint32_t>(size() + sizeof(uint32_t) - ref);
+    fields_.push_back({id, size()});
+  }
+
+  uint32_t endTable() {
+    add<int32_t>(0);
+    const uint32_t table = size();
+    uint16_t num_fields = 0;
+    for (auto &[id, _] : fields_) num_fields = std::max<uint16_t>(num_fields, id + 1);
+    std::vector<uint16_t> vtable(num_fields, 0);
+    for (auto &[id, pos] : fields_) vtable[id] = table - pos;
+    for (auto it = vtable.rbegin(); it != vtable.rend(); ++it) add<uint16_t>(*it);
+    add<uint16_t>(table - table_start_);
+    add<uint16_t>((num_fields + 2) * sizeof(uint16_t));
+    // the vtable is found at table - soffset
+    const int32_t soffset = size() - table;
+    memcpy(&buf_[buf_.size() - table], &soffset, sizeof(soffset));
+    return table;
+  }
+
+  std::string finish(uint32_t root) {
+    align(min_align_, sizeof(uint32_t));
+    add<uint32_t>(size() + sizeof(uint32_t) - root);
+    return std::string((const char *)&buf_[head_], size());
+  }
+
+private:
+  void align(size_t alignment, size_t additional = 0) {
+    min_align_ = std::max(min_align_, alignment);
+    fill((alignment - (size() + additional) % alignment) % alignment);
+  }
+
+  void reserve(size_t n) {
+    if (head_ < n) {
+      const size_t used = size();
+      std::vector<uint8_t> buf(std::max(buf_.size() * 2, used + n));
+      std::copy(buf_.end() - used, buf_.end(), buf.end() - used);
+      head_ = buf.size() - used;
+      buf_ = std::move(buf);
+    }
+  }
+
+  void prepend(const void *data, size_t n) {
+    if (n == 0) return;
+    reserve(n);
+    head_ -= n;
+    memcpy(&buf_[head_], data, n);
+  }
+
+  void fill(size_t n) {
+    reserve(n);
+    head_ -= n;
+    memset(&buf_[head_], 0, n);
+  }
+
+  std::vector<uint8_t> buf_ = std::vector<uint8_t>(1024);
+  size_t head_ = 1024;
+  size_t min_align_ = 1;
+  uint32_t table_start_ = 0;
+  std::vector<std::pair<uint16_t, uint32_t>> fields_;
+};
+
+uint32_t buildSchema(FlatBufferBuilder &fbb, const std::vector<ArrowWriter::Field> &fields) {
+  std::vector<uint32_t> field_tables;
+  for (const auto &f : fields) {
+    const uint32_t name = fbb.createString(f.name);
+    const uint32_t children = fbb.createVector(std::vector<uint32_t>{});
+
+    uint8_t type_type = TYPE_BINARY;
+    fbb.startTable();
+    switch (f.type) {
+      case ArrowWriter::Type::UInt8:
+      case ArrowWriter::Type::UInt32:
+      case ArrowWriter::Type::UInt64:
+        type_type = TYPE_INT;
+        fbb.addField<int32_t>(0, f.type == ArrowWriter::Type::UInt8 ? 8 : f.type == ArrowWriter::Type::UInt32 ? 32 : 64);
+        fbb.addField<uint8_t>(1, false);  // is_signed
+        break;
+      case ArrowWriter::Type::Float64:
+        type_type = TYPE_FLOATING_POINT;
+        fbb.addField<int16_t>(0, PRECISION_DOUBLE);
+        break;
+      case ArrowWriter::Type::Binary:
+        break;
+    }
+    const uint32_t type = fbb.endTable();
+
+    fbb.startTable();
+    fbb.addOffset(0, name);
+    fbb.addField<uint8_t>(1, true);  // nullable
+    fbb.addField<uint8_t>(2, type_type);
+    fbb.addOffset(3, type);
+    fbb.addOffset(5, children);
+    field_tables.push_back(fbb.endTable());
+  }
+  const uint32_t fields_vector = fbb.createVector(field_tables);
+
+  fbb.startTable();
+  fbb.addField<int16_t>(0, 0);  // little endian
+  fbb.addOffset(1, fields_vector);
+  return fbb.endTable();
+}
+
+std::string buildMessage(FlatBufferBuilder &fbb, uint8_t header_type, uint32_t header, int64_t body_length) {
+  fbb.startTable();
+  fbb.addField<int16_t>(0, METADATA_V5);
+  fbb.addField<uint8_t>(1, header_type);
+  fbb.addOffset(2, header);
+  fbb.addField<int64_t>(3, body_length);
+  return fbb.finish(fbb.endTable());
+}
+
+}  // namespace
+
+ArrowWriter::ArrowWriter(const std::string &file_name, const std::vector<Field> &fields) : fields_(fields) {
+  file_ = fopen(file_name.c_str(), "wb");
+  ok_ = file_ != nullptr;
+  write(MAGIC, sizeof(MAGIC));
+
+  FlatBufferBuilder fbb;
+  const uint32_t schema = buildSchema(fbb, fields_);
+  writeMessage(buildMessage(fbb, HEADER_SCHEMA, schema, 0), {});
+}
+
+ArrowWriter::~ArrowWriter() {
+  finish();
+}
+
+bool ArrowWriter::writeBatch(int64_t length, const std::vector<Column> &columns) {
+  assert(columns.size() == fields_.size());
+  std::vector<FieldNode> nodes;
+  std::vector<Buffer> buffers;
+  std::vector<std::pair<const void *, size_t>> body;
+  int64_t body_length = 0;
+  auto add_buffer = [&](const void *data, size_t size) {
+    buffers.push_back({body_length, (int64_t)size});
+    body.push_back({data, size});
+    body_length += padded(size);
+  };
+
+  for (size_t i = 0; i < fields_.size(); ++i) {
+    nodes.push_back({length, 0});
+    add_buffer(nullptr, 0);  // validity bitmap, may be omitted when there are no nulls
+    if (fields_[i].type == Type::Binary) {
+      assert(columns[i].offsets && columns[i].offsets[0] == 0 && (size_t)columns[i].offsets[length] == columns[i].size);
+      add_buffer(columns[i].offsets, (length + 1) * sizeof(int32_t));
+    }
+    add_buffer(columns[i].data, columns[i].size);
+  }
+
+  FlatBufferBuilder fbb;
+  const uint32_t buffers_vector = fbb.createVector(buffers.data(), buffers.size(), sizeof(Buffer), alignof(Buffer));
+  const uint32_t nodes_vector = fbb.createVector(nodes.data(), nodes.size(), sizeof(FieldNode), alignof(FieldNode));
+  fbb.startTable();
+  fbb.addField<int64_t>(0, length);
+  fbb.addOffset(1, nodes_vector);
+  fbb.addOffset(2, buffers_vector);
+  const uint32_t record_batch = fbb.endTable();
+
+  const int64_t offset = offset_;
+  writeMessage(buildMessage(fbb, HEADER_RECORD_BATCH, record_batch, body_length), body);
+  record_batches_.push_back({offset, (int32_t)(offset_ - offset - body_length), body_length});
+  return ok_;
+}
+
+bool ArrowWriter::finish() {
+  if (!file_) return false;
+
+  // end-of-stream marker
+  const uint32_t eos[] = {CONTINUATION, 0};
+  write(eos, sizeof(eos));
+
+  std::vector<FooterBlock> blocks;
+  for (auto &b : record_batches_) blocks.push_back({b.offset, b.meta_data_length, 0, b.body_length});
+  FlatBufferBuilder fbb;
+  const uint32_t record_batches = fbb.createVector(blocks.data(), blocks.size(), sizeof(FooterBlock), alignof(FooterBlock));
+  const uint32_t dictionaries = fbb.createVector(nullptr, 0, sizeof(FooterBlock), alignof(FooterBlock));
+  const uint32_t schema = buildSchema(fbb, fields_);
+  fbb.startTable();
+  fbb.addField<int16_t>(0, METADATA_V5);
+  fbb.addOffset(1, schema);
+  fbb.addOffset(2, dictionaries);
+  fbb.addOffset(3, record_batches);
+  const std::string footer = fbb.finish(fbb.endTable());
+
+  const int32_t footer_size = footer.size();
+  write(footer.data(), footer.size());
+  write(&footer_size, sizeof(footer_size));
+  write(MAGIC, strlen(MAGIC));
+
+  ok_ = fclose(file_) == 0 && ok_;
+  file_ = nullptr;
+  return ok_;
+}
+
+void ArrowWriter::writeMessage(const std::string &metadata, const std::vector<std::pair<const void *, size_t>> &body) {
+  // continuation marker and the metadata size, then the metadata padded to 8 bytes and the body
+  const int32_t metadata_size = padded(metadata.size());
+  write(&CONTINUATION, sizeof(CONTINUATION));
+  write(&metadata_size, sizeof(metadata_size));
+  write(metadata.data(), metadata.size());
+  writePadding(metadata_size - metadata.size());
+  for (auto &[data, size] : body) {
+    write(data, size);
+    writePadding(padded(size) - size);
+  }
+}
+
+void ArrowWriter::write(const void *data, size_t size) {
+  if (ok_ && size > 0) {
+    ok_ = fwrite(data, 1, size, file_) == size;
+    offset_ += size;
+  }
+}
+
+void ArrowWriter::writePadding(size_t size) {
+  static const uint8_t zeros[8] = {};
+  write(zeros, size);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Minimal writer for the Arrow IPC file format (Feather v2), readable by pyarrow, pandas, polars, etc.
+// Columns are uncompressed, without nulls, and written as a sequence of record batches so that
+// large exports are streamed to disk instead of built in memory.
+class ArrowWriter {
+public:
+  enum class Type { UInt8, UInt32, UInt64, Float64, Binary };
+  struct Field {
+    std::string name;
+    Type type;
+  };
+  // A view of one column of a record batch. for Binary columns data is the concatenated values,
+  // and offsets has length + 1 entries into data.
+  struct Column {
+    const void *data = nullptr;
+    size_t size = 0;
+    const int32_t *offsets = nullptr;
+  };
+  template <class T>
+  static Column column(const T *values, size_t length) { return {values, length * sizeof(T)}; }
+  static Column column(const std::vector<uint8_t> &data, const std::vector<int32_t> &offsets) {
+    return {data.data(), data.size(), offsets.data()};
+  }
+
+  ArrowWriter(const std::string &file_name, const std::vector<Field> &fields);
+  ~ArrowWriter();
+  bool writeBatch(int64_t length, const std::vector<Column> &columns);
+  // writes the footer and closes the file, returns false if any write failed
+  bool finish();
+
+private:
+  struct Block {
+    int64_t offset;
+    int32_t meta_data_length;
+    int64_t body_length;
+  };
+  void writeMessage(const std::string &metadata, const std::vector<std::pair<const void *, size_t>> &body);
+  void write(const void *data, size_t size);
+  void writePadding(size_t size);
+
+  FILE *file_ = nullptr;
+  bool ok_ = false;
+  int64_t offset_ = 0;
+  std::vector<Field> fields_;
+  std::vector<Block> record_batches_;
+};
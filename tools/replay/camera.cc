@@ -78,7 +78,9 @@ void CameraServer::cameraThread(Camera &cam) {
     // Prefetch the next frame
     getFrame(cam, fr, segment_id + 1, frame_id + 1);
 
-    --publishing_;
+    if (--publishing_ == 0) {
+      sent_.notify();
+    }
   }
 }
 
@@ -111,7 +113,5 @@ void CameraServer::pushFrame(CameraType type, FrameReader *fr, const Event *even
 }
 
 void CameraServer::waitForSent() {
-  while (publishing_ > 0) {
-    std::this_thread::yield();
-  }
+  sent_.wait([this] { return publishing_ == 0; });
 }
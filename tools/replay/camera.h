@@ -26,7 +26,7 @@ protected:
     int width;
     int height;
     std::thread thread;
-    SafeQueue<std::pair<FrameReader*, const Event *>> queue;
+    SPSCQueue<std::pair<FrameReader*, const Event *>, 16> queue;
     std::set<VisionBuf *> cached_buf;
   };
   void startVipcServer();
@@ -39,5 +39,6 @@ protected:
       {.type = WideRoadCam, .stream_type = VISION_STREAM_WIDE_ROAD},
   };
   std::atomic<int> publishing_ = 0;
+  EventCount sent_;
   std::unique_ptr<VisionIpcServer> vipc_server_;
 };
@@ -1,10 +1,104 @@
+#include <cstdio>
+#include <numeric>
+
 #include <QApplication>
 #include <QCommandLineParser>
+#include <QThread>
+#include <QtConcurrent>
 
 #include "common/prefix.h"
+#include "tools/replay/arrow_writer.h"
 #include "tools/replay/consoleui.h"
 #include "tools/replay/replay.h"
 
+// headless export of the CAN messages in the route. segments are parsed in parallel,
+// a few at a time, and written in order as one record batch per segment.
+// a segment that fails to load fails the export, unless allow_missing leaves it out.
+static bool exportCan(const QString &route_name, const QString &data_dir, uint32_t flags, const QString &file_name, bool allow_missing) {
+  Route route(route_name, data_dir);
+  if (!route.load()) {
+    rError("failed to load route %s", route_name.toStdString().c_str());
+    return false;
+  }
+
+  struct Batch {
+    bool loaded = false;
+    std::vector<uint64_t> mono_times;
+    std::vector<uint32_t> addrs;
+    std::vector<uint8_t> buses, data;
+    std::vector<int32_t> offsets = {0};
+  };
+  std::vector<bool> filters(capnp::Schema::from<cereal::Event>().asStruct().getUnionFields().size(), false);
+  filters[cereal::Event::Which::CAN] = true;
+  std::vector<int> segments;
+  std::vector<QString> logs;
+  for (const auto &[n, files] : route.segments()) {
+    segments.push_back(n);
+    logs.push_back(files.rlog.isEmpty() ? files.qlog : files.rlog);
+  }
+
+  ArrowWriter writer(file_name.toStdString(), {{"mono_time", ArrowWriter::Type::UInt64}, {"addr", ArrowWriter::Type::UInt32},
+                                               {"bus", ArrowWriter::Type::UInt8}, {"data", ArrowWriter::Type::Binary}});
+  // no partial file is left behind
+  auto fail = [&]() {
+    writer.finish();
+    std::remove(file_name.toStdString().c_str());
+    return false;
+  };
+  const size_t window = std::max(1, QThread::idealThreadCount());
+  for (size_t begin = 0; begin < logs.size(); begin += window) {
+    std::vector<Batch> batches(std::min(window, logs.size() - begin));
+    std::vector<int> indexes(batches.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    QtConcurrent::blockingMap(indexes, [&](int i) {
+      LogReader log(filters);
+      const std::string url = logs[begin + i].toStdString();
+      if (url.empty() || !log.load(url, nullptr, !(flags & REPLAY_FLAG_NO_FILE_CACHE), 0, 3)) {
+        return;
+      }
+      Batch &b = batches[i];
+      b.loaded = true;
+      for (const Event &e : log.events) {
+        capnp::FlatArrayMessageReader reader(e.data);
+        for (const auto &c : reader.getRoot<cereal::Event>().getCan()) {
+          b.mono_times.push_back(e.mono_time);
+          b.addrs.push_back(c.getAddress());
+          b.buses.push_back(c.getSrc());
+          auto dat = c.getDat();
+          b.data.insert(b.data.end(), dat.begin(), dat.end());
+          b.offsets.push_back(b.data.size());
+        }
+      }
+    });
+
+    for (size_t i = 0; i < batches.size(); ++i) {
+      const Batch &b = batches[i];
+      if (!b.loaded) {
+        if (!allow_missing) {
+          rError("failed to load segment %d, pass --allow-missing to export without it", segments[begin + i]);
+          return fail();
+        }
+        rWarning("failed to load segment %d, it's missing from the export", segments[begin + i]);
+        continue;
+      }
+      const size_t length = b.addrs.size();
+      if (!writer.writeBatch(length, {ArrowWriter::column(b.mono_times.data(), length), ArrowWriter::column(b.addrs.data(), length),
+                                      ArrowWriter::column(b.buses.data(), length), ArrowWriter::column(b.data, b.offsets)})) {
+        rError("failed to write %s", file_name.toStdString().c_str());
+        return fail();
+      }
+    }
+    rInfo("exported %zu/%zu segments", begin + batches.size(), logs.size());
+  }
+
+  if (!writer.finish()) {
+    rError("failed to write %s", file_name.toStdString().c_str());
+    std::remove(file_name.toStdString().c_str());
+    return false;
+  }
+  return true;
+}
+
 int main(int argc, char *argv[]) {
 #ifdef __APPLE__
   // With all sockets opened, we might hit the default limit of 256 on macOS
@@ -38,6 +132,8 @@ int main(int argc, char *argv[]) {
   parser.addOption({"demo", "use a demo route instead of providing your own"});
   parser.addOption({"data_dir", "local directory with routes", "data_dir"});
   parser.addOption({"prefix", "set OPENPILOT_PREFIX", "prefix"});
+  parser.addOption({"export", "export the CAN messages to an Arrow IPC <file> and exit", "file"});
+  parser.addOption({"allow-missing", "with --export, leave out segments that fail to load instead of failing"});
   for (auto &[name, _, desc] : flags) {
     parser.addOption({name, desc});
   }
@@ -65,6 +161,10 @@ int main(int argc, char *argv[]) {
     op_prefix.reset(new OpenpilotPrefix(prefix.toStdString()));
   }
 
+  if (parser.isSet("export")) {
+    return exportCan(route, parser.value("data_dir"), replay_flags, parser.value("export"), parser.isSet("allow-missing")) ? 0 : 1;
+  }
+
   Replay *replay = new Replay(route, allow, block, nullptr, replay_flags, parser.value("data_dir"), &app);
   if (!parser.value("c").isEmpty()) {
     replay->setSegmentCacheLimit(parser.value("c").toInt());
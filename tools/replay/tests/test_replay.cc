@@ -5,6 +5,7 @@
 
 #include "catch2/catch.hpp"
 #include "common/util.h"
+#include "tools/replay/arrow_writer.h"
 #include "tools/replay/replay.h"
 #include "tools/replay/util.h"
 
@@ -135,6 +136,48 @@ std::string download_demo_route() {
 }
 
 
+TEST_CASE("ArrowWriter") {
+  char filename[] = "/tmp/XXXXXX";
+  close(mkstemp(filename));
+
+  const std::vector<uint64_t> mono_times = {1, 2, 3, 4, 5};
+  const std::vector<uint8_t> data = {0xaa, 0xbb, 0xcc};
+  const std::vector<int32_t> offsets = {0, 1, 1, 2, 3, 3};
+  {
+    ArrowWriter writer(filename, {{"mono_time", ArrowWriter::Type::UInt64}, {"data", ArrowWriter::Type::Binary}});
+    for (int i = 0; i < 2; ++i) {
+      REQUIRE(writer.writeBatch(mono_times.size(), {ArrowWriter::column(mono_times.data(), mono_times.size()),
+                                                    ArrowWriter::column(data, offsets)}));
+    }
+    REQUIRE(writer.finish());
+  }
+
+  std::string content = util::read_file(filename);
+  REQUIRE(content.size() % 8 == 2);
+  REQUIRE(content.substr(0, 6) == "ARROW1");
+  REQUIRE(content.substr(content.size() - 6) == "ARROW1");
+  int32_t footer_size = *(int32_t *)&content[content.size() - 10];
+  REQUIRE((footer_size > 0 && footer_size % 8 == 0 && (size_t)footer_size < content.size()));
+
+  // the body of each record batch: 8 byte aligned mono_times, offsets and data
+  std::string values((const char *)mono_times.data(), mono_times.size() * sizeof(uint64_t));
+  size_t pos = content.find(values);
+  REQUIRE((pos != std::string::npos && pos % 8 == 0));
+  REQUIRE(content.find(values, pos + values.size()) != std::string::npos);
+  REQUIRE(content.compare(pos + 40, 24, (const char *)offsets.data(), 24) == 0);
+  REQUIRE(content.compare(pos + 64, 3, (const char *)data.data(), 3) == 0);
+
+  // and through a real Arrow reader where one is installed
+  if (std::system("python3 -c 'import pyarrow' 2>/dev/null") != 0) {
+    WARN("pyarrow not installed, skipping the pyarrow read");
+    return;
+  }
+  const std::string table = util::check_output(util::string_format(
+      "python3 -c 'import sys, pyarrow.ipc as ipc; t = ipc.open_file(sys.argv[1]).read_all(); t.validate(full=True); print(t.to_pydict())' %s", filename));
+  REQUIRE(table == "{'mono_time': [1, 2, 3, 4, 5, 1, 2, 3, 4, 5], "
+                   "'data': [b'\\xaa', b'', b'\\xbb', b'\\xcc', b'', b'\\xaa', b'', b'\\xbb', b'\\xcc', b'']}\n");
+}
+
 TEST_CASE("Local route") {
   std::string data_dir = download_demo_route();
 
@@ -362,7 +362,8 @@ void *MonotonicBuffer::allocate(size_t bytes, size_t alignment) {
   assert(bytes > 0);
   void *p = std::align(alignment, bytes, current_buf, available);
   if (p == nullptr) {
-    available = next_buffer_size = std::max(next_buffer_size, bytes);
+    // aligned_alloc wants a multiple of the alignment
+    available = next_buffer_size = (std::max(next_buffer_size, bytes) + alignment - 1) / alignment * alignment;
     current_buf = buffers.emplace_back(std::aligned_alloc(alignment, next_buffer_size));
     next_buffer_size *= growth_factor;
     p = current_buf;
@@ -25,8 +25,11 @@ class MonotonicBuffer {
 public:
   MonotonicBuffer(size_t initial_size) : next_buffer_size(initial_size) {}
   ~MonotonicBuffer();
-  void *allocate(size_t bytes, size_t alignment = 16ul);
+  void *allocate(size_t bytes, size_t alignment = default_alignment);
   void deallocate(void *p) {}
+  // the space allocate() takes up for bytes with the default alignment
+  static constexpr size_t alignedSize(size_t bytes) { return (bytes + default_alignment - 1) & ~(default_alignment - 1); }
+  static constexpr size_t default_alignment = 16;
 
 private:
   void *current_buf = nullptr;